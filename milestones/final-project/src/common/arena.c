@@ -0,0 +1,85 @@
+#include "arena.h"
+#include "memory.h"
+
+#include <stdint.h>
+#include <string.h>
+
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t size;
+    size_t used;
+    // Payload follows, aligned to ARENA_ALIGNMENT
+};
+
+#define BLOCK_HEADER_SIZE \
+    ((sizeof(ArenaBlock) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+static unsigned char* block_data(ArenaBlock *block) {
+    return (unsigned char*)block + BLOCK_HEADER_SIZE;
+}
+
+static ArenaBlock* new_block(size_t size) {
+    ArenaBlock *block = MALLOC(BLOCK_HEADER_SIZE + size);
+    if (!block) return NULL;
+
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+void arena_init(Arena *arena, size_t block_size) {
+    memset(arena, 0, sizeof(Arena));
+    arena->block_size = block_size ? block_size : ARENA_DEFAULT_BLOCK_SIZE;
+}
+
+void* arena_alloc(Arena *arena, size_t size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+    ArenaBlock *block = arena->current;
+    if (block && block->size - block->used >= size) {
+        void *ptr = block_data(block) + block->used;
+        block->used += size;
+        arena->allocated += size;
+        return ptr;
+    }
+
+    // Move on to a block kept from before the last reset if it fits,
+    // otherwise link a fresh one in after the current block
+    ArenaBlock *next = block ? block->next : arena->head;
+    if (next && next->size >= size) {
+        next->used = 0;
+    } else {
+        next = new_block(size > arena->block_size ? size : arena->block_size);
+        if (!next) return NULL;
+        arena->blocks++;
+
+        if (block) {
+            next->next = block->next;
+            block->next = next;
+        } else {
+            next->next = arena->head;
+            arena->head = next;
+        }
+    }
+
+    arena->current = next;
+    next->used = size;
+    arena->allocated += size;
+    return block_data(next);
+}
+
+void arena_reset(Arena *arena) {
+    arena->current = NULL;
+    arena->allocated = 0;
+}
+
+void arena_free(Arena *arena) {
+    ArenaBlock *block = arena->head;
+    while (block) {
+        ArenaBlock *next = block->next;
+        FREE(block);
+        block = next;
+    }
+    arena_init(arena, arena->block_size);
+}
@@ -0,0 +1,30 @@
+#ifndef DEVTOOLS_ARENA_H
+#define DEVTOOLS_ARENA_H
+
+#include <stddef.h>
+
+// Bump allocator.
+//
+// Memory is carved out of large blocks and never freed individually:
+// arena_reset() rewinds every block for reuse and arena_free() releases
+// them all at once. Requests larger than a block get a block of their own.
+
+#define ARENA_DEFAULT_BLOCK_SIZE (1024 * 1024)
+#define ARENA_ALIGNMENT 16
+
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+    ArenaBlock *head;
+    ArenaBlock *current;
+    size_t block_size;
+    size_t blocks;          // blocks obtained from the system allocator
+    size_t allocated;       // bytes handed out since the last reset
+} Arena;
+
+void arena_init(Arena *arena, size_t block_size);
+void* arena_alloc(Arena *arena, size_t size);
+void arena_reset(Arena *arena);
+void arena_free(Arena *arena);
+
+#endif // DEVTOOLS_ARENA_H
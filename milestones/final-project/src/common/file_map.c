@@ -0,0 +1,110 @@
+#include "file_map.h"
+#include "../config.h"
+#include "memory.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define READ_CHUNK_SIZE (1024 * 1024)
+
+// Shared by every empty input, so there is nothing to free
+static const char empty_input[1] = "";
+
+// The fallback: grow a heap buffer until read() reports the end. `hint`
+// is the expected size; one spare byte lets the final empty read finish
+// without doubling the buffer.
+static int read_to_end(FileMap *map, int fd, size_t hint) {
+    size_t capacity = hint > 0 ? hint + 1 : READ_CHUNK_SIZE;
+    size_t used = 0;
+    char *data = MALLOC(capacity);
+    if (!data) return ERROR_MEMORY_ALLOCATION;
+
+    for (;;) {
+        if (used == capacity) {
+            char *grown = REALLOC(data, capacity * 2);
+            if (!grown) {
+                FREE(data);
+                return ERROR_MEMORY_ALLOCATION;
+            }
+            data = grown;
+            capacity *= 2;
+        }
+
+        ssize_t n = read(fd, data + used, capacity - used);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            int saved = errno;
+            FREE(data);
+            errno = saved;
+            return ERROR_PERMISSION_DENIED;
+        }
+        if (n == 0) break;
+        used += (size_t)n;
+    }
+
+    if (used == 0) {
+        FREE(data);
+        return SUCCESS;
+    }
+
+    map->data = data;
+    map->length = used;
+    return SUCCESS;
+}
+
+int file_map_fd(FileMap *map, int fd) {
+    map->data = empty_input;
+    map->length = 0;
+    map->mapped = false;
+
+    struct stat st;
+    bool regular = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+
+    if (regular && st.st_size >= FILE_MAP_MIN_SIZE) {
+        size_t length = (size_t)st.st_size;
+        void *data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, length, MADV_SEQUENTIAL);
+            map->data = data;
+            map->length = length;
+            map->mapped = true;
+            return SUCCESS;
+        }
+    }
+
+    return read_to_end(map, fd, regular ? (size_t)st.st_size : 0);
+}
+
+int file_map_open(FileMap *map, const char *path) {
+    if (strcmp(path, "-") == 0) {
+        return file_map_fd(map, STDIN_FILENO);
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return errno == ENOENT ? ERROR_FILE_NOT_FOUND : ERROR_PERMISSION_DENIED;
+    }
+
+    int status = file_map_fd(map, fd);
+    int saved = errno;
+    close(fd);
+    errno = saved;
+    return status;
+}
+
+void file_map_close(FileMap *map) {
+    if (map->mapped) {
+        munmap((void*)map->data, map->length);
+    } else if (map->data != empty_input) {
+        char *data = (char*)map->data;
+        FREE(data);
+    }
+
+    map->data = empty_input;
+    map->length = 0;
+    map->mapped = false;
+}
@@ -0,0 +1,37 @@
+#ifndef DEVTOOLS_FILE_MAP_H
+#define DEVTOOLS_FILE_MAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Whole-file input without copying.
+//
+// Regular files are memory-mapped read-only and advised for one sequential
+// pass, so the kernel reads ahead and the bytes are scanned straight out
+// of the page cache. Pipes, terminals and other inputs that cannot be
+// mapped are read to the end into a heap buffer instead, as are small
+// files, where the mapping costs more than the copy it saves. Either way
+// the caller sees one contiguous buffer of the whole input.
+//
+// A mapped file that another process truncates while it is mapped raises
+// SIGBUS on access to the lost pages, as with any mmap-based reader.
+
+#define FILE_MAP_MIN_SIZE (64 * 1024)
+
+typedef struct {
+    const char *data;           // never NULL, even for empty input
+    size_t length;
+    bool mapped;                // data is a mapping rather than a heap buffer
+} FileMap;
+
+// Loads the input open on `fd`; the descriptor may be closed afterwards
+int file_map_fd(FileMap *map, int fd);
+
+// Opens and loads `path` ("-" for standard input). Errors leave errno set
+// and return ERROR_FILE_NOT_FOUND, ERROR_PERMISSION_DENIED or
+// ERROR_MEMORY_ALLOCATION.
+int file_map_open(FileMap *map, const char *path);
+
+void file_map_close(FileMap *map);
+
+#endif // DEVTOOLS_FILE_MAP_H
@@ -0,0 +1,135 @@
+#include "ordered_pool.h"
+#include "../config.h"
+#include "memory.h"
+#include "logging.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+
+typedef struct {
+    size_t count;
+    size_t window;
+    OrderedWorkFn work;
+    void *ctx;
+
+    pthread_mutex_t lock;
+    pthread_cond_t ready;   // an item finished (emitter waits here)
+    pthread_cond_t space;   // the window advanced (workers wait here)
+    size_t next_index;
+    size_t emitted;
+    bool *done;
+} OrderedPool;
+
+typedef struct {
+    OrderedPool *pool;
+    int id;
+} OrderedWorker;
+
+static void* ordered_worker_main(void *arg) {
+    OrderedWorker *worker = (OrderedWorker*)arg;
+    OrderedPool *pool = worker->pool;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->next_index < pool->count &&
+               pool->next_index >= pool->emitted + pool->window) {
+            pthread_cond_wait(&pool->space, &pool->lock);
+        }
+        if (pool->next_index >= pool->count) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        size_t index = pool->next_index++;
+        pthread_mutex_unlock(&pool->lock);
+
+        pool->work(index, worker->id, pool->ctx);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->done[index % pool->window] = true;
+        if (index == pool->emitted) {
+            pthread_cond_signal(&pool->ready);
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    return NULL;
+}
+
+int ordered_pool_run(size_t count, int workers, size_t window,
+                     OrderedWorkFn work, OrderedEmitFn emit, void *ctx) {
+    if (!work || !emit) return ERROR_INVALID_ARGUMENT;
+    if (count == 0) return SUCCESS;
+    if (workers < 1) workers = 1;
+    if (window < (size_t)workers) window = (size_t)workers;
+
+    OrderedPool pool;
+    memset(&pool, 0, sizeof(pool));
+    pool.count = count;
+    pool.window = window;
+    pool.work = work;
+    pool.ctx = ctx;
+
+    pool.done = MALLOC(window * sizeof(bool));
+    pthread_t *threads = MALLOC((size_t)workers * sizeof(pthread_t));
+    OrderedWorker *args = MALLOC((size_t)workers * sizeof(OrderedWorker));
+    if (!pool.done || !threads || !args) {
+        FREE(pool.done);
+        FREE(threads);
+        FREE(args);
+        return ERROR_MEMORY_ALLOCATION;
+    }
+    memset(pool.done, 0, window * sizeof(bool));
+
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.ready, NULL);
+    pthread_cond_init(&pool.space, NULL);
+
+    int started = 0;
+    for (int i = 0; i < workers; i++) {
+        args[i].pool = &pool;
+        args[i].id = i;
+        if (pthread_create(&threads[i], NULL, ordered_worker_main, &args[i]) != 0) {
+            LOG_WARN("Failed to start worker %d, continuing with %d", i, started);
+            break;
+        }
+        started++;
+    }
+
+    if (started == 0) {
+        // No threads at all: do the work inline, still in order
+        for (size_t i = 0; i < count; i++) {
+            work(i, 0, ctx);
+            emit(i, ctx);
+        }
+    } else {
+        // The calling thread drains finished items in index order
+        for (size_t i = 0; i < count; i++) {
+            pthread_mutex_lock(&pool.lock);
+            while (!pool.done[i % window]) {
+                pthread_cond_wait(&pool.ready, &pool.lock);
+            }
+            pthread_mutex_unlock(&pool.lock);
+
+            emit(i, ctx);
+
+            pthread_mutex_lock(&pool.lock);
+            pool.done[i % window] = false;
+            pool.emitted++;
+            pthread_cond_broadcast(&pool.space);
+            pthread_mutex_unlock(&pool.lock);
+        }
+    }
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool.lock);
+    pthread_cond_destroy(&pool.ready);
+    pthread_cond_destroy(&pool.space);
+    FREE(pool.done);
+    FREE(threads);
+    FREE(args);
+    return SUCCESS;
+}
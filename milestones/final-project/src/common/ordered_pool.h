@@ -0,0 +1,20 @@
+#ifndef DEVTOOLS_ORDERED_POOL_H
+#define DEVTOOLS_ORDERED_POOL_H
+
+#include <stddef.h>
+
+// Ordered parallel map.
+//
+// Runs `work` for every index in [0, count) on a pool of threads and calls
+// `emit` on the calling thread in strictly increasing index order. At most
+// `window` items can be claimed ahead of the last emitted one, so callers
+// can keep per-item results in a ring of `window` slots (index % window)
+// that acts as the reorder buffer.
+
+typedef void (*OrderedWorkFn)(size_t index, int worker, void *ctx);
+typedef void (*OrderedEmitFn)(size_t index, void *ctx);
+
+int ordered_pool_run(size_t count, int workers, size_t window,
+                     OrderedWorkFn work, OrderedEmitFn emit, void *ctx);
+
+#endif // DEVTOOLS_ORDERED_POOL_H
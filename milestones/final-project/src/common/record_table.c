@@ -0,0 +1,240 @@
+#include "record_table.h"
+#include "error.h"
+#include "logging.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+uint64_t record_table_mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+static size_t table_map_size(const RecordTable *table, uint64_t capacity) {
+    return sizeof(RecordTableHeader) + (size_t)capacity * table->record_size;
+}
+
+static inline RecordHead* slot_at(unsigned char *records, uint32_t record_size, uint64_t slot) {
+    return (RecordHead*)(records + (size_t)slot * record_size);
+}
+
+// First slot on the probe sequence of `hash` that is empty or, given a
+// match function, holds `key`
+static RecordHead* probe(unsigned char *records, uint32_t record_size, uint64_t capacity,
+                         uint64_t hash, RecordMatchFn matches, const void *key) {
+    uint64_t mask = capacity - 1;
+    uint64_t slot = hash & mask;
+
+    for (;;) {
+        RecordHead *head = slot_at(records, record_size, slot);
+        if (!head->used) return head;
+        if (matches && head->hash == hash && matches(head, key)) return head;
+        slot = (slot + 1) & mask;
+    }
+}
+
+// Size `fd` for an empty table of `capacity` records and map it
+static RecordTableHeader* map_new(const RecordTable *table, int fd, uint64_t capacity,
+                                  uint64_t generation) {
+    size_t size = table_map_size(table, capacity);
+    if (ftruncate(fd, 0) != 0 || ftruncate(fd, (off_t)size) != 0) {
+        return NULL;
+    }
+
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) return NULL;
+
+    RecordTableHeader *header = (RecordTableHeader*)map;
+    memcpy(header->magic, table->magic, sizeof(header->magic));
+    header->version = table->version;
+    header->record_size = table->record_size;
+    header->capacity = capacity;
+    header->count = 0;
+    header->generation = generation;
+    return header;
+}
+
+// Rewrite the table into a fresh file of `capacity` records, keeping only
+// records used within the last `max_age` generations (all of them for 0),
+// then swap it into place
+static bool rebuild(RecordTable *table, uint64_t capacity, uint64_t max_age) {
+    char tmp_path[MAX_PATH_LENGTH + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", table->path);
+
+    int fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    flock(fd, LOCK_EX);
+
+    uint64_t generation = table->header->generation;
+    RecordTableHeader *header = map_new(table, fd, capacity, generation);
+    if (!header) {
+        close(fd);
+        unlink(tmp_path);
+        return false;
+    }
+    unsigned char *records = (unsigned char*)(header + 1);
+
+    for (uint64_t i = 0; i < table->header->capacity; i++) {
+        const RecordHead *head = slot_at(table->records, table->record_size, i);
+        if (!head->used) continue;
+        if (max_age > 0 && head->generation + max_age <= generation) continue;
+
+        // Keys are unique, so the first empty slot is the record's slot
+        RecordHead *slot = probe(records, table->record_size, capacity, head->hash, NULL, NULL);
+        memcpy(slot, head, table->record_size);
+        header->count++;
+    }
+
+    if (rename(tmp_path, table->path) != 0) {
+        munmap(header, table_map_size(table, capacity));
+        close(fd);
+        unlink(tmp_path);
+        return false;
+    }
+
+    munmap(table->header, table->map_size);
+    close(table->fd);
+
+    table->fd = fd;
+    table->header = header;
+    table->records = records;
+    table->map_size = table_map_size(table, capacity);
+    return true;
+}
+
+bool record_table_open(RecordTable *table, const char *path, const char *name,
+                       const char *magic, uint32_t version, uint32_t record_size) {
+    memset(table, 0, sizeof(RecordTable));
+    strncpy(table->path, path, sizeof(table->path) - 1);
+    table->name = name;
+    memcpy(table->magic, magic, sizeof(table->magic));
+    table->version = version;
+    table->record_size = record_size;
+
+    // One writer at a time; concurrent runs queue up on the lock. A run
+    // that waited may find the file replaced by a rebuild, so retry until
+    // the locked descriptor is the file currently at `path`.
+    struct stat st, current;
+    for (;;) {
+        table->fd = open(path, O_RDWR | O_CREAT, 0644);
+        if (table->fd < 0) {
+            LOG_ERROR("Cannot open %s %s: %s", name, path, strerror(errno));
+            return false;
+        }
+
+        flock(table->fd, LOCK_EX);
+        if (fstat(table->fd, &st) == 0 && stat(path, &current) == 0 &&
+            st.st_ino == current.st_ino && st.st_dev == current.st_dev) {
+            break;
+        }
+        close(table->fd);
+    }
+
+    void *map = MAP_FAILED;
+    if ((size_t)st.st_size >= sizeof(RecordTableHeader)) {
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, table->fd, 0);
+    }
+
+    if (map != MAP_FAILED) {
+        RecordTableHeader *header = (RecordTableHeader*)map;
+        bool valid = memcmp(header->magic, magic, sizeof(header->magic)) == 0 &&
+                     header->version == version &&
+                     header->record_size == record_size &&
+                     header->capacity > 0 &&
+                     (header->capacity & (header->capacity - 1)) == 0 &&
+                     table_map_size(table, header->capacity) == (size_t)st.st_size;
+        if (valid) {
+            table->header = header;
+            table->map_size = (size_t)st.st_size;
+        } else {
+            LOG_WARN("The %s %s is unreadable or outdated, starting over", name, path);
+            munmap(map, (size_t)st.st_size);
+        }
+    }
+
+    if (!table->header) {
+        table->header = map_new(table, table->fd, RECORD_TABLE_INITIAL_CAPACITY, 0);
+        table->map_size = table_map_size(table, RECORD_TABLE_INITIAL_CAPACITY);
+        if (!table->header) {
+            LOG_ERROR("Cannot create %s %s", name, path);
+            close(table->fd);
+            return false;
+        }
+    }
+
+    table->records = (unsigned char*)(table->header + 1);
+    table->generation = table->header->generation + 1;
+    return true;
+}
+
+void record_table_close(RecordTable *table) {
+    msync(table->header, table->map_size, MS_ASYNC);
+    munmap(table->header, table->map_size);
+    close(table->fd);
+}
+
+void* record_table_find(const RecordTable *table, uint64_t hash, RecordMatchFn matches,
+                        const void *key) {
+    return probe(table->records, table->record_size, table->header->capacity, hash, matches, key);
+}
+
+void* record_table_insert(RecordTable *table, uint64_t hash, RecordMatchFn matches,
+                          const void *key) {
+    RecordHead *head = record_table_find(table, hash, matches, key);
+    if (head->used) return head;
+
+    if ((table->header->count + 1) * 10 > table->header->capacity * 7) {
+        if (!rebuild(table, table->header->capacity * 2, 0)) {
+            LOG_WARN("Cannot grow %s %s", table->name, table->path);
+            return NULL;
+        }
+        head = record_table_find(table, hash, matches, key);
+    }
+
+    memset(head, 0, table->record_size);
+    head->hash = hash;
+    head->used = 1;
+    table->header->count++;
+    return head;
+}
+
+void record_table_end_run(RecordTable *table) {
+    table->header->generation = table->generation;
+}
+
+int record_table_compact(RecordTable *table, unsigned int max_age) {
+    uint64_t before = table->header->count;
+    uint64_t generation = table->header->generation;
+    uint64_t kept = 0;
+
+    for (uint64_t i = 0; i < table->header->capacity; i++) {
+        const RecordHead *head = slot_at(table->records, table->record_size, i);
+        if (head->used && head->generation + max_age > generation) {
+            kept++;
+        }
+    }
+
+    // Smallest power of two that keeps the load factor at or under 50%
+    uint64_t capacity = RECORD_TABLE_INITIAL_CAPACITY;
+    while (capacity < kept * 2) {
+        capacity *= 2;
+    }
+
+    if (!rebuild(table, capacity, max_age)) {
+        LOG_ERROR("Failed to compact %s %s", table->name, table->path);
+        return ERROR_UNKNOWN;
+    }
+
+    if (!g_config.quiet) {
+        fprintf(stderr, "Compacted %s: kept %llu of %llu entries (%llu KB)\n", table->path,
+                (unsigned long long)kept, (unsigned long long)before,
+                (unsigned long long)(table->map_size / 1024));
+    }
+    return SUCCESS;
+}
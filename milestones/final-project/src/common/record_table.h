@@ -0,0 +1,85 @@
+#ifndef DEVTOOLS_RECORD_TABLE_H
+#define DEVTOOLS_RECORD_TABLE_H
+
+#include "../config.h"
+
+// Persistent record tables, the storage behind the hash and metrics caches.
+//
+// A file holds a header followed by an open-addressing table of fixed-size
+// records, mapped read/write and updated in place. Every record starts with
+// a RecordHead; what follows it (the key and the cached values) is up to
+// the cache. Slots are found by the 64-bit hash of the key, which is kept in
+// the record so the table can be rebuilt without knowing the key's layout.
+//
+// Each run that reads or writes records is one generation, and records
+// remember the last generation that used them. Compaction drops records
+// unused in the last N generations. A run only becomes a generation once
+// the cache calls record_table_end_run(), so opening a table just to compact
+// it ages nothing.
+//
+// One process at a time: the file stays locked from open to close.
+
+#define RECORD_TABLE_INITIAL_CAPACITY 4096
+
+typedef struct {
+    uint64_t hash;              // of the record's key
+    uint64_t generation;        // last run that used the record
+    uint32_t used;              // 0 marks an empty slot
+    uint32_t reserved;
+} RecordHead;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t capacity;
+    uint64_t count;
+    uint64_t generation;        // last run that used the table
+    uint64_t reserved[3];
+} RecordTableHeader;
+
+typedef struct {
+    char path[MAX_PATH_LENGTH];
+    const char *name;           // for messages, e.g. "hash cache"
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+
+    int fd;
+    RecordTableHeader *header;
+    unsigned char *records;
+    size_t map_size;
+    uint64_t generation;        // this run's
+} RecordTable;
+
+// Whether `record` (whose head hash matched) holds `key`
+typedef bool (*RecordMatchFn)(const void *record, const void *key);
+
+// Opens (or creates) the table at `path`. A file with another magic,
+// version or record size is replaced by an empty table.
+bool record_table_open(RecordTable *table, const char *path, const char *name,
+                       const char *magic, uint32_t version, uint32_t record_size);
+void record_table_close(RecordTable *table);
+
+// Slot holding `key` or the empty slot where it would go. Safe from
+// several threads while nothing inserts.
+void* record_table_find(const RecordTable *table, uint64_t hash, RecordMatchFn matches,
+                        const void *key);
+
+// Slot holding `key`, claimed (head filled in, rest zeroed) if it was
+// empty. Grows the table first when it is 70% full; NULL if it cannot.
+void* record_table_insert(RecordTable *table, uint64_t hash, RecordMatchFn matches,
+                          const void *key);
+
+// Makes this run a generation: records stamped with table->generation
+// count as used by it
+void record_table_end_run(RecordTable *table);
+
+// Rebuilds the table with only the records used in the last `max_age`
+// generations, at the smallest size that keeps it half empty
+int record_table_compact(RecordTable *table, unsigned int max_age);
+
+// splitmix64 finalizer, for hashing keys
+uint64_t record_table_mix(uint64_t x);
+
+#endif // DEVTOOLS_RECORD_TABLE_H
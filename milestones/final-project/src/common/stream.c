@@ -0,0 +1,374 @@
+#include "stream.h"
+#include "../config.h"
+#include "memory.h"
+#include "logging.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+// Fill `buffer` completely unless the input ends first
+static ssize_t read_full(int fd, char *buffer, size_t size) {
+    size_t total = 0;
+
+    while (total < size) {
+        ssize_t n = read(fd, buffer + total, size - total);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return -1;
+        if (n == 0) break;
+        total += (size_t)n;
+    }
+
+    return (ssize_t)total;
+}
+
+static bool write_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t n = write(fd, data, length);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return false;
+        data += n;
+        length -= (size_t)n;
+    }
+
+    return true;
+}
+
+static int channel_init(StreamChannel *channel, int fd, size_t block_size, size_t headroom) {
+    memset(channel, 0, sizeof(*channel));
+    channel->fd = fd;
+    channel->block_size = block_size;
+    channel->headroom = headroom;
+    channel->held = -1;
+
+    for (int i = 0; i < 2; i++) {
+        channel->buffers[i] = MALLOC(headroom + block_size);
+        if (!channel->buffers[i]) {
+            FREE(channel->buffers[0]);
+            return ERROR_MEMORY_ALLOCATION;
+        }
+        channel->capacities[i] = block_size;
+    }
+
+    pthread_mutex_init(&channel->lock, NULL);
+    pthread_cond_init(&channel->changed, NULL);
+    return SUCCESS;
+}
+
+static void channel_destroy(StreamChannel *channel) {
+    pthread_mutex_destroy(&channel->lock);
+    pthread_cond_destroy(&channel->changed);
+    FREE(channel->buffers[0]);
+    FREE(channel->buffers[1]);
+}
+
+// Reads ahead into whichever block the caller is not holding. Cancellation
+// is only enabled while blocked in read(2), so closing a reader early
+// never leaves the lock held.
+static void* reader_main(void *arg) {
+    StreamReader *reader = (StreamReader*)arg;
+    int slot = 0;
+
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+
+    for (;;) {
+        pthread_mutex_lock(&reader->lock);
+        while (reader->full[slot] && !reader->closing) {
+            pthread_cond_wait(&reader->changed, &reader->lock);
+        }
+        bool closing = reader->closing;
+        pthread_mutex_unlock(&reader->lock);
+        if (closing) break;
+
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+        ssize_t n = read_full(reader->fd, reader->buffers[slot] + reader->headroom,
+                              reader->block_size);
+        int error = errno;
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+
+        pthread_mutex_lock(&reader->lock);
+        reader->lengths[slot] = n > 0 ? (size_t)n : 0;
+        reader->error = n < 0 ? error : 0;
+        reader->full[slot] = true;
+        pthread_cond_signal(&reader->changed);
+        pthread_mutex_unlock(&reader->lock);
+
+        // An empty or failed block is the last one
+        if (n <= 0) break;
+        slot ^= 1;
+    }
+
+    return NULL;
+}
+
+int stream_reader_open(StreamReader *reader, int fd, size_t block_size, size_t headroom) {
+    int status = channel_init(reader, fd, block_size, headroom);
+    if (status != SUCCESS) return status;
+
+    reader->running = pthread_create(&reader->thread, NULL, reader_main, reader) == 0;
+    if (!reader->running) {
+        LOG_WARN("Failed to start reader thread, reading synchronously");
+    }
+
+    return SUCCESS;
+}
+
+ssize_t stream_reader_next(StreamReader *reader, char **data) {
+    if (reader->ended) return reader->error ? -1 : 0;
+
+    if (!reader->running) {
+        // Single-threaded fallback: one block, read on demand
+        ssize_t n = read_full(reader->fd, reader->buffers[0] + reader->headroom,
+                              reader->block_size);
+        if (n <= 0) {
+            reader->ended = true;
+            reader->error = n < 0 ? errno : 0;
+        }
+        *data = reader->buffers[0] + reader->headroom;
+        return n;
+    }
+
+    pthread_mutex_lock(&reader->lock);
+    int slot = 0;
+    if (reader->held >= 0) {
+        reader->full[reader->held] = false;
+        pthread_cond_signal(&reader->changed);
+        slot = reader->held ^ 1;
+    }
+    while (!reader->full[slot]) {
+        pthread_cond_wait(&reader->changed, &reader->lock);
+    }
+    reader->held = slot;
+    size_t length = reader->lengths[slot];
+    int error = reader->error;
+    pthread_mutex_unlock(&reader->lock);
+
+    *data = reader->buffers[slot] + reader->headroom;
+    if (length == 0) {
+        reader->ended = true;
+        if (error) {
+            errno = error;
+            return -1;
+        }
+    }
+
+    return (ssize_t)length;
+}
+
+void stream_reader_close(StreamReader *reader) {
+    if (reader->running) {
+        pthread_mutex_lock(&reader->lock);
+        reader->closing = true;
+        pthread_cond_signal(&reader->changed);
+        pthread_mutex_unlock(&reader->lock);
+
+        // The caller may stop early (bad input) while the thread is still
+        // waiting for data that will never come
+        if (!reader->ended) {
+            pthread_cancel(reader->thread);
+        }
+        pthread_join(reader->thread, NULL);
+    }
+
+    channel_destroy(reader);
+}
+
+// Writes blocks in the order they were committed until the caller closes
+// the writer. After a failed write the remaining blocks are dropped, so
+// the caller never waits on a writer that has given up.
+static void* writer_main(void *arg) {
+    StreamWriter *writer = (StreamWriter*)arg;
+    int slot = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&writer->lock);
+        while (!writer->full[slot] && !writer->closing) {
+            pthread_cond_wait(&writer->changed, &writer->lock);
+        }
+        bool pending = writer->full[slot];
+        bool failed = writer->error != 0;
+        pthread_mutex_unlock(&writer->lock);
+        if (!pending) break;
+
+        int error = 0;
+        if (!failed && !write_all(writer->fd, writer->buffers[slot], writer->lengths[slot])) {
+            error = errno;
+        }
+
+        pthread_mutex_lock(&writer->lock);
+        if (error) writer->error = error;
+        writer->full[slot] = false;
+        pthread_cond_signal(&writer->changed);
+        pthread_mutex_unlock(&writer->lock);
+
+        slot ^= 1;
+    }
+
+    return NULL;
+}
+
+int stream_writer_open(StreamWriter *writer, int fd, size_t block_size) {
+    int status = channel_init(writer, fd, block_size, 0);
+    if (status != SUCCESS) return status;
+
+    writer->held = 0;
+    writer->running = pthread_create(&writer->thread, NULL, writer_main, writer) == 0;
+    if (!writer->running) {
+        LOG_WARN("Failed to start writer thread, writing synchronously");
+    }
+
+    return SUCCESS;
+}
+
+char* stream_writer_buffer(StreamWriter *writer) {
+    if (writer->running) {
+        pthread_mutex_lock(&writer->lock);
+        while (writer->full[writer->held]) {
+            pthread_cond_wait(&writer->changed, &writer->lock);
+        }
+        pthread_mutex_unlock(&writer->lock);
+    }
+
+    return writer->buffers[writer->held];
+}
+
+bool stream_writer_commit(StreamWriter *writer, size_t length) {
+    if (length == 0) return writer->error == 0;
+
+    if (!writer->running) {
+        if (writer->error == 0 && !write_all(writer->fd, writer->buffers[0], length)) {
+            writer->error = errno;
+        }
+        return writer->error == 0;
+    }
+
+    pthread_mutex_lock(&writer->lock);
+    writer->lengths[writer->held] = length;
+    writer->full[writer->held] = true;
+    pthread_cond_signal(&writer->changed);
+    bool ok = writer->error == 0;
+    pthread_mutex_unlock(&writer->lock);
+
+    writer->held ^= 1;
+    return ok;
+}
+
+char* stream_writer_reserve(StreamWriter *writer, size_t size) {
+    int held = writer->held;
+
+    if (writer->used > 0 && writer->used + size > writer->capacities[held]) {
+        stream_writer_commit(writer, writer->used);
+        writer->used = 0;
+        held = writer->held;
+    }
+
+    if (writer->used == 0) {
+        // Wait for the writer thread to hand this block back
+        stream_writer_buffer(writer);
+
+        if (size > writer->capacities[held]) {
+            char *grown = REALLOC(writer->buffers[held], size);
+            if (!grown) return NULL;
+            writer->buffers[held] = grown;
+            writer->capacities[held] = size;
+        }
+    }
+
+    return writer->buffers[held] + writer->used;
+}
+
+void stream_writer_advance(StreamWriter *writer, size_t length) {
+    writer->used += length;
+}
+
+bool stream_writer_close(StreamWriter *writer) {
+    if (writer->used > 0) {
+        stream_writer_commit(writer, writer->used);
+        writer->used = 0;
+    }
+
+    if (writer->running) {
+        pthread_mutex_lock(&writer->lock);
+        writer->closing = true;
+        pthread_cond_signal(&writer->changed);
+        pthread_mutex_unlock(&writer->lock);
+        pthread_join(writer->thread, NULL);
+    }
+
+    bool ok = writer->error == 0;
+    channel_destroy(writer);
+    return ok;
+}
+
+static int emit_record(StreamRecordFn fn, void *ctx, const char *record, size_t length) {
+    if (length > 0 && record[length - 1] == '\r') length--;
+    return fn(record, length, ctx);
+}
+
+// Appends to the buffer that joins lines split across blocks
+static bool append_partial(char **line, size_t *length, size_t *capacity,
+                           const char *data, size_t size) {
+    if (*length + size > *capacity) {
+        size_t grown_capacity = *capacity ? *capacity * 2 : 4096;
+        while (grown_capacity < *length + size) grown_capacity *= 2;
+
+        char *grown = REALLOC(*line, grown_capacity);
+        if (!grown) return false;
+        *line = grown;
+        *capacity = grown_capacity;
+    }
+
+    memcpy(*line + *length, data, size);
+    *length += size;
+    return true;
+}
+
+int stream_read_records(StreamReader *reader, StreamRecordFn fn, void *ctx) {
+    char *line = NULL;
+    size_t line_length = 0, line_capacity = 0;
+    int status = SUCCESS;
+
+    while (status == SUCCESS) {
+        char *data;
+        ssize_t n = stream_reader_next(reader, &data);
+        if (n < 0) {
+            LOG_ERROR("Read failed: %s", strerror(errno));
+            status = ERROR_PERMISSION_DENIED;
+            break;
+        }
+        if (n == 0) {
+            if (line_length > 0) {
+                status = emit_record(fn, ctx, line, line_length);
+            }
+            break;
+        }
+
+        const char *p = data;
+        const char *end = data + n;
+        const char *newline;
+
+        while (status == SUCCESS && (newline = memchr(p, '\n', (size_t)(end - p))) != NULL) {
+            if (line_length > 0) {
+                // The rest of a line that started in an earlier block
+                if (!append_partial(&line, &line_length, &line_capacity, p,
+                                    (size_t)(newline - p))) {
+                    status = ERROR_MEMORY_ALLOCATION;
+                    break;
+                }
+                status = emit_record(fn, ctx, line, line_length);
+                line_length = 0;
+            } else {
+                status = emit_record(fn, ctx, p, (size_t)(newline - p));
+            }
+            p = newline + 1;
+        }
+
+        if (status == SUCCESS && p < end &&
+            !append_partial(&line, &line_length, &line_capacity, p, (size_t)(end - p))) {
+            status = ERROR_MEMORY_ALLOCATION;
+        }
+    }
+
+    FREE(line);
+    return status;
+}
@@ -0,0 +1,75 @@
+#ifndef DEVTOOLS_STREAM_H
+#define DEVTOOLS_STREAM_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// Double-buffered stream I/O.
+//
+// A StreamReader reads ahead on a background thread into one of two fixed
+// blocks while the caller transforms the other; a StreamWriter does the
+// same in the opposite direction. read(2), the transform and write(2) all
+// overlap, and memory use is four blocks however long the stream is.
+
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int fd;
+    size_t block_size;
+    size_t headroom;
+    char *buffers[2];
+    size_t capacities[2];
+    size_t lengths[2];
+    bool full[2];
+    int held;               // block owned by the caller, -1 for none
+    size_t used;            // writer: bytes reserved and filled in that block
+    int error;              // errno of the first failed read or write
+    bool closing;           // the caller is done with the channel
+    bool ended;             // reader: the caller has seen end of input
+    bool running;           // false if the thread could not be started
+} StreamChannel;
+
+typedef StreamChannel StreamReader;
+typedef StreamChannel StreamWriter;
+
+// Reader. Every block has `headroom` writable bytes in front of it so the
+// caller can prepend state carried over from the previous block (a partial
+// quantum or escape) without copying the new data.
+int stream_reader_open(StreamReader *reader, int fd, size_t block_size, size_t headroom);
+
+// Releases the previous block and returns the next one: its length, 0 at
+// end of input, or -1 if a read failed (errno is set)
+ssize_t stream_reader_next(StreamReader *reader, char **data);
+void stream_reader_close(StreamReader *reader);
+
+// Writer. Fill the block returned by stream_writer_buffer() with at most
+// block_size bytes, then hand it over with stream_writer_commit(); the
+// commit returns false once an earlier write has failed.
+int stream_writer_open(StreamWriter *writer, int fd, size_t block_size);
+char* stream_writer_buffer(StreamWriter *writer);
+bool stream_writer_commit(StreamWriter *writer, size_t length);
+
+// Record-oriented output: reserve room for up to `size` bytes after what
+// is already in the current block (handing a full block to the writer
+// thread first), then advance by the bytes actually produced. A block is
+// grown to fit a record larger than itself and keeps that size. Returns
+// NULL only if that growth fails.
+char* stream_writer_reserve(StreamWriter *writer, size_t size);
+void stream_writer_advance(StreamWriter *writer, size_t length);
+
+// Commits any reserved output, then waits for pending blocks to be
+// written; false if any write failed
+bool stream_writer_close(StreamWriter *writer);
+
+// Calls `fn` for every line of the reader's input without its "\n" or
+// "\r\n"; a final line without a newline is included. Lines split across
+// blocks are joined in one buffer kept for the whole stream, so there is
+// no allocation per record. Stops at the first status other than SUCCESS
+// and returns it.
+typedef int (*StreamRecordFn)(const char *record, size_t length, void *ctx);
+int stream_read_records(StreamReader *reader, StreamRecordFn fn, void *ctx);
+
+#endif // DEVTOOLS_STREAM_H
@@ -0,0 +1,289 @@
+#include "work_queue.h"
+#include "../config.h"
+#include "memory.h"
+#include "logging.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DEQUE_INITIAL_CAPACITY 64
+
+// Per-worker double-ended queue (owner uses the tail, thieves the head)
+typedef struct {
+    pthread_mutex_t lock;
+    void **items;
+    size_t head;
+    size_t count;
+    size_t capacity;
+} WorkDeque;
+
+typedef struct {
+    WorkPool *pool;
+    int id;
+} WorkerArg;
+
+struct WorkPool {
+    WorkDeque *deques;
+    int workers;
+    WorkFn fn;
+    void *ctx;
+
+    // Items queued or running; the pool is finished when this reaches 0
+    size_t pending;
+
+    // Idle workers sleep here until new work is pushed or everything is done
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;
+    unsigned long generation;
+    int sleepers;
+
+    unsigned int next_submit;
+};
+
+static bool deque_push(WorkDeque *dq, void *item) {
+    pthread_mutex_lock(&dq->lock);
+
+    if (dq->count == dq->capacity) {
+        size_t new_capacity = dq->capacity ? dq->capacity * 2 : DEQUE_INITIAL_CAPACITY;
+        void **items = MALLOC(new_capacity * sizeof(void*));
+        if (!items) {
+            pthread_mutex_unlock(&dq->lock);
+            return false;
+        }
+
+        // Unwrap the ring into the new array
+        for (size_t i = 0; i < dq->count; i++) {
+            items[i] = dq->items[(dq->head + i) % dq->capacity];
+        }
+        FREE(dq->items);
+        dq->items = items;
+        dq->head = 0;
+        dq->capacity = new_capacity;
+    }
+
+    dq->items[(dq->head + dq->count) % dq->capacity] = item;
+    dq->count++;
+
+    pthread_mutex_unlock(&dq->lock);
+    return true;
+}
+
+static bool deque_pop_tail(WorkDeque *dq, void **item) {
+    bool found = false;
+
+    pthread_mutex_lock(&dq->lock);
+    if (dq->count > 0) {
+        dq->count--;
+        *item = dq->items[(dq->head + dq->count) % dq->capacity];
+        found = true;
+    }
+    pthread_mutex_unlock(&dq->lock);
+
+    return found;
+}
+
+static bool deque_steal_head(WorkDeque *dq, void **item) {
+    bool found = false;
+
+    pthread_mutex_lock(&dq->lock);
+    if (dq->count > 0) {
+        *item = dq->items[dq->head];
+        dq->head = (dq->head + 1) % dq->capacity;
+        dq->count--;
+        found = true;
+    }
+    pthread_mutex_unlock(&dq->lock);
+
+    return found;
+}
+
+// Own deque first, then try every other worker once
+static bool take_work(WorkPool *pool, int id, void **item) {
+    if (deque_pop_tail(&pool->deques[id], item)) {
+        return true;
+    }
+
+    for (int i = 1; i < pool->workers; i++) {
+        int victim = (id + i) % pool->workers;
+        if (deque_steal_head(&pool->deques[victim], item)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void announce_work(WorkPool *pool) {
+    pthread_mutex_lock(&pool->idle_lock);
+    pool->generation++;
+    if (pool->sleepers > 0) {
+        pthread_cond_signal(&pool->idle_cond);
+    }
+    pthread_mutex_unlock(&pool->idle_lock);
+}
+
+static void finish_item(WorkPool *pool) {
+    if (__atomic_sub_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL) == 0) {
+        pthread_mutex_lock(&pool->idle_lock);
+        pthread_cond_broadcast(&pool->idle_cond);
+        pthread_mutex_unlock(&pool->idle_lock);
+    }
+}
+
+static void run_item(WorkPool *pool, int id, void *item) {
+    pool->fn(pool, id, item, pool->ctx);
+    finish_item(pool);
+}
+
+static void* worker_main(void *arg) {
+    WorkerArg *wa = (WorkerArg*)arg;
+    WorkPool *pool = wa->pool;
+    int id = wa->id;
+    void *item;
+
+    for (;;) {
+        if (take_work(pool, id, &item)) {
+            run_item(pool, id, item);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->idle_lock);
+        if (__atomic_load_n(&pool->pending, __ATOMIC_ACQUIRE) == 0) {
+            pthread_mutex_unlock(&pool->idle_lock);
+            break;
+        }
+        unsigned long seen = pool->generation;
+        pthread_mutex_unlock(&pool->idle_lock);
+
+        // Work pushed between the failed scan and the snapshot would
+        // otherwise be missed until the next push
+        if (take_work(pool, id, &item)) {
+            run_item(pool, id, item);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->idle_lock);
+        while (__atomic_load_n(&pool->pending, __ATOMIC_ACQUIRE) > 0 &&
+               pool->generation == seen) {
+            pool->sleepers++;
+            pthread_cond_wait(&pool->idle_cond, &pool->idle_lock);
+            pool->sleepers--;
+        }
+        pthread_mutex_unlock(&pool->idle_lock);
+    }
+
+    return NULL;
+}
+
+WorkPool* work_pool_create(int workers, WorkFn fn, void *ctx) {
+    if (!fn) return NULL;
+    if (workers < 1) workers = 1;
+
+    WorkPool *pool = MALLOC(sizeof(WorkPool));
+    if (!pool) return NULL;
+    memset(pool, 0, sizeof(WorkPool));
+
+    pool->deques = MALLOC((size_t)workers * sizeof(WorkDeque));
+    if (!pool->deques) {
+        FREE(pool);
+        return NULL;
+    }
+    memset(pool->deques, 0, (size_t)workers * sizeof(WorkDeque));
+
+    for (int i = 0; i < workers; i++) {
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+    }
+    pthread_mutex_init(&pool->idle_lock, NULL);
+    pthread_cond_init(&pool->idle_cond, NULL);
+
+    pool->workers = workers;
+    pool->fn = fn;
+    pool->ctx = ctx;
+
+    return pool;
+}
+
+void work_pool_destroy(WorkPool *pool) {
+    if (!pool) return;
+
+    for (int i = 0; i < pool->workers; i++) {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+        FREE(pool->deques[i].items);
+    }
+    pthread_mutex_destroy(&pool->idle_lock);
+    pthread_cond_destroy(&pool->idle_cond);
+
+    FREE(pool->deques);
+    FREE(pool);
+}
+
+bool work_pool_submit(WorkPool *pool, void *item) {
+    if (!pool) return false;
+
+    int target = (int)(__atomic_fetch_add(&pool->next_submit, 1, __ATOMIC_RELAXED) %
+                       (unsigned int)pool->workers);
+    return work_pool_push(pool, target, item);
+}
+
+bool work_pool_push(WorkPool *pool, int worker, void *item) {
+    if (!pool || worker < 0 || worker >= pool->workers) return false;
+
+    // Count the item before it becomes visible so a fast thief can never
+    // drive `pending` to zero while the pushing worker is still running
+    __atomic_add_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL);
+
+    if (!deque_push(&pool->deques[worker], item)) {
+        __atomic_sub_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL);
+        return false;
+    }
+
+    announce_work(pool);
+    return true;
+}
+
+int work_pool_run(WorkPool *pool) {
+    if (!pool) return ERROR_INVALID_ARGUMENT;
+
+    WorkerArg *args = MALLOC((size_t)pool->workers * sizeof(WorkerArg));
+    pthread_t *threads = MALLOC((size_t)pool->workers * sizeof(pthread_t));
+    if (!args || !threads) {
+        FREE(args);
+        FREE(threads);
+        return ERROR_MEMORY_ALLOCATION;
+    }
+
+    // The calling thread acts as worker 0
+    int started = 1;
+    for (int i = 1; i < pool->workers; i++) {
+        args[i].pool = pool;
+        args[i].id = i;
+        if (pthread_create(&threads[i], NULL, worker_main, &args[i]) != 0) {
+            LOG_WARN("Failed to start worker %d, continuing with %d", i, started);
+            break;
+        }
+        started++;
+    }
+
+    args[0].pool = pool;
+    args[0].id = 0;
+    worker_main(&args[0]);
+
+    for (int i = 1; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    FREE(args);
+    FREE(threads);
+    return SUCCESS;
+}
+
+int work_pool_workers(const WorkPool *pool) {
+    return pool ? pool->workers : 0;
+}
+
+int work_pool_default_workers(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 1;
+}
@@ -0,0 +1,37 @@
+#ifndef DEVTOOLS_WORK_QUEUE_H
+#define DEVTOOLS_WORK_QUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Work-stealing thread pool.
+//
+// Every worker owns a deque: it pushes and pops new work at the tail
+// (depth-first, cache friendly) while idle workers steal from the head of
+// other deques (oldest and usually largest pieces of work). Work items are
+// opaque pointers; the pool never frees them.
+
+typedef struct WorkPool WorkPool;
+
+// Called once per item on a worker thread. `worker` is in [0, workers) and
+// is stable for the lifetime of the thread, so it can index per-thread state.
+typedef void (*WorkFn)(WorkPool *pool, int worker, void *item, void *ctx);
+
+// Pool lifecycle
+WorkPool* work_pool_create(int workers, WorkFn fn, void *ctx);
+void work_pool_destroy(WorkPool *pool);
+
+// Queue an item from outside the pool (round-robin across deques)
+bool work_pool_submit(WorkPool *pool, void *item);
+
+// Queue an item from inside a worker onto its own deque
+bool work_pool_push(WorkPool *pool, int worker, void *item);
+
+// Start the workers and block until every queued item has been processed
+int work_pool_run(WorkPool *pool);
+
+// Helpers
+int work_pool_workers(const WorkPool *pool);
+int work_pool_default_workers(void);
+
+#endif // DEVTOOLS_WORK_QUEUE_H
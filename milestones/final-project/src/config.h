@@ -2,7 +2,10 @@
 #define DEVTOOLS_CONFIG_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <time.h>
 
 // Version information
 #define DEVTOOLS_VERSION "1.0.0"
@@ -113,14 +116,28 @@ typedef struct {
     Error error;
 } Command;
 
+// File type index entry (name is interned and owned by the index)
+typedef struct {
+    const char *name;
+    uint32_t length;
+    uint32_t hash;
+    size_t count;
+} FileTypeEntry;
+
+// Open-addressing hash index of file extensions; grows without limit
+typedef struct {
+    FileTypeEntry *slots;
+    size_t capacity;
+    size_t count;
+    struct FileTypeStringBlock *strings;
+} FileTypeIndex;
+
 // File analysis structure
 typedef struct {
     size_t file_count;
     size_t total_size;
     size_t total_lines;
-    char file_types[256][32];
-    size_t type_counts[256];
-    int unique_types;
+    FileTypeIndex types;
     time_t newest_file;
     time_t oldest_file;
 } FileAnalysis;
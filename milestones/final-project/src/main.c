@@ -6,6 +6,7 @@
 
 #include <getopt.h>
 #include <string.h>
+#include <unistd.h>
 
 DevToolsConfig g_config;
 
@@ -173,7 +174,8 @@ Command parse_arguments(int argc, char *argv[]) {
         {0, 0, 0, 0}
     };
 
-    while ((c = getopt_long(argc, argv, "hvq", long_options, &option_index)) != -1) {
+    // '+' stops at the tool name so tool options are left for the tool
+    while ((c = getopt_long(argc, argv, "+hvq", long_options, &option_index)) != -1) {
         switch (c) {
             case 'h':
                 print_help();
@@ -238,7 +240,8 @@ int execute_command(const Command *cmd) {
 
     LOG_INFO("Executing tool: %s", cmd->tool->name);
 
-    int result = cmd->tool->execute(cmd->argc - 1, cmd->argv + 1);
+    // Tools receive their name as argv[0] so they can run getopt themselves
+    int result = cmd->tool->execute(cmd->argc, cmd->argv);
 
     if (result != SUCCESS) {
         LOG_ERROR("Tool %s failed with error: %d", cmd->tool->name, result);
@@ -250,8 +253,12 @@ int execute_command(const Command *cmd) {
 }
 
 int main(int argc, char *argv[]) {
-    printf("DevTools Utility Suite %s\n", DEVTOOLS_VERSION);
-    printf("=================================\n\n");
+    // The banner is for people at a terminal; in a pipeline it would end
+    // up in front of the tool's output
+    if (isatty(STDOUT_FILENO)) {
+        printf("DevTools Utility Suite %s\n", DEVTOOLS_VERSION);
+        printf("=================================\n\n");
+    }
 
     // Initialize core systems
     if (!init_devtools()) {
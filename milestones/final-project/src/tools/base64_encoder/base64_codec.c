@@ -0,0 +1,414 @@
+#include "base64_encoder.h"
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BASE64_X86 1
+#include <immintrin.h>
+#endif
+
+// Bulk kernels convert as much of the input as they can with full vectors
+// and return how much they consumed; the scalar code finishes the tail
+typedef size_t (*EncodeBulkFn)(const unsigned char *in, size_t length, char *out);
+typedef size_t (*DecodeBulkFn)(const char *in, size_t length, unsigned char *out);
+
+static const char alphabet[64] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static int active_kernel = -1;
+static signed char decode_table[256];
+static bool decode_table_ready = false;
+
+// ---------------------------------------------------------------------
+// Scalar
+// ---------------------------------------------------------------------
+
+static int decode_char(unsigned char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+static void init_decode_table(void) {
+    for (int c = 0; c < 256; c++) {
+        decode_table[c] = (signed char)decode_char((unsigned char)c);
+    }
+    decode_table_ready = true;
+}
+
+// Full quanta through the reverse table; like the vector kernels it stops
+// at the first invalid character and leaves the last quantum alone
+static size_t decode_scalar(const char *in, size_t length, unsigned char *out) {
+    const unsigned char *p = (const unsigned char*)in;
+    size_t done = 0;
+
+    if (!decode_table_ready) {
+        init_decode_table();
+    }
+
+    while (length - done > 4) {
+        int a = decode_table[p[done]];
+        int b = decode_table[p[done + 1]];
+        int c = decode_table[p[done + 2]];
+        int d = decode_table[p[done + 3]];
+        if ((a | b | c | d) < 0) break;
+
+        uint32_t bits = ((uint32_t)a << 18) | ((uint32_t)b << 12) | ((uint32_t)c << 6) | (uint32_t)d;
+        out[0] = (unsigned char)(bits >> 16);
+        out[1] = (unsigned char)(bits >> 8);
+        out[2] = (unsigned char)bits;
+        out += 3;
+        done += 4;
+    }
+
+    return done;
+}
+
+static void encode_scalar(const unsigned char *in, size_t groups, char *out) {
+    for (size_t i = 0; i < groups; i++) {
+        uint32_t v = ((uint32_t)in[0] << 16) | ((uint32_t)in[1] << 8) | in[2];
+        out[0] = alphabet[v >> 18];
+        out[1] = alphabet[(v >> 12) & 0x3f];
+        out[2] = alphabet[(v >> 6) & 0x3f];
+        out[3] = alphabet[v & 0x3f];
+        in += 3;
+        out += 4;
+    }
+}
+
+#ifdef BASE64_X86
+
+// ---------------------------------------------------------------------
+// SSSE3 / AVX2
+//
+// Encode: pshufb spreads each 3 input bytes over a 32-bit lane, two
+// multiplies move the four 6-bit fields into separate bytes, and the
+// index -> ASCII mapping is a per-range offset picked with pshufb from a
+// 16-byte constant instead of a 64-entry table.
+//
+// Decode: the high nibble selects the offset back to 0..63 ('/' needs a
+// fix-up), and an invalid character is any byte whose bit is missing in
+// the 16x8 nibble validity matrix. maddubs/madd pack the 6-bit values
+// and a final shuffle drops the empty fourth byte of every lane.
+// ---------------------------------------------------------------------
+
+__attribute__((target("ssse3")))
+static inline __m128i encode_lookup_ssse3(__m128i indices) {
+    const __m128i shift_lut = _mm_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+
+    // 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12
+    __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    range = _mm_or_si128(range, _mm_and_si128(upper, _mm_set1_epi8(13)));
+    return _mm_add_epi8(_mm_shuffle_epi8(shift_lut, range), indices);
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i encode_split_ssse3(__m128i in) {
+    in = _mm_shuffle_epi8(in, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+    __m128i hi = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)),
+                                 _mm_set1_epi32(0x04000040));
+    __m128i lo = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)),
+                                 _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(hi, lo);
+}
+
+// 12 bytes in, 16 characters out; each load reads 16 bytes
+__attribute__((target("ssse3")))
+static size_t encode_ssse3(const unsigned char *in, size_t length, char *out) {
+    size_t done = 0;
+    while (length - done >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(in + done));
+        _mm_storeu_si128((__m128i*)out, encode_lookup_ssse3(encode_split_ssse3(v)));
+        done += 12;
+        out += 16;
+    }
+    return done;
+}
+
+__attribute__((target("avx2")))
+static size_t encode_avx2(const unsigned char *in, size_t length, char *out) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+        1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m256i shift_lut = _mm256_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    size_t done = 0;
+
+    // 24 bytes in (12 per 128-bit lane), 32 characters out
+    while (length - done >= 28) {
+        __m128i lo = _mm_loadu_si128((const __m128i*)(in + done));
+        __m128i hi = _mm_loadu_si128((const __m128i*)(in + done + 12));
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+
+        v = _mm256_shuffle_epi8(v, shuffle);
+        __m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00)),
+                                        _mm256_set1_epi32(0x04000040));
+        __m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0)),
+                                        _mm256_set1_epi32(0x01000010));
+        __m256i indices = _mm256_or_si256(t0, t1);
+
+        __m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        range = _mm256_or_si256(range, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+        __m256i ascii = _mm256_add_epi8(_mm256_shuffle_epi8(shift_lut, range), indices);
+
+        _mm256_storeu_si256((__m256i*)out, ascii);
+        done += 24;
+        out += 32;
+    }
+
+    return done + encode_ssse3(in + done, length - done, out);
+}
+
+// 16 characters in, 12 bytes out (16 stored). Stops at the first block
+// holding a non-alphabet character, and always leaves the last quantum
+// (which may be padded) to the scalar code.
+__attribute__((target("ssse3")))
+static size_t decode_ssse3(const char *in, size_t length, unsigned char *out) {
+    const __m128i shift_lut = _mm_setr_epi8(
+        0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask_lut = _mm_setr_epi8(
+        (char)0xa8, (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf8,
+        (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf0, 0x54, 0x50, 0x50, 0x50, 0x54);
+    const __m128i bit_lut = _mm_setr_epi8(
+        1, 2, 4, 8, 16, 32, 64, (char)128, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    size_t done = 0;
+
+    while (length - done > 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(in + done));
+        __m128i hi = _mm_and_si128(_mm_srli_epi32(v, 4), nibble);
+        __m128i lo = _mm_and_si128(v, nibble);
+
+        __m128i valid = _mm_and_si128(_mm_shuffle_epi8(mask_lut, lo),
+                                      _mm_shuffle_epi8(bit_lut, hi));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(valid, _mm_setzero_si128())) != 0) break;
+
+        __m128i slash = _mm_cmpeq_epi8(v, _mm_set1_epi8('/'));
+        __m128i shift = _mm_add_epi8(_mm_shuffle_epi8(shift_lut, hi),
+                                     _mm_and_si128(slash, _mm_set1_epi8(-3)));
+        v = _mm_add_epi8(v, shift);
+
+        v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+        v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+        _mm_storeu_si128((__m128i*)out, _mm_shuffle_epi8(v, pack));
+
+        done += 16;
+        out += 12;
+    }
+
+    return done;
+}
+
+__attribute__((target("avx2")))
+static size_t decode_avx2(const char *in, size_t length, unsigned char *out) {
+    const __m256i shift_lut = _mm256_setr_epi8(
+        0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i mask_lut = _mm256_setr_epi8(
+        (char)0xa8, (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf8,
+        (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf0, 0x54, 0x50, 0x50, 0x50, 0x54,
+        (char)0xa8, (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf8,
+        (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf8, (char)0xf0, 0x54, 0x50, 0x50, 0x50, 0x54);
+    const __m256i bit_lut = _mm256_setr_epi8(
+        1, 2, 4, 8, 16, 32, 64, (char)128, 0, 0, 0, 0, 0, 0, 0, 0,
+        1, 2, 4, 8, 16, 32, 64, (char)128, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i pack = _mm256_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    size_t done = 0;
+
+    while (length - done > 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(in + done));
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi32(v, 4), nibble);
+        __m256i lo = _mm256_and_si256(v, nibble);
+
+        __m256i valid = _mm256_and_si256(_mm256_shuffle_epi8(mask_lut, lo),
+                                         _mm256_shuffle_epi8(bit_lut, hi));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(valid, _mm256_setzero_si256())) != 0) break;
+
+        __m256i slash = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('/'));
+        __m256i shift = _mm256_add_epi8(_mm256_shuffle_epi8(shift_lut, hi),
+                                        _mm256_and_si256(slash, _mm256_set1_epi8(-3)));
+        v = _mm256_add_epi8(v, shift);
+
+        v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+        v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+        v = _mm256_shuffle_epi8(v, pack);
+
+        // Each lane holds 12 bytes; close the gap between them
+        v = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+        _mm256_storeu_si256((__m256i*)out, v);
+
+        done += 32;
+        out += 24;
+    }
+
+    return done + decode_ssse3(in + done, length - done, out);
+}
+
+#endif // BASE64_X86
+
+// ---------------------------------------------------------------------
+// Dispatch
+// ---------------------------------------------------------------------
+
+bool base64_kernel_supported(Base64Kernel kernel) {
+    switch (kernel) {
+        case BASE64_KERNEL_SCALAR:
+            return true;
+#ifdef BASE64_X86
+        case BASE64_KERNEL_SSSE3:
+            return __builtin_cpu_supports("ssse3");
+        case BASE64_KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+Base64Kernel base64_best_kernel(void) {
+    if (base64_kernel_supported(BASE64_KERNEL_AVX2)) return BASE64_KERNEL_AVX2;
+    if (base64_kernel_supported(BASE64_KERNEL_SSSE3)) return BASE64_KERNEL_SSSE3;
+    return BASE64_KERNEL_SCALAR;
+}
+
+Base64Kernel base64_kernel(void) {
+    if (active_kernel < 0) {
+        active_kernel = base64_best_kernel();
+    }
+    return (Base64Kernel)active_kernel;
+}
+
+bool base64_set_kernel(Base64Kernel kernel) {
+    if (!base64_kernel_supported(kernel)) return false;
+    active_kernel = kernel;
+    return true;
+}
+
+const char* base64_kernel_name(Base64Kernel kernel) {
+    switch (kernel) {
+        case BASE64_KERNEL_SCALAR: return "scalar";
+        case BASE64_KERNEL_SSSE3:  return "ssse3";
+        case BASE64_KERNEL_AVX2:   return "avx2";
+        default:                   return "unknown";
+    }
+}
+
+static EncodeBulkFn encode_bulk(void) {
+    switch (base64_kernel()) {
+#ifdef BASE64_X86
+        case BASE64_KERNEL_SSSE3: return encode_ssse3;
+        case BASE64_KERNEL_AVX2:  return encode_avx2;
+#endif
+        default:                  return NULL;
+    }
+}
+
+static DecodeBulkFn decode_bulk(void) {
+    switch (base64_kernel()) {
+#ifdef BASE64_X86
+        case BASE64_KERNEL_SSSE3: return decode_ssse3;
+        case BASE64_KERNEL_AVX2:  return decode_avx2;
+#endif
+        default:                  return NULL;
+    }
+}
+
+// ---------------------------------------------------------------------
+// Codec
+// ---------------------------------------------------------------------
+
+size_t base64_encoded_length(size_t length) {
+    return (length + 2) / 3 * 4;
+}
+
+size_t base64_decoded_max_length(size_t length) {
+    return (length + 3) / 4 * 3;
+}
+
+size_t base64_encode(const unsigned char *in, size_t length, char *out) {
+    EncodeBulkFn bulk = encode_bulk();
+    size_t done = bulk ? bulk(in, length, out) : 0;
+    char *p = out + done / 3 * 4;
+
+    size_t groups = (length - done) / 3;
+    encode_scalar(in + done, groups, p);
+    done += groups * 3;
+    p += groups * 4;
+
+    size_t tail = length - done;
+    if (tail > 0) {
+        uint32_t v = (uint32_t)in[done] << 16;
+        if (tail == 2) v |= (uint32_t)in[done + 1] << 8;
+
+        p[0] = alphabet[v >> 18];
+        p[1] = alphabet[(v >> 12) & 0x3f];
+        p[2] = tail == 2 ? alphabet[(v >> 6) & 0x3f] : '=';
+        p[3] = '=';
+        p += 4;
+    }
+
+    return (size_t)(p - out);
+}
+
+bool base64_decode(const char *in, size_t length, unsigned char *out,
+                   size_t *out_length, size_t *error_offset) {
+    DecodeBulkFn bulk = decode_bulk();
+    size_t done = bulk ? bulk(in, length, out) : 0;
+    done += decode_scalar(in + done, length - done, out + done / 4 * 3);
+    unsigned char *p = out + done / 4 * 3;
+
+    while (done < length) {
+        size_t quantum = length - done < 4 ? length - done : 4;
+        bool last = done + quantum == length;
+        int values[4];
+        size_t count = 0;
+
+        for (size_t i = 0; i < quantum; i++) {
+            unsigned char c = (unsigned char)in[done + i];
+            int v = decode_char(c);
+
+            if (v >= 0 && count == i) {
+                values[count++] = v;
+                continue;
+            }
+
+            // '=' may only pad the final quantum, after at least 2 characters
+            if (c == '=' && last && i >= 2) continue;
+
+            *error_offset = done + i;
+            return false;
+        }
+
+        if (count < 2 || (count < 4 && !last)) {
+            *error_offset = done + count;
+            return false;
+        }
+
+        uint32_t bits = ((uint32_t)values[0] << 18) | ((uint32_t)values[1] << 12);
+        if (count > 2) bits |= (uint32_t)values[2] << 6;
+        if (count > 3) bits |= (uint32_t)values[3];
+
+        *p++ = (unsigned char)(bits >> 16);
+        if (count > 2) *p++ = (unsigned char)(bits >> 8);
+        if (count > 3) *p++ = (unsigned char)bits;
+
+        done += quantum;
+    }
+
+    *out_length = (size_t)(p - out);
+    return true;
+}
@@ -0,0 +1,517 @@
+#include "base64_encoder.h"
+#include "../../common/error.h"
+#include "../../common/logging.h"
+#include "../../common/memory.h"
+#include "../../common/stream.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_ROUNDS 3
+
+static double elapsed_seconds(const struct timespec *start, const struct timespec *end) {
+    return (double)(end->tv_sec - start->tv_sec) +
+           (double)(end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static bool write_output(FILE *out, const void *data, size_t length) {
+    return fwrite(data, 1, length, out) == length;
+}
+
+// Drop line breaks and other whitespace in place
+static size_t strip_whitespace(char *data, size_t length) {
+    size_t out = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        char c = data[i];
+        if (c != '\n' && c != '\r' && c != ' ' && c != '\t') {
+            data[out++] = c;
+        }
+    }
+
+    return out;
+}
+
+// Opens the double-buffered reader and writer shared by both directions
+static int open_streams(StreamReader *reader, int in_fd, size_t in_block, size_t headroom,
+                        StreamWriter *writer, int out_fd, size_t out_block) {
+    int status = stream_reader_open(reader, in_fd, in_block, headroom);
+    if (status != SUCCESS) return status;
+
+    status = stream_writer_open(writer, out_fd, out_block);
+    if (status != SUCCESS) {
+        stream_reader_close(reader);
+    }
+
+    return status;
+}
+
+static int close_streams(StreamReader *reader, StreamWriter *writer, int status) {
+    stream_reader_close(reader);
+    if (!stream_writer_close(writer) && status == SUCCESS) {
+        LOG_ERROR("Write failed: %s", strerror(writer->error));
+        status = ERROR_PERMISSION_DENIED;
+    }
+
+    return status;
+}
+
+static int encode_stream(int in_fd, int out_fd) {
+    StreamReader reader;
+    StreamWriter writer;
+    int status = open_streams(&reader, in_fd, BASE64_ENCODE_BLOCK, 2, &writer, out_fd,
+                              base64_encoded_length(BASE64_ENCODE_BLOCK + 2) +
+                              BASE64_OUTPUT_SLACK + 1);
+    if (status != SUCCESS) return status;
+
+    // Up to 2 bytes of an incomplete group are carried into the headroom
+    // of the next block, so padding only ever appears at the very end
+    unsigned char carry[2];
+    size_t carried = 0;
+    bool wrote = false;
+
+    for (;;) {
+        char *data;
+        ssize_t n = stream_reader_next(&reader, &data);
+        if (n < 0) {
+            LOG_ERROR("Read failed: %s", strerror(errno));
+            status = ERROR_PERMISSION_DENIED;
+            break;
+        }
+
+        unsigned char *block = (unsigned char*)data - carried;
+        memcpy(block, carry, carried);
+        size_t length = carried + (size_t)n;
+        size_t usable = n == 0 ? length : length / 3 * 3;
+
+        char *encoded = stream_writer_buffer(&writer);
+        size_t encoded_length = base64_encode(block, usable, encoded);
+        wrote = wrote || encoded_length > 0;
+        if (n == 0 && wrote) {
+            encoded[encoded_length++] = '\n';
+        }
+        if (!stream_writer_commit(&writer, encoded_length)) break;
+
+        carried = length - usable;
+        memcpy(carry, block + usable, carried);
+
+        if (n == 0) break;
+    }
+
+    return close_streams(&reader, &writer, status);
+}
+
+static int decode_stream(int in_fd, int out_fd) {
+    StreamReader reader;
+    StreamWriter writer;
+    int status = open_streams(&reader, in_fd, BASE64_DECODE_BLOCK, 3, &writer, out_fd,
+                              base64_decoded_max_length(BASE64_DECODE_BLOCK + 3) +
+                              BASE64_OUTPUT_SLACK);
+    if (status != SUCCESS) return status;
+
+    // Up to 3 characters of an incomplete quantum are carried into the
+    // headroom of the next block; offsets count non-whitespace characters
+    char carry[3];
+    size_t carried = 0;
+    uint64_t offset = 0;
+    bool padded = false;
+
+    for (;;) {
+        char *data;
+        ssize_t n = stream_reader_next(&reader, &data);
+        if (n < 0) {
+            LOG_ERROR("Read failed: %s", strerror(errno));
+            status = ERROR_PERMISSION_DENIED;
+            break;
+        }
+
+        size_t fresh = (size_t)n;
+        if (fresh > 0) {
+            bool spaced = memchr(data, '\n', fresh) || memchr(data, ' ', fresh) ||
+                          memchr(data, '\r', fresh) || memchr(data, '\t', fresh);
+            if (spaced) fresh = strip_whitespace(data, fresh);
+        }
+
+        char *block = data - carried;
+        memcpy(block, carry, carried);
+        size_t length = carried + fresh;
+
+        if (padded && length > 0) {
+            LOG_ERROR("Invalid Base64 input: data after padding");
+            status = ERROR_PARSE_ERROR;
+            break;
+        }
+
+        size_t usable = n == 0 ? length : length / 4 * 4;
+        size_t decoded_length, error_offset;
+        unsigned char *decoded = (unsigned char*)stream_writer_buffer(&writer);
+
+        if (!base64_decode(block, usable, decoded, &decoded_length, &error_offset)) {
+            LOG_ERROR("Invalid Base64 input near character %llu",
+                      (unsigned long long)(offset + error_offset));
+            status = ERROR_PARSE_ERROR;
+            break;
+        }
+        if (!stream_writer_commit(&writer, decoded_length)) break;
+
+        padded = usable > 0 && block[usable - 1] == '=';
+        offset += usable;
+        carried = length - usable;
+        memcpy(carry, block + usable, carried);
+
+        if (n == 0) break;
+    }
+
+    return close_streams(&reader, &writer, status);
+}
+
+// Batch mode: every input line is one record and produces one output line.
+// Output goes straight into the writer's blocks, so records cost no
+// allocation; an invalid record is reported and left empty so the output
+// stays aligned with the input. A record that decodes to data containing a
+// newline counts as invalid too, since writing it would split its line.
+typedef struct {
+    StreamWriter *writer;
+    bool decode;
+    size_t records;
+    size_t invalid;
+} Base64Batch;
+
+static int batch_record(const char *record, size_t length, void *ctx) {
+    Base64Batch *batch = (Base64Batch*)ctx;
+    size_t capacity = batch->decode ? base64_decoded_max_length(length)
+                                    : base64_encoded_length(length);
+    char *out = stream_writer_reserve(batch->writer, capacity + BASE64_OUTPUT_SLACK + 1);
+    if (!out) return ERROR_MEMORY_ALLOCATION;
+
+    size_t n = 0;
+    batch->records++;
+
+    if (batch->decode) {
+        size_t error_offset;
+        if (!base64_decode(record, length, (unsigned char*)out, &n, &error_offset)) {
+            batch->invalid++;
+            n = 0;
+            if (!g_config.quiet) {
+                fprintf(stderr, "base64-encoder: record %zu: invalid Base64 near character %zu\n",
+                        batch->records, error_offset);
+            }
+        } else if (memchr(out, '\n', n)) {
+            batch->invalid++;
+            n = 0;
+            if (!g_config.quiet) {
+                fprintf(stderr, "base64-encoder: record %zu: decoded data contains a newline\n",
+                        batch->records);
+            }
+        }
+    } else {
+        n = base64_encode((const unsigned char*)record, length, out);
+    }
+
+    out[n++] = '\n';
+    stream_writer_advance(batch->writer, n);
+    return SUCCESS;
+}
+
+static int batch_stream(int in_fd, int out_fd, Base64Batch *batch) {
+    StreamReader reader;
+    StreamWriter writer;
+    int status = open_streams(&reader, in_fd, BASE64_DECODE_BLOCK, 0, &writer, out_fd,
+                              BASE64_DECODE_BLOCK);
+    if (status != SUCCESS) return status;
+
+    batch->writer = &writer;
+    status = stream_read_records(&reader, batch_record, batch);
+    batch->writer = NULL;
+
+    return close_streams(&reader, &writer, status);
+}
+
+static int convert_stream(int fd, bool decode, Base64Batch *batch) {
+    if (batch) return batch_stream(fd, STDOUT_FILENO, batch);
+    return decode ? decode_stream(fd, STDOUT_FILENO) : encode_stream(fd, STDOUT_FILENO);
+}
+
+static int encode_string(const char *text, FILE *out) {
+    size_t length = strlen(text);
+    char *encoded = MALLOC(base64_encoded_length(length) + BASE64_OUTPUT_SLACK);
+    if (!encoded) return ERROR_MEMORY_ALLOCATION;
+
+    size_t n = base64_encode((const unsigned char*)text, length, encoded);
+    write_output(out, encoded, n);
+    fputc('\n', out);
+
+    FREE(encoded);
+    return SUCCESS;
+}
+
+static int decode_string(const char *text, FILE *out) {
+    size_t length = strlen(text);
+    char *copy = STRDUP(text);
+    unsigned char *decoded = MALLOC(base64_decoded_max_length(length) + BASE64_OUTPUT_SLACK);
+    int status = SUCCESS;
+
+    if (!copy || !decoded) {
+        FREE(copy);
+        FREE(decoded);
+        return ERROR_MEMORY_ALLOCATION;
+    }
+
+    size_t decoded_length, error_offset;
+    length = strip_whitespace(copy, length);
+    if (base64_decode(copy, length, decoded, &decoded_length, &error_offset)) {
+        write_output(out, decoded, decoded_length);
+    } else {
+        LOG_ERROR("Invalid Base64 input near character %zu", error_offset);
+        status = ERROR_PARSE_ERROR;
+    }
+
+    FREE(copy);
+    FREE(decoded);
+    return status;
+}
+
+// Times encode and decode with every kernel the CPU supports over the same
+// random buffer, next to memcpy of the same size as a ceiling
+static int run_benchmark(size_t megabytes) {
+    size_t length = (megabytes << 20) / 3 * 3;
+    size_t encoded_length = base64_encoded_length(length);
+    unsigned char *data = MALLOC(length + BASE64_OUTPUT_SLACK);
+    char *encoded = MALLOC(encoded_length + BASE64_OUTPUT_SLACK);
+    char *reference = MALLOC(encoded_length + BASE64_OUTPUT_SLACK);
+    unsigned char *decoded = MALLOC(length + BASE64_OUTPUT_SLACK);
+    int status = SUCCESS;
+
+    if (!data || !encoded || !reference || !decoded) {
+        FREE(data);
+        FREE(encoded);
+        FREE(reference);
+        FREE(decoded);
+        return ERROR_MEMORY_ALLOCATION;
+    }
+
+    uint64_t rng = 0x9E3779B97F4A7C15ull;
+    for (size_t i = 0; i < length; i++) {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        data[i] = (unsigned char)rng;
+    }
+
+    Base64Kernel best = base64_kernel();
+    struct timespec start, end;
+    double copy_time = 0;
+
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        memcpy(decoded, data, length);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double t = elapsed_seconds(&start, &end);
+        if (round == 0 || t < copy_time) copy_time = t;
+    }
+
+    printf("Base64 kernel benchmark\n");
+    printf("=======================\n");
+    printf("Data: %.1f MB random bytes, best of %d rounds (GB/s of binary data)\n\n",
+           (double)length / (1024.0 * 1024.0), BENCH_ROUNDS);
+    printf("  %-8s %12s %12s\n", "kernel", "encode", "decode");
+    printf("  %-8s %7.2f GB/s\n", "memcpy", (double)length / copy_time / 1e9);
+
+    for (int k = 0; k < BASE64_KERNEL_COUNT; k++) {
+        if (!base64_set_kernel((Base64Kernel)k)) {
+            printf("  %-8s %12s\n", base64_kernel_name((Base64Kernel)k), "not supported");
+            continue;
+        }
+
+        double encode_time = 0, decode_time = 0;
+        bool ok = true;
+
+        for (int round = 0; round < BENCH_ROUNDS; round++) {
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            base64_encode(data, length, encoded);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            double t = elapsed_seconds(&start, &end);
+            if (round == 0 || t < encode_time) encode_time = t;
+
+            size_t decoded_length, error_offset;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            ok = base64_decode(encoded, encoded_length, decoded, &decoded_length, &error_offset) &&
+                 decoded_length == length;
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            t = elapsed_seconds(&start, &end);
+            if (round == 0 || t < decode_time) decode_time = t;
+        }
+
+        // Every kernel must agree with the scalar one byte for byte
+        if (k == BASE64_KERNEL_SCALAR) {
+            memcpy(reference, encoded, encoded_length);
+        } else if (memcmp(reference, encoded, encoded_length) != 0) {
+            ok = false;
+        }
+        ok = ok && memcmp(decoded, data, length) == 0;
+
+        printf("  %-8s %7.2f GB/s %7.2f GB/s%s\n", base64_kernel_name((Base64Kernel)k),
+               (double)length / encode_time / 1e9, (double)length / decode_time / 1e9,
+               ok ? "" : "  MISMATCH");
+        if (!ok) status = ERROR_UNKNOWN;
+    }
+
+    base64_set_kernel(best);
+    FREE(data);
+    FREE(encoded);
+    FREE(reference);
+    FREE(decoded);
+    return status;
+}
+
+int base64_encoder_execute(int argc, char *argv[]) {
+    bool decode = false;
+    const char *text = NULL;
+    bool batch_mode = false;
+    size_t bench_megabytes = 0;
+
+    static struct option long_options[] = {
+        {"encode", no_argument, 0, 'e'},
+        {"decode", no_argument, 0, 'd'},
+        {"string", required_argument, 0, 's'},
+        {"batch", no_argument, 0, 'b'},
+        {"kernel", required_argument, 0, 1000},
+        {"bench", required_argument, 0, 1001},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    // Reset getopt state left over from global option parsing
+    optind = 0;
+
+    int c;
+    while ((c = getopt_long(argc, argv, "eds:bh", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'e':
+                decode = false;
+                break;
+
+            case 'd':
+                decode = true;
+                break;
+
+            case 's':
+                text = optarg;
+                break;
+
+            case 'b':
+                batch_mode = true;
+                break;
+
+            case 1000: { // --kernel
+                int kernel = 0;
+                while (kernel < BASE64_KERNEL_COUNT &&
+                       strcmp(optarg, base64_kernel_name((Base64Kernel)kernel)) != 0) {
+                    kernel++;
+                }
+                if (kernel == BASE64_KERNEL_COUNT) {
+                    LOG_ERROR("Unknown kernel: %s (use scalar, ssse3 or avx2)", optarg);
+                    return ERROR_INVALID_ARGUMENT;
+                }
+                if (!base64_set_kernel((Base64Kernel)kernel)) {
+                    LOG_ERROR("Kernel %s is not supported by this CPU", optarg);
+                    return ERROR_INVALID_ARGUMENT;
+                }
+                break;
+            }
+
+            case 1001: // --bench
+                bench_megabytes = strtoul(optarg, NULL, 10);
+                break;
+
+            case 'h':
+                base64_encoder_help();
+                return SUCCESS;
+
+            default:
+                return ERROR_INVALID_ARGUMENT;
+        }
+    }
+
+    if (bench_megabytes > 0) {
+        return run_benchmark(bench_megabytes);
+    }
+
+    if (text) {
+        return decode ? decode_string(text, stdout) : encode_string(text, stdout);
+    }
+
+    // Stream each file (or stdin) to stdout in large blocks, bypassing stdio
+    fflush(stdout);
+
+    Base64Batch batch = { .writer = NULL, .decode = decode, .records = 0, .invalid = 0 };
+    Base64Batch *records = batch_mode ? &batch : NULL;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int result = SUCCESS;
+    if (optind >= argc) {
+        result = convert_stream(STDIN_FILENO, decode, records);
+    }
+
+    for (int i = optind; i < argc; i++) {
+        bool from_stdin = strcmp(argv[i], "-") == 0;
+        int fd = from_stdin ? STDIN_FILENO : open(argv[i], O_RDONLY);
+        if (fd < 0) {
+            fprintf(stderr, "base64-encoder: %s: %s\n", argv[i], strerror(errno));
+            result = errno == ENOENT ? ERROR_FILE_NOT_FOUND : ERROR_PERMISSION_DENIED;
+            continue;
+        }
+
+        int status = convert_stream(fd, decode, records);
+        if (status != SUCCESS) {
+            result = status;
+        }
+
+        if (!from_stdin) close(fd);
+    }
+
+    if (batch_mode) {
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double elapsed = elapsed_seconds(&start, &end);
+        if (elapsed <= 0) elapsed = 1e-9;
+
+        if (!g_config.quiet) {
+            fprintf(stderr, "base64-encoder: %zu records (%zu invalid) in %.3f s, %.0f records/s\n",
+                    batch.records, batch.invalid, elapsed, (double)batch.records / elapsed);
+        }
+        if (result == SUCCESS && batch.invalid > 0) {
+            result = ERROR_PARSE_ERROR;
+        }
+    }
+
+    return result;
+}
+
+void base64_encoder_help(void) {
+    printf("Base64 Encoder/Decoder Tool\n");
+    printf("===========================\n");
+    printf("Encodes or decodes Base64 (RFC 4648). Files and stdin are streamed to\n");
+    printf("stdout through a fixed double buffer (reads, conversion and writes\n");
+    printf("overlap) using SSSE3/AVX2 kernels when available.\n");
+    printf("Decoding ignores line breaks and whitespace.\n");
+    printf("\nOptions:\n");
+    printf("  -e, --encode        Encode (default)\n");
+    printf("  -d, --decode        Decode\n");
+    printf("  -s, --string TEXT   Convert TEXT instead of reading input\n");
+    printf("  -b, --batch         Convert each input line as a separate record and\n");
+    printf("                      report records/s on stderr; decoded records must\n");
+    printf("                      not contain newlines\n");
+    printf("      --kernel NAME   Force a kernel: scalar, ssse3 or avx2\n");
+    printf("      --bench MB      Compare kernel throughput on MB of random data\n");
+    printf("\nUsage:\n");
+    printf("  devtools base64-encoder -s 'hello world'\n");
+    printf("  devtools base64-encoder firmware.bin > firmware.b64\n");
+    printf("  devtools base64-encoder -d < firmware.b64 > firmware.bin\n");
+    printf("  devtools base64-encoder -b < tokens.txt > tokens.b64\n");
+}
@@ -0,0 +1,44 @@
+#ifndef DEVTOOLS_BASE64_ENCODER_H
+#define DEVTOOLS_BASE64_ENCODER_H
+
+#include "../../config.h"
+
+// Streaming block sizes. Input is double-buffered in blocks of this size
+// and incomplete groups are carried between blocks, so memory use does not
+// depend on the input length.
+#define BASE64_ENCODE_BLOCK (3 * 1024 * 1024)
+#define BASE64_DECODE_BLOCK (4 * 1024 * 1024)
+
+// Output slack the vector kernels may write past the last valid byte
+#define BASE64_OUTPUT_SLACK 32
+
+typedef enum {
+    BASE64_KERNEL_SCALAR,
+    BASE64_KERNEL_SSSE3,
+    BASE64_KERNEL_AVX2,
+    BASE64_KERNEL_COUNT
+} Base64Kernel;
+
+// Kernel selection (runtime CPU dispatch; the best one is used by default)
+Base64Kernel base64_best_kernel(void);
+Base64Kernel base64_kernel(void);
+bool base64_set_kernel(Base64Kernel kernel);
+bool base64_kernel_supported(Base64Kernel kernel);
+const char* base64_kernel_name(Base64Kernel kernel);
+
+// Codec. Output buffers need BASE64_OUTPUT_SLACK spare bytes at the end.
+size_t base64_encoded_length(size_t length);
+size_t base64_decoded_max_length(size_t length);
+size_t base64_encode(const unsigned char *in, size_t length, char *out);
+
+// Decodes whitespace-free input. Padding (or a 2-3 character tail without
+// it) is only accepted in the last quantum. On failure returns false and
+// sets *error_offset to the first offending character.
+bool base64_decode(const char *in, size_t length, unsigned char *out,
+                   size_t *out_length, size_t *error_offset);
+
+// Tool entry points
+int base64_encoder_execute(int argc, char *argv[]);
+void base64_encoder_help(void);
+
+#endif // DEVTOOLS_BASE64_ENCODER_H
@@ -0,0 +1,857 @@
+#include "code_lexer.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <strings.h>
+
+#define KEYWORD_SLOTS 128
+#define MAX_BRACE_DEPTH 256
+
+// Byte classes: the lexer dispatches on these, never on raw bytes
+enum {
+    CLASS_OTHER,
+    CLASS_SPACE,
+    CLASS_NEWLINE,
+    CLASS_IDENT,
+    CLASS_DIGIT,
+    CLASS_QUOTE,
+    CLASS_BACKTICK,
+    CLASS_SLASH,
+    CLASS_HASH,
+    CLASS_OPEN,             // ( [ (and { } in Python)
+    CLASS_CLOSE,
+    CLASS_BRACE_OPEN,
+    CLASS_BRACE_CLOSE,
+    CLASS_SEMICOLON,
+    CLASS_AMP,
+    CLASS_PIPE,
+    CLASS_QUESTION,
+    CLASS_EQUALS
+};
+
+// What a keyword does to the counts
+enum {
+    KEYWORD_DECISION,
+    KEYWORD_DECISION_AT_START,  // only as the first word of a statement
+    KEYWORD_FUNCTION,           // starts a function (def, function)
+    KEYWORD_SCOPE,              // its braces may hold function definitions
+    KEYWORD_OPERATOR,           // C++ operator names end in symbols
+    KEYWORD_OTHER               // never the name of a definition
+};
+
+// Kinds of open braces, for telling definitions from calls and macros
+enum {
+    BRACE_BLOCK,
+    BRACE_SCOPE,
+    BRACE_FUNCTION
+};
+
+typedef struct {
+    const char *text;
+    unsigned char kind;
+} Keyword;
+
+typedef struct {
+    const char *name;
+    const Keyword *keywords;
+    size_t keyword_count;
+    bool slash_comments;        // // and /* */
+    bool hash_comments;         // #
+    bool directives;            // # starts a preprocessor line
+    bool triple_quotes;         // Python strings and docstrings
+    bool template_strings;      // `...` spanning lines
+    bool raw_strings;           // C++ R"delim(...)delim"
+    bool regex_literals;        // a / where an operand is expected
+    bool arrow_functions;       // => defines a function
+    bool digit_separators;      // 1'000'000
+    bool brace_functions;       // name(...) { defines a function
+    bool scoped_functions;      // ... only at file level or in a class/namespace body
+    bool logical_operators;     // && || ?: count as decisions
+    bool rvalue_references;     // C++: T&& declares a reference
+
+    // Built once from the above
+    unsigned char classes[256];
+    unsigned char keyword_slots[KEYWORD_SLOTS];     // keyword index + 1, 0 if empty
+} Language;
+
+static const Keyword c_keywords[] = {
+    {"if", KEYWORD_DECISION}, {"for", KEYWORD_DECISION}, {"while", KEYWORD_DECISION},
+    {"case", KEYWORD_DECISION},
+    {"struct", KEYWORD_SCOPE}, {"union", KEYWORD_SCOPE}, {"enum", KEYWORD_SCOPE},
+    {"extern", KEYWORD_SCOPE},
+    {"switch", KEYWORD_OTHER}, {"return", KEYWORD_OTHER}, {"else", KEYWORD_OTHER},
+    {"do", KEYWORD_OTHER}, {"goto", KEYWORD_OTHER}, {"sizeof", KEYWORD_OTHER},
+    {"_Alignof", KEYWORD_OTHER}, {"_Alignas", KEYWORD_OTHER}, {"_Generic", KEYWORD_OTHER},
+    {"_Static_assert", KEYWORD_OTHER}, {"static_assert", KEYWORD_OTHER},
+    {"__attribute__", KEYWORD_OTHER}, {"__declspec", KEYWORD_OTHER},
+    {"asm", KEYWORD_OTHER}, {"__asm__", KEYWORD_OTHER},
+    {"typeof", KEYWORD_OTHER}, {"__typeof__", KEYWORD_OTHER}, {"defined", KEYWORD_OTHER}
+};
+
+static const Keyword cpp_keywords[] = {
+    {"if", KEYWORD_DECISION}, {"for", KEYWORD_DECISION}, {"while", KEYWORD_DECISION},
+    {"case", KEYWORD_DECISION}, {"catch", KEYWORD_DECISION},
+    {"struct", KEYWORD_SCOPE}, {"union", KEYWORD_SCOPE}, {"enum", KEYWORD_SCOPE},
+    {"extern", KEYWORD_SCOPE}, {"class", KEYWORD_SCOPE}, {"namespace", KEYWORD_SCOPE},
+    {"operator", KEYWORD_OPERATOR},
+    {"switch", KEYWORD_OTHER}, {"return", KEYWORD_OTHER}, {"else", KEYWORD_OTHER},
+    {"do", KEYWORD_OTHER}, {"goto", KEYWORD_OTHER}, {"sizeof", KEYWORD_OTHER},
+    {"alignof", KEYWORD_OTHER}, {"alignas", KEYWORD_OTHER}, {"decltype", KEYWORD_OTHER},
+    {"noexcept", KEYWORD_OTHER}, {"throw", KEYWORD_OTHER}, {"new", KEYWORD_OTHER},
+    {"delete", KEYWORD_OTHER}, {"typeid", KEYWORD_OTHER}, {"requires", KEYWORD_OTHER},
+    {"static_assert", KEYWORD_OTHER}, {"co_return", KEYWORD_OTHER},
+    {"co_await", KEYWORD_OTHER}, {"co_yield", KEYWORD_OTHER},
+    {"__attribute__", KEYWORD_OTHER}, {"__declspec", KEYWORD_OTHER},
+    {"asm", KEYWORD_OTHER}, {"__asm__", KEYWORD_OTHER}, {"defined", KEYWORD_OTHER}
+};
+
+static const Keyword python_keywords[] = {
+    {"if", KEYWORD_DECISION}, {"elif", KEYWORD_DECISION}, {"for", KEYWORD_DECISION},
+    {"while", KEYWORD_DECISION}, {"except", KEYWORD_DECISION}, {"and", KEYWORD_DECISION},
+    {"or", KEYWORD_DECISION}, {"case", KEYWORD_DECISION_AT_START},
+    {"def", KEYWORD_FUNCTION}
+};
+
+static const Keyword js_keywords[] = {
+    {"if", KEYWORD_DECISION}, {"for", KEYWORD_DECISION}, {"while", KEYWORD_DECISION},
+    {"case", KEYWORD_DECISION}, {"catch", KEYWORD_DECISION},
+    {"function", KEYWORD_FUNCTION}, {"class", KEYWORD_SCOPE},
+    {"switch", KEYWORD_OTHER}, {"return", KEYWORD_OTHER}, {"else", KEYWORD_OTHER},
+    {"do", KEYWORD_OTHER}, {"typeof", KEYWORD_OTHER}, {"void", KEYWORD_OTHER},
+    {"delete", KEYWORD_OTHER}, {"new", KEYWORD_OTHER}, {"await", KEYWORD_OTHER},
+    {"yield", KEYWORD_OTHER}, {"in", KEYWORD_OTHER}, {"of", KEYWORD_OTHER},
+    {"instanceof", KEYWORD_OTHER}, {"throw", KEYWORD_OTHER}, {"with", KEYWORD_OTHER},
+    {"super", KEYWORD_OTHER}, {"import", KEYWORD_OTHER}
+};
+
+#define KEYWORDS(list) list, sizeof(list) / sizeof(list[0])
+
+static Language languages[CODE_LANGUAGE_COUNT] = {
+    [CODE_LANGUAGE_NONE] = { .name = "text" },
+    [CODE_LANGUAGE_C] = {
+        .name = "C", .keywords = KEYWORDS(c_keywords),
+        .slash_comments = true, .directives = true,
+        .brace_functions = true, .scoped_functions = true, .logical_operators = true
+    },
+    [CODE_LANGUAGE_CPP] = {
+        .name = "C++", .keywords = KEYWORDS(cpp_keywords),
+        .slash_comments = true, .directives = true, .raw_strings = true,
+        .digit_separators = true, .brace_functions = true, .scoped_functions = true,
+        .logical_operators = true, .rvalue_references = true
+    },
+    [CODE_LANGUAGE_PYTHON] = {
+        .name = "Python", .keywords = KEYWORDS(python_keywords),
+        .hash_comments = true, .triple_quotes = true
+    },
+    [CODE_LANGUAGE_JS] = {
+        .name = "JS", .keywords = KEYWORDS(js_keywords),
+        .slash_comments = true, .template_strings = true, .regex_literals = true,
+        .arrow_functions = true, .brace_functions = true, .logical_operators = true
+    }
+};
+
+static const struct {
+    const char *extension;
+    CodeLanguage language;
+} extensions[] = {
+    {"c", CODE_LANGUAGE_C}, {"h", CODE_LANGUAGE_C},
+    {"cc", CODE_LANGUAGE_CPP}, {"cpp", CODE_LANGUAGE_CPP}, {"cxx", CODE_LANGUAGE_CPP},
+    {"c++", CODE_LANGUAGE_CPP}, {"C", CODE_LANGUAGE_CPP}, {"hh", CODE_LANGUAGE_CPP},
+    {"hpp", CODE_LANGUAGE_CPP}, {"hxx", CODE_LANGUAGE_CPP}, {"h++", CODE_LANGUAGE_CPP},
+    {"H", CODE_LANGUAGE_CPP}, {"ipp", CODE_LANGUAGE_CPP}, {"tpp", CODE_LANGUAGE_CPP},
+    {"py", CODE_LANGUAGE_PYTHON}, {"pyi", CODE_LANGUAGE_PYTHON}, {"pyw", CODE_LANGUAGE_PYTHON},
+    {"js", CODE_LANGUAGE_JS}, {"mjs", CODE_LANGUAGE_JS}, {"cjs", CODE_LANGUAGE_JS},
+    {"jsx", CODE_LANGUAGE_JS}, {"ts", CODE_LANGUAGE_JS}, {"tsx", CODE_LANGUAGE_JS},
+    {"mts", CODE_LANGUAGE_JS}, {"cts", CODE_LANGUAGE_JS}
+};
+
+static pthread_once_t languages_once = PTHREAD_ONCE_INIT;
+
+static unsigned keyword_hash(const char *word, size_t length) {
+    return ((unsigned)length * 31u + (unsigned char)word[0] * 7u +
+            (unsigned char)word[length - 1]) & (KEYWORD_SLOTS - 1);
+}
+
+static void build_language(Language *lang, bool plain) {
+    memset(lang->classes, CLASS_OTHER, sizeof(lang->classes));
+    lang->classes[' '] = lang->classes['\t'] = lang->classes['\r'] = CLASS_SPACE;
+    lang->classes['\f'] = lang->classes['\v'] = CLASS_SPACE;
+    lang->classes['\n'] = CLASS_NEWLINE;
+    if (plain) return;
+
+    for (int c = 0; c < 256; c++) {
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c >= 0x80) {
+            lang->classes[c] = CLASS_IDENT;
+        } else if (c >= '0' && c <= '9') {
+            lang->classes[c] = CLASS_DIGIT;
+        }
+    }
+
+    lang->classes['"'] = lang->classes['\''] = CLASS_QUOTE;
+    lang->classes['('] = lang->classes['['] = CLASS_OPEN;
+    lang->classes[')'] = lang->classes[']'] = CLASS_CLOSE;
+    lang->classes['{'] = lang->brace_functions ? CLASS_BRACE_OPEN : CLASS_OPEN;
+    lang->classes['}'] = lang->brace_functions ? CLASS_BRACE_CLOSE : CLASS_CLOSE;
+    lang->classes[';'] = CLASS_SEMICOLON;
+    lang->classes['='] = CLASS_EQUALS;
+
+    if (lang->slash_comments || lang->regex_literals) lang->classes['/'] = CLASS_SLASH;
+    if (lang->hash_comments || lang->directives) lang->classes['#'] = CLASS_HASH;
+    if (lang->template_strings) {
+        // JavaScript names may hold $ and private ones start with #
+        lang->classes['`'] = CLASS_BACKTICK;
+        lang->classes['$'] = lang->classes['#'] = CLASS_IDENT;
+    }
+    if (lang->logical_operators) {
+        lang->classes['&'] = CLASS_AMP;
+        lang->classes['|'] = CLASS_PIPE;
+        lang->classes['?'] = CLASS_QUESTION;
+    }
+
+    memset(lang->keyword_slots, 0, sizeof(lang->keyword_slots));
+    for (size_t i = 0; i < lang->keyword_count; i++) {
+        const char *word = lang->keywords[i].text;
+        unsigned slot = keyword_hash(word, strlen(word));
+        while (lang->keyword_slots[slot]) slot = (slot + 1) & (KEYWORD_SLOTS - 1);
+        lang->keyword_slots[slot] = (unsigned char)(i + 1);
+    }
+}
+
+static void build_languages(void) {
+    for (int i = 0; i < CODE_LANGUAGE_COUNT; i++) {
+        build_language(&languages[i], i == CODE_LANGUAGE_NONE);
+    }
+}
+
+static const Keyword* find_keyword(const Language *lang, const char *word, size_t length) {
+    unsigned slot = keyword_hash(word, length);
+
+    while (lang->keyword_slots[slot]) {
+        const Keyword *keyword = &lang->keywords[lang->keyword_slots[slot] - 1];
+        if (strncmp(keyword->text, word, length) == 0 && keyword->text[length] == '\0') {
+            return keyword;
+        }
+        slot = (slot + 1) & (KEYWORD_SLOTS - 1);
+    }
+    return NULL;
+}
+
+CodeLanguage code_language_for(const char *filename) {
+    const char *slash = strrchr(filename, '/');
+    const char *base = slash ? slash + 1 : filename;
+    const char *dot = strrchr(base, '.');
+    if (!dot || dot == base) return CODE_LANGUAGE_NONE;
+
+    for (size_t i = 0; i < sizeof(extensions) / sizeof(extensions[0]); i++) {
+        if (strcmp(dot + 1, extensions[i].extension) == 0) return extensions[i].language;
+    }
+    return CODE_LANGUAGE_NONE;
+}
+
+const char* code_language_name(CodeLanguage language) {
+    return language < CODE_LANGUAGE_COUNT ? languages[language].name : "unknown";
+}
+
+bool code_language_parse(const char *name, CodeLanguage *language) {
+    static const struct {
+        const char *name;
+        CodeLanguage language;
+    } names[] = {
+        {"c", CODE_LANGUAGE_C}, {"c++", CODE_LANGUAGE_CPP}, {"cpp", CODE_LANGUAGE_CPP},
+        {"python", CODE_LANGUAGE_PYTHON}, {"py", CODE_LANGUAGE_PYTHON},
+        {"js", CODE_LANGUAGE_JS}, {"javascript", CODE_LANGUAGE_JS},
+        {"typescript", CODE_LANGUAGE_JS}, {"text", CODE_LANGUAGE_NONE}
+    };
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcasecmp(name, names[i].name) == 0) {
+            *language = names[i].language;
+            return true;
+        }
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------
+// Lexer
+// ---------------------------------------------------------------------
+
+typedef struct {
+    const Language *lang;
+    SourceCounts *counts;
+    const char *text;
+    size_t length;
+
+    size_t line_start;          // offset of the current line
+    bool code;                  // the current line holds code
+    bool comment;               // ... or a comment
+
+    bool statement_start;       // nothing lexed yet in this statement (Python)
+    bool directive;             // inside a preprocessor line
+    bool operand;               // the last token ends an operand: '/' divides
+    bool callable;              // the last token may name a definition
+    bool operator_name;         // C++: inside `operator<symbols>`
+    bool defining;              // JavaScript: `function` already counted this one
+
+    // Definition candidates: name ( ... ) followed by {
+    int paren_depth;
+    int candidate_depth;        // paren depth inside the candidate's '(', 0 for none
+    bool pending;               // the candidate's ')' has been seen
+    int pending_depth;          // paren depth the candidate started at
+    bool scope;                 // a scope keyword opened this statement
+
+    size_t brace_depth;
+    unsigned char braces[MAX_BRACE_DEPTH];
+} Lexer;
+
+static void end_line(Lexer *lx, size_t at) {
+    SourceCounts *counts = lx->counts;
+    size_t length = at - lx->line_start;
+
+    counts->lines++;
+    if (length > counts->longest_line) counts->longest_line = length;
+    if (lx->code) {
+        counts->code_lines++;
+    } else if (lx->comment) {
+        counts->comment_lines++;
+    } else {
+        counts->blank_lines++;
+    }
+
+    lx->line_start = at + 1;
+    lx->code = false;
+    lx->comment = false;
+}
+
+// A newline inside a string or comment: the next line continues it
+static void inner_newline(Lexer *lx, size_t at, bool comment) {
+    end_line(lx, at);
+    if (comment) {
+        lx->comment = true;
+    } else {
+        lx->code = true;
+    }
+}
+
+static void newline(Lexer *lx, size_t at) {
+    const char *text = lx->text;
+    bool continued = (at > 0 && text[at - 1] == '\\') ||
+                     (at > 1 && text[at - 1] == '\r' && text[at - 2] == '\\');
+
+    end_line(lx, at);
+    if (!continued) {
+        lx->directive = false;
+        if (lx->paren_depth == 0) lx->statement_start = true;
+    }
+}
+
+static void token(Lexer *lx, bool operand) {
+    lx->code = true;
+    lx->statement_start = false;
+    lx->operand = operand;
+    lx->callable = lx->operator_name;
+}
+
+static size_t lex_block_comment(Lexer *lx, size_t i) {
+    lx->comment = true;
+
+    for (i += 2; i < lx->length; i++) {
+        char c = lx->text[i];
+        if (c == '\n') {
+            inner_newline(lx, i, true);
+        } else if (c == '*' && i + 1 < lx->length && lx->text[i + 1] == '/') {
+            return i + 2;
+        }
+    }
+    return lx->length;
+}
+
+// The rest of the line; the newline itself is left to the main loop
+static size_t lex_line_comment(Lexer *lx, size_t i) {
+    lx->comment = true;
+    const char *newline_at = memchr(lx->text + i, '\n', lx->length - i);
+    return newline_at ? (size_t)(newline_at - lx->text) : lx->length;
+}
+
+// '...' or "..." from the opening quote. An unescaped newline ends a
+// string left open by mistake, so one bad quote cannot swallow the file.
+static size_t lex_quoted(Lexer *lx, size_t i) {
+    const char *text = lx->text;
+    char quote = text[i];
+
+    token(lx, true);
+    for (i++; i < lx->length; i++) {
+        char c = text[i];
+        if (c == '\\') {
+            if (i + 1 < lx->length && text[i + 1] == '\n') inner_newline(lx, i + 1, false);
+            i++;
+        } else if (c == quote) {
+            return i + 1;
+        } else if (c == '\n') {
+            return i;
+        }
+    }
+    return lx->length;
+}
+
+// Python '''...''' and """...""". One that opens a statement is a
+// docstring, counted as comment lines.
+static size_t lex_triple_quoted(Lexer *lx, size_t i) {
+    const char *text = lx->text;
+    char quote = text[i];
+    bool docstring = lx->statement_start;
+
+    if (docstring) {
+        lx->comment = true;
+        lx->statement_start = false;
+    } else {
+        token(lx, true);
+    }
+
+    for (i += 3; i < lx->length; i++) {
+        char c = text[i];
+        if (c == '\\') {
+            if (i + 1 < lx->length && text[i + 1] == '\n') inner_newline(lx, i + 1, docstring);
+            i++;
+        } else if (c == '\n') {
+            inner_newline(lx, i, docstring);
+        } else if (c == quote && i + 2 < lx->length && text[i + 1] == quote &&
+                   text[i + 2] == quote) {
+            return i + 3;
+        }
+    }
+    return lx->length;
+}
+
+static size_t lex_string(Lexer *lx, size_t i) {
+    const char *text = lx->text;
+    if (lx->lang->triple_quotes && i + 2 < lx->length &&
+        text[i + 1] == text[i] && text[i + 2] == text[i]) {
+        return lex_triple_quoted(lx, i);
+    }
+    return lex_quoted(lx, i);
+}
+
+// JavaScript `...`, which may span lines
+static size_t lex_template(Lexer *lx, size_t i) {
+    const char *text = lx->text;
+
+    token(lx, true);
+    for (i++; i < lx->length; i++) {
+        char c = text[i];
+        if (c == '\\') {
+            if (i + 1 < lx->length && text[i + 1] == '\n') inner_newline(lx, i + 1, false);
+            i++;
+        } else if (c == '`') {
+            return i + 1;
+        } else if (c == '\n') {
+            inner_newline(lx, i, false);
+        }
+    }
+    return lx->length;
+}
+
+// C++ R"delim(...)delim" from the opening quote
+static size_t lex_raw_string(Lexer *lx, size_t i) {
+    const char *text = lx->text;
+    size_t open = i + 1;
+    size_t paren = open;
+
+    while (paren < lx->length && paren - open < 16 && text[paren] != '(' &&
+           text[paren] != '"' && text[paren] != '\n' && text[paren] != ' ') {
+        paren++;
+    }
+    if (paren >= lx->length || text[paren] != '(') return lex_quoted(lx, i);
+
+    const char *delimiter = text + open;
+    size_t delimiter_length = paren - open;
+
+    token(lx, true);
+    for (i = paren + 1; i < lx->length; i++) {
+        if (text[i] == '\n') {
+            inner_newline(lx, i, false);
+        } else if (text[i] == ')' && i + 1 + delimiter_length < lx->length &&
+                   memcmp(text + i + 1, delimiter, delimiter_length) == 0 &&
+                   text[i + 1 + delimiter_length] == '"') {
+            return i + 2 + delimiter_length;
+        }
+    }
+    return lx->length;
+}
+
+// JavaScript /regex/flags where an operand is expected. A newline means
+// it was not one after all.
+static size_t lex_regex(Lexer *lx, size_t i) {
+    const char *text = lx->text;
+    bool in_class = false;
+
+    token(lx, true);
+    for (i++; i < lx->length; i++) {
+        char c = text[i];
+        if (c == '\n') return i;
+        if (c == '\\' && i + 1 < lx->length && text[i + 1] != '\n') {
+            i++;
+        } else if (c == '[') {
+            in_class = true;
+        } else if (c == ']') {
+            in_class = false;
+        } else if (c == '/' && !in_class) {
+            for (i++; i < lx->length && lx->lang->classes[(unsigned char)text[i]] == CLASS_IDENT; i++) {}
+            return i;
+        }
+    }
+    return lx->length;
+}
+
+static size_t lex_number(Lexer *lx, size_t i) {
+    const Language *lang = lx->lang;
+    const char *text = lx->text;
+
+    token(lx, true);
+    while (i < lx->length) {
+        unsigned char c = (unsigned char)text[i];
+        int cls = lang->classes[c];
+        if (cls == CLASS_IDENT || cls == CLASS_DIGIT || c == '.') {
+            i++;
+        } else if (c == '\'' && lang->digit_separators && i + 1 < lx->length &&
+                   lang->classes[(unsigned char)text[i + 1]] >= CLASS_IDENT &&
+                   lang->classes[(unsigned char)text[i + 1]] <= CLASS_DIGIT) {
+            i++;
+        } else {
+            break;
+        }
+    }
+    return i;
+}
+
+static bool is_raw_prefix(const char *word, size_t length) {
+    if (word[length - 1] != 'R') return false;
+    if (length == 1) return true;
+    if (length == 2) return word[0] == 'L' || word[0] == 'u' || word[0] == 'U';
+    return length == 3 && word[0] == 'u' && word[1] == '8';
+}
+
+static size_t lex_word(Lexer *lx, size_t i) {
+    const Language *lang = lx->lang;
+    const char *text = lx->text;
+    size_t start = i;
+
+    while (i < lx->length) {
+        int cls = lang->classes[(unsigned char)text[i]];
+        if (cls != CLASS_IDENT && cls != CLASS_DIGIT) break;
+        i++;
+    }
+
+    bool quoted = i < lx->length && lang->classes[(unsigned char)text[i]] == CLASS_QUOTE;
+    if (quoted && lang->raw_strings && text[i] == '"' && is_raw_prefix(text + start, i - start)) {
+        return lex_raw_string(lx, i);
+    }
+    // A Python string prefix (r, b, f, rb, ...) belongs to the string
+    if (quoted && lang->triple_quotes && i - start <= 2) {
+        return i;
+    }
+
+    bool at_start = lx->statement_start;
+    token(lx, true);
+    lx->operator_name = false;
+
+    const Keyword *keyword = find_keyword(lang, text + start, i - start);
+    if (!keyword) {
+        lx->callable = !lx->directive;
+        return i;
+    }
+
+    lx->operand = false;
+    lx->callable = false;
+    if (lx->directive) return i;
+
+    switch (keyword->kind) {
+        case KEYWORD_DECISION:
+            lx->counts->decisions++;
+            break;
+        case KEYWORD_DECISION_AT_START:
+            if (at_start) lx->counts->decisions++;
+            break;
+        case KEYWORD_FUNCTION:
+            lx->counts->functions++;
+            lx->defining = true;
+            break;
+        case KEYWORD_SCOPE:
+            lx->scope = true;
+            break;
+        case KEYWORD_OPERATOR:
+            lx->operator_name = true;
+            lx->callable = true;
+            break;
+        default:
+            break;
+    }
+    return i;
+}
+
+// Function bodies and plain blocks do not hold definitions in C and C++;
+// a name(...) { there is a macro or a statement. Elsewhere a definition's
+// body follows its parameters directly, not a call nested in a condition.
+static bool definition_allowed(const Lexer *lx) {
+    if (!lx->lang->scoped_functions) return lx->paren_depth == lx->pending_depth;
+    if (lx->brace_depth == 0) return true;
+    if (lx->brace_depth > MAX_BRACE_DEPTH) return false;
+    return lx->braces[lx->brace_depth - 1] == BRACE_SCOPE;
+}
+
+static void open_brace(Lexer *lx) {
+    unsigned char kind = BRACE_BLOCK;
+
+    if (lx->pending && !lx->directive && definition_allowed(lx)) {
+        kind = BRACE_FUNCTION;
+        lx->counts->functions++;
+    } else if (lx->scope) {
+        kind = BRACE_SCOPE;
+    }
+
+    if (lx->brace_depth < MAX_BRACE_DEPTH) lx->braces[lx->brace_depth] = kind;
+    lx->brace_depth++;
+
+    lx->pending = false;
+    lx->scope = false;
+    lx->defining = false;
+    lx->candidate_depth = 0;
+}
+
+// End of a statement or block: no definition is in progress
+static void end_statement(Lexer *lx) {
+    lx->pending = false;
+    lx->scope = false;
+    lx->defining = false;
+    lx->candidate_depth = 0;
+}
+
+// C++: whether the && at `i`, following an operand, declares an rvalue or
+// forwarding reference (auto&& x, T&& x, Args&&... args) rather than
+// joining two conditions. A name and && read the same either way, so
+// this goes by what surrounds them.
+static bool rvalue_reference(const Lexer *lx, size_t i) {
+    static const char *const type_words[] = {
+        "auto", "bool", "char", "char8_t", "char16_t", "char32_t", "wchar_t", "short",
+        "int", "long", "float", "double", "void", "signed", "unsigned", "const", "volatile"
+    };
+    const Language *lang = lx->lang;
+    const char *text = lx->text;
+
+    // Right after a type word
+    size_t end = i;
+    while (end > 0 && lang->classes[(unsigned char)text[end - 1]] == CLASS_SPACE) end--;
+    size_t start = end;
+    while (start > 0 && (lang->classes[(unsigned char)text[start - 1]] == CLASS_IDENT ||
+                         lang->classes[(unsigned char)text[start - 1]] == CLASS_DIGIT)) {
+        start--;
+    }
+    for (size_t k = 0; start < end && k < sizeof(type_words) / sizeof(type_words[0]); k++) {
+        if (strncmp(type_words[k], text + start, end - start) == 0 &&
+            type_words[k][end - start] == '\0') {
+            return true;
+        }
+    }
+
+    // In the parameter list of a definition, where no expressions go
+    if (lx->candidate_depth > 0 && lx->candidate_depth == lx->paren_depth &&
+        definition_allowed(lx)) {
+        return true;
+    }
+
+    // No operand follows (T&&> T&&) T&&...), or a name being initialized
+    // does: a && b = c does not compile as an expression
+    size_t j = i + 2;
+    while (j < lx->length && lang->classes[(unsigned char)text[j]] == CLASS_SPACE) j++;
+    if (j >= lx->length) return false;
+    char next = text[j];
+    if (next == ')' || next == ']' || next == '>' || next == ',' || next == ';' ||
+        next == '.' || next == '=') {
+        return true;
+    }
+    if (lang->classes[(unsigned char)next] != CLASS_IDENT) return false;
+    while (j < lx->length && (lang->classes[(unsigned char)text[j]] == CLASS_IDENT ||
+                              lang->classes[(unsigned char)text[j]] == CLASS_DIGIT)) {
+        j++;
+    }
+    while (j < lx->length && lang->classes[(unsigned char)text[j]] == CLASS_SPACE) j++;
+    return j < lx->length && text[j] == '=' && !(j + 1 < lx->length && text[j + 1] == '=');
+}
+
+void code_lex(CodeLanguage language, const char *text, size_t length, SourceCounts *counts) {
+    pthread_once(&languages_once, build_languages);
+
+    SourceCounts file;
+    memset(&file, 0, sizeof(file));
+
+    Lexer lx;
+    memset(&lx, 0, sizeof(lx));
+    lx.lang = &languages[language < CODE_LANGUAGE_COUNT ? language : CODE_LANGUAGE_NONE];
+    lx.counts = &file;
+    lx.text = text;
+    lx.length = length;
+    lx.statement_start = true;
+
+    const Language *lang = lx.lang;
+    size_t i = 0;
+
+    while (i < length) {
+        unsigned char c = (unsigned char)text[i];
+
+        switch (lang->classes[c]) {
+            case CLASS_SPACE:
+                i++;
+                break;
+
+            case CLASS_NEWLINE:
+                newline(&lx, i);
+                i++;
+                break;
+
+            case CLASS_IDENT:
+                i = lex_word(&lx, i);
+                break;
+
+            case CLASS_DIGIT:
+                i = lex_number(&lx, i);
+                break;
+
+            case CLASS_QUOTE:
+                i = lex_string(&lx, i);
+                break;
+
+            case CLASS_BACKTICK:
+                i = lex_template(&lx, i);
+                break;
+
+            case CLASS_SLASH:
+                if (lang->slash_comments && i + 1 < length && text[i + 1] == '/') {
+                    i = lex_line_comment(&lx, i);
+                } else if (lang->slash_comments && i + 1 < length && text[i + 1] == '*') {
+                    i = lex_block_comment(&lx, i);
+                } else if (lang->regex_literals && !lx.operand) {
+                    i = lex_regex(&lx, i);
+                } else {
+                    token(&lx, false);
+                    i++;
+                }
+                break;
+
+            case CLASS_HASH:
+                if (lang->hash_comments) {
+                    i = lex_line_comment(&lx, i);
+                } else {
+                    // A directive if nothing precedes it on the line
+                    if (!lx.code) lx.directive = true;
+                    token(&lx, false);
+                    i++;
+                }
+                break;
+
+            case CLASS_OPEN:
+                if (c == '(' && lx.callable && !lx.defining && lx.candidate_depth == 0 &&
+                    lang->brace_functions) {
+                    lx.candidate_depth = lx.paren_depth + 1;
+                }
+                lx.paren_depth++;
+                lx.operator_name = false;
+                token(&lx, false);
+                i++;
+                break;
+
+            case CLASS_CLOSE:
+                if (lx.paren_depth > 0) {
+                    if (c == ')' && lx.candidate_depth == lx.paren_depth) {
+                        lx.pending = true;
+                        lx.pending_depth = lx.paren_depth - 1;
+                        lx.candidate_depth = 0;
+                    }
+                    lx.paren_depth--;
+                }
+                token(&lx, true);
+                i++;
+                break;
+
+            case CLASS_BRACE_OPEN:
+                open_brace(&lx);
+                token(&lx, false);
+                i++;
+                break;
+
+            case CLASS_BRACE_CLOSE:
+                if (lx.brace_depth > 0) lx.brace_depth--;
+                end_statement(&lx);
+                token(&lx, false);
+                i++;
+                break;
+
+            case CLASS_SEMICOLON:
+                end_statement(&lx);
+                token(&lx, false);
+                if (lx.paren_depth == 0) lx.statement_start = true;
+                i++;
+                break;
+
+            case CLASS_AMP:
+            case CLASS_PIPE:
+                if (i + 1 < length && text[i + 1] == (char)c) {
+                    // Only between operands: C++ also writes && in declarations
+                    bool decision = !lx.directive &&
+                                    (!lang->rvalue_references || c == '|' ||
+                                     (lx.operand && !rvalue_reference(&lx, i)));
+                    if (decision) file.decisions++;
+                    i++;
+                }
+                token(&lx, false);
+                i++;
+                break;
+
+            case CLASS_QUESTION:
+                token(&lx, false);
+                if (i + 1 < length && text[i + 1] == '.' &&
+                    !(i + 2 < length && text[i + 2] >= '0' && text[i + 2] <= '9')) {
+                    i += 2;     // optional chaining, not a branch
+                    break;
+                }
+                if (!lx.directive) file.decisions++;
+                i += i + 1 < length && text[i + 1] == '?' ? 2 : 1;
+                break;
+
+            case CLASS_EQUALS:
+                if (lang->arrow_functions && i + 1 < length && text[i + 1] == '>') {
+                    // An arrow function; its name(...) before was the parameter list
+                    file.functions++;
+                    lx.pending = false;
+                    token(&lx, false);
+                    i += 2;
+                    break;
+                }
+                token(&lx, false);
+                i++;
+                break;
+
+            default:
+                token(&lx, false);
+                i++;
+                break;
+        }
+    }
+
+    if (length > lx.line_start) end_line(&lx, length);
+
+    if (language != CODE_LANGUAGE_NONE && file.code_lines > 0) {
+        file.complexity = file.decisions + (file.functions > 0 ? file.functions : 1);
+    }
+    source_counts_merge(counts, &file);
+}
+
+void source_counts_merge(SourceCounts *dest, const SourceCounts *src) {
+    dest->lines += src->lines;
+    dest->code_lines += src->code_lines;
+    dest->comment_lines += src->comment_lines;
+    dest->blank_lines += src->blank_lines;
+    dest->functions += src->functions;
+    dest->decisions += src->decisions;
+    dest->complexity += src->complexity;
+    if (src->longest_line > dest->longest_line) dest->longest_line = src->longest_line;
+}
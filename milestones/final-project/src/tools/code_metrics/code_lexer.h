@@ -0,0 +1,61 @@
+#ifndef DEVTOOLS_CODE_LEXER_H
+#define DEVTOOLS_CODE_LEXER_H
+
+#include "../../config.h"
+
+// Single-pass source lexers.
+//
+// Each language is a table: a class for every byte, a keyword hash and a
+// few syntax flags (comment styles, string forms). One lexer walks a file
+// once, byte class by byte class, and produces every metric on the way:
+// each line is classified when its newline is reached, and keywords and
+// operators feed the complexity and function counts as they are lexed.
+// Nothing is tokenized into memory and no line is looked at twice.
+//
+// Lines holding any code count as code, even with a trailing comment;
+// lines inside a comment or holding only comments count as comments.
+// Python docstrings (a triple-quoted string opening a statement) count as
+// comments.
+//
+// Decision points: if / for / while / case / catch (elif / except / and /
+// or in Python) plus && || ?: and ?? in the C family and JavaScript. The
+// complexity of a file is its decision points plus one for every function,
+// and at least one for a file with code (McCabe summed over functions).
+//
+// Functions: definitions `name(...) {` in C and C++ (at file level or in a
+// class or namespace body; calls and macros inside functions do not
+// count), `def` in Python, and `function`, arrow functions and method
+// definitions in JavaScript.
+
+typedef enum {
+    CODE_LANGUAGE_NONE,         // unknown: lines are only code or blank
+    CODE_LANGUAGE_C,
+    CODE_LANGUAGE_CPP,
+    CODE_LANGUAGE_PYTHON,
+    CODE_LANGUAGE_JS,
+    CODE_LANGUAGE_COUNT
+} CodeLanguage;
+
+typedef struct {
+    size_t lines;
+    size_t code_lines;          // SLOC
+    size_t comment_lines;
+    size_t blank_lines;
+    size_t functions;
+    size_t decisions;
+    size_t complexity;
+    size_t longest_line;        // in bytes, without the newline
+} SourceCounts;
+
+// Language from the file name's extension (.h counts as C)
+CodeLanguage code_language_for(const char *filename);
+const char* code_language_name(CodeLanguage language);
+// Language from a name such as "c", "c++", "python" or "js"; false if unknown
+bool code_language_parse(const char *name, CodeLanguage *language);
+
+// Lexes text[0, length) as one file and adds its counts to `counts`
+void code_lex(CodeLanguage language, const char *text, size_t length, SourceCounts *counts);
+
+void source_counts_merge(SourceCounts *dest, const SourceCounts *src);
+
+#endif // DEVTOOLS_CODE_LEXER_H
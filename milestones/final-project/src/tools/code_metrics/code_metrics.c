@@ -0,0 +1,328 @@
+#include "code_metrics.h"
+#include "../../common/error.h"
+#include "../../common/file_map.h"
+#include "../../common/logging.h"
+#include "../../common/memory.h"
+#include "content_hash.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+
+int code_metrics_file(CodeMetrics *metrics, const char *filename, CodeLanguage language,
+                      MetricsCache *cache) {
+    FileMap map;
+    int status = file_map_open(&map, filename);
+    if (status != SUCCESS) {
+        fprintf(stderr, "code-metrics: %s: %s\n", filename, strerror(errno));
+        return status;
+    }
+
+    metrics->files++;
+    metrics->bytes += map.length;
+
+    // Hashing runs many times faster than lexing, so unchanged content
+    // costs little more than reading it
+    SourceCounts counts;
+    memset(&counts, 0, sizeof(counts));
+    if (cache) {
+        MetricsKey key = { content_hash64(map.data, map.length, 0), map.length, language };
+        if (!metrics_cache_lookup(cache, &key, &counts)) {
+            code_lex(language, map.data, map.length, &counts);
+            metrics_cache_store(cache, &key, &counts);
+        }
+    } else {
+        code_lex(language, map.data, map.length, &counts);
+    }
+    source_counts_merge(&metrics->source, &counts);
+
+    file_map_close(&map);
+    return SUCCESS;
+}
+
+void code_metrics_merge(CodeMetrics *dest, const CodeMetrics *src) {
+    dest->files += src->files;
+    dest->bytes += src->bytes;
+    source_counts_merge(&dest->source, &src->source);
+}
+
+static void print_header(void) {
+    printf("%9s %9s %9s %9s %9s %-7s %s\n",
+           "code", "comment", "blank", "functions", "complex", "lang", "file");
+}
+
+static void print_row(const CodeMetrics *metrics, const char *language, const char *name) {
+    const SourceCounts *source = &metrics->source;
+    printf("%9zu %9zu %9zu %9zu %9zu %-7s %s\n", source->code_lines, source->comment_lines,
+           source->blank_lines, source->functions, source->complexity, language, name);
+}
+
+// Directories in name order under each parent: first child and next
+// sibling links over the interned nodes
+typedef struct {
+    int32_t *first_child;
+    int32_t *next_sibling;
+} DirTree;
+
+static const DirTable *sort_dirs;
+
+static int compare_dirs(const void *a, const void *b) {
+    const DirNode *x = &sort_dirs->nodes[*(const int32_t*)a];
+    const DirNode *y = &sort_dirs->nodes[*(const int32_t*)b];
+    if (x->parent != y->parent) return x->parent < y->parent ? -1 : 1;
+    return strcmp(x->name, y->name);
+}
+
+static void print_dir(const MetricsReport *report, const DirTree *tree, int32_t node,
+                      int max_depth) {
+    const DirNode *dir = &report->dirs.nodes[node];
+    char name[MAX_PATH_LENGTH];
+
+    snprintf(name, sizeof(name), "%*s%s%s", (int)dir->depth * 2, "", dir->name,
+             node == DIR_TABLE_ROOT || strcmp(dir->name, "/") == 0 ? "" : "/");
+    print_row(&report->dir_metrics[node], "dir", name);
+
+    if (max_depth >= 0 && (int)dir->depth >= max_depth) return;
+    for (int32_t child = tree->first_child[node]; child >= 0; child = tree->next_sibling[child]) {
+        print_dir(report, tree, child, max_depth);
+    }
+}
+
+static bool print_tree(const MetricsReport *report, int max_depth) {
+    size_t count = report->dirs.count;
+    int32_t *order = MALLOC(count * sizeof(int32_t));
+    int32_t *first_child = MALLOC(count * sizeof(int32_t));
+    int32_t *next_sibling = MALLOC(count * sizeof(int32_t));
+    if (!order || !first_child || !next_sibling) {
+        FREE(order);
+        FREE(first_child);
+        FREE(next_sibling);
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        order[i] = (int32_t)i;
+        first_child[i] = next_sibling[i] = -1;
+    }
+
+    // Sorted by (parent, name); linked back to front, so every list ends
+    // up in name order
+    sort_dirs = &report->dirs;
+    qsort(order + 1, count - 1, sizeof(int32_t), compare_dirs);
+    for (size_t i = count; i-- > 1;) {
+        int32_t node = order[i];
+        int32_t parent = report->dirs.nodes[node].parent;
+        next_sibling[node] = first_child[parent];
+        first_child[parent] = node;
+    }
+
+    DirTree tree = { first_child, next_sibling };
+    print_dir(report, &tree, DIR_TABLE_ROOT, max_depth);
+
+    FREE(order);
+    FREE(first_child);
+    FREE(next_sibling);
+    return true;
+}
+
+// File rows (or the directory tree), then totals per language and overall
+static void print_report(MetricsReport *report, bool tree, int tree_depth) {
+    metrics_report_rollup(report);
+    const CodeMetrics *total = &report->dir_metrics[DIR_TABLE_ROOT];
+    if (total->files == 0) return;
+
+    print_header();
+    for (size_t i = 0; i < report->row_count; i++) {
+        const FileRow *row = &report->rows[i];
+        print_row(&row->metrics, code_language_name(row->language),
+                  strcmp(row->path, "-") == 0 ? "(stdin)" : row->path);
+    }
+    if (tree && !print_tree(report, tree_depth)) {
+        LOG_ERROR("Out of memory printing the directory tree");
+    }
+
+    if (total->files > 1 || report->row_count == 0) {
+        int used = 0;
+        for (int i = 0; i < CODE_LANGUAGE_COUNT; i++) {
+            if (report->languages[i].files > 0) used++;
+        }
+        for (int i = 0; used > 1 && i < CODE_LANGUAGE_COUNT; i++) {
+            if (report->languages[i].files > 0) {
+                print_row(&report->languages[i], code_language_name((CodeLanguage)i), "total");
+            }
+        }
+        print_row(total, "all", "total");
+    }
+}
+
+int code_metrics_execute(int argc, char *argv[]) {
+    static struct option long_options[] = {
+        {"language", required_argument, 0, 'l'},
+        {"cache", required_argument, 0, 'c'},
+        {"compact-cache", no_argument, 0, 1000},
+        {"cache-max-age", required_argument, 0, 1001},
+        {"jobs", required_argument, 0, 'j'},
+        {"tree", no_argument, 0, 't'},
+        {"depth", required_argument, 0, 1002},
+        {"summary", no_argument, 0, 's'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    // Reset getopt state left over from global option parsing
+    optind = 0;
+
+    MetricsOptions options;
+    memset(&options, 0, sizeof(options));
+    options.rows = true;
+
+    const char *cache_path = NULL;
+    bool tree = false;
+    int tree_depth = -1;
+    bool compact_cache = false;
+    unsigned int cache_max_age = METRICS_CACHE_DEFAULT_MAX_AGE;
+
+    int c;
+    while ((c = getopt_long(argc, argv, "l:c:j:tsh", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'l':
+                if (!code_language_parse(optarg, &options.language)) {
+                    LOG_ERROR("Unknown language: %s", optarg);
+                    return ERROR_INVALID_ARGUMENT;
+                }
+                options.forced = true;
+                break;
+
+            case 'j':
+                options.jobs = atoi(optarg);
+                if (options.jobs <= 0) {
+                    LOG_ERROR("Invalid job count: %s", optarg);
+                    return ERROR_INVALID_ARGUMENT;
+                }
+                break;
+
+            case 't':
+                tree = true;
+                options.rows = false;
+                break;
+
+            case 1002: // --depth
+                tree_depth = atoi(optarg);
+                if (tree_depth < 0) {
+                    LOG_ERROR("Invalid depth: %s", optarg);
+                    return ERROR_INVALID_ARGUMENT;
+                }
+                tree = true;
+                options.rows = false;
+                break;
+
+            case 's':
+                options.rows = false;
+                break;
+
+            case 'c':
+                cache_path = optarg;
+                break;
+
+            case 1000: // --compact-cache
+                compact_cache = true;
+                break;
+
+            case 1001: // --cache-max-age
+                cache_max_age = (unsigned int)strtoul(optarg, NULL, 10);
+                if (cache_max_age == 0) {
+                    LOG_ERROR("Invalid cache age: %s", optarg);
+                    return ERROR_INVALID_ARGUMENT;
+                }
+                break;
+
+            case 'h':
+                code_metrics_help();
+                return SUCCESS;
+
+            default:
+                return ERROR_INVALID_ARGUMENT;
+        }
+    }
+
+    if (compact_cache && !cache_path) {
+        LOG_ERROR("--compact-cache needs --cache FILE");
+        return ERROR_INVALID_ARGUMENT;
+    }
+
+    if (optind >= argc && !compact_cache) {
+        LOG_ERROR("Usage: devtools code-metrics <files>");
+        return ERROR_INVALID_ARGUMENT;
+    }
+
+    MetricsCache *cache = NULL;
+    if (cache_path) {
+        cache = metrics_cache_open(cache_path);
+        if (!cache) return ERROR_FILE_NOT_FOUND;
+    }
+
+    options.cache = cache;
+
+    MetricsReport report;
+    int result = SUCCESS;
+    if (!metrics_report_init(&report)) {
+        result = ERROR_MEMORY_ALLOCATION;
+    } else if (optind < argc) {
+        result = code_metrics_collect(argv + optind, argc - optind, &options, &report);
+        print_report(&report, tree, tree_depth);
+
+        if (!g_config.quiet) {
+            const CodeMetrics *total = &report.dir_metrics[DIR_TABLE_ROOT];
+            fprintf(stderr, "%zu files, %zu lines, %zu bytes, longest line %zu bytes\n",
+                    total->files, total->source.lines, total->bytes, total->source.longest_line);
+            if (cache) {
+                size_t hits, misses;
+                metrics_cache_stats(cache, &hits, &misses);
+                fprintf(stderr, "Cache: %zu hits, %zu lexed\n", hits, misses);
+            }
+        }
+    }
+    metrics_report_free(&report);
+
+    if (compact_cache) {
+        int status = metrics_cache_compact(cache, cache_max_age);
+        if (result == SUCCESS) result = status;
+    }
+
+    metrics_cache_close(cache);
+    return result;
+}
+
+void code_metrics_help(void) {
+    printf("Code Metrics Tool\n");
+    printf("=================\n");
+    printf("Counts code, comment and blank lines, functions and cyclomatic\n");
+    printf("complexity per file, lexing each file once with a lexer for its\n");
+    printf("language (C, C++, Python, JavaScript; chosen by extension).\n");
+    printf("A line holding any code is a code line. Complexity is the number of\n");
+    printf("decision points (if, for, while, case, catch, &&, ||, ?:) plus one\n");
+    printf("per function. Files are scanned in place through a memory mapping.\n");
+    printf("Directories are walked in parallel for files in a known language.\n");
+    printf("\nOptions:\n");
+    printf("  -l, --language LANG  Lex every file as LANG (c, c++, python, js, text)\n");
+    printf("  -j, --jobs N         Measure files on N threads (default: one per CPU)\n");
+    printf("  -t, --tree           Print a tree of per-directory totals instead of files\n");
+    printf("  --depth N            Limit the tree to N levels; each argument is one\n");
+    printf("                       level, its subdirectories the next (implies --tree)\n");
+    printf("  -s, --summary        Print only the totals\n");
+    printf("  -h, --help           Show this help message\n");
+    printf("\nIncremental cache:\n");
+    printf("  -c, --cache FILE     Keep per-file results keyed by a hash of the file's\n");
+    printf("                       contents; only new or changed contents are lexed\n");
+    printf("  --compact-cache      Drop entries unused in the last N runs and shrink\n");
+    printf("                       the cache file (may be run without any files)\n");
+    printf("  --cache-max-age N    Runs an entry survives compaction (default: %d)\n",
+           METRICS_CACHE_DEFAULT_MAX_AGE);
+    printf("\nUsage:\n");
+    printf("  devtools code-metrics <file1> [file2] ...\n");
+    printf("  devtools code-metrics src/*.c src/*.h\n");
+    printf("  devtools code-metrics --tree --depth 2 src\n");
+    printf("  cat script | devtools code-metrics -l python -\n");
+    printf("  devtools code-metrics --cache .metricscache $(git ls-files '*.c')\n");
+}
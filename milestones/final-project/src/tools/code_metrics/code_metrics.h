@@ -0,0 +1,94 @@
+#ifndef DEVTOOLS_CODE_METRICS_H
+#define DEVTOOLS_CODE_METRICS_H
+
+#include "../../config.h"
+#include "../../common/arena.h"
+#include "code_lexer.h"
+#include "dir_table.h"
+
+// Source statistics per file. Every file is scanned once, in place,
+// through a read-only mapping, by the lexer of its language; lines have
+// no length limit.
+typedef struct {
+    size_t files;
+    size_t bytes;
+    SourceCounts source;
+} CodeMetrics;
+
+// Persistent per-file results keyed by content: a file whose bytes were
+// lexed before (under any name) is not lexed again
+#define METRICS_CACHE_DEFAULT_MAX_AGE 5
+
+typedef struct {
+    uint64_t hash;              // content_hash64 of the file
+    uint64_t length;
+    CodeLanguage language;
+} MetricsKey;
+
+typedef struct MetricsCache MetricsCache;
+
+// One file's row in a report
+typedef struct {
+    const char *path;
+    int root;                   // the command-line argument it was found under
+    CodeLanguage language;
+    CodeMetrics metrics;
+} FileRow;
+
+// Everything one run collects. Each worker fills a report of its own and
+// shares nothing while the pool runs; the reports are merged afterwards.
+typedef struct {
+    FileRow *rows;
+    size_t row_count;
+    size_t row_capacity;
+    Arena paths;
+
+    CodeMetrics languages[CODE_LANGUAGE_COUNT];
+
+    // Per interned directory: the files directly inside it, or everything
+    // below it after metrics_report_rollup()
+    DirTable dirs;
+    CodeMetrics *dir_metrics;
+    size_t dir_capacity;
+
+    int status;                 // last failure, or SUCCESS
+} MetricsReport;
+
+typedef struct {
+    bool forced;                // lex every file as `language`
+    CodeLanguage language;
+    MetricsCache *cache;        // may be NULL
+    int jobs;                   // 0 for one per CPU
+    bool rows;                  // keep a row per file
+} MetricsOptions;
+
+// Tool entry points
+int code_metrics_execute(int argc, char *argv[]);
+void code_metrics_help(void);
+
+// Adds the statistics of one file ("-" for standard input), lexed as
+// `language` or taken from `cache` (may be NULL), to `metrics`
+int code_metrics_file(CodeMetrics *metrics, const char *filename, CodeLanguage language,
+                      MetricsCache *cache);
+void code_metrics_merge(CodeMetrics *dest, const CodeMetrics *src);
+
+// Measures files and directory trees (directories are walked for files in
+// a known language, or every file with a forced language) on a
+// work-stealing pool. Rows come out sorted by argument, then path.
+int code_metrics_collect(char **paths, int count, const MetricsOptions *options,
+                         MetricsReport *report);
+bool metrics_report_init(MetricsReport *report);
+void metrics_report_free(MetricsReport *report);
+// Adds every directory's totals to its ancestors
+void metrics_report_rollup(MetricsReport *report);
+
+// Cache functions (lookups and stores are safe from worker threads; stores
+// reach the file when the cache is closed)
+MetricsCache* metrics_cache_open(const char *path);
+void metrics_cache_close(MetricsCache *cache);
+bool metrics_cache_lookup(MetricsCache *cache, const MetricsKey *key, SourceCounts *counts);
+void metrics_cache_store(MetricsCache *cache, const MetricsKey *key, const SourceCounts *counts);
+int metrics_cache_compact(MetricsCache *cache, unsigned int max_age);
+void metrics_cache_stats(const MetricsCache *cache, size_t *hits, size_t *misses);
+
+#endif // DEVTOOLS_CODE_METRICS_H
@@ -0,0 +1,92 @@
+#include "content_hash.h"
+
+#include <string.h>
+
+#define PRIME1 0x9E3779B185EBCA87ull
+#define PRIME2 0xC2B2AE3D27D4EB4Full
+#define PRIME3 0x165667B19E3779F9ull
+#define PRIME4 0x85EBCA77C2B2AE63ull
+#define PRIME5 0x27D4EB2F165667C5ull
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t read32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t lane_round(uint64_t acc, uint64_t input) {
+    acc += input * PRIME2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME1;
+}
+
+static inline uint64_t merge_lane(uint64_t hash, uint64_t lane) {
+    hash ^= lane_round(0, lane);
+    return hash * PRIME1 + PRIME4;
+}
+
+uint64_t content_hash64(const void *data, size_t length, uint64_t seed) {
+    const unsigned char *p = (const unsigned char*)data;
+    const unsigned char *end = p + length;
+    uint64_t hash;
+
+    if (length >= 32) {
+        uint64_t v1 = seed + PRIME1 + PRIME2;
+        uint64_t v2 = seed + PRIME2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME1;
+
+        const unsigned char *limit = end - 32;
+        do {
+            v1 = lane_round(v1, read64(p));
+            v2 = lane_round(v2, read64(p + 8));
+            v3 = lane_round(v3, read64(p + 16));
+            v4 = lane_round(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        hash = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        hash = merge_lane(hash, v1);
+        hash = merge_lane(hash, v2);
+        hash = merge_lane(hash, v3);
+        hash = merge_lane(hash, v4);
+    } else {
+        hash = seed + PRIME5;
+    }
+
+    hash += (uint64_t)length;
+
+    // Tail: whole words, a half word, then single bytes
+    while (end - p >= 8) {
+        hash ^= lane_round(0, read64(p));
+        hash = rotl64(hash, 27) * PRIME1 + PRIME4;
+        p += 8;
+    }
+    if (end - p >= 4) {
+        hash ^= (uint64_t)read32(p) * PRIME1;
+        hash = rotl64(hash, 23) * PRIME2 + PRIME3;
+        p += 4;
+    }
+    while (p < end) {
+        hash ^= (uint64_t)*p * PRIME5;
+        hash = rotl64(hash, 11) * PRIME1;
+        p++;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    hash *= PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
@@ -0,0 +1,12 @@
+#ifndef DEVTOOLS_CONTENT_HASH_H
+#define DEVTOOLS_CONTENT_HASH_H
+
+#include "../../config.h"
+
+// 64-bit non-cryptographic content hash (the XXH64 construction: four
+// multiply-rotate lanes over 32-byte stripes, folded and avalanched).
+// Several GB/s, so hashing a file costs far less than lexing it. Input
+// words are read in host byte order.
+uint64_t content_hash64(const void *data, size_t length, uint64_t seed);
+
+#endif // DEVTOOLS_CONTENT_HASH_H
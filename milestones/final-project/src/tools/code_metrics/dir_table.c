@@ -0,0 +1,144 @@
+#include "dir_table.h"
+#include "../../common/memory.h"
+
+#include <string.h>
+
+#define DIR_TABLE_INITIAL_CAPACITY 256
+#define DIR_TABLE_NAME_BLOCK (64 * 1024)
+
+// FNV-1a over the name, seeded with the parent
+static uint32_t hash_child(int32_t parent, const char *name, size_t length) {
+    uint32_t hash = 2166136261u ^ (uint32_t)parent * 0x9E3779B1u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static bool node_matches(const DirNode *node, int32_t parent, const char *name, size_t length) {
+    return node->parent == parent && node->name_length == length &&
+           memcmp(node->name, name, length) == 0;
+}
+
+static bool grow_slots(DirTable *table) {
+    size_t slot_count = table->slot_count * 2;
+    int32_t *slots = MALLOC(slot_count * sizeof(int32_t));
+    if (!slots) return false;
+    memset(slots, 0xff, slot_count * sizeof(int32_t));
+
+    for (size_t i = 0; i < table->count; i++) {
+        const DirNode *node = &table->nodes[i];
+        size_t slot = hash_child(node->parent, node->name, node->name_length) & (slot_count - 1);
+        while (slots[slot] >= 0) {
+            slot = (slot + 1) & (slot_count - 1);
+        }
+        slots[slot] = (int32_t)i;
+    }
+
+    FREE(table->slots);
+    table->slots = slots;
+    table->slot_count = slot_count;
+    return true;
+}
+
+static int32_t add_node(DirTable *table, int32_t parent, const char *name, size_t length) {
+    if (table->count == table->capacity) {
+        size_t capacity = table->capacity * 2;
+        DirNode *nodes = REALLOC(table->nodes, capacity * sizeof(DirNode));
+        if (!nodes) return -1;
+        table->nodes = nodes;
+        table->capacity = capacity;
+    }
+
+    char *copy = arena_alloc(&table->names, length + 1);
+    if (!copy) return -1;
+    memcpy(copy, name, length);
+    copy[length] = '\0';
+
+    DirNode *node = &table->nodes[table->count];
+    node->parent = parent;
+    node->depth = parent >= 0 ? table->nodes[parent].depth + 1 : 0;
+    node->name = copy;
+    node->name_length = (uint32_t)length;
+    return (int32_t)table->count++;
+}
+
+bool dir_table_init(DirTable *table) {
+    memset(table, 0, sizeof(DirTable));
+    arena_init(&table->names, DIR_TABLE_NAME_BLOCK);
+
+    table->capacity = DIR_TABLE_INITIAL_CAPACITY;
+    table->slot_count = DIR_TABLE_INITIAL_CAPACITY * 2;
+    table->nodes = MALLOC(table->capacity * sizeof(DirNode));
+    table->slots = MALLOC(table->slot_count * sizeof(int32_t));
+    if (!table->nodes || !table->slots) {
+        dir_table_free(table);
+        return false;
+    }
+    memset(table->slots, 0xff, table->slot_count * sizeof(int32_t));
+
+    // The root is not hashed: nothing looks it up by name
+    table->last_node = -1;
+    return add_node(table, -1, ".", 1) == DIR_TABLE_ROOT;
+}
+
+void dir_table_free(DirTable *table) {
+    FREE(table->nodes);
+    FREE(table->slots);
+    arena_free(&table->names);
+    table->count = table->capacity = table->slot_count = 0;
+}
+
+int32_t dir_table_child(DirTable *table, int32_t parent, const char *name, size_t length) {
+    size_t mask = table->slot_count - 1;
+    size_t slot = hash_child(parent, name, length) & mask;
+
+    while (table->slots[slot] >= 0) {
+        int32_t index = table->slots[slot];
+        if (node_matches(&table->nodes[index], parent, name, length)) return index;
+        slot = (slot + 1) & mask;
+    }
+
+    int32_t index = add_node(table, parent, name, length);
+    if (index < 0) return -1;
+    table->slots[slot] = index;
+
+    // Keep the load factor at or under 50%
+    if (table->count * 2 > table->slot_count && !grow_slots(table)) return -1;
+    return index;
+}
+
+int32_t dir_table_intern(DirTable *table, int32_t parent, const char *path, size_t length) {
+    if (table->last_node >= 0 && parent == table->last_parent && length == table->last_length &&
+        memcmp(path, table->last_path, length) == 0) {
+        return table->last_node;
+    }
+
+    int32_t node = parent;
+    size_t i = 0;
+
+    if (length > 0 && path[0] == '/') {
+        node = dir_table_child(table, node, "/", 1);
+        i = 1;
+    }
+
+    while (node >= 0 && i < length) {
+        size_t start = i;
+        while (i < length && path[i] != '/') i++;
+
+        size_t component = i - start;
+        if (component > 0 && !(component == 1 && path[start] == '.')) {
+            node = dir_table_child(table, node, path + start, component);
+        }
+        i++;
+    }
+
+    if (node >= 0 && length < sizeof(table->last_path)) {
+        memcpy(table->last_path, path, length);
+        table->last_length = length;
+        table->last_parent = parent;
+        table->last_node = node;
+    }
+    return node;
+}
@@ -0,0 +1,51 @@
+#ifndef DEVTOOLS_DIR_TABLE_H
+#define DEVTOOLS_DIR_TABLE_H
+
+#include "../../config.h"
+#include "../../common/arena.h"
+
+// Interned directory paths.
+//
+// Every directory is stored once as (parent, last component), so a path
+// costs one short name however deep it is, shared prefixes are stored
+// once, and ancestors are reached by following parent links. A parent is
+// always interned before its children, so its index is smaller: walking
+// the nodes backwards visits every child before its parent.
+
+#define DIR_TABLE_ROOT 0        // "." : where relative paths start
+
+typedef struct {
+    int32_t parent;             // -1 for the root
+    uint32_t depth;
+    const char *name;           // one component, NUL-terminated
+    uint32_t name_length;
+} DirNode;
+
+typedef struct {
+    DirNode *nodes;
+    size_t count;
+    size_t capacity;
+
+    int32_t *slots;             // hash of (parent, name) -> node, -1 if empty
+    size_t slot_count;
+    Arena names;
+
+    // The directory interned last: files arrive grouped by directory
+    int32_t last_parent;
+    int32_t last_node;
+    size_t last_length;
+    char last_path[MAX_PATH_LENGTH];
+} DirTable;
+
+bool dir_table_init(DirTable *table);
+void dir_table_free(DirTable *table);
+
+// Node for `name` under `parent`, added if new; -1 when out of memory
+int32_t dir_table_child(DirTable *table, int32_t parent, const char *name, size_t length);
+
+// Node for the directory path[0, length) below `parent`, added with its
+// ancestors if new. Empty and "." components are skipped; an absolute path
+// hangs off a "/" child of `parent`.
+int32_t dir_table_intern(DirTable *table, int32_t parent, const char *path, size_t length);
+
+#endif // DEVTOOLS_DIR_TABLE_H
@@ -0,0 +1,168 @@
+#include "code_metrics.h"
+#include "../../common/memory.h"
+#include "../../common/record_table.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#define CACHE_MAGIC "DTMCACHE"
+
+// Bump whenever the lexers count differently: rows from older rules
+// would otherwise be served as if they were current
+#define CACHE_VERSION 2
+
+// Rows are keyed by what was lexed (content hash, length, language), not
+// by which file held it, so renamed, copied and reverted files hit as well
+typedef struct {
+    RecordHead head;
+    uint64_t hash;
+    uint64_t length;
+    uint32_t language;
+    uint32_t reserved;
+
+    // SourceCounts, at fixed width
+    uint64_t lines;
+    uint64_t code_lines;
+    uint64_t comment_lines;
+    uint64_t blank_lines;
+    uint64_t functions;
+    uint64_t decisions;
+    uint64_t complexity;
+    uint64_t longest_line;
+} CacheRecord;
+
+typedef struct {
+    MetricsKey key;
+    SourceCounts counts;
+} PendingRow;
+
+struct MetricsCache {
+    RecordTable table;
+    size_t hits;
+    size_t misses;
+
+    // Rows lexed this run. The table is only read while workers run and
+    // these are written into it on close, so lookups need no lock.
+    PendingRow *pending;
+    size_t pending_count;
+    size_t pending_capacity;
+    pthread_mutex_t lock;
+};
+
+static uint64_t key_hash(const MetricsKey *key) {
+    return record_table_mix(key->hash ^ (key->length * 0x9E3779B97F4A7C15ull) ^
+                            (uint64_t)key->language);
+}
+
+static bool record_matches(const void *record, const void *key) {
+    const CacheRecord *r = (const CacheRecord*)record;
+    const MetricsKey *k = (const MetricsKey*)key;
+    return r->hash == k->hash && r->length == k->length && r->language == (uint32_t)k->language;
+}
+
+MetricsCache* metrics_cache_open(const char *path) {
+    MetricsCache *cache = MALLOC(sizeof(MetricsCache));
+    if (!cache) return NULL;
+    memset(cache, 0, sizeof(MetricsCache));
+
+    if (!record_table_open(&cache->table, path, "metrics cache", CACHE_MAGIC, CACHE_VERSION,
+                           sizeof(CacheRecord))) {
+        FREE(cache);
+        return NULL;
+    }
+
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+// Write the rows lexed this run into the table. Only a run that looked
+// files up counts as a generation.
+static void cache_flush(MetricsCache *cache) {
+    if (cache->hits + cache->misses > 0) record_table_end_run(&cache->table);
+
+    for (size_t i = 0; i < cache->pending_count; i++) {
+        const PendingRow *row = &cache->pending[i];
+        CacheRecord *record = record_table_insert(&cache->table, key_hash(&row->key),
+                                                  record_matches, &row->key);
+        if (!record) break;
+
+        const SourceCounts *counts = &row->counts;
+        record->hash = row->key.hash;
+        record->length = row->key.length;
+        record->language = (uint32_t)row->key.language;
+        record->head.generation = cache->table.generation;
+        record->lines = counts->lines;
+        record->code_lines = counts->code_lines;
+        record->comment_lines = counts->comment_lines;
+        record->blank_lines = counts->blank_lines;
+        record->functions = counts->functions;
+        record->decisions = counts->decisions;
+        record->complexity = counts->complexity;
+        record->longest_line = counts->longest_line;
+    }
+    cache->pending_count = 0;
+}
+
+void metrics_cache_close(MetricsCache *cache) {
+    if (!cache) return;
+
+    cache_flush(cache);
+    record_table_close(&cache->table);
+    pthread_mutex_destroy(&cache->lock);
+    FREE(cache->pending);
+    FREE(cache);
+}
+
+bool metrics_cache_lookup(MetricsCache *cache, const MetricsKey *key, SourceCounts *counts) {
+    CacheRecord *record = record_table_find(&cache->table, key_hash(key), record_matches, key);
+
+    if (!record->head.used) {
+        __atomic_add_fetch(&cache->misses, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    counts->lines = (size_t)record->lines;
+    counts->code_lines = (size_t)record->code_lines;
+    counts->comment_lines = (size_t)record->comment_lines;
+    counts->blank_lines = (size_t)record->blank_lines;
+    counts->functions = (size_t)record->functions;
+    counts->decisions = (size_t)record->decisions;
+    counts->complexity = (size_t)record->complexity;
+    counts->longest_line = (size_t)record->longest_line;
+
+    // Identical files share a row, so several workers may touch it at once
+    __atomic_store_n(&record->head.generation, cache->table.generation, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&cache->hits, 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+void metrics_cache_store(MetricsCache *cache, const MetricsKey *key, const SourceCounts *counts) {
+    pthread_mutex_lock(&cache->lock);
+
+    if (cache->pending_count == cache->pending_capacity) {
+        size_t capacity = cache->pending_capacity ? cache->pending_capacity * 2 : 256;
+        PendingRow *grown = REALLOC(cache->pending, capacity * sizeof(PendingRow));
+        if (!grown) {
+            pthread_mutex_unlock(&cache->lock);
+            return;
+        }
+        cache->pending = grown;
+        cache->pending_capacity = capacity;
+    }
+
+    cache->pending[cache->pending_count].key = *key;
+    cache->pending[cache->pending_count].counts = *counts;
+    cache->pending_count++;
+
+    pthread_mutex_unlock(&cache->lock);
+}
+
+int metrics_cache_compact(MetricsCache *cache, unsigned int max_age) {
+    cache_flush(cache);
+    return record_table_compact(&cache->table, max_age);
+}
+
+void metrics_cache_stats(const MetricsCache *cache, size_t *hits, size_t *misses) {
+    *hits = cache->hits;
+    *misses = cache->misses;
+}
@@ -0,0 +1,327 @@
+#include "code_metrics.h"
+#include "../../common/error.h"
+#include "../../common/memory.h"
+#include "../../common/work_queue.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define REPORT_PATH_BLOCK (256 * 1024)
+
+// A queued directory to list or file to measure; the path follows. The
+// first `base` bytes of the path are the argument directory it was found
+// under.
+typedef struct {
+    int root;
+    size_t base;
+    bool directory;
+    char path[];
+} WalkItem;
+
+// Shared state for one walk. Workers only read it; everything they
+// produce goes into their own report.
+typedef struct {
+    const MetricsOptions *options;
+    MetricsReport *shards;
+} MetricsWalk;
+
+static WalkItem* walk_item(int root, size_t base, const char *path, size_t length,
+                           bool directory) {
+    WalkItem *item = MALLOC(sizeof(WalkItem) + length + 1);
+    if (!item) return NULL;
+
+    item->root = root;
+    item->base = base;
+    item->directory = directory;
+    memcpy(item->path, path, length);
+    item->path[length] = '\0';
+    return item;
+}
+
+bool metrics_report_init(MetricsReport *report) {
+    memset(report, 0, sizeof(MetricsReport));
+    arena_init(&report->paths, REPORT_PATH_BLOCK);
+    report->status = SUCCESS;
+
+    // The root always has a slot: it holds the grand total
+    report->dir_capacity = 256;
+    report->dir_metrics = MALLOC(report->dir_capacity * sizeof(CodeMetrics));
+    if (report->dir_metrics) {
+        memset(report->dir_metrics, 0, report->dir_capacity * sizeof(CodeMetrics));
+    }
+    return dir_table_init(&report->dirs) && report->dir_metrics;
+}
+
+void metrics_report_free(MetricsReport *report) {
+    FREE(report->rows);
+    FREE(report->dir_metrics);
+    arena_free(&report->paths);
+    dir_table_free(&report->dirs);
+}
+
+// Slot for a directory node's totals, zeroed when first reached
+static CodeMetrics* dir_metrics(MetricsReport *report, int32_t node) {
+    if ((size_t)node >= report->dir_capacity) {
+        size_t capacity = report->dir_capacity;
+        while (capacity <= (size_t)node) capacity *= 2;
+
+        CodeMetrics *grown = REALLOC(report->dir_metrics, capacity * sizeof(CodeMetrics));
+        if (!grown) return NULL;
+        memset(grown + report->dir_capacity, 0,
+               (capacity - report->dir_capacity) * sizeof(CodeMetrics));
+        report->dir_metrics = grown;
+        report->dir_capacity = capacity;
+    }
+    return &report->dir_metrics[node];
+}
+
+static bool report_row(MetricsReport *report, const char *path, int root,
+                       CodeLanguage language, const CodeMetrics *metrics) {
+    if (report->row_count == report->row_capacity) {
+        size_t capacity = report->row_capacity ? report->row_capacity * 2 : 256;
+        FileRow *grown = REALLOC(report->rows, capacity * sizeof(FileRow));
+        if (!grown) return false;
+        report->rows = grown;
+        report->row_capacity = capacity;
+    }
+
+    size_t length = strlen(path);
+    char *copy = arena_alloc(&report->paths, length + 1);
+    if (!copy) return false;
+    memcpy(copy, path, length + 1);
+
+    FileRow *row = &report->rows[report->row_count++];
+    row->path = copy;
+    row->root = root;
+    row->language = language;
+    row->metrics = *metrics;
+    return true;
+}
+
+// Length of the directory part of `path`: 0 without a slash, 1 for "/x"
+static size_t dir_length(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash ? (size_t)(slash - path) + (slash == path) : 0;
+}
+
+// Add one measured file to the language and directory totals. Its
+// directory is interned below a node for the argument directory, named as
+// given, so tree depth counts from each argument, not from the cwd.
+static bool report_file(MetricsReport *report, const char *path, size_t base, int root,
+                        CodeLanguage language, const CodeMetrics *metrics, bool keep_row) {
+    code_metrics_merge(&report->languages[language], metrics);
+
+    int32_t node = DIR_TABLE_ROOT;
+    if (base > 0 && !(base == 1 && path[0] == '.')) {
+        node = dir_table_child(&report->dirs, DIR_TABLE_ROOT, path, base);
+    }
+
+    const char *rest = path + base;
+    while (*rest == '/') rest++;
+    if (node >= 0) node = dir_table_intern(&report->dirs, node, rest, dir_length(rest));
+    CodeMetrics *dir = node >= 0 ? dir_metrics(report, node) : NULL;
+    if (!dir) return false;
+    code_metrics_merge(dir, metrics);
+
+    return !keep_row || report_row(report, path, root, language, metrics);
+}
+
+// Fold a worker's report into `dest`. Source nodes are re-interned in
+// index order, so every parent is mapped before its children.
+static bool report_merge(MetricsReport *dest, const MetricsReport *src) {
+    for (int i = 0; i < CODE_LANGUAGE_COUNT; i++) {
+        code_metrics_merge(&dest->languages[i], &src->languages[i]);
+    }
+    if (src->status != SUCCESS) dest->status = src->status;
+
+    int32_t *map = MALLOC(src->dirs.count * sizeof(int32_t));
+    if (!map) return false;
+
+    bool ok = true;
+    map[DIR_TABLE_ROOT] = DIR_TABLE_ROOT;
+    for (size_t i = 0; ok && i < src->dirs.count; i++) {
+        const DirNode *node = &src->dirs.nodes[i];
+        if (i != DIR_TABLE_ROOT) {
+            map[i] = dir_table_child(&dest->dirs, map[node->parent], node->name,
+                                     node->name_length);
+        }
+
+        CodeMetrics *dir = map[i] >= 0 ? dir_metrics(dest, map[i]) : NULL;
+        if (!dir) {
+            ok = false;
+        } else if (i < src->dir_capacity) {
+            code_metrics_merge(dir, &src->dir_metrics[i]);
+        }
+    }
+    FREE(map);
+
+    for (size_t i = 0; ok && i < src->row_count; i++) {
+        const FileRow *row = &src->rows[i];
+        ok = report_row(dest, row->path, row->root, row->language, &row->metrics);
+    }
+    return ok;
+}
+
+void metrics_report_rollup(MetricsReport *report) {
+    for (size_t i = report->dirs.count; i-- > 1;) {
+        int32_t parent = report->dirs.nodes[i].parent;
+        code_metrics_merge(&report->dir_metrics[parent], &report->dir_metrics[i]);
+    }
+}
+
+static int compare_rows(const void *a, const void *b) {
+    const FileRow *x = (const FileRow*)a;
+    const FileRow *y = (const FileRow*)b;
+    if (x->root != y->root) return x->root < y->root ? -1 : 1;
+    return strcmp(x->path, y->path);
+}
+
+static void measure_file(MetricsWalk *walk, int worker, const WalkItem *item) {
+    const MetricsOptions *options = walk->options;
+    MetricsReport *shard = &walk->shards[worker];
+    CodeLanguage language = options->forced ? options->language : code_language_for(item->path);
+
+    CodeMetrics metrics;
+    memset(&metrics, 0, sizeof(metrics));
+
+    int status = code_metrics_file(&metrics, item->path, language, options->cache);
+    if (status != SUCCESS) {
+        shard->status = status;
+        return;
+    }
+
+    if (!report_file(shard, item->path, item->base, item->root, language, &metrics,
+                     options->rows)) {
+        shard->status = ERROR_MEMORY_ALLOCATION;
+    }
+}
+
+// Queue the entries of one directory on this worker's deque: hidden
+// entries never, files only in a language the lexers know (or any file
+// with a forced language)
+static void list_directory(WorkPool *pool, MetricsWalk *walk, int worker, const WalkItem *item) {
+    MetricsReport *shard = &walk->shards[worker];
+    DIR *dir = opendir(item->path);
+    if (!dir) {
+        fprintf(stderr, "code-metrics: %s: %s\n", item->path, strerror(errno));
+        shard->status = ERROR_FILE_NOT_FOUND;
+        return;
+    }
+
+    char path[MAX_PATH_LENGTH];
+    struct dirent *entry;
+
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+
+        int len = snprintf(path, sizeof(path), "%s/%s", item->path, entry->d_name);
+        if (len < 0 || (size_t)len >= sizeof(path)) {
+            continue;
+        }
+
+        // d_type saves a stat() per entry on most file systems; symlinks
+        // are not followed, so cycles cannot occur
+        bool directory = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN) {
+            struct stat st;
+            if (lstat(path, &st) != 0) continue;
+            if (!S_ISDIR(st.st_mode) && !S_ISREG(st.st_mode)) continue;
+            directory = S_ISDIR(st.st_mode);
+        } else if (!directory && entry->d_type != DT_REG) {
+            continue;
+        }
+
+        if (!directory && !walk->options->forced &&
+            code_language_for(entry->d_name) == CODE_LANGUAGE_NONE) {
+            continue;
+        }
+
+        WalkItem *child = walk_item(item->root, item->base, path, (size_t)len, directory);
+        if (!child || !work_pool_push(pool, worker, child)) {
+            FREE(child);
+            shard->status = ERROR_MEMORY_ALLOCATION;
+        }
+    }
+
+    closedir(dir);
+}
+
+// Work item handler
+static void process_item(WorkPool *pool, int worker, void *item, void *ctx) {
+    MetricsWalk *walk = (MetricsWalk*)ctx;
+    WalkItem *entry = (WalkItem*)item;
+
+    if (entry->directory) {
+        list_directory(pool, walk, worker, entry);
+    } else {
+        measure_file(walk, worker, entry);
+    }
+
+    FREE(entry);
+}
+
+int code_metrics_collect(char **paths, int count, const MetricsOptions *options,
+                         MetricsReport *report) {
+    int jobs = options->jobs > 0 ? options->jobs : work_pool_default_workers();
+
+    MetricsReport *shards = MALLOC((size_t)jobs * sizeof(MetricsReport));
+    if (!shards) return ERROR_MEMORY_ALLOCATION;
+
+    int status = SUCCESS;
+    int ready = 0;
+    while (ready < jobs && status == SUCCESS) {
+        if (!metrics_report_init(&shards[ready])) status = ERROR_MEMORY_ALLOCATION;
+        ready++;
+    }
+
+    MetricsWalk walk = { .options = options, .shards = shards };
+    WorkPool *pool = status == SUCCESS ? work_pool_create(jobs, process_item, &walk) : NULL;
+    if (status == SUCCESS && !pool) status = ERROR_MEMORY_ALLOCATION;
+
+    // Named files are measured whatever their name; directories are walked
+    for (int i = 0; pool && i < count; i++) {
+        struct stat st;
+        bool directory = false;
+        if (strcmp(paths[i], "-") != 0) {
+            if (stat(paths[i], &st) != 0) {
+                fprintf(stderr, "code-metrics: %s: %s\n", paths[i], strerror(errno));
+                status = ERROR_FILE_NOT_FOUND;
+                continue;
+            }
+            directory = S_ISDIR(st.st_mode);
+        }
+
+        size_t length = strlen(paths[i]);
+        while (length > 1 && paths[i][length - 1] == '/') length--;
+
+        // A directory argument is its own base; a file's is its directory
+        size_t base = directory ? length : dir_length(paths[i]);
+        WalkItem *item = walk_item(i, base, paths[i], length, directory);
+        if (!item || !work_pool_submit(pool, item)) {
+            FREE(item);
+            status = ERROR_MEMORY_ALLOCATION;
+        }
+    }
+
+    if (pool) {
+        work_pool_run(pool);
+        work_pool_destroy(pool);
+    }
+
+    for (int i = 0; i < ready; i++) {
+        if (pool && status != ERROR_MEMORY_ALLOCATION && !report_merge(report, &shards[i])) {
+            status = ERROR_MEMORY_ALLOCATION;
+        }
+        metrics_report_free(&shards[i]);
+    }
+    FREE(shards);
+
+    if (report->row_count > 1) {
+        qsort(report->rows, report->row_count, sizeof(FileRow), compare_rows);
+    }
+    if (status == SUCCESS) status = report->status;
+    return status;
+}
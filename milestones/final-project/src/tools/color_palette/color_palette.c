@@ -0,0 +1,634 @@
+#include "color_palette.h"
+#include "../../common/error.h"
+#include "../../common/logging.h"
+#include "../../common/memory.h"
+
+#include <ctype.h>
+#include <getopt.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_ROUNDS 3
+#define BENCH_SAMPLE 65536
+#define BENCH_ALL_COLORS (1u << 24)
+#define BENCH_CHECK_CHUNK (1u << 20)
+
+#define DEFAULT_COUNT 5
+#define DEFAULT_CANDIDATES 10000000
+#define DEFAULT_CONTRAST 4.5f
+#define SEARCH_HUES 36
+#define SEARCH_SATURATIONS 4
+#define SEARCH_LIGHTNESSES 8
+#define DEFAULT_ITERATIONS 30
+
+static double elapsed_seconds(const struct timespec *start, const struct timespec *end) {
+    return (double)(end->tv_sec - start->tv_sec) +
+           (double)(end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+bool color_parse_hex(const char *text, unsigned char rgb[3]) {
+    if (*text == '#') text++;
+
+    size_t length = strlen(text);
+    if (length != 3 && length != 6) return false;
+
+    unsigned int value[6];
+    for (size_t i = 0; i < length; i++) {
+        int c = tolower((unsigned char)text[i]);
+        if (!isxdigit(c)) return false;
+        value[i] = (unsigned int)(isdigit(c) ? c - '0' : c - 'a' + 10);
+    }
+
+    for (int i = 0; i < 3; i++) {
+        rgb[i] = length == 3 ? (unsigned char)(value[i] * 17)
+                             : (unsigned char)(value[2 * i] * 16 + value[2 * i + 1]);
+    }
+    return true;
+}
+
+void color_fill(Color *color, const char *name, const unsigned char rgb[3]) {
+    float c0[8], c1[8], c2[8];
+    ColorBatch batch = { { c0, c1, c2 }, 0, 8 };
+    color_batch_from_rgb8(&batch, rgb, 1);
+    color_rgb_to_hsl(&batch, &batch);
+
+    snprintf(color->name, sizeof(color->name), "%s", name);
+    snprintf(color->hex, sizeof(color->hex), "#%02x%02x%02x", rgb[0], rgb[1], rgb[2]);
+    for (int i = 0; i < 3; i++) {
+        color->rgb[i] = rgb[i];
+        color->hsl[i] = batch.c[i][0];
+    }
+}
+
+// Lightness offsets for the n-th repeat of a hue: 0, +0.12, -0.12, +0.24, ...
+static float repeat_lightness(float lightness, int repeat) {
+    float delta = 0.12f * (float)((repeat + 1) / 2) * (repeat % 2 ? 1.0f : -1.0f);
+    float l = lightness + delta;
+    return l < 0.05f ? 0.05f : (l > 0.95f ? 0.95f : l);
+}
+
+int palette_from_scheme(ColorPalette *palette, const unsigned char base[3],
+                        const char *scheme, int count) {
+    if (count < 1 || count > PALETTE_MAX_SIZE) return ERROR_INVALID_ARGUMENT;
+
+    float c0[PALETTE_MAX_SIZE], c1[PALETTE_MAX_SIZE], c2[PALETTE_MAX_SIZE];
+    ColorBatch batch = { { c0, c1, c2 }, 0, PALETTE_MAX_SIZE };
+    color_batch_from_rgb8(&batch, base, 1);
+    color_rgb_to_hsl(&batch, &batch);
+    float h = c0[0], s = c1[0], l = c2[0];
+
+    for (int i = 0; i < count; i++) {
+        c0[i] = h;
+        c1[i] = s;
+        c2[i] = l;
+
+        if (strcmp(scheme, "monochromatic") == 0) {
+            if (count > 1) c2[i] = 0.15f + 0.7f * (float)i / (float)(count - 1);
+        } else if (strcmp(scheme, "analogous") == 0) {
+            c0[i] = h + 30.0f * ((float)i - (float)(count - 1) * 0.5f);
+        } else if (strcmp(scheme, "complementary") == 0) {
+            c0[i] = h + 180.0f * (float)(i % 2);
+            c2[i] = repeat_lightness(l, i / 2);
+        } else if (strcmp(scheme, "triadic") == 0) {
+            c0[i] = h + 120.0f * (float)(i % 3);
+            c2[i] = repeat_lightness(l, i / 3);
+        } else {
+            return ERROR_INVALID_ARGUMENT;
+        }
+        c0[i] = fmodf(c0[i] + 360.0f, 360.0f);
+    }
+    batch.count = (size_t)count;
+    color_hsl_to_rgb(&batch, &batch);
+
+    unsigned char rgb[PALETTE_MAX_SIZE][3];
+    color_batch_to_rgb8(&batch, rgb[0]);
+
+    memset(palette, 0, sizeof(ColorPalette));
+    snprintf(palette->name, sizeof(palette->name), "#%02x%02x%02x", base[0], base[1], base[2]);
+    snprintf(palette->scheme, sizeof(palette->scheme), "%s", scheme);
+    for (int i = 0; i < count; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "%s-%d", scheme, i + 1);
+        color_fill(&palette->colors[i], name, rgb[i]);
+    }
+    palette->color_count = count;
+    return SUCCESS;
+}
+
+// One line per color; a truecolor swatch in front when color output is on
+void palette_print(const ColorPalette *palette) {
+    printf("%s (%s, %d colors)\n", palette->name, palette->scheme, palette->color_count);
+
+    for (int i = 0; i < palette->color_count; i++) {
+        const Color *color = &palette->colors[i];
+        if (g_config.color_output) {
+            printf("\033[48;2;%d;%d;%dm      " COLOR_RESET " ",
+                   color->rgb[0], color->rgb[1], color->rgb[2]);
+        }
+        printf("%-16s %s  rgb(%3d, %3d, %3d)  hsl(%3.0f, %3.0f%%, %3.0f%%)\n",
+               color->name, color->hex, color->rgb[0], color->rgb[1], color->rgb[2],
+               color->hsl[0], color->hsl[1] * 100.0f, color->hsl[2] * 100.0f);
+    }
+}
+
+// HSL, HSV and Lab of each color named on the command line
+static int convert_colors(char **colors, int count) {
+    unsigned char rgb[3];
+    float c0[8], c1[8], c2[8];
+    ColorBatch batch = { { c0, c1, c2 }, 0, 8 };
+    float space[3][3];
+
+    for (int i = 0; i < count; i++) {
+        if (!color_parse_hex(colors[i], rgb)) {
+            LOG_ERROR("Invalid color: %s (use #rrggbb or #rgb)", colors[i]);
+            return ERROR_INVALID_ARGUMENT;
+        }
+
+        void (*to[3])(const ColorBatch*, ColorBatch*) = {
+            color_rgb_to_hsl, color_rgb_to_hsv, color_rgb_to_lab
+        };
+        for (int s = 0; s < 3; s++) {
+            color_batch_from_rgb8(&batch, rgb, 1);
+            to[s](&batch, &batch);
+            for (int ch = 0; ch < 3; ch++) space[s][ch] = batch.c[ch][0];
+        }
+        color_batch_from_rgb8(&batch, rgb, 1);
+        float luminance;
+        color_rgb_luminance(&batch, &luminance);
+
+        printf("#%02x%02x%02x  rgb(%d, %d, %d)  hsl(%.1f, %.1f%%, %.1f%%)  "
+               "hsv(%.1f, %.1f%%, %.1f%%)  lab(%.2f, %.2f, %.2f)  luminance %.4f\n",
+               rgb[0], rgb[1], rgb[2], rgb[0], rgb[1], rgb[2],
+               space[0][0], space[0][1] * 100.0f, space[0][2] * 100.0f,
+               space[1][0], space[1][1] * 100.0f, space[1][2] * 100.0f,
+               space[2][0], space[2][1], space[2][2], luminance);
+    }
+    return SUCCESS;
+}
+
+static int search_palette(const PaletteSearch *search) {
+    PaletteResult result;
+    int status = palette_search(search, &result);
+    if (status != SUCCESS) return status;
+
+    ColorPalette palette;
+    memset(&palette, 0, sizeof(palette));
+    snprintf(palette.name, sizeof(palette.name), "on #%02x%02x%02x, contrast %.1f:1",
+             search->background[0], search->background[1], search->background[2],
+             search->min_contrast);
+    snprintf(palette.scheme, sizeof(palette.scheme), "search");
+    for (int i = 0; i < search->size; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "color-%d", i + 1);
+        color_fill(&palette.colors[i], name, result.rgb[i]);
+    }
+    palette.color_count = search->size;
+    palette_print(&palette);
+    fflush(stdout);
+
+    if (!g_config.quiet) {
+        double seconds = result.seconds > 0 ? result.seconds : 1e-9;
+        fprintf(stderr, "%llu palettes in %.3f s (%.1f M/s, %s), min distance %.1f, "
+                "min contrast %.2f:1\n", (unsigned long long)result.scored, seconds,
+                (double)result.scored / seconds / 1e6, color_kernel_name(color_kernel()),
+                result.min_distance, result.min_contrast);
+    }
+    if (result.score < 0) {
+        LOG_WARN("No palette reaches contrast %.2f:1; showing the closest", search->min_contrast);
+    }
+    return SUCCESS;
+}
+
+static int extract_palette(const char *path, const ImagePaletteOptions *options) {
+    ColorPalette palette;
+    ImagePaletteStats stats;
+    int status = image_palette(path, options, &palette, &stats);
+    if (status != SUCCESS) return status;
+
+    palette_print(&palette);
+    fflush(stdout);
+
+    if (!g_config.quiet) {
+        fprintf(stderr, "%dx%d (%.1f MP), %zu histogram bins, %d k-means iterations; "
+                "read %.3f s, histogram %.3f s, k-means %.3f s\n", stats.width, stats.height,
+                (double)stats.width * stats.height / 1e6, stats.bins, stats.iterations,
+                stats.read_seconds, stats.histogram_seconds, stats.cluster_seconds);
+    }
+    return SUCCESS;
+}
+
+// ---------------------------------------------------------------------
+// Benchmark
+// ---------------------------------------------------------------------
+
+typedef void (*ConvertFn)(const ColorBatch *src, ColorBatch *dst);
+
+static const struct {
+    const char *name;
+    ConvertFn to;
+    ConvertFn from;
+} bench_spaces[] = {
+    { "hsl", color_rgb_to_hsl, color_hsl_to_rgb },
+    { "hsv", color_rgb_to_hsv, color_hsv_to_rgb },
+    { "lab", color_rgb_to_lab, color_lab_to_rgb }
+};
+
+#define BENCH_SPACES (int)(sizeof(bench_spaces) / sizeof(bench_spaces[0]))
+
+static double time_conversion(ConvertFn convert, const ColorBatch *src, ColorBatch *dst) {
+    struct timespec start, end;
+    double best = 0;
+
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        convert(src, dst);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double t = elapsed_seconds(&start, &end);
+        if (round == 0 || t < best) best = t;
+    }
+    return best;
+}
+
+// Largest difference between the first BENCH_SAMPLE results and the
+// scalar kernel's
+static float scalar_difference(ConvertFn convert, const ColorBatch *src, const ColorBatch *out,
+                               ColorBatch *reference) {
+    ColorKernel kernel = color_kernel();
+    ColorBatch sample = *src;
+    sample.count = src->count < BENCH_SAMPLE ? src->count : BENCH_SAMPLE;
+
+    color_set_kernel(COLOR_KERNEL_SCALAR);
+    convert(&sample, reference);
+    color_set_kernel(kernel);
+
+    float worst = 0;
+    for (int ch = 0; ch < 3; ch++) {
+        for (size_t i = 0; i < sample.count; i++) {
+            float d = fabsf(reference->c[ch][i] - out->c[ch][i]);
+            if (d > worst) worst = d;
+        }
+    }
+    return worst;
+}
+
+// Whether every 8-bit color comes back unchanged from `to` then `from`
+// with the active kernel; checked a chunk at a time whatever the timed
+// data size
+static bool round_trips(ConvertFn to, ConvertFn from, ColorBatch *batch, unsigned char *input,
+                        unsigned char *output) {
+    for (uint32_t first = 0; first < BENCH_ALL_COLORS; first += BENCH_CHECK_CHUNK) {
+        for (uint32_t i = 0; i < BENCH_CHECK_CHUNK; i++) {
+            uint32_t value = first + i;
+            input[3 * i] = (unsigned char)(value >> 16);
+            input[3 * i + 1] = (unsigned char)(value >> 8);
+            input[3 * i + 2] = (unsigned char)value;
+        }
+
+        color_batch_from_rgb8(batch, input, BENCH_CHECK_CHUNK);
+        to(batch, batch);
+        from(batch, batch);
+        color_batch_to_rgb8(batch, output);
+        if (memcmp(input, output, (size_t)BENCH_CHECK_CHUNK * 3) != 0) return false;
+    }
+    return true;
+}
+
+// Times each conversion both ways with every kernel the CPU supports.
+// Every 8-bit color must survive each round trip, and each kernel must
+// agree with the scalar one; palette scoring is timed last.
+static int run_benchmark(size_t millions) {
+    size_t count = millions * 1000000;
+    ColorBatch rgb, space, back, reference, check;
+    unsigned char *input = MALLOC(count * 3);
+    unsigned char *check_input = MALLOC((size_t)BENCH_CHECK_CHUNK * 3);
+    unsigned char *check_output = MALLOC((size_t)BENCH_CHECK_CHUNK * 3);
+    bool ready = color_batch_init(&rgb, count);
+    ready = color_batch_init(&space, count) && ready;
+    ready = color_batch_init(&back, count) && ready;
+    ready = color_batch_init(&reference, BENCH_SAMPLE) && ready;
+    ready = color_batch_init(&check, BENCH_CHECK_CHUNK) && ready;
+    int status = SUCCESS;
+
+    if (!input || !check_input || !check_output || !ready) {
+        status = ERROR_MEMORY_ALLOCATION;
+        goto done;
+    }
+
+    // An odd multiplier permutes the 2^24 colors, so up to 16.7 M are distinct
+    for (size_t i = 0; i < count; i++) {
+        uint32_t value = (uint32_t)(i * 2654435761u) & 0xFFFFFF;
+        input[3 * i] = (unsigned char)(value >> 16);
+        input[3 * i + 1] = (unsigned char)(value >> 8);
+        input[3 * i + 2] = (unsigned char)value;
+    }
+    color_batch_from_rgb8(&rgb, input, count);
+
+    printf("Color conversion benchmark\n");
+    printf("==========================\n");
+    printf("Data: %.1f M colors, best of %d rounds (M colors/s); palettes scored/s\n",
+           (double)count / 1e6, BENCH_ROUNDS);
+    printf("Round trips checked over all %.1f M 8-bit colors\n\n", BENCH_ALL_COLORS / 1e6);
+    printf("  %-8s", "kernel");
+    for (int s = 0; s < BENCH_SPACES; s++) {
+        printf("  rgb>%s  %s>rgb", bench_spaces[s].name, bench_spaces[s].name);
+    }
+    printf("  %10s\n", "palettes");
+
+    ColorKernel best = color_kernel();
+    PaletteSearch search = {
+        .size = DEFAULT_COUNT, .min_contrast = DEFAULT_CONTRAST, .background = { 255, 255, 255 },
+        .candidates = count, .seed = 1, .hue_steps = SEARCH_HUES,
+        .saturation_steps = SEARCH_SATURATIONS, .lightness_steps = SEARCH_LIGHTNESSES
+    };
+    PaletteResult first;
+
+    for (int k = 0; k < COLOR_KERNEL_COUNT; k++) {
+        if (!color_set_kernel((ColorKernel)k)) {
+            printf("  %-8s  not supported\n", color_kernel_name((ColorKernel)k));
+            continue;
+        }
+
+        bool ok = true;
+        printf("  %-8s", color_kernel_name((ColorKernel)k));
+        for (int s = 0; s < BENCH_SPACES; s++) {
+            double to_time = time_conversion(bench_spaces[s].to, &rgb, &space);
+            ok = scalar_difference(bench_spaces[s].to, &rgb, &space, &reference) < 1e-3f && ok;
+
+            double from_time = time_conversion(bench_spaces[s].from, &space, &back);
+            ok = scalar_difference(bench_spaces[s].from, &space, &back, &reference) < 1e-5f && ok;
+
+            ok = round_trips(bench_spaces[s].to, bench_spaces[s].from, &check, check_input,
+                             check_output) && ok;
+
+            printf(" %8.1f %8.1f", (double)count / to_time / 1e6,
+                   (double)count / from_time / 1e6);
+            fflush(stdout);
+        }
+
+        PaletteResult result;
+        int searched = palette_search(&search, &result);
+        if (searched != SUCCESS) {
+            status = searched;
+            break;
+        }
+
+        // The same candidates are drawn whatever the kernel
+        if (k == COLOR_KERNEL_SCALAR) {
+            first = result;
+        } else {
+            ok = memcmp(first.rgb, result.rgb, sizeof(result.rgb)) == 0 && ok;
+        }
+
+        printf("  %8.1f M%s\n", (double)result.scored / result.seconds / 1e6,
+               ok ? "" : "  MISMATCH");
+        if (!ok) status = ERROR_UNKNOWN;
+    }
+
+    color_set_kernel(best);
+
+done:
+    FREE(input);
+    FREE(check_input);
+    FREE(check_output);
+    color_batch_free(&rgb);
+    color_batch_free(&space);
+    color_batch_free(&back);
+    color_batch_free(&reference);
+    color_batch_free(&check);
+    return status;
+}
+
+int color_palette_execute(int argc, char *argv[]) {
+    static struct option long_options[] = {
+        {"scheme", required_argument, 0, 's'},
+        {"count", required_argument, 0, 'n'},
+        {"convert", no_argument, 0, 'c'},
+        {"image", required_argument, 0, 'i'},
+        {"jobs", required_argument, 0, 'j'},
+        {"iterations", required_argument, 0, 1008},
+        {"search", no_argument, 0, 1000},
+        {"background", required_argument, 0, 1001},
+        {"contrast", required_argument, 0, 1002},
+        {"candidates", required_argument, 0, 1003},
+        {"seed", required_argument, 0, 1004},
+        {"kernel", required_argument, 0, 1005},
+        {"bench", required_argument, 0, 1006},
+        {"no-color", no_argument, 0, 1007},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    // Reset getopt state left over from global option parsing
+    optind = 0;
+
+    const char *scheme = "analogous";
+    int count = DEFAULT_COUNT;
+    bool convert = false;
+    bool search_mode = false;
+    const char *image = NULL;
+    int bench_millions = 0;
+    g_config.color_output = isatty(STDOUT_FILENO);
+
+    PaletteSearch search = {
+        .min_contrast = DEFAULT_CONTRAST, .background = { 255, 255, 255 },
+        .candidates = DEFAULT_CANDIDATES, .seed = 1, .hue_steps = SEARCH_HUES,
+        .saturation_steps = SEARCH_SATURATIONS, .lightness_steps = SEARCH_LIGHTNESSES
+    };
+    ImagePaletteOptions extract = { .max_iterations = DEFAULT_ITERATIONS, .seed = 1 };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "s:n:ci:j:h", long_options, NULL)) != -1) {
+        switch (c) {
+            case 's':
+                scheme = optarg;
+                break;
+
+            case 'n':
+                count = atoi(optarg);
+                if (count < 1 || count > PALETTE_MAX_SIZE) {
+                    LOG_ERROR("Invalid color count: %s (1 to %d)", optarg, PALETTE_MAX_SIZE);
+                    return ERROR_INVALID_ARGUMENT;
+                }
+                break;
+
+            case 'c':
+                convert = true;
+                break;
+
+            case 'i':
+                image = optarg;
+                break;
+
+            case 'j':
+                extract.jobs = atoi(optarg);
+                if (extract.jobs <= 0) {
+                    LOG_ERROR("Invalid job count: %s", optarg);
+                    return ERROR_INVALID_ARGUMENT;
+                }
+                break;
+
+            case 1008: // --iterations
+                extract.max_iterations = atoi(optarg);
+                if (extract.max_iterations <= 0) {
+                    LOG_ERROR("Invalid iteration count: %s", optarg);
+                    return ERROR_INVALID_ARGUMENT;
+                }
+                break;
+
+            case 1000: // --search
+                search_mode = true;
+                break;
+
+            case 1001: // --background
+                if (!color_parse_hex(optarg, search.background)) {
+                    LOG_ERROR("Invalid color: %s (use #rrggbb or #rgb)", optarg);
+                    return ERROR_INVALID_ARGUMENT;
+                }
+                break;
+
+            case 1002: // --contrast
+                search.min_contrast = strtof(optarg, NULL);
+                if (search.min_contrast < 1.0f || search.min_contrast > 21.0f) {
+                    LOG_ERROR("Invalid contrast ratio: %s (1 to 21)", optarg);
+                    return ERROR_INVALID_ARGUMENT;
+                }
+                break;
+
+            case 1003: // --candidates
+                search.candidates = strtoull(optarg, NULL, 10);
+                if (search.candidates == 0) {
+                    LOG_ERROR("Invalid candidate count: %s", optarg);
+                    return ERROR_INVALID_ARGUMENT;
+                }
+                break;
+
+            case 1004: // --seed
+                search.seed = extract.seed = strtoull(optarg, NULL, 10);
+                break;
+
+            case 1005: { // --kernel
+                int kernel = 0;
+                while (kernel < COLOR_KERNEL_COUNT &&
+                       strcmp(optarg, color_kernel_name((ColorKernel)kernel)) != 0) {
+                    kernel++;
+                }
+                if (kernel == COLOR_KERNEL_COUNT) {
+                    LOG_ERROR("Unknown kernel: %s (use scalar or avx2)", optarg);
+                    return ERROR_INVALID_ARGUMENT;
+                }
+                if (!color_set_kernel((ColorKernel)kernel)) {
+                    LOG_ERROR("Kernel %s is not supported by this CPU", optarg);
+                    return ERROR_INVALID_ARGUMENT;
+                }
+                break;
+            }
+
+            case 1006: // --bench
+                bench_millions = atoi(optarg);
+                if (bench_millions <= 0) {
+                    LOG_ERROR("Invalid benchmark size: %s", optarg);
+                    return ERROR_INVALID_ARGUMENT;
+                }
+                break;
+
+            case 1007: // --no-color
+                g_config.color_output = false;
+                break;
+
+            case 'h':
+                color_palette_help();
+                return SUCCESS;
+
+            default:
+                return ERROR_INVALID_ARGUMENT;
+        }
+    }
+
+    if (bench_millions > 0) {
+        return run_benchmark((size_t)bench_millions);
+    }
+
+    if (image) {
+        extract.colors = count;
+        return extract_palette(image, &extract);
+    }
+
+    if (search_mode) {
+        if (count < 2) {
+            LOG_ERROR("A searched palette needs at least 2 colors");
+            return ERROR_INVALID_ARGUMENT;
+        }
+        search.size = count;
+        return search_palette(&search);
+    }
+
+    if (optind >= argc) {
+        LOG_ERROR("Usage: devtools color-palette [options] <color>");
+        return ERROR_INVALID_ARGUMENT;
+    }
+
+    if (convert) {
+        return convert_colors(argv + optind, argc - optind);
+    }
+
+    unsigned char base[3];
+    if (!color_parse_hex(argv[optind], base)) {
+        LOG_ERROR("Invalid color: %s (use #rrggbb or #rgb)", argv[optind]);
+        return ERROR_INVALID_ARGUMENT;
+    }
+
+    ColorPalette palette;
+    if (palette_from_scheme(&palette, base, scheme, count) != SUCCESS) {
+        LOG_ERROR("Unknown scheme: %s (use monochromatic, analogous, complementary "
+                  "or triadic)", scheme);
+        return ERROR_INVALID_ARGUMENT;
+    }
+    palette_print(&palette);
+    return SUCCESS;
+}
+
+void color_palette_help(void) {
+    printf("Color Palette Tool\n");
+    printf("==================\n");
+    printf("Generates color palettes from a base color, extracts the dominant colors\n");
+    printf("of an image, or searches for the most distinct palette whose colors all\n");
+    printf("keep a contrast ratio against a background. Colors are converted in\n");
+    printf("batches with SIMD kernels (AVX2 when available); a search scores\n");
+    printf("millions of palettes per second.\n");
+    printf("\nOptions:\n");
+    printf("  -s, --scheme NAME     monochromatic, analogous (default), complementary\n");
+    printf("                        or triadic\n");
+    printf("  -n, --count N         Colors in the palette (default: %d, at most %d)\n",
+           DEFAULT_COUNT, PALETTE_MAX_SIZE);
+    printf("  -c, --convert         Print each color as HSL, HSV and CIE Lab\n");
+    printf("  -i, --image FILE      Extract the N dominant colors of a PNM image\n");
+    printf("                        (PPM or PGM, binary or ASCII; \"-\" for stdin)\n");
+    printf("      --no-color        Leave out the color swatches\n");
+    printf("      --kernel NAME     Force a kernel: scalar or avx2\n");
+    printf("      --bench N         Compare kernel throughput on N million colors\n");
+    printf("  -h, --help            Show this help message\n");
+    printf("\nPalette search:\n");
+    printf("      --search          Pick the palette of N colors with the largest\n");
+    printf("                        smallest pairwise distance (CIE76) among random\n");
+    printf("                        palettes from an HSL grid of %d colors\n",
+           SEARCH_HUES * SEARCH_SATURATIONS * SEARCH_LIGHTNESSES);
+    printf("      --background HEX  Background color (default: #ffffff)\n");
+    printf("      --contrast RATIO  WCAG contrast every color needs (default: %.1f)\n",
+           DEFAULT_CONTRAST);
+    printf("      --candidates N    Palettes to score (default: %d)\n", DEFAULT_CANDIDATES);
+    printf("      --seed N          Random seed, also for k-means++ (default: 1)\n");
+    printf("\nImage palettes:\n");
+    printf("  Pixels are counted into a histogram of 5 bits per channel on N threads;\n");
+    printf("  k-means++ clusters its occupied bins in CIE Lab, weighted by pixel count.\n");
+    printf("  -j, --jobs N          Threads (default: one per CPU)\n");
+    printf("      --iterations N    Most k-means iterations (default: %d)\n", DEFAULT_ITERATIONS);
+    printf("\nUsage:\n");
+    printf("  devtools color-palette '#3366cc'\n");
+    printf("  devtools color-palette -s triadic -n 6 '#e07a5f'\n");
+    printf("  devtools color-palette --convert '#336699' '#fff'\n");
+    printf("  devtools color-palette --search -n 6 --background '#1e1e1e'\n");
+    printf("  devtools color-palette -n 8 --image photo.ppm\n");
+}
@@ -0,0 +1,141 @@
+#ifndef DEVTOOLS_COLOR_PALETTE_H
+#define DEVTOOLS_COLOR_PALETTE_H
+
+#include "../../config.h"
+
+// Batched color conversion.
+//
+// Colors are converted many at a time from structure-of-arrays float
+// buffers, one array per channel, so the vector kernels load eight
+// colors' worth of a channel with one instruction. The sRGB transfer curve
+// comes from a precomputed table (interpolated, exact to ~1e-7) in one
+// direction and from cube roots in the other; the Lab cube root is a bit
+// estimate refined by Halley steps. Nothing calls powf or cbrtf per color.
+//
+// Channel conventions:
+//   RGB  r g b in [0, 1], sRGB encoded
+//   HSL  h in [0, 360), s l in [0, 1]
+//   HSV  h in [0, 360), s v in [0, 1]
+//   Lab  CIE L*a*b* under D65, L in [0, 100]
+// Conversions back to RGB clamp to [0, 1].
+
+#define COLOR_BATCH_ALIGN 32
+
+typedef struct {
+    float *c[3];                // channels; which space is up to the caller
+    size_t count;
+    size_t capacity;            // a multiple of 8
+} ColorBatch;
+
+typedef enum {
+    COLOR_KERNEL_SCALAR,
+    COLOR_KERNEL_AVX2,
+    COLOR_KERNEL_COUNT
+} ColorKernel;
+
+// Kernel selection (runtime CPU dispatch; the best one is used by default)
+ColorKernel color_best_kernel(void);
+ColorKernel color_kernel(void);
+bool color_set_kernel(ColorKernel kernel);
+bool color_kernel_supported(ColorKernel kernel);
+const char* color_kernel_name(ColorKernel kernel);
+
+// Batches
+bool color_batch_init(ColorBatch *batch, size_t capacity);
+void color_batch_free(ColorBatch *batch);
+// Interleaved 8-bit r g b to and from an RGB batch; `count` colors
+void color_batch_from_rgb8(ColorBatch *batch, const unsigned char *rgb, size_t count);
+void color_batch_to_rgb8(const ColorBatch *batch, unsigned char *rgb);
+
+// Conversions over src->count colors into `dst` (which may be `src`)
+void color_rgb_to_hsl(const ColorBatch *src, ColorBatch *dst);
+void color_hsl_to_rgb(const ColorBatch *src, ColorBatch *dst);
+void color_rgb_to_hsv(const ColorBatch *src, ColorBatch *dst);
+void color_hsv_to_rgb(const ColorBatch *src, ColorBatch *dst);
+void color_rgb_to_lab(const ColorBatch *src, ColorBatch *dst);
+void color_lab_to_rgb(const ColorBatch *src, ColorBatch *dst);
+// WCAG relative luminance of each color into `y`
+void color_rgb_luminance(const ColorBatch *src, float *y);
+
+// Palette search.
+//
+// Brute force over palettes of `size` colors drawn from a pool of
+// candidate colors. Every pool color is converted once (Lab for distance,
+// luminance for contrast); a palette is then scored from those tables
+// alone, eight palettes per vector step. A palette whose every color meets
+// the contrast ratio against the background scores its smallest pairwise
+// CIE76 distance; one that does not scores how far it falls short, as a
+// negative number, so any accessible palette beats every other one.
+
+#define PALETTE_MAX_SIZE 16
+
+typedef struct {
+    int size;                   // colors per palette
+    float min_contrast;         // WCAG ratio against the background, e.g. 4.5
+    unsigned char background[3];
+    uint64_t candidates;        // palettes to score
+    uint64_t seed;
+    int hue_steps;              // pool: an HSL grid of this many hues,
+    int saturation_steps;       // saturations
+    int lightness_steps;        // and lightnesses
+} PaletteSearch;
+
+typedef struct {
+    float score;
+    float min_distance;         // smallest pairwise CIE76 distance
+    float min_contrast;         // worst contrast ratio against the background
+    unsigned char rgb[PALETTE_MAX_SIZE][3];
+    uint64_t scored;
+    double seconds;
+} PaletteResult;
+
+int palette_search(const PaletteSearch *search, PaletteResult *result);
+float color_contrast_ratio(float y1, float y2);
+
+// Image palettes.
+//
+// A PNM image (P2, P3, P5 or P6, any maxval) is reduced to a histogram
+// with 5 bits per channel: 32768 bins, each keeping its pixel count and
+// the mean color of its pixels. Every worker fills its own histogram from a
+// slice of the raster. k-means++ then clusters the occupied bins in Lab,
+// weighted by pixel count, so clustering costs the same for any image
+// size. Assignment steps split the bins across the worker pool.
+
+#define IMAGE_HISTOGRAM_BITS 5
+#define IMAGE_HISTOGRAM_BINS (1 << (3 * IMAGE_HISTOGRAM_BITS))
+
+typedef struct {
+    int colors;                 // clusters, at most PALETTE_MAX_SIZE
+    int max_iterations;
+    uint64_t seed;
+    int jobs;                   // threads; 0 for one per CPU
+} ImagePaletteOptions;
+
+typedef struct {
+    int width;
+    int height;
+    size_t bins;                // occupied histogram bins
+    int iterations;
+    double read_seconds;
+    double histogram_seconds;
+    double cluster_seconds;
+} ImagePaletteStats;
+
+// Fills `palette` with the image's dominant colors, most common first.
+// Fewer colors than asked for come back when the image has fewer distinct
+// bins.
+int image_palette(const char *path, const ImagePaletteOptions *options,
+                  ColorPalette *palette, ImagePaletteStats *stats);
+
+// Palettes
+void color_fill(Color *color, const char *name, const unsigned char rgb[3]);
+bool color_parse_hex(const char *text, unsigned char rgb[3]);
+int palette_from_scheme(ColorPalette *palette, const unsigned char base[3],
+                        const char *scheme, int count);
+void palette_print(const ColorPalette *palette);
+
+// Tool entry points
+int color_palette_execute(int argc, char *argv[]);
+void color_palette_help(void);
+
+#endif // DEVTOOLS_COLOR_PALETTE_H
@@ -0,0 +1,662 @@
+#include "color_palette.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define COLOR_X86 1
+#include <immintrin.h>
+#endif
+
+// sRGB decoding table: DECODE_STEPS intervals over [0, 1], each a base
+// value and a slope for linear interpolation
+#define DECODE_STEPS 4096
+
+// Linear sRGB -> XYZ (D65), rows pre-divided by the white point
+#define XR (0.4124564f / 0.95047f)
+#define XG (0.3575761f / 0.95047f)
+#define XB (0.1804375f / 0.95047f)
+#define YR 0.2126729f
+#define YG 0.7151522f
+#define YB 0.0721750f
+#define ZR (0.0193339f / 1.08883f)
+#define ZG (0.1191920f / 1.08883f)
+#define ZB (0.9503041f / 1.08883f)
+
+// XYZ (white point scaled) -> linear sRGB
+#define RX (3.2404542f * 0.95047f)
+#define RY (-1.5371385f)
+#define RZ (-0.4985314f * 1.08883f)
+#define GX (-0.9692660f * 0.95047f)
+#define GY 1.8760108f
+#define GZ (0.0415560f * 1.08883f)
+#define BX (0.0556434f * 0.95047f)
+#define BY (-0.2040259f)
+#define BZ (1.0572252f * 1.08883f)
+
+// CIE Lab companding: cube roots above (6/29)^3, a line below
+#define LAB_EPSILON 0.008856452f        // (6/29)^3
+#define LAB_DELTA 0.20689655f           // 6/29
+#define LAB_SLOPE 7.787037f             // 1 / (3 (6/29)^2)
+#define LAB_OFFSET 0.13793103f          // 4/29
+
+#define ENCODE_LINEAR_LIMIT 0.0031308f
+
+static float decode_base[DECODE_STEPS + 1];
+static float decode_slope[DECODE_STEPS + 1];
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+static int active_kernel = -1;
+
+// Conversions that have vector kernels; the kernels return how many
+// colors they converted and the scalar code finishes the tail
+typedef enum {
+    CONVERT_RGB_TO_HSL,
+    CONVERT_HSL_TO_RGB,
+    CONVERT_RGB_TO_HSV,
+    CONVERT_HSV_TO_RGB,
+    CONVERT_RGB_TO_LAB,
+    CONVERT_LAB_TO_RGB,
+    CONVERT_COUNT
+} Conversion;
+
+typedef size_t (*ConvertBulkFn)(const ColorBatch *src, ColorBatch *dst, size_t count);
+
+static void build_tables(void) {
+    for (int i = 0; i <= DECODE_STEPS; i++) {
+        double x0 = (double)i / DECODE_STEPS;
+        double x1 = (double)(i + 1) / DECODE_STEPS;
+        double y0 = x0 <= 0.04045 ? x0 / 12.92 : pow((x0 + 0.055) / 1.055, 2.4);
+        double y1 = x1 <= 0.04045 ? x1 / 12.92 : pow((x1 + 0.055) / 1.055, 2.4);
+        decode_base[i] = (float)y0;
+        decode_slope[i] = (float)(y1 - y0);
+    }
+}
+
+// ---------------------------------------------------------------------
+// Batches
+// ---------------------------------------------------------------------
+
+bool color_batch_init(ColorBatch *batch, size_t capacity) {
+    memset(batch, 0, sizeof(ColorBatch));
+    capacity = (capacity + 7) & ~(size_t)7;
+    if (capacity == 0) capacity = 8;
+
+    for (int i = 0; i < 3; i++) {
+        void *channel;
+        if (posix_memalign(&channel, COLOR_BATCH_ALIGN, capacity * sizeof(float)) != 0) {
+            color_batch_free(batch);
+            return false;
+        }
+        batch->c[i] = channel;
+        memset(channel, 0, capacity * sizeof(float));
+    }
+
+    batch->capacity = capacity;
+    return true;
+}
+
+void color_batch_free(ColorBatch *batch) {
+    for (int i = 0; i < 3; i++) {
+        free(batch->c[i]);
+        batch->c[i] = NULL;
+    }
+    batch->count = batch->capacity = 0;
+}
+
+void color_batch_from_rgb8(ColorBatch *batch, const unsigned char *rgb, size_t count) {
+    float *r = batch->c[0], *g = batch->c[1], *b = batch->c[2];
+    const float scale = 1.0f / 255.0f;
+
+    for (size_t i = 0; i < count; i++) {
+        r[i] = (float)rgb[3 * i] * scale;
+        g[i] = (float)rgb[3 * i + 1] * scale;
+        b[i] = (float)rgb[3 * i + 2] * scale;
+    }
+    batch->count = count;
+}
+
+static unsigned char to_byte(float x) {
+    x = x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x);
+    return (unsigned char)(x * 255.0f + 0.5f);
+}
+
+void color_batch_to_rgb8(const ColorBatch *batch, unsigned char *rgb) {
+    for (size_t i = 0; i < batch->count; i++) {
+        rgb[3 * i] = to_byte(batch->c[0][i]);
+        rgb[3 * i + 1] = to_byte(batch->c[1][i]);
+        rgb[3 * i + 2] = to_byte(batch->c[2][i]);
+    }
+}
+
+// ---------------------------------------------------------------------
+// Scalar
+// ---------------------------------------------------------------------
+
+static inline float clamp01(float x) {
+    return x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x);
+}
+
+static inline float decode_srgb(float x) {
+    float t = clamp01(x) * DECODE_STEPS;
+    int i = (int)t;
+    if (i > DECODE_STEPS - 1) i = DECODE_STEPS - 1;
+    return decode_base[i] + (t - (float)i) * decode_slope[i];
+}
+
+// Bit-level estimate (within a few percent) and two Halley steps; the
+// vector kernel does the same arithmetic
+static inline float fast_cbrt(float x) {
+    int32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    bits = (int32_t)((float)bits * (1.0f / 3.0f)) + 709921077;
+
+    float y;
+    memcpy(&y, &bits, sizeof(y));
+    for (int i = 0; i < 2; i++) {
+        float y3 = y * y * y;
+        y = y * (y3 + 2.0f * x) / (2.0f * y3 + x);
+    }
+    return y;
+}
+
+// x^(1/2.4) = x^(5/12) = c * c^(1/4) with c the cube root
+static inline float encode_srgb(float x) {
+    x = clamp01(x);
+    if (x <= ENCODE_LINEAR_LIMIT) return 12.92f * x;
+
+    float c = fast_cbrt(x);
+    return 1.055f * c * sqrtf(sqrtf(c)) - 0.055f;
+}
+
+static inline float lab_f(float t) {
+    return t > LAB_EPSILON ? fast_cbrt(t) : t * LAB_SLOPE + LAB_OFFSET;
+}
+
+static inline float lab_f_inverse(float f) {
+    return f > LAB_DELTA ? f * f * f : (f - LAB_OFFSET) / LAB_SLOPE;
+}
+
+static inline float wrap_hue(float h, float period) {
+    return h - period * floorf(h / period);
+}
+
+// Hue in degrees of a color whose largest channel is `max`, with chroma `d`
+static inline float hue_of(float r, float g, float b, float max, float d) {
+    if (d <= 0.0f) return 0.0f;
+
+    float h;
+    if (max == r) {
+        h = (g - b) / d;
+    } else if (max == g) {
+        h = (b - r) / d + 2.0f;
+    } else {
+        h = (r - g) / d + 4.0f;
+    }
+    h *= 60.0f;
+    return h < 0.0f ? h + 360.0f : h;
+}
+
+static void rgb_to_hsl_scalar(const ColorBatch *src, ColorBatch *dst, size_t from, size_t to) {
+    for (size_t i = from; i < to; i++) {
+        float r = src->c[0][i], g = src->c[1][i], b = src->c[2][i];
+        float max = fmaxf(r, fmaxf(g, b));
+        float min = fminf(r, fminf(g, b));
+        float d = max - min;
+        float l = (max + min) * 0.5f;
+
+        dst->c[0][i] = hue_of(r, g, b, max, d);
+        dst->c[1][i] = d > 0.0f ? d / (1.0f - fabsf(2.0f * l - 1.0f)) : 0.0f;
+        dst->c[2][i] = l;
+    }
+}
+
+// f(n) = l - a max(-1, min(k - 3, 9 - k, 1)), k = (n + h / 30) mod 12
+static inline float hsl_channel(float n, float h, float l, float a) {
+    float k = wrap_hue(n + h * (1.0f / 30.0f), 12.0f);
+    return l - a * fmaxf(-1.0f, fminf(fminf(k - 3.0f, 9.0f - k), 1.0f));
+}
+
+static void hsl_to_rgb_scalar(const ColorBatch *src, ColorBatch *dst, size_t from, size_t to) {
+    for (size_t i = from; i < to; i++) {
+        float h = src->c[0][i], s = src->c[1][i], l = src->c[2][i];
+        float a = s * fminf(l, 1.0f - l);
+
+        dst->c[0][i] = clamp01(hsl_channel(0.0f, h, l, a));
+        dst->c[1][i] = clamp01(hsl_channel(8.0f, h, l, a));
+        dst->c[2][i] = clamp01(hsl_channel(4.0f, h, l, a));
+    }
+}
+
+static void rgb_to_hsv_scalar(const ColorBatch *src, ColorBatch *dst, size_t from, size_t to) {
+    for (size_t i = from; i < to; i++) {
+        float r = src->c[0][i], g = src->c[1][i], b = src->c[2][i];
+        float max = fmaxf(r, fmaxf(g, b));
+        float min = fminf(r, fminf(g, b));
+        float d = max - min;
+
+        dst->c[0][i] = hue_of(r, g, b, max, d);
+        dst->c[1][i] = max > 0.0f ? d / max : 0.0f;
+        dst->c[2][i] = max;
+    }
+}
+
+// f(n) = v - v s max(0, min(k, 4 - k, 1)), k = (n + h / 60) mod 6
+static inline float hsv_channel(float n, float h, float v, float vs) {
+    float k = wrap_hue(n + h * (1.0f / 60.0f), 6.0f);
+    return v - vs * fmaxf(0.0f, fminf(fminf(k, 4.0f - k), 1.0f));
+}
+
+static void hsv_to_rgb_scalar(const ColorBatch *src, ColorBatch *dst, size_t from, size_t to) {
+    for (size_t i = from; i < to; i++) {
+        float h = src->c[0][i], s = src->c[1][i], v = src->c[2][i];
+        float vs = v * s;
+
+        dst->c[0][i] = clamp01(hsv_channel(5.0f, h, v, vs));
+        dst->c[1][i] = clamp01(hsv_channel(3.0f, h, v, vs));
+        dst->c[2][i] = clamp01(hsv_channel(1.0f, h, v, vs));
+    }
+}
+
+static void rgb_to_lab_scalar(const ColorBatch *src, ColorBatch *dst, size_t from, size_t to) {
+    for (size_t i = from; i < to; i++) {
+        float r = decode_srgb(src->c[0][i]);
+        float g = decode_srgb(src->c[1][i]);
+        float b = decode_srgb(src->c[2][i]);
+
+        float fx = lab_f(XR * r + XG * g + XB * b);
+        float fy = lab_f(YR * r + YG * g + YB * b);
+        float fz = lab_f(ZR * r + ZG * g + ZB * b);
+
+        dst->c[0][i] = 116.0f * fy - 16.0f;
+        dst->c[1][i] = 500.0f * (fx - fy);
+        dst->c[2][i] = 200.0f * (fy - fz);
+    }
+}
+
+static void lab_to_rgb_scalar(const ColorBatch *src, ColorBatch *dst, size_t from, size_t to) {
+    for (size_t i = from; i < to; i++) {
+        float fy = (src->c[0][i] + 16.0f) * (1.0f / 116.0f);
+        float fx = fy + src->c[1][i] * (1.0f / 500.0f);
+        float fz = fy - src->c[2][i] * (1.0f / 200.0f);
+
+        float x = lab_f_inverse(fx);
+        float y = lab_f_inverse(fy);
+        float z = lab_f_inverse(fz);
+
+        dst->c[0][i] = encode_srgb(RX * x + RY * y + RZ * z);
+        dst->c[1][i] = encode_srgb(GX * x + GY * y + GZ * z);
+        dst->c[2][i] = encode_srgb(BX * x + BY * y + BZ * z);
+    }
+}
+
+typedef void (*ConvertScalarFn)(const ColorBatch *src, ColorBatch *dst, size_t from, size_t to);
+
+static const ConvertScalarFn scalar_kernels[CONVERT_COUNT] = {
+    [CONVERT_RGB_TO_HSL] = rgb_to_hsl_scalar,
+    [CONVERT_HSL_TO_RGB] = hsl_to_rgb_scalar,
+    [CONVERT_RGB_TO_HSV] = rgb_to_hsv_scalar,
+    [CONVERT_HSV_TO_RGB] = hsv_to_rgb_scalar,
+    [CONVERT_RGB_TO_LAB] = rgb_to_lab_scalar,
+    [CONVERT_LAB_TO_RGB] = lab_to_rgb_scalar
+};
+
+// ---------------------------------------------------------------------
+// AVX2: eight colors per step, same arithmetic as the scalar code
+// ---------------------------------------------------------------------
+
+#ifdef COLOR_X86
+
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+
+AVX2_TARGET
+static inline __m256 clamp01_avx2(__m256 x) {
+    return _mm256_min_ps(_mm256_max_ps(x, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+}
+
+AVX2_TARGET
+static inline __m256 decode_srgb_avx2(__m256 x) {
+    __m256 t = _mm256_mul_ps(clamp01_avx2(x), _mm256_set1_ps((float)DECODE_STEPS));
+    __m256i i = _mm256_min_epi32(_mm256_cvttps_epi32(t), _mm256_set1_epi32(DECODE_STEPS - 1));
+    __m256 frac = _mm256_sub_ps(t, _mm256_cvtepi32_ps(i));
+    __m256 base = _mm256_i32gather_ps(decode_base, i, 4);
+    __m256 slope = _mm256_i32gather_ps(decode_slope, i, 4);
+    return _mm256_add_ps(base, _mm256_mul_ps(frac, slope));
+}
+
+AVX2_TARGET
+static inline __m256 fast_cbrt_avx2(__m256 x) {
+    __m256 bits = _mm256_cvtepi32_ps(_mm256_castps_si256(x));
+    __m256i estimate = _mm256_add_epi32(
+        _mm256_cvttps_epi32(_mm256_mul_ps(bits, _mm256_set1_ps(1.0f / 3.0f))),
+        _mm256_set1_epi32(709921077));
+
+    __m256 y = _mm256_castsi256_ps(estimate);
+    __m256 two = _mm256_set1_ps(2.0f);
+    for (int i = 0; i < 2; i++) {
+        __m256 y3 = _mm256_mul_ps(_mm256_mul_ps(y, y), y);
+        __m256 num = _mm256_add_ps(y3, _mm256_mul_ps(two, x));
+        __m256 den = _mm256_add_ps(_mm256_mul_ps(two, y3), x);
+        y = _mm256_div_ps(_mm256_mul_ps(y, num), den);
+    }
+    return y;
+}
+
+AVX2_TARGET
+static inline __m256 encode_srgb_avx2(__m256 x) {
+    x = clamp01_avx2(x);
+    __m256 c = fast_cbrt_avx2(x);
+    __m256 curve = _mm256_sub_ps(
+        _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(1.055f), c), _mm256_sqrt_ps(_mm256_sqrt_ps(c))),
+        _mm256_set1_ps(0.055f));
+    __m256 line = _mm256_mul_ps(_mm256_set1_ps(12.92f), x);
+    __m256 linear = _mm256_cmp_ps(x, _mm256_set1_ps(ENCODE_LINEAR_LIMIT), _CMP_LE_OQ);
+    return _mm256_blendv_ps(curve, line, linear);
+}
+
+AVX2_TARGET
+static inline __m256 lab_f_avx2(__m256 t) {
+    __m256 root = fast_cbrt_avx2(t);
+    __m256 line = _mm256_add_ps(_mm256_mul_ps(t, _mm256_set1_ps(LAB_SLOPE)),
+                                _mm256_set1_ps(LAB_OFFSET));
+    return _mm256_blendv_ps(line, root, _mm256_cmp_ps(t, _mm256_set1_ps(LAB_EPSILON), _CMP_GT_OQ));
+}
+
+AVX2_TARGET
+static inline __m256 lab_f_inverse_avx2(__m256 f) {
+    __m256 cube = _mm256_mul_ps(_mm256_mul_ps(f, f), f);
+    __m256 line = _mm256_div_ps(_mm256_sub_ps(f, _mm256_set1_ps(LAB_OFFSET)),
+                                _mm256_set1_ps(LAB_SLOPE));
+    return _mm256_blendv_ps(line, cube, _mm256_cmp_ps(f, _mm256_set1_ps(LAB_DELTA), _CMP_GT_OQ));
+}
+
+AVX2_TARGET
+static inline __m256 wrap_hue_avx2(__m256 h, float period) {
+    __m256 p = _mm256_set1_ps(period);
+    return _mm256_sub_ps(h, _mm256_mul_ps(p, _mm256_floor_ps(_mm256_div_ps(h, p))));
+}
+
+// Branch-free hue_of(): all three sectors, blended by which channel is max
+AVX2_TARGET
+static inline __m256 hue_of_avx2(__m256 r, __m256 g, __m256 b, __m256 max, __m256 d) {
+    __m256 zero = _mm256_setzero_ps();
+    __m256 chromatic = _mm256_cmp_ps(d, zero, _CMP_GT_OQ);
+    __m256 safe_d = _mm256_blendv_ps(_mm256_set1_ps(1.0f), d, chromatic);
+
+    __m256 hr = _mm256_div_ps(_mm256_sub_ps(g, b), safe_d);
+    __m256 hg = _mm256_add_ps(_mm256_div_ps(_mm256_sub_ps(b, r), safe_d), _mm256_set1_ps(2.0f));
+    __m256 hb = _mm256_add_ps(_mm256_div_ps(_mm256_sub_ps(r, g), safe_d), _mm256_set1_ps(4.0f));
+
+    __m256 is_r = _mm256_cmp_ps(max, r, _CMP_EQ_OQ);
+    __m256 is_g = _mm256_cmp_ps(max, g, _CMP_EQ_OQ);
+    __m256 h = _mm256_blendv_ps(_mm256_blendv_ps(hb, hg, is_g), hr, is_r);
+
+    h = _mm256_mul_ps(h, _mm256_set1_ps(60.0f));
+    h = _mm256_add_ps(h, _mm256_and_ps(_mm256_cmp_ps(h, zero, _CMP_LT_OQ), _mm256_set1_ps(360.0f)));
+    return _mm256_and_ps(h, chromatic);
+}
+
+AVX2_TARGET
+static size_t rgb_to_hsl_avx2(const ColorBatch *src, ColorBatch *dst, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 r = _mm256_loadu_ps(src->c[0] + i);
+        __m256 g = _mm256_loadu_ps(src->c[1] + i);
+        __m256 b = _mm256_loadu_ps(src->c[2] + i);
+
+        __m256 max = _mm256_max_ps(r, _mm256_max_ps(g, b));
+        __m256 min = _mm256_min_ps(r, _mm256_min_ps(g, b));
+        __m256 d = _mm256_sub_ps(max, min);
+        __m256 l = _mm256_mul_ps(_mm256_add_ps(max, min), _mm256_set1_ps(0.5f));
+
+        // 1 - |2l - 1|, zero only for black and white where d is zero too
+        __m256 sign = _mm256_set1_ps(-0.0f);
+        __m256 centered = _mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(2.0f), l), _mm256_set1_ps(1.0f));
+        __m256 den = _mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_andnot_ps(sign, centered));
+        __m256 chromatic = _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_GT_OQ);
+        den = _mm256_blendv_ps(_mm256_set1_ps(1.0f), den, chromatic);
+        __m256 s = _mm256_and_ps(_mm256_div_ps(d, den), chromatic);
+
+        _mm256_storeu_ps(dst->c[0] + i, hue_of_avx2(r, g, b, max, d));
+        _mm256_storeu_ps(dst->c[1] + i, s);
+        _mm256_storeu_ps(dst->c[2] + i, l);
+    }
+    return i;
+}
+
+AVX2_TARGET
+static inline __m256 hsl_channel_avx2(float n, __m256 h, __m256 l, __m256 a) {
+    __m256 k = wrap_hue_avx2(_mm256_add_ps(_mm256_set1_ps(n),
+                                           _mm256_mul_ps(h, _mm256_set1_ps(1.0f / 30.0f))), 12.0f);
+    __m256 m = _mm256_min_ps(_mm256_min_ps(_mm256_sub_ps(k, _mm256_set1_ps(3.0f)),
+                                           _mm256_sub_ps(_mm256_set1_ps(9.0f), k)),
+                             _mm256_set1_ps(1.0f));
+    m = _mm256_max_ps(_mm256_set1_ps(-1.0f), m);
+    return clamp01_avx2(_mm256_sub_ps(l, _mm256_mul_ps(a, m)));
+}
+
+AVX2_TARGET
+static size_t hsl_to_rgb_avx2(const ColorBatch *src, ColorBatch *dst, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 h = _mm256_loadu_ps(src->c[0] + i);
+        __m256 s = _mm256_loadu_ps(src->c[1] + i);
+        __m256 l = _mm256_loadu_ps(src->c[2] + i);
+        __m256 a = _mm256_mul_ps(s, _mm256_min_ps(l, _mm256_sub_ps(_mm256_set1_ps(1.0f), l)));
+
+        __m256 r = hsl_channel_avx2(0.0f, h, l, a);
+        __m256 g = hsl_channel_avx2(8.0f, h, l, a);
+        __m256 b = hsl_channel_avx2(4.0f, h, l, a);
+        _mm256_storeu_ps(dst->c[0] + i, r);
+        _mm256_storeu_ps(dst->c[1] + i, g);
+        _mm256_storeu_ps(dst->c[2] + i, b);
+    }
+    return i;
+}
+
+AVX2_TARGET
+static size_t rgb_to_hsv_avx2(const ColorBatch *src, ColorBatch *dst, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 r = _mm256_loadu_ps(src->c[0] + i);
+        __m256 g = _mm256_loadu_ps(src->c[1] + i);
+        __m256 b = _mm256_loadu_ps(src->c[2] + i);
+
+        __m256 max = _mm256_max_ps(r, _mm256_max_ps(g, b));
+        __m256 min = _mm256_min_ps(r, _mm256_min_ps(g, b));
+        __m256 d = _mm256_sub_ps(max, min);
+
+        __m256 lit = _mm256_cmp_ps(max, _mm256_setzero_ps(), _CMP_GT_OQ);
+        __m256 den = _mm256_blendv_ps(_mm256_set1_ps(1.0f), max, lit);
+        __m256 s = _mm256_and_ps(_mm256_div_ps(d, den), lit);
+
+        _mm256_storeu_ps(dst->c[0] + i, hue_of_avx2(r, g, b, max, d));
+        _mm256_storeu_ps(dst->c[1] + i, s);
+        _mm256_storeu_ps(dst->c[2] + i, max);
+    }
+    return i;
+}
+
+AVX2_TARGET
+static inline __m256 hsv_channel_avx2(float n, __m256 h, __m256 v, __m256 vs) {
+    __m256 k = wrap_hue_avx2(_mm256_add_ps(_mm256_set1_ps(n),
+                                           _mm256_mul_ps(h, _mm256_set1_ps(1.0f / 60.0f))), 6.0f);
+    __m256 m = _mm256_min_ps(_mm256_min_ps(k, _mm256_sub_ps(_mm256_set1_ps(4.0f), k)),
+                             _mm256_set1_ps(1.0f));
+    m = _mm256_max_ps(_mm256_setzero_ps(), m);
+    return clamp01_avx2(_mm256_sub_ps(v, _mm256_mul_ps(vs, m)));
+}
+
+AVX2_TARGET
+static size_t hsv_to_rgb_avx2(const ColorBatch *src, ColorBatch *dst, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 h = _mm256_loadu_ps(src->c[0] + i);
+        __m256 s = _mm256_loadu_ps(src->c[1] + i);
+        __m256 v = _mm256_loadu_ps(src->c[2] + i);
+        __m256 vs = _mm256_mul_ps(v, s);
+
+        __m256 r = hsv_channel_avx2(5.0f, h, v, vs);
+        __m256 g = hsv_channel_avx2(3.0f, h, v, vs);
+        __m256 b = hsv_channel_avx2(1.0f, h, v, vs);
+        _mm256_storeu_ps(dst->c[0] + i, r);
+        _mm256_storeu_ps(dst->c[1] + i, g);
+        _mm256_storeu_ps(dst->c[2] + i, b);
+    }
+    return i;
+}
+
+// a * x + b * y + c * z, multiplied and added in the scalar code's order
+AVX2_TARGET
+static inline __m256 dot3_avx2(float a, __m256 x, float b, __m256 y, float c, __m256 z) {
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(a), x),
+                                       _mm256_mul_ps(_mm256_set1_ps(b), y)),
+                         _mm256_mul_ps(_mm256_set1_ps(c), z));
+}
+
+AVX2_TARGET
+static size_t rgb_to_lab_avx2(const ColorBatch *src, ColorBatch *dst, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 r = decode_srgb_avx2(_mm256_loadu_ps(src->c[0] + i));
+        __m256 g = decode_srgb_avx2(_mm256_loadu_ps(src->c[1] + i));
+        __m256 b = decode_srgb_avx2(_mm256_loadu_ps(src->c[2] + i));
+
+        __m256 fx = lab_f_avx2(dot3_avx2(XR, r, XG, g, XB, b));
+        __m256 fy = lab_f_avx2(dot3_avx2(YR, r, YG, g, YB, b));
+        __m256 fz = lab_f_avx2(dot3_avx2(ZR, r, ZG, g, ZB, b));
+
+        _mm256_storeu_ps(dst->c[0] + i, _mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(116.0f), fy),
+                                                      _mm256_set1_ps(16.0f)));
+        _mm256_storeu_ps(dst->c[1] + i, _mm256_mul_ps(_mm256_set1_ps(500.0f), _mm256_sub_ps(fx, fy)));
+        _mm256_storeu_ps(dst->c[2] + i, _mm256_mul_ps(_mm256_set1_ps(200.0f), _mm256_sub_ps(fy, fz)));
+    }
+    return i;
+}
+
+AVX2_TARGET
+static size_t lab_to_rgb_avx2(const ColorBatch *src, ColorBatch *dst, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 fy = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(src->c[0] + i), _mm256_set1_ps(16.0f)),
+                                  _mm256_set1_ps(1.0f / 116.0f));
+        __m256 fx = _mm256_add_ps(fy, _mm256_mul_ps(_mm256_loadu_ps(src->c[1] + i),
+                                                    _mm256_set1_ps(1.0f / 500.0f)));
+        __m256 fz = _mm256_sub_ps(fy, _mm256_mul_ps(_mm256_loadu_ps(src->c[2] + i),
+                                                    _mm256_set1_ps(1.0f / 200.0f)));
+
+        __m256 x = lab_f_inverse_avx2(fx);
+        __m256 y = lab_f_inverse_avx2(fy);
+        __m256 z = lab_f_inverse_avx2(fz);
+
+        __m256 r = encode_srgb_avx2(dot3_avx2(RX, x, RY, y, RZ, z));
+        __m256 g = encode_srgb_avx2(dot3_avx2(GX, x, GY, y, GZ, z));
+        __m256 b = encode_srgb_avx2(dot3_avx2(BX, x, BY, y, BZ, z));
+        _mm256_storeu_ps(dst->c[0] + i, r);
+        _mm256_storeu_ps(dst->c[1] + i, g);
+        _mm256_storeu_ps(dst->c[2] + i, b);
+    }
+    return i;
+}
+
+static const ConvertBulkFn avx2_kernels[CONVERT_COUNT] = {
+    [CONVERT_RGB_TO_HSL] = rgb_to_hsl_avx2,
+    [CONVERT_HSL_TO_RGB] = hsl_to_rgb_avx2,
+    [CONVERT_RGB_TO_HSV] = rgb_to_hsv_avx2,
+    [CONVERT_HSV_TO_RGB] = hsv_to_rgb_avx2,
+    [CONVERT_RGB_TO_LAB] = rgb_to_lab_avx2,
+    [CONVERT_LAB_TO_RGB] = lab_to_rgb_avx2
+};
+
+#endif // COLOR_X86
+
+// ---------------------------------------------------------------------
+// Dispatch
+// ---------------------------------------------------------------------
+
+bool color_kernel_supported(ColorKernel kernel) {
+    switch (kernel) {
+        case COLOR_KERNEL_SCALAR:
+            return true;
+#ifdef COLOR_X86
+        case COLOR_KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+        default:
+            return false;
+    }
+}
+
+ColorKernel color_best_kernel(void) {
+    if (color_kernel_supported(COLOR_KERNEL_AVX2)) return COLOR_KERNEL_AVX2;
+    return COLOR_KERNEL_SCALAR;
+}
+
+ColorKernel color_kernel(void) {
+    if (active_kernel < 0) {
+        active_kernel = color_best_kernel();
+    }
+    return (ColorKernel)active_kernel;
+}
+
+bool color_set_kernel(ColorKernel kernel) {
+    if (!color_kernel_supported(kernel)) return false;
+    active_kernel = kernel;
+    return true;
+}
+
+const char* color_kernel_name(ColorKernel kernel) {
+    switch (kernel) {
+        case COLOR_KERNEL_SCALAR: return "scalar";
+        case COLOR_KERNEL_AVX2:   return "avx2";
+        default:                  return "unknown";
+    }
+}
+
+static void convert(Conversion conversion, const ColorBatch *src, ColorBatch *dst) {
+    pthread_once(&tables_once, build_tables);
+
+    size_t count = src->count;
+    size_t done = 0;
+#ifdef COLOR_X86
+    if (color_kernel() == COLOR_KERNEL_AVX2) {
+        done = avx2_kernels[conversion](src, dst, count);
+    }
+#endif
+    scalar_kernels[conversion](src, dst, done, count);
+    dst->count = count;
+}
+
+void color_rgb_to_hsl(const ColorBatch *src, ColorBatch *dst) {
+    convert(CONVERT_RGB_TO_HSL, src, dst);
+}
+
+void color_hsl_to_rgb(const ColorBatch *src, ColorBatch *dst) {
+    convert(CONVERT_HSL_TO_RGB, src, dst);
+}
+
+void color_rgb_to_hsv(const ColorBatch *src, ColorBatch *dst) {
+    convert(CONVERT_RGB_TO_HSV, src, dst);
+}
+
+void color_hsv_to_rgb(const ColorBatch *src, ColorBatch *dst) {
+    convert(CONVERT_HSV_TO_RGB, src, dst);
+}
+
+void color_rgb_to_lab(const ColorBatch *src, ColorBatch *dst) {
+    convert(CONVERT_RGB_TO_LAB, src, dst);
+}
+
+void color_lab_to_rgb(const ColorBatch *src, ColorBatch *dst) {
+    convert(CONVERT_LAB_TO_RGB, src, dst);
+}
+
+void color_rgb_luminance(const ColorBatch *src, float *y) {
+    pthread_once(&tables_once, build_tables);
+
+    for (size_t i = 0; i < src->count; i++) {
+        y[i] = YR * decode_srgb(src->c[0][i]) + YG * decode_srgb(src->c[1][i]) +
+               YB * decode_srgb(src->c[2][i]);
+    }
+}
@@ -0,0 +1,567 @@
+#include "color_palette.h"
+#include "../../common/error.h"
+#include "../../common/file_map.h"
+#include "../../common/memory.h"
+#include "../../common/work_queue.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define HISTOGRAM_CHUNK (1 << 20)       // pixels per work item
+#define ASSIGN_CHUNK 2048               // histogram bins per work item
+#define BIN_SHIFT (8 - IMAGE_HISTOGRAM_BITS)
+#define PNM_MAX_SIDE (1 << 20)
+
+typedef struct {
+    int width;
+    int height;
+    int channels;               // 1 (P2, P5) or 3 (P3, P6)
+    int sample_bytes;           // 2 when maxval is above 255
+    const unsigned char *raster;
+    unsigned char *decoded;     // ASCII rasters, already scaled to 8 bits
+    unsigned char *scale;       // sample value -> 8-bit value
+} PnmImage;
+
+typedef struct {
+    uint32_t count[IMAGE_HISTOGRAM_BINS];
+    uint64_t sum[IMAGE_HISTOGRAM_BINS][3];
+} Histogram;
+
+// A slice of pixels or of histogram bins, one work item
+typedef struct {
+    size_t first;
+    size_t count;
+} Range;
+
+typedef struct {
+    const PnmImage *image;
+    Histogram *shards;
+} HistogramJob;
+
+typedef struct {
+    double l, a, b, weight;
+} ClusterSum;
+
+// Occupied bins in Lab with their pixel counts, and the clustering state.
+// Assignment items write disjoint slices of `cluster`; sums and move
+// counts are per worker.
+typedef struct {
+    size_t bins;
+    ColorBatch lab;
+    float *weight;
+    unsigned char *cluster;
+    int k;
+    float center[PALETTE_MAX_SIZE][3];
+    ClusterSum *sums;           // [worker][PALETTE_MAX_SIZE]
+    size_t *moved;              // [worker]
+} KMeans;
+
+static double seconds_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// ---------------------------------------------------------------------
+// PNM
+// ---------------------------------------------------------------------
+
+// Skips whitespace and comments, then reads one decimal number
+static bool pnm_number(const char **cursor, const char *end, unsigned long *value) {
+    const char *p = *cursor;
+    for (;;) {
+        while (p < end && isspace((unsigned char)*p)) p++;
+        if (p == end || *p != '#') break;
+        while (p < end && *p != '\n') p++;
+    }
+    if (p == end || !isdigit((unsigned char)*p)) return false;
+
+    unsigned long v = 0;
+    while (p < end && isdigit((unsigned char)*p)) {
+        if (v > 100000000) return false;
+        v = v * 10 + (unsigned long)(*p - '0');
+        p++;
+    }
+
+    *cursor = p;
+    *value = v;
+    return true;
+}
+
+static void pnm_close(PnmImage *image) {
+    FREE(image->decoded);
+    FREE(image->scale);
+}
+
+static int pnm_open(PnmImage *image, const FileMap *map, const char **why) {
+    memset(image, 0, sizeof(PnmImage));
+    const char *p = map->data;
+    const char *end = p + map->length;
+
+    *why = "not a PNM image (P2, P3, P5 or P6)";
+    if (map->length < 2 || p[0] != 'P' || (p[1] != '2' && p[1] != '3' && p[1] != '5' && p[1] != '6')) {
+        return ERROR_PARSE_ERROR;
+    }
+    bool ascii = p[1] == '2' || p[1] == '3';
+    image->channels = p[1] == '3' || p[1] == '6' ? 3 : 1;
+    p += 2;
+
+    unsigned long width, height, maxval;
+    *why = "bad PNM header";
+    if (!pnm_number(&p, end, &width) || !pnm_number(&p, end, &height) ||
+        !pnm_number(&p, end, &maxval)) {
+        return ERROR_PARSE_ERROR;
+    }
+    if (width == 0 || height == 0 || width > PNM_MAX_SIDE || height > PNM_MAX_SIDE ||
+        maxval == 0 || maxval > 65535) {
+        return ERROR_PARSE_ERROR;
+    }
+    image->width = (int)width;
+    image->height = (int)height;
+    image->sample_bytes = maxval > 255 ? 2 : 1;
+
+    // Any maxval maps onto 0..255 through one table lookup per sample. The
+    // table covers every value a sample can hold, and values above maxval
+    // clamp to 255 as in the ASCII path; ASCII rasters reuse the table as
+    // the identity once decoded.
+    size_t entries = image->sample_bytes == 2 ? 65536 : 256;
+    image->scale = MALLOC(entries);
+    if (!image->scale) return ERROR_MEMORY_ALLOCATION;
+    for (size_t v = 0; v < entries; v++) {
+        image->scale[v] = v <= maxval ? (unsigned char)((v * 255 + maxval / 2) / maxval) : 255;
+    }
+
+    size_t samples = (size_t)width * height * (size_t)image->channels;
+    *why = "truncated image data";
+
+    if (!ascii) {
+        // Exactly one whitespace character separates the header from the raster
+        if (p == end || !isspace((unsigned char)*p)) return ERROR_PARSE_ERROR;
+        p++;
+        if ((size_t)(end - p) < samples * (size_t)image->sample_bytes) return ERROR_PARSE_ERROR;
+        image->raster = (const unsigned char*)p;
+        return SUCCESS;
+    }
+
+    image->decoded = MALLOC(samples);
+    if (!image->decoded) return ERROR_MEMORY_ALLOCATION;
+
+    for (size_t i = 0; i < samples; i++) {
+        unsigned long v;
+        if (!pnm_number(&p, end, &v)) return ERROR_PARSE_ERROR;
+        image->decoded[i] = image->scale[v < maxval ? v : maxval];
+    }
+
+    for (int v = 0; v < 256; v++) image->scale[v] = (unsigned char)v;
+    image->sample_bytes = 1;
+    image->raster = image->decoded;
+    return SUCCESS;
+}
+
+// ---------------------------------------------------------------------
+// Histogram
+// ---------------------------------------------------------------------
+
+static inline unsigned int histogram_bin(unsigned int r, unsigned int g, unsigned int b) {
+    return (r >> BIN_SHIFT) << (2 * IMAGE_HISTOGRAM_BITS) |
+           (g >> BIN_SHIFT) << IMAGE_HISTOGRAM_BITS | (b >> BIN_SHIFT);
+}
+
+static inline void histogram_add(Histogram *h, unsigned int r, unsigned int g, unsigned int b) {
+    unsigned int bin = histogram_bin(r, g, b);
+    h->count[bin]++;
+    h->sum[bin][0] += r;
+    h->sum[bin][1] += g;
+    h->sum[bin][2] += b;
+}
+
+// Work item handler: one slice of pixels into this worker's histogram.
+// 8-bit RGB, by far the common case, skips the generic sample decoding.
+static void histogram_chunk(WorkPool *pool, int worker, void *item, void *ctx) {
+    (void)pool;
+    const HistogramJob *job = (const HistogramJob*)ctx;
+    const Range *range = (const Range*)item;
+    const PnmImage *image = job->image;
+    const unsigned char *scale = image->scale;
+    Histogram *h = &job->shards[worker];
+
+    size_t stride = (size_t)image->channels * (size_t)image->sample_bytes;
+    const unsigned char *p = image->raster + range->first * stride;
+    const unsigned char *end = p + range->count * stride;
+
+    if (image->channels == 3 && image->sample_bytes == 1) {
+        for (; p < end; p += 3) {
+            histogram_add(h, scale[p[0]], scale[p[1]], scale[p[2]]);
+        }
+        return;
+    }
+
+    for (; p < end; p += stride) {
+        unsigned int rgb[3] = { 0, 0, 0 };
+        for (int c = 0; c < image->channels; c++) {
+            const unsigned char *s = p + c * image->sample_bytes;
+            rgb[c] = image->sample_bytes == 1 ? scale[s[0]] : scale[s[0] << 8 | s[1]];
+        }
+        if (image->channels == 1) rgb[1] = rgb[2] = rgb[0];
+        histogram_add(h, rgb[0], rgb[1], rgb[2]);
+    }
+}
+
+// Histogram of the whole image in shards[0]
+static int build_histogram(const PnmImage *image, Histogram *shards, int jobs) {
+    size_t pixels = (size_t)image->width * (size_t)image->height;
+    size_t count = (pixels + HISTOGRAM_CHUNK - 1) / HISTOGRAM_CHUNK;
+    Range *ranges = MALLOC(count * sizeof(Range));
+    if (!ranges) return ERROR_MEMORY_ALLOCATION;
+
+    HistogramJob job = { image, shards };
+    WorkPool *pool = work_pool_create(jobs, histogram_chunk, &job);
+    int status = pool ? SUCCESS : ERROR_MEMORY_ALLOCATION;
+
+    for (size_t i = 0; status == SUCCESS && i < count; i++) {
+        ranges[i].first = i * HISTOGRAM_CHUNK;
+        ranges[i].count = pixels - ranges[i].first < HISTOGRAM_CHUNK ? pixels - ranges[i].first
+                                                                      : HISTOGRAM_CHUNK;
+        if (!work_pool_submit(pool, &ranges[i])) status = ERROR_MEMORY_ALLOCATION;
+    }
+
+    if (pool) {
+        // Items queued before a failure still run; the result is discarded
+        work_pool_run(pool);
+        work_pool_destroy(pool);
+    }
+    FREE(ranges);
+
+    for (int w = 1; status == SUCCESS && w < jobs; w++) {
+        for (size_t bin = 0; bin < IMAGE_HISTOGRAM_BINS; bin++) {
+            shards[0].count[bin] += shards[w].count[bin];
+            for (int c = 0; c < 3; c++) shards[0].sum[bin][c] += shards[w].sum[bin][c];
+        }
+    }
+    return status;
+}
+
+// ---------------------------------------------------------------------
+// k-means
+// ---------------------------------------------------------------------
+
+// splitmix64 scaled to [0, 1)
+static double random_unit(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    return (double)(z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static inline float lab_distance2(const KMeans *km, size_t bin, const float center[3]) {
+    float dl = km->lab.c[0][bin] - center[0];
+    float da = km->lab.c[1][bin] - center[1];
+    float db = km->lab.c[2][bin] - center[2];
+    return dl * dl + da * da + db * db;
+}
+
+// Bin picked with probability proportional to weight * score
+static size_t pick_bin(const KMeans *km, const float *score, double total, uint64_t *state) {
+    double target = random_unit(state) * total;
+    size_t last = 0;
+
+    for (size_t i = 0; i < km->bins; i++) {
+        double mass = (double)km->weight[i] * (score ? score[i] : 1.0f);
+        if (mass <= 0) continue;
+        last = i;
+        if (target < mass) return i;
+        target -= mass;
+    }
+    return last;
+}
+
+// k-means++: the first center by pixel count alone, every further one by
+// pixel count times the squared distance to the nearest center so far.
+// Stops early when every bin already sits on a center.
+static bool kmeans_seed(KMeans *km, uint64_t seed) {
+    float *nearest = MALLOC(km->bins * sizeof(float));
+    if (!nearest) return false;
+
+    uint64_t state = seed;
+    double total = 0;
+    for (size_t i = 0; i < km->bins; i++) total += km->weight[i];
+
+    size_t bin = pick_bin(km, NULL, total, &state);
+    int k = km->k;
+    km->k = 0;
+
+    for (;;) {
+        for (int c = 0; c < 3; c++) km->center[km->k][c] = km->lab.c[c][bin];
+        km->k++;
+        if (km->k == k) break;
+
+        total = 0;
+        for (size_t i = 0; i < km->bins; i++) {
+            float d = lab_distance2(km, i, km->center[km->k - 1]);
+            if (km->k == 1 || d < nearest[i]) nearest[i] = d;
+            total += (double)km->weight[i] * nearest[i];
+        }
+        if (total <= 0) break;
+
+        bin = pick_bin(km, nearest, total, &state);
+    }
+
+    FREE(nearest);
+    return true;
+}
+
+// Work item handler: nearest center for a slice of bins, accumulated
+// into this worker's sums
+static void assign_chunk(WorkPool *pool, int worker, void *item, void *ctx) {
+    (void)pool;
+    KMeans *km = (KMeans*)ctx;
+    const Range *range = (const Range*)item;
+    ClusterSum *sums = &km->sums[(size_t)worker * PALETTE_MAX_SIZE];
+    size_t moved = 0;
+
+    for (size_t i = range->first; i < range->first + range->count; i++) {
+        int best = 0;
+        float best_distance = FLT_MAX;
+        for (int c = 0; c < km->k; c++) {
+            float d = lab_distance2(km, i, km->center[c]);
+            if (d < best_distance) {
+                best_distance = d;
+                best = c;
+            }
+        }
+
+        if (km->cluster[i] != best) {
+            km->cluster[i] = (unsigned char)best;
+            moved++;
+        }
+
+        double w = km->weight[i];
+        sums[best].l += w * km->lab.c[0][i];
+        sums[best].a += w * km->lab.c[1][i];
+        sums[best].b += w * km->lab.c[2][i];
+        sums[best].weight += w;
+    }
+
+    km->moved[worker] += moved;
+}
+
+// Lloyd iterations until no bin changes cluster; leaves the final
+// per-cluster totals in the first worker's sums
+static int kmeans_run(KMeans *km, int jobs, int max_iterations, int *iterations) {
+    size_t count = (km->bins + ASSIGN_CHUNK - 1) / ASSIGN_CHUNK;
+    Range *ranges = MALLOC(count * sizeof(Range));
+    WorkPool *pool = ranges ? work_pool_create(jobs, assign_chunk, km) : NULL;
+    if (!pool) {
+        FREE(ranges);
+        return ERROR_MEMORY_ALLOCATION;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        ranges[i].first = i * ASSIGN_CHUNK;
+        ranges[i].count = km->bins - ranges[i].first < ASSIGN_CHUNK ? km->bins - ranges[i].first
+                                                                     : ASSIGN_CHUNK;
+    }
+
+    int status = SUCCESS;
+    memset(km->cluster, 0xFF, km->bins);
+    *iterations = 0;
+
+    while (status == SUCCESS && *iterations < max_iterations) {
+        memset(km->sums, 0, (size_t)jobs * PALETTE_MAX_SIZE * sizeof(ClusterSum));
+        memset(km->moved, 0, (size_t)jobs * sizeof(size_t));
+
+        for (size_t i = 0; i < count; i++) {
+            if (!work_pool_submit(pool, &ranges[i])) status = ERROR_MEMORY_ALLOCATION;
+        }
+        work_pool_run(pool);
+        (*iterations)++;
+
+        size_t moved = km->moved[0];
+        for (int w = 1; w < jobs; w++) {
+            moved += km->moved[w];
+            for (int c = 0; c < km->k; c++) {
+                ClusterSum *dest = &km->sums[c];
+                const ClusterSum *src = &km->sums[(size_t)w * PALETTE_MAX_SIZE + c];
+                dest->l += src->l;
+                dest->a += src->a;
+                dest->b += src->b;
+                dest->weight += src->weight;
+            }
+        }
+
+        // A cluster that lost all its bins keeps its old center
+        for (int c = 0; c < km->k; c++) {
+            const ClusterSum *sum = &km->sums[c];
+            if (sum->weight <= 0) continue;
+            km->center[c][0] = (float)(sum->l / sum->weight);
+            km->center[c][1] = (float)(sum->a / sum->weight);
+            km->center[c][2] = (float)(sum->b / sum->weight);
+        }
+
+        if (moved == 0) break;
+    }
+
+    work_pool_destroy(pool);
+    FREE(ranges);
+    return status;
+}
+
+static void kmeans_free(KMeans *km) {
+    color_batch_free(&km->lab);
+    FREE(km->weight);
+    FREE(km->cluster);
+    FREE(km->sums);
+    FREE(km->moved);
+}
+
+// Occupied bins as mean colors in Lab, weighted by their pixel counts
+static bool kmeans_init(KMeans *km, const Histogram *histogram, int k, int jobs) {
+    memset(km, 0, sizeof(KMeans));
+    for (size_t bin = 0; bin < IMAGE_HISTOGRAM_BINS; bin++) {
+        if (histogram->count[bin] > 0) km->bins++;
+    }
+
+    km->k = k;
+    km->weight = MALLOC(km->bins * sizeof(float));
+    km->cluster = MALLOC(km->bins);
+    km->sums = MALLOC((size_t)jobs * PALETTE_MAX_SIZE * sizeof(ClusterSum));
+    km->moved = MALLOC((size_t)jobs * sizeof(size_t));
+    if (!km->weight || !km->cluster || !km->sums || !km->moved ||
+        !color_batch_init(&km->lab, km->bins)) {
+        kmeans_free(km);
+        return false;
+    }
+
+    size_t n = 0;
+    for (size_t bin = 0; bin < IMAGE_HISTOGRAM_BINS; bin++) {
+        uint32_t count = histogram->count[bin];
+        if (count == 0) continue;
+
+        double scale = 1.0 / (255.0 * count);
+        for (int c = 0; c < 3; c++) km->lab.c[c][n] = (float)((double)histogram->sum[bin][c] * scale);
+        km->weight[n] = (float)count;
+        n++;
+    }
+    km->lab.count = n;
+    color_rgb_to_lab(&km->lab, &km->lab);
+    return true;
+}
+
+// ---------------------------------------------------------------------
+// Palette
+// ---------------------------------------------------------------------
+
+static const ClusterSum *sort_sums;
+
+static int compare_clusters(const void *a, const void *b) {
+    double x = sort_sums[*(const int*)a].weight;
+    double y = sort_sums[*(const int*)b].weight;
+    return x > y ? -1 : (x < y ? 1 : 0);
+}
+
+static void fill_palette(ColorPalette *palette, const KMeans *km, const char *path) {
+    int order[PALETTE_MAX_SIZE];
+    double total = 0;
+    for (int c = 0; c < km->k; c++) {
+        order[c] = c;
+        total += km->sums[c].weight;
+    }
+    sort_sums = km->sums;
+    qsort(order, (size_t)km->k, sizeof(int), compare_clusters);
+
+    float c0[PALETTE_MAX_SIZE], c1[PALETTE_MAX_SIZE], c2[PALETTE_MAX_SIZE];
+    ColorBatch batch = { { c0, c1, c2 }, 0, PALETTE_MAX_SIZE };
+    for (int i = 0; i < km->k; i++) {
+        c0[i] = km->center[order[i]][0];
+        c1[i] = km->center[order[i]][1];
+        c2[i] = km->center[order[i]][2];
+    }
+    batch.count = (size_t)km->k;
+    color_lab_to_rgb(&batch, &batch);
+
+    unsigned char rgb[PALETTE_MAX_SIZE][3];
+    color_batch_to_rgb8(&batch, rgb[0]);
+
+    const char *base = strrchr(path, '/');
+    memset(palette, 0, sizeof(ColorPalette));
+    snprintf(palette->name, sizeof(palette->name), "%s", base ? base + 1 : path);
+    snprintf(palette->scheme, sizeof(palette->scheme), "k-means");
+
+    for (int i = 0; i < km->k; i++) {
+        double weight = km->sums[order[i]].weight;
+        if (weight <= 0) continue;
+
+        char name[32];
+        snprintf(name, sizeof(name), "%.1f%%", total > 0 ? 100.0 * weight / total : 0.0);
+        color_fill(&palette->colors[palette->color_count++], name, rgb[i]);
+    }
+}
+
+int image_palette(const char *path, const ImagePaletteOptions *options,
+                  ColorPalette *palette, ImagePaletteStats *stats) {
+    memset(stats, 0, sizeof(ImagePaletteStats));
+    if (options->colors < 1 || options->colors > PALETTE_MAX_SIZE) return ERROR_INVALID_ARGUMENT;
+    int jobs = options->jobs > 0 ? options->jobs : work_pool_default_workers();
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    FileMap map;
+    int status = file_map_open(&map, path);
+    if (status != SUCCESS) {
+        fprintf(stderr, "color-palette: %s: %s\n", path, strerror(errno));
+        return status;
+    }
+
+    PnmImage image;
+    const char *why = NULL;
+    status = pnm_open(&image, &map, &why);
+    if (status == ERROR_PARSE_ERROR) {
+        fprintf(stderr, "color-palette: %s: %s\n", path, why);
+    }
+    stats->width = image.width;
+    stats->height = image.height;
+    stats->read_seconds = seconds_since(&start);
+
+    Histogram *shards = NULL;
+    if (status == SUCCESS) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        shards = MALLOC((size_t)jobs * sizeof(Histogram));
+        if (!shards) {
+            status = ERROR_MEMORY_ALLOCATION;
+        } else {
+            memset(shards, 0, (size_t)jobs * sizeof(Histogram));
+            status = build_histogram(&image, shards, jobs);
+        }
+        stats->histogram_seconds = seconds_since(&start);
+    }
+    pnm_close(&image);
+    file_map_close(&map);
+
+    KMeans km;
+    if (status == SUCCESS) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int k = options->colors;
+        if (!kmeans_init(&km, &shards[0], k, jobs)) {
+            status = ERROR_MEMORY_ALLOCATION;
+        } else {
+            stats->bins = km.bins;
+            if (!kmeans_seed(&km, options->seed)) {
+                status = ERROR_MEMORY_ALLOCATION;
+            } else {
+                status = kmeans_run(&km, jobs, options->max_iterations, &stats->iterations);
+            }
+            if (status == SUCCESS) fill_palette(palette, &km, path);
+            kmeans_free(&km);
+        }
+        stats->cluster_seconds = seconds_since(&start);
+    }
+
+    FREE(shards);
+    return status;
+}
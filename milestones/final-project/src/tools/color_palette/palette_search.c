@@ -0,0 +1,284 @@
+#include "color_palette.h"
+#include "../../common/error.h"
+#include "../../common/memory.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PALETTE_X86 1
+#include <immintrin.h>
+#endif
+
+// Palettes are drawn and scored eight at a time, one per lane
+#define LANES 8
+
+// Pool colors with their Lab coordinates and contrast against the
+// background, the only inputs scoring needs
+typedef struct {
+    int count;
+    ColorBatch lab;
+    float *contrast;
+    unsigned char *rgb;
+} PalettePool;
+
+// Eight xorshift32 generators, one per lane; every kernel draws the same
+// candidates, so they find the same palette
+typedef struct {
+    uint32_t state[LANES];
+    float scale;                // pool size / 2^24
+    int32_t last;               // pool size - 1
+} PaletteDraw;
+
+typedef void (*ScoreFn)(const PalettePool *pool, PaletteDraw *draw, int size, float target,
+                        int32_t indices[][LANES], float scores[LANES]);
+
+float color_contrast_ratio(float y1, float y2) {
+    float light = y1 > y2 ? y1 : y2;
+    float dark = y1 > y2 ? y2 : y1;
+    return (light + 0.05f) / (dark + 0.05f);
+}
+
+static void pool_free(PalettePool *pool) {
+    color_batch_free(&pool->lab);
+    FREE(pool->contrast);
+    FREE(pool->rgb);
+}
+
+// The HSL grid (greys and the black and white ends left out), rounded to
+// 8-bit colors so scores describe the colors that get printed
+static int pool_build(PalettePool *pool, const PaletteSearch *search) {
+    memset(pool, 0, sizeof(PalettePool));
+    int hues = search->hue_steps, sats = search->saturation_steps;
+    int lights = search->lightness_steps;
+    pool->count = hues * sats * lights;
+
+    float *luminance = MALLOC((size_t)pool->count * sizeof(float));
+    pool->contrast = MALLOC((size_t)pool->count * sizeof(float));
+    pool->rgb = MALLOC((size_t)pool->count * 3);
+    if (!luminance || !pool->contrast || !pool->rgb ||
+        !color_batch_init(&pool->lab, (size_t)pool->count)) {
+        FREE(luminance);
+        pool_free(pool);
+        return ERROR_MEMORY_ALLOCATION;
+    }
+
+    ColorBatch *batch = &pool->lab;
+    size_t n = 0;
+    for (int h = 0; h < hues; h++) {
+        for (int s = 0; s < sats; s++) {
+            for (int l = 0; l < lights; l++) {
+                batch->c[0][n] = 360.0f * (float)h / (float)hues;
+                batch->c[1][n] = (float)(s + 1) / (float)sats;
+                batch->c[2][n] = (float)(l + 1) / (float)(lights + 1);
+                n++;
+            }
+        }
+    }
+    batch->count = n;
+
+    color_hsl_to_rgb(batch, batch);
+    color_batch_to_rgb8(batch, pool->rgb);
+    color_batch_from_rgb8(batch, pool->rgb, n);
+    color_rgb_luminance(batch, luminance);
+    color_rgb_to_lab(batch, batch);
+
+    // A single-color batch on the stack for the background
+    float r[8], g[8], b[8], y;
+    ColorBatch background = { { r, g, b }, 0, 8 };
+    color_batch_from_rgb8(&background, search->background, 1);
+    color_rgb_luminance(&background, &y);
+
+    for (size_t i = 0; i < n; i++) {
+        pool->contrast[i] = color_contrast_ratio(luminance[i], y);
+    }
+    FREE(luminance);
+    return SUCCESS;
+}
+
+static void draw_init(PaletteDraw *draw, uint64_t seed, int pool_size) {
+    for (int lane = 0; lane < LANES; lane++) {
+        // splitmix64 spreads nearby seeds; xorshift32 must not start at zero
+        uint64_t z = (seed += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        z ^= z >> 31;
+        draw->state[lane] = (uint32_t)z ? (uint32_t)z : 1;
+    }
+    draw->scale = (float)pool_size / 16777216.0f;
+    draw->last = pool_size - 1;
+}
+
+// ---------------------------------------------------------------------
+// Scalar
+// ---------------------------------------------------------------------
+
+static void score_scalar(const PalettePool *pool, PaletteDraw *draw, int size, float target,
+                         int32_t indices[][LANES], float scores[LANES]) {
+    for (int slot = 0; slot < size; slot++) {
+        for (int lane = 0; lane < LANES; lane++) {
+            uint32_t x = draw->state[lane];
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            draw->state[lane] = x;
+
+            int32_t index = (int32_t)((float)(x >> 8) * draw->scale);
+            indices[slot][lane] = index < draw->last ? index : draw->last;
+        }
+    }
+
+    const float *L = pool->lab.c[0], *A = pool->lab.c[1], *B = pool->lab.c[2];
+    for (int lane = 0; lane < LANES; lane++) {
+        float contrast = FLT_MAX, distance = FLT_MAX;
+
+        for (int i = 0; i < size; i++) {
+            int32_t p = indices[i][lane];
+            contrast = fminf(contrast, pool->contrast[p]);
+
+            for (int j = 0; j < i; j++) {
+                int32_t q = indices[j][lane];
+                float dl = L[p] - L[q], da = A[p] - A[q], db = B[p] - B[q];
+                distance = fminf(distance, dl * dl + da * da + db * db);
+            }
+        }
+
+        scores[lane] = contrast >= target ? sqrtf(distance) : contrast - target;
+    }
+}
+
+// ---------------------------------------------------------------------
+// AVX2: the eight palettes side by side, gathered from the pool tables
+// ---------------------------------------------------------------------
+
+#ifdef PALETTE_X86
+
+__attribute__((target("avx2")))
+static void score_avx2(const PalettePool *pool, PaletteDraw *draw, int size, float target,
+                       int32_t indices[][LANES], float scores[LANES]) {
+    __m256 l[PALETTE_MAX_SIZE], a[PALETTE_MAX_SIZE], b[PALETTE_MAX_SIZE];
+    __m256i x = _mm256_loadu_si256((const __m256i*)draw->state);
+    __m256 scale = _mm256_set1_ps(draw->scale);
+    __m256i last = _mm256_set1_epi32(draw->last);
+    __m256 contrast = _mm256_set1_ps(FLT_MAX);
+
+    for (int slot = 0; slot < size; slot++) {
+        x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 13));
+        x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+        x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 5));
+
+        __m256 r = _mm256_cvtepi32_ps(_mm256_srli_epi32(x, 8));
+        __m256i index = _mm256_min_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(r, scale)), last);
+        _mm256_storeu_si256((__m256i*)indices[slot], index);
+
+        l[slot] = _mm256_i32gather_ps(pool->lab.c[0], index, 4);
+        a[slot] = _mm256_i32gather_ps(pool->lab.c[1], index, 4);
+        b[slot] = _mm256_i32gather_ps(pool->lab.c[2], index, 4);
+        contrast = _mm256_min_ps(contrast, _mm256_i32gather_ps(pool->contrast, index, 4));
+    }
+    _mm256_storeu_si256((__m256i*)draw->state, x);
+
+    __m256 distance = _mm256_set1_ps(FLT_MAX);
+    for (int i = 1; i < size; i++) {
+        for (int j = 0; j < i; j++) {
+            __m256 dl = _mm256_sub_ps(l[i], l[j]);
+            __m256 da = _mm256_sub_ps(a[i], a[j]);
+            __m256 db = _mm256_sub_ps(b[i], b[j]);
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dl, dl), _mm256_mul_ps(da, da)),
+                                     _mm256_mul_ps(db, db));
+            distance = _mm256_min_ps(distance, d);
+        }
+    }
+
+    __m256 goal = _mm256_set1_ps(target);
+    __m256 met = _mm256_cmp_ps(contrast, goal, _CMP_GE_OQ);
+    __m256 score = _mm256_blendv_ps(_mm256_sub_ps(contrast, goal), _mm256_sqrt_ps(distance), met);
+    _mm256_storeu_ps(scores, score);
+}
+
+#endif // PALETTE_X86
+
+static ScoreFn score_kernel(void) {
+#ifdef PALETTE_X86
+    if (color_kernel() == COLOR_KERNEL_AVX2) return score_avx2;
+#endif
+    return score_scalar;
+}
+
+static double seconds_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static const float *sort_lightness;
+
+static int compare_lightness(const void *a, const void *b) {
+    float x = sort_lightness[*(const int32_t*)a];
+    float y = sort_lightness[*(const int32_t*)b];
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+int palette_search(const PaletteSearch *search, PaletteResult *result) {
+    memset(result, 0, sizeof(PaletteResult));
+    if (search->size < 2 || search->size > PALETTE_MAX_SIZE || search->hue_steps <= 0 ||
+        search->saturation_steps <= 0 || search->lightness_steps <= 0) {
+        return ERROR_INVALID_ARGUMENT;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    PalettePool pool;
+    int status = pool_build(&pool, search);
+    if (status != SUCCESS) return status;
+
+    PaletteDraw draw;
+    draw_init(&draw, search->seed, pool.count);
+    ScoreFn score = score_kernel();
+
+    int size = search->size;
+    int32_t indices[PALETTE_MAX_SIZE][LANES];
+    int32_t best[PALETTE_MAX_SIZE];
+    float scores[LANES];
+    result->score = -FLT_MAX;
+
+    // Ties keep the earliest palette, so the result does not depend on
+    // the kernel
+    while (result->scored < search->candidates) {
+        score(&pool, &draw, size, search->min_contrast, indices, scores);
+        result->scored += LANES;
+
+        for (int lane = 0; lane < LANES; lane++) {
+            if (scores[lane] > result->score) {
+                result->score = scores[lane];
+                for (int i = 0; i < size; i++) best[i] = indices[i][lane];
+            }
+        }
+    }
+
+    sort_lightness = pool.lab.c[0];
+    qsort(best, (size_t)size, sizeof(int32_t), compare_lightness);
+
+    const float *L = pool.lab.c[0], *A = pool.lab.c[1], *B = pool.lab.c[2];
+    result->min_distance = FLT_MAX;
+    result->min_contrast = FLT_MAX;
+    for (int i = 0; i < size; i++) {
+        int32_t p = best[i];
+        memcpy(result->rgb[i], pool.rgb + 3 * (size_t)p, 3);
+        result->min_contrast = fminf(result->min_contrast, pool.contrast[p]);
+
+        for (int j = 0; j < i; j++) {
+            int32_t q = best[j];
+            float dl = L[p] - L[q], da = A[p] - A[q], db = B[p] - B[q];
+            result->min_distance = fminf(result->min_distance, sqrtf(dl * dl + da * da + db * db));
+        }
+    }
+
+    pool_free(&pool);
+    result->seconds = seconds_since(&start);
+    return SUCCESS;
+}
@@ -0,0 +1,16 @@
+#ifndef DEVTOOLS_FILE_ANALYZER_H
+#define DEVTOOLS_FILE_ANALYZER_H
+
+#include "../../config.h"
+
+// Tool entry points
+int file_analyzer_execute(int argc, char *argv[]);
+void file_analyzer_help(void);
+
+// Analysis functions (jobs <= 0 uses one worker per online CPU)
+FileAnalysis* analyze_files(char **files, int count, int jobs);
+void merge_analysis(FileAnalysis *dest, const FileAnalysis *src);
+void free_analysis(FileAnalysis *analysis);
+void print_analysis(const FileAnalysis *analysis);
+
+#endif // DEVTOOLS_FILE_ANALYZER_H
@@ -0,0 +1,178 @@
+#include "file_type_index.h"
+#include "../../common/memory.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define INDEX_INITIAL_CAPACITY 64
+#define STRING_BLOCK_SIZE 4096
+
+// Interned extension strings live in a chain of blocks freed together
+struct FileTypeStringBlock {
+    struct FileTypeStringBlock *next;
+    size_t used;
+    size_t size;
+    char data[];
+};
+
+// FNV-1a
+static uint32_t hash_extension(const char *ext, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)ext[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static const char* intern_string(FileTypeIndex *index, const char *str, size_t length) {
+    struct FileTypeStringBlock *block = index->strings;
+
+    if (!block || block->size - block->used < length + 1) {
+        size_t size = length + 1 > STRING_BLOCK_SIZE ? length + 1 : STRING_BLOCK_SIZE;
+        block = MALLOC(sizeof(struct FileTypeStringBlock) + size);
+        if (!block) return NULL;
+
+        block->next = index->strings;
+        block->used = 0;
+        block->size = size;
+        index->strings = block;
+    }
+
+    char *copy = block->data + block->used;
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+    block->used += length + 1;
+
+    return copy;
+}
+
+static bool grow_index(FileTypeIndex *index) {
+    size_t new_capacity = index->capacity ? index->capacity * 2 : INDEX_INITIAL_CAPACITY;
+    FileTypeEntry *slots = MALLOC(new_capacity * sizeof(FileTypeEntry));
+    if (!slots) return false;
+    memset(slots, 0, new_capacity * sizeof(FileTypeEntry));
+
+    // Reinsert using the stored hashes; names are interned, so no copies
+    for (size_t i = 0; i < index->capacity; i++) {
+        FileTypeEntry *entry = &index->slots[i];
+        if (!entry->name) continue;
+
+        size_t slot = entry->hash & (new_capacity - 1);
+        while (slots[slot].name) {
+            slot = (slot + 1) & (new_capacity - 1);
+        }
+        slots[slot] = *entry;
+    }
+
+    FREE(index->slots);
+    index->slots = slots;
+    index->capacity = new_capacity;
+    return true;
+}
+
+// Linear probe for an extension; returns the matching or first empty slot
+static FileTypeEntry* find_slot(const FileTypeIndex *index, const char *ext,
+                                size_t length, uint32_t hash) {
+    size_t mask = index->capacity - 1;
+    size_t slot = hash & mask;
+
+    for (;;) {
+        FileTypeEntry *entry = &index->slots[slot];
+        if (!entry->name) {
+            return entry;
+        }
+        if (entry->hash == hash && entry->length == length &&
+            memcmp(entry->name, ext, length) == 0) {
+            return entry;
+        }
+        slot = (slot + 1) & mask;
+    }
+}
+
+void file_type_index_init(FileTypeIndex *index) {
+    memset(index, 0, sizeof(FileTypeIndex));
+}
+
+void file_type_index_free(FileTypeIndex *index) {
+    if (!index) return;
+
+    struct FileTypeStringBlock *block = index->strings;
+    while (block) {
+        struct FileTypeStringBlock *next = block->next;
+        FREE(block);
+        block = next;
+    }
+
+    FREE(index->slots);
+    file_type_index_init(index);
+}
+
+bool file_type_index_add(FileTypeIndex *index, const char *ext, size_t length, size_t count) {
+    // Keep the load factor under 70% so probe sequences stay short
+    if ((index->count + 1) * 10 > index->capacity * 7) {
+        if (!grow_index(index)) return false;
+    }
+
+    uint32_t hash = hash_extension(ext, length);
+    FileTypeEntry *entry = find_slot(index, ext, length, hash);
+
+    if (!entry->name) {
+        const char *name = intern_string(index, ext, length);
+        if (!name) return false;
+
+        entry->name = name;
+        entry->length = (uint32_t)length;
+        entry->hash = hash;
+        entry->count = 0;
+        index->count++;
+    }
+
+    entry->count += count;
+    return true;
+}
+
+size_t file_type_index_lookup(const FileTypeIndex *index, const char *ext) {
+    if (index->count == 0) return 0;
+
+    size_t length = strlen(ext);
+    const FileTypeEntry *entry = find_slot(index, ext, length, hash_extension(ext, length));
+    return entry->name ? entry->count : 0;
+}
+
+bool file_type_index_merge(FileTypeIndex *dest, const FileTypeIndex *src) {
+    for (size_t i = 0; i < src->capacity; i++) {
+        const FileTypeEntry *entry = &src->slots[i];
+        if (!entry->name) continue;
+
+        if (!file_type_index_add(dest, entry->name, entry->length, entry->count)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int compare_entries(const void *a, const void *b) {
+    const FileTypeEntry *ea = (const FileTypeEntry*)a;
+    const FileTypeEntry *eb = (const FileTypeEntry*)b;
+
+    if (ea->count != eb->count) {
+        return ea->count < eb->count ? 1 : -1;
+    }
+    return strcmp(ea->name, eb->name);
+}
+
+FileTypeEntry* file_type_index_sorted(const FileTypeIndex *index) {
+    FileTypeEntry *entries = MALLOC((index->count + 1) * sizeof(FileTypeEntry));
+    if (!entries) return NULL;
+
+    size_t n = 0;
+    for (size_t i = 0; i < index->capacity; i++) {
+        if (index->slots[i].name) {
+            entries[n++] = index->slots[i];
+        }
+    }
+
+    qsort(entries, n, sizeof(FileTypeEntry), compare_entries);
+    return entries;
+}
@@ -0,0 +1,18 @@
+#ifndef DEVTOOLS_FILE_TYPE_INDEX_H
+#define DEVTOOLS_FILE_TYPE_INDEX_H
+
+#include "../../config.h"
+
+// Lifecycle
+void file_type_index_init(FileTypeIndex *index);
+void file_type_index_free(FileTypeIndex *index);
+
+// Add `count` occurrences of an extension (interned on first sight)
+bool file_type_index_add(FileTypeIndex *index, const char *ext, size_t length, size_t count);
+size_t file_type_index_lookup(const FileTypeIndex *index, const char *ext);
+bool file_type_index_merge(FileTypeIndex *dest, const FileTypeIndex *src);
+
+// Copy of the occupied entries sorted by descending count (caller frees)
+FileTypeEntry* file_type_index_sorted(const FileTypeIndex *index);
+
+#endif // DEVTOOLS_FILE_TYPE_INDEX_H
@@ -0,0 +1,175 @@
+#include "hash_generator.h"
+#include "../../common/memory.h"
+#include "../../common/record_table.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define CACHE_MAGIC "DTHCACHE"
+#define CACHE_VERSION 2
+
+// Files modified this close to the start of the run are not cached: a
+// second write within the same timestamp tick would go unnoticed
+#define CACHE_RACY_SECONDS 2
+
+// Raw digest sizes and their offsets inside a record
+static const unsigned int digest_size[HASH_TYPE_COUNT] = { 16, 20, 32, 64 };
+static const unsigned int digest_offset[HASH_TYPE_COUNT] = { 0, 16, 36, 68 };
+#define CACHE_DIGEST_BYTES 132
+
+// Records are keyed by (dev, ino); size and mtime tell whether the digests
+// still describe the file
+typedef struct {
+    RecordHead head;
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtime_ns;
+    uint32_t types;         // valid digests
+    uint32_t reserved;
+    unsigned char digests[CACHE_DIGEST_BYTES];
+} CacheRecord;
+
+typedef struct {
+    uint64_t dev;
+    uint64_t ino;
+} CacheKey;
+
+struct HashCache {
+    RecordTable table;
+    time_t racy_cutoff;
+    size_t hits;
+    size_t misses;
+    pthread_mutex_t lock;
+};
+
+static int64_t stat_mtime_ns(const struct stat *st) {
+#ifdef __APPLE__
+    return (int64_t)st->st_mtimespec.tv_sec * 1000000000 + st->st_mtimespec.tv_nsec;
+#else
+    return (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+#endif
+}
+
+static uint64_t key_hash(const CacheKey *key) {
+    return record_table_mix(key->ino ^ (key->dev * 0x9E3779B97F4A7C15ull));
+}
+
+static bool record_matches(const void *record, const void *key) {
+    const CacheRecord *r = (const CacheRecord*)record;
+    const CacheKey *k = (const CacheKey*)key;
+    return r->dev == k->dev && r->ino == k->ino;
+}
+
+HashCache* hash_cache_open(const char *path) {
+    HashCache *cache = MALLOC(sizeof(HashCache));
+    if (!cache) return NULL;
+    memset(cache, 0, sizeof(HashCache));
+
+    if (!record_table_open(&cache->table, path, "hash cache", CACHE_MAGIC, CACHE_VERSION,
+                           sizeof(CacheRecord))) {
+        FREE(cache);
+        return NULL;
+    }
+
+    cache->racy_cutoff = time(NULL) - CACHE_RACY_SECONDS;
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+// Only a run that looked files up counts as a generation
+static void cache_end_run(HashCache *cache) {
+    if (cache->hits + cache->misses > 0) record_table_end_run(&cache->table);
+}
+
+void hash_cache_close(HashCache *cache) {
+    if (!cache) return;
+
+    cache_end_run(cache);
+    record_table_close(&cache->table);
+    pthread_mutex_destroy(&cache->lock);
+    FREE(cache);
+}
+
+bool hash_cache_lookup(HashCache *cache, const struct stat *st, unsigned int types,
+                       HashResult *result) {
+    CacheKey key = { (uint64_t)st->st_dev, (uint64_t)st->st_ino };
+    bool hit = false;
+
+    pthread_mutex_lock(&cache->lock);
+
+    CacheRecord *record = record_table_find(&cache->table, key_hash(&key), record_matches, &key);
+    if (record->head.used &&
+        record->size == (uint64_t)st->st_size &&
+        record->mtime_ns == stat_mtime_ns(st) &&
+        (record->types & types) == types) {
+        result->types = types;
+        result->bytes = record->size;
+        for (int t = 0; t < HASH_TYPE_COUNT; t++) {
+            result->length[t] = 0;
+            if (!(types & HASH_MASK(t))) continue;
+
+            memcpy(result->digest[t], record->digests + digest_offset[t], digest_size[t]);
+            result->length[t] = digest_size[t];
+        }
+        record->head.generation = cache->table.generation;
+        hit = true;
+    }
+
+    if (hit) {
+        cache->hits++;
+    } else {
+        cache->misses++;
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+    return hit;
+}
+
+void hash_cache_store(HashCache *cache, const struct stat *st, const HashResult *result) {
+    // Skip files that might still change within the same mtime tick
+    if (st->st_mtime >= cache->racy_cutoff) return;
+
+    CacheKey key = { (uint64_t)st->st_dev, (uint64_t)st->st_ino };
+
+    pthread_mutex_lock(&cache->lock);
+
+    CacheRecord *record = record_table_insert(&cache->table, key_hash(&key), record_matches, &key);
+    if (!record) {
+        pthread_mutex_unlock(&cache->lock);
+        return;
+    }
+
+    if (record->types == 0 || record->size != (uint64_t)st->st_size ||
+        record->mtime_ns != stat_mtime_ns(st)) {
+        // New file or a changed one: previous digests no longer apply
+        record->dev = key.dev;
+        record->ino = key.ino;
+        record->size = (uint64_t)st->st_size;
+        record->mtime_ns = stat_mtime_ns(st);
+        record->types = 0;
+    }
+
+    for (int t = 0; t < HASH_TYPE_COUNT; t++) {
+        if (!(result->types & HASH_MASK(t))) continue;
+        memcpy(record->digests + digest_offset[t], result->digest[t], digest_size[t]);
+    }
+    record->head.generation = cache->table.generation;
+    record->types |= result->types;
+
+    pthread_mutex_unlock(&cache->lock);
+}
+
+int hash_cache_compact(HashCache *cache, unsigned int max_age) {
+    pthread_mutex_lock(&cache->lock);
+    cache_end_run(cache);
+    int status = record_table_compact(&cache->table, max_age);
+    pthread_mutex_unlock(&cache->lock);
+    return status;
+}
+
+void hash_cache_stats(const HashCache *cache, size_t *hits, size_t *misses) {
+    *hits = cache->hits;
+    *misses = cache->misses;
+}
@@ -0,0 +1,204 @@
+#include "hash_generator.h"
+#include "../../common/memory.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <openssl/evp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static const EVP_MD* hash_algorithm(HashType type) {
+    switch (type) {
+        case HASH_MD5:    return EVP_md5();
+        case HASH_SHA1:   return EVP_sha1();
+        case HASH_SHA256: return EVP_sha256();
+        case HASH_SHA512: return EVP_sha512();
+    }
+    return NULL;
+}
+
+const char* hash_type_name(HashType type) {
+    switch (type) {
+        case HASH_MD5:    return "md5";
+        case HASH_SHA1:   return "sha1";
+        case HASH_SHA256: return "sha256";
+        case HASH_SHA512: return "sha512";
+    }
+    return "unknown";
+}
+
+bool hash_engine_init(HashEngine *engine, unsigned int types) {
+    memset(engine, 0, sizeof(HashEngine));
+    engine->types = types;
+
+    for (int t = 0; t < HASH_TYPE_COUNT; t++) {
+        if (!(types & HASH_MASK(t))) continue;
+
+        engine->contexts[t] = EVP_MD_CTX_new();
+        if (!engine->contexts[t]) {
+            hash_engine_free(engine);
+            return false;
+        }
+    }
+
+    if (!hash_engine_reset(engine)) {
+        hash_engine_free(engine);
+        return false;
+    }
+    return true;
+}
+
+// Contexts are reused across files; only their state is reinitialized
+bool hash_engine_reset(HashEngine *engine) {
+    for (int t = 0; t < HASH_TYPE_COUNT; t++) {
+        if (!engine->contexts[t]) continue;
+
+        if (EVP_DigestInit_ex(engine->contexts[t], hash_algorithm((HashType)t), NULL) != 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void hash_engine_update(HashEngine *engine, const void *data, size_t length) {
+    for (int t = 0; t < HASH_TYPE_COUNT; t++) {
+        if (engine->contexts[t]) {
+            EVP_DigestUpdate(engine->contexts[t], data, length);
+        }
+    }
+}
+
+void hash_engine_final(HashEngine *engine, HashResult *result) {
+    result->types = engine->types;
+
+    for (int t = 0; t < HASH_TYPE_COUNT; t++) {
+        result->length[t] = 0;
+        if (engine->contexts[t]) {
+            EVP_DigestFinal_ex(engine->contexts[t], result->digest[t], &result->length[t]);
+        }
+    }
+}
+
+void hash_engine_free(HashEngine *engine) {
+    for (int t = 0; t < HASH_TYPE_COUNT; t++) {
+        if (engine->contexts[t]) {
+            EVP_MD_CTX_free(engine->contexts[t]);
+            engine->contexts[t] = NULL;
+        }
+    }
+}
+
+static int errno_to_error(int err) {
+    switch (err) {
+        case ENOENT: return ERROR_FILE_NOT_FOUND;
+        case EACCES:
+        case EPERM:  return ERROR_PERMISSION_DENIED;
+        case ENOMEM: return ERROR_MEMORY_ALLOCATION;
+        default:     return ERROR_UNKNOWN;
+    }
+}
+
+int hash_file(HashEngine *engine, const char *filename, void *buffer,
+              size_t buffer_size, HashResult *result) {
+    bool from_stdin = strcmp(filename, "-") == 0;
+    int fd = from_stdin ? STDIN_FILENO : open(filename, O_RDONLY);
+    if (fd < 0) {
+        return errno_to_error(errno);
+    }
+
+    // Page-aligned buffer keeps reads on the kernel's fast copy path
+    void *owned = NULL;
+    if (!buffer) {
+        buffer_size = HASH_READ_BUFFER_SIZE;
+        if (posix_memalign(&owned, 4096, buffer_size) != 0) {
+            if (!from_stdin) close(fd);
+            return ERROR_MEMORY_ALLOCATION;
+        }
+        buffer = owned;
+    }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    if (!from_stdin) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#endif
+
+    int status = SUCCESS;
+    if (!hash_engine_reset(engine)) {
+        status = ERROR_UNKNOWN;
+    }
+
+    result->bytes = 0;
+    while (status == SUCCESS) {
+        ssize_t n = read(fd, buffer, buffer_size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            status = errno_to_error(errno);
+            break;
+        }
+        if (n == 0) break;
+
+        // Every requested digest consumes the same bytes while they are hot
+        hash_engine_update(engine, buffer, (size_t)n);
+        result->bytes += (uint64_t)n;
+    }
+
+    if (status == SUCCESS) {
+        hash_engine_final(engine, result);
+    }
+
+    if (!from_stdin) close(fd);
+    free(owned);
+    return status;
+}
+
+int calculate_hash(const char *filename, HashType type, char *output) {
+    HashEngine engine;
+    HashResult result;
+
+    if (!hash_engine_init(&engine, HASH_MASK(type))) {
+        return ERROR_MEMORY_ALLOCATION;
+    }
+
+    int status = hash_file(&engine, filename, NULL, 0, &result);
+    if (status == SUCCESS) {
+        hash_result_hex(&result, type, output);
+    }
+
+    hash_engine_free(&engine);
+    return status;
+}
+
+void hash_result_hex(const HashResult *result, HashType type, char *output) {
+    static const char hex[] = "0123456789abcdef";
+
+    for (unsigned int i = 0; i < result->length[type]; i++) {
+        output[i * 2] = hex[result->digest[type][i] >> 4];
+        output[i * 2 + 1] = hex[result->digest[type][i] & 0x0f];
+    }
+    output[result->length[type] * 2] = '\0';
+}
+
+// One line per file. A single digest uses the sha256sum-compatible
+// "<hex>  <file>" form; several digests are tagged by algorithm.
+void print_manifest_line(FILE *out, const char *filename, const HashResult *result) {
+    char hex[SHA512_DIGEST_LENGTH + 1];
+    int requested = 0;
+
+    for (int t = 0; t < HASH_TYPE_COUNT; t++) {
+        if (result->types & HASH_MASK(t)) requested++;
+    }
+
+    for (int t = 0; t < HASH_TYPE_COUNT; t++) {
+        if (!(result->types & HASH_MASK(t))) continue;
+
+        hash_result_hex(result, (HashType)t, hex);
+        if (requested > 1) {
+            fprintf(out, "%s:%s ", hash_type_name((HashType)t), hex);
+        } else {
+            fprintf(out, "%s ", hex);
+        }
+    }
+    fprintf(out, " %s\n", filename);
+}
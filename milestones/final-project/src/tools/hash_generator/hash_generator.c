@@ -0,0 +1,396 @@
+#include "hash_generator.h"
+#include "../../common/error.h"
+#include "../../common/logging.h"
+#include "../../common/memory.h"
+#include "../../common/ordered_pool.h"
+#include "../../common/work_queue.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Per-run state for parallel hashing. Workers own an engine and a read
+// buffer each; results land in a ring of `window` slots that doubles as
+// the reorder buffer, so output stays in command-line order.
+typedef struct {
+    char **files;
+    HashEngine *engines;
+    void **buffers;
+    HashResult *results;
+    int *status;
+    bool *cached;               // answered from the cache, not read
+    size_t window;
+    HashCache *cache;
+    uint64_t total_bytes;
+    size_t hashed_files;
+    uint64_t cached_bytes;
+    size_t cached_files;
+    int result;
+} HashRun;
+
+static void hash_work(size_t index, int worker, void *ctx) {
+    HashRun *run = (HashRun*)ctx;
+    size_t slot = index % run->window;
+    const char *filename = run->files[index];
+    HashResult *result = &run->results[slot];
+
+    // Unchanged files are answered from the cache without being read. The
+    // stat is taken before reading, so a file modified mid-read is stored
+    // under its old mtime and simply misses next time.
+    struct stat st;
+    bool cacheable = run->cache && strcmp(filename, "-") != 0 &&
+                     stat(filename, &st) == 0 && S_ISREG(st.st_mode);
+
+    run->cached[slot] = cacheable &&
+                        hash_cache_lookup(run->cache, &st, run->engines[worker].types, result);
+    if (run->cached[slot]) {
+        run->status[slot] = SUCCESS;
+        return;
+    }
+
+    run->status[slot] = hash_file(&run->engines[worker], filename,
+                                  run->buffers[worker], HASH_READ_BUFFER_SIZE, result);
+
+    if (cacheable && run->status[slot] == SUCCESS) {
+        hash_cache_store(run->cache, &st, result);
+    }
+}
+
+static void hash_emit(size_t index, void *ctx) {
+    HashRun *run = (HashRun*)ctx;
+    size_t slot = index % run->window;
+
+    if (run->status[slot] != SUCCESS) {
+        fprintf(stderr, "hash-generate: %s: %s\n", run->files[index],
+                error_string(run->status[slot]));
+        run->result = run->status[slot];
+        return;
+    }
+
+    print_manifest_line(stdout, run->files[index], &run->results[slot]);
+
+    // Throughput counts only bytes that were actually read and hashed
+    if (run->cached[slot]) {
+        run->cached_bytes += run->results[slot].bytes;
+        run->cached_files++;
+    } else {
+        run->total_bytes += run->results[slot].bytes;
+        run->hashed_files++;
+    }
+}
+
+static void free_hash_run(HashRun *run, int jobs) {
+    for (int i = 0; i < jobs; i++) {
+        if (run->engines) hash_engine_free(&run->engines[i]);
+        if (run->buffers) free(run->buffers[i]);
+    }
+    FREE(run->engines);
+    FREE(run->buffers);
+    FREE(run->results);
+    FREE(run->status);
+    FREE(run->cached);
+}
+
+static double elapsed_seconds(const struct timespec *start, const struct timespec *end) {
+    return (double)(end->tv_sec - start->tv_sec) +
+           (double)(end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Hash files on `jobs` threads and print one manifest line per file
+static int hash_files(char **files, int count, unsigned int types, int jobs,
+                      HashCache *cache, bool stats) {
+    if (jobs > count) jobs = count;
+
+    HashRun run;
+    memset(&run, 0, sizeof(run));
+    run.files = files;
+    run.cache = cache;
+    run.window = (size_t)jobs * 4;
+    run.result = SUCCESS;
+
+    run.engines = MALLOC((size_t)jobs * sizeof(HashEngine));
+    run.buffers = MALLOC((size_t)jobs * sizeof(void*));
+    run.results = MALLOC(run.window * sizeof(HashResult));
+    run.status = MALLOC(run.window * sizeof(int));
+    run.cached = MALLOC(run.window * sizeof(bool));
+    if (!run.engines || !run.buffers || !run.results || !run.status || !run.cached) {
+        FREE(run.engines);
+        FREE(run.buffers);
+        FREE(run.results);
+        FREE(run.status);
+        FREE(run.cached);
+        return ERROR_MEMORY_ALLOCATION;
+    }
+    memset(run.engines, 0, (size_t)jobs * sizeof(HashEngine));
+    memset(run.buffers, 0, (size_t)jobs * sizeof(void*));
+
+    for (int i = 0; i < jobs; i++) {
+        if (!hash_engine_init(&run.engines[i], types) ||
+            posix_memalign(&run.buffers[i], 4096, HASH_READ_BUFFER_SIZE) != 0) {
+            LOG_ERROR("Failed to initialize hash engine");
+            free_hash_run(&run, jobs);
+            return ERROR_MEMORY_ALLOCATION;
+        }
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int status = ordered_pool_run((size_t)count, jobs, run.window, hash_work, hash_emit, &run);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (stats) {
+        double elapsed = elapsed_seconds(&start, &end);
+        double mb = (double)run.total_bytes / (1024.0 * 1024.0);
+        if (elapsed <= 0) elapsed = 1e-9;
+
+        fprintf(stderr, "Hashed %zu files (%.2f MB) in %.3f s with %d jobs: "
+                "%.1f files/s, %.2f MB/s\n",
+                run.hashed_files, mb, elapsed, jobs,
+                (double)run.hashed_files / elapsed, mb / elapsed);
+
+        if (cache) {
+            fprintf(stderr, "Answered %zu files (%.2f MB) from the cache without reading them\n",
+                    run.cached_files, (double)run.cached_bytes / (1024.0 * 1024.0));
+
+            size_t hits, misses;
+            hash_cache_stats(cache, &hits, &misses);
+            fprintf(stderr, "Cache: %zu hits, %zu misses (%.1f%% hit rate)\n", hits, misses,
+                    hits + misses ? 100.0 * (double)hits / (double)(hits + misses) : 0.0);
+        }
+    }
+
+    free_hash_run(&run, jobs);
+    return status != SUCCESS ? status : run.result;
+}
+
+// Parse sizes such as "65536", "512K", "4M" or "1G". Zero, signs and
+// values that do not fit in 64 bits are rejected.
+static bool parse_size(const char *text, uint64_t *size) {
+    if (*text < '0' || *text > '9') return false;
+
+    char *end;
+    errno = 0;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (errno == ERANGE) return false;
+
+    unsigned int shift = 0;
+    switch (*end) {
+        case 'k': case 'K': shift = 10; end++; break;
+        case 'm': case 'M': shift = 20; end++; break;
+        case 'g': case 'G': shift = 30; end++; break;
+        default: break;
+    }
+
+    if (*end != '\0' || value == 0 || value > (UINT64_MAX >> shift)) return false;
+    *size = (uint64_t)value << shift;
+    return true;
+}
+
+int hash_generator_execute(int argc, char *argv[]) {
+    unsigned int types = 0;
+    int jobs = 0;
+    bool stats = false;
+    bool tree = false;
+    const char *cache_path = NULL;
+    bool compact_cache = false;
+    unsigned int cache_max_age = HASH_CACHE_DEFAULT_MAX_AGE;
+    TreeHashOptions tree_options = {
+        .chunk_size = TREE_DEFAULT_CHUNK_SIZE
+    };
+
+    static struct option long_options[] = {
+        {"md5", no_argument, 0, 1000},
+        {"sha1", no_argument, 0, 1001},
+        {"sha256", no_argument, 0, 1002},
+        {"sha512", no_argument, 0, 1003},
+        {"all", no_argument, 0, 'a'},
+        {"jobs", required_argument, 0, 'j'},
+        {"stats", no_argument, 0, 's'},
+        {"tree", no_argument, 0, 't'},
+        {"chunk-size", required_argument, 0, 1004},
+        {"print-chunks", no_argument, 0, 1005},
+        {"verify-chunks", required_argument, 0, 1006},
+        {"cache", required_argument, 0, 'c'},
+        {"compact-cache", no_argument, 0, 1007},
+        {"cache-max-age", required_argument, 0, 1008},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    // Reset getopt state left over from global option parsing
+    optind = 0;
+
+    int c;
+    while ((c = getopt_long(argc, argv, "aj:stc:h", long_options, NULL)) != -1) {
+        switch (c) {
+            case 1000: types |= HASH_MASK(HASH_MD5); break;
+            case 1001: types |= HASH_MASK(HASH_SHA1); break;
+            case 1002: types |= HASH_MASK(HASH_SHA256); break;
+            case 1003: types |= HASH_MASK(HASH_SHA512); break;
+
+            case 'a':
+                types = HASH_MASK(HASH_MD5) | HASH_MASK(HASH_SHA1) |
+                        HASH_MASK(HASH_SHA256) | HASH_MASK(HASH_SHA512);
+                break;
+
+            case 'j':
+                jobs = atoi(optarg);
+                if (jobs < 1) {
+                    LOG_ERROR("Invalid job count: %s", optarg);
+                    return ERROR_INVALID_ARGUMENT;
+                }
+                break;
+
+            case 's':
+                stats = true;
+                break;
+
+            case 't':
+                tree = true;
+                break;
+
+            case 1004: // --chunk-size
+                if (!parse_size(optarg, &tree_options.chunk_size)) {
+                    LOG_ERROR("Invalid chunk size: %s", optarg);
+                    return ERROR_INVALID_ARGUMENT;
+                }
+                break;
+
+            case 1005: // --print-chunks
+                tree = true;
+                tree_options.print_chunks = true;
+                break;
+
+            case 1006: // --verify-chunks
+                tree = true;
+                tree_options.verify_manifest = optarg;
+                break;
+
+            case 'c':
+                cache_path = optarg;
+                break;
+
+            case 1007: // --compact-cache
+                compact_cache = true;
+                break;
+
+            case 1008: // --cache-max-age
+                cache_max_age = (unsigned int)strtoul(optarg, NULL, 10);
+                if (cache_max_age == 0) {
+                    LOG_ERROR("Invalid cache age: %s", optarg);
+                    return ERROR_INVALID_ARGUMENT;
+                }
+                break;
+
+            case 'h':
+                hash_generator_help();
+                return SUCCESS;
+
+            default:
+                return ERROR_INVALID_ARGUMENT;
+        }
+    }
+
+    if (types == 0) {
+        types = HASH_MASK(HASH_SHA256);
+    }
+
+    if (compact_cache && !cache_path) {
+        LOG_ERROR("--compact-cache needs --cache FILE");
+        return ERROR_INVALID_ARGUMENT;
+    }
+
+    if (optind >= argc && !compact_cache) {
+        LOG_ERROR("Usage: devtools hash-generate [--md5] [--sha1] [--sha256] [--sha512] <files>");
+        return ERROR_INVALID_ARGUMENT;
+    }
+
+    if (jobs == 0) {
+        jobs = work_pool_default_workers();
+    }
+
+    if (tree) {
+        if (cache_path || compact_cache) {
+            LOG_ERROR("--cache and --compact-cache do not apply to tree mode");
+            return ERROR_INVALID_ARGUMENT;
+        }
+        if (types & (types - 1)) {
+            LOG_ERROR("Tree mode takes a single hash algorithm");
+            return ERROR_INVALID_ARGUMENT;
+        }
+        for (int t = 0; t < HASH_TYPE_COUNT; t++) {
+            if (types & HASH_MASK(t)) tree_options.type = (HashType)t;
+        }
+        tree_options.jobs = jobs;
+
+        LOG_INFO("Tree-hashing %d files with %d jobs", argc - optind, jobs);
+        return tree_hash_files(argv + optind, argc - optind, &tree_options);
+    }
+
+    HashCache *cache = NULL;
+    if (cache_path) {
+        cache = hash_cache_open(cache_path);
+        if (!cache) return ERROR_FILE_NOT_FOUND;
+    }
+
+    int result = SUCCESS;
+    if (optind < argc) {
+        LOG_INFO("Hashing %d files with %d jobs", argc - optind, jobs);
+        result = hash_files(argv + optind, argc - optind, types, jobs, cache,
+                            stats || g_config.verbose);
+    }
+
+    if (compact_cache) {
+        int status = hash_cache_compact(cache, cache_max_age);
+        if (result == SUCCESS) result = status;
+    }
+
+    hash_cache_close(cache);
+    return result;
+}
+
+void hash_generator_help(void) {
+    printf("Hash Generator Tool\n");
+    printf("==================\n");
+    printf("Generates file digests in a single read pass per file,\n");
+    printf("however many algorithms are requested. Files are hashed in\n");
+    printf("parallel and printed in the order they were given.\n");
+    printf("\nOptions:\n");
+    printf("  --md5               MD5 digest\n");
+    printf("  --sha1              SHA-1 digest\n");
+    printf("  --sha256            SHA-256 digest (default)\n");
+    printf("  --sha512            SHA-512 digest\n");
+    printf("  -a, --all           All of the above\n");
+    printf("  -j, --jobs N        Hash files on N threads (default: one per CPU)\n");
+    printf("  -s, --stats         Report files/s and MB/s on stderr\n");
+    printf("\nIncremental cache:\n");
+    printf("  -c, --cache FILE    Reuse digests of files whose device, inode, size\n");
+    printf("                      and mtime are unchanged since an earlier run\n");
+    printf("  --compact-cache     Drop entries unused in the last N runs and shrink\n");
+    printf("                      the cache file (may be run without any files)\n");
+    printf("  --cache-max-age N   Runs an entry survives compaction (default: %d)\n",
+           HASH_CACHE_DEFAULT_MAX_AGE);
+    printf("\nTree mode (single large files):\n");
+    printf("  -t, --tree          Hash fixed-size chunks in parallel and combine\n");
+    printf("                      them into a Merkle root digest\n");
+    printf("  --chunk-size SIZE   Chunk size, e.g. 1M, 4M (default), 64M\n");
+    printf("  --print-chunks      Also list every chunk digest after the root\n");
+    printf("  --verify-chunks F   Compare chunks against a --print-chunks manifest\n");
+    printf("                      (chunk size is taken from the manifest)\n");
+    printf("\nOutput:\n");
+    printf("  One algorithm:   <hex>  <file>          (sha256sum compatible)\n");
+    printf("  Several:         md5:<hex> sha256:<hex>  <file>\n");
+    printf("\nUsage:\n");
+    printf("  devtools hash-generate --sha256 file.zip\n");
+    printf("  devtools hash-generate --md5 --sha1 --sha256 artifacts/*\n");
+    printf("  cat image.iso | devtools hash-generate --sha512 -\n");
+    printf("  devtools hash-generate --cache .hashcache --stats build/*\n");
+    printf("  devtools hash-generate --cache .hashcache --compact-cache\n");
+    printf("  devtools hash-generate --tree --print-chunks disk.img > disk.tree\n");
+    printf("  devtools hash-generate --verify-chunks disk.tree disk.img\n");
+}
@@ -0,0 +1,75 @@
+#ifndef DEVTOOLS_HASH_GENERATOR_H
+#define DEVTOOLS_HASH_GENERATOR_H
+
+#include "../../config.h"
+
+#define HASH_TYPE_COUNT 4
+#define HASH_MASK(type) (1u << (type))
+#define HASH_MAX_RAW_LENGTH 64
+#define HASH_READ_BUFFER_SIZE (1024 * 1024)
+
+// Streaming hash engine: one context per requested HashType, all fed from
+// the same buffer so every digest is computed in a single read pass
+typedef struct {
+    unsigned int types;
+    void *contexts[HASH_TYPE_COUNT];
+} HashEngine;
+
+typedef struct {
+    unsigned int types;
+    unsigned char digest[HASH_TYPE_COUNT][HASH_MAX_RAW_LENGTH];
+    unsigned int length[HASH_TYPE_COUNT];
+    uint64_t bytes;
+} HashResult;
+
+// Chunked tree (Merkle) hashing of single large files
+#define TREE_DEFAULT_CHUNK_SIZE (4ull * 1024 * 1024)
+
+typedef struct {
+    HashType type;
+    uint64_t chunk_size;
+    int jobs;
+    bool print_chunks;
+    const char *verify_manifest;
+} TreeHashOptions;
+
+// Persistent digest cache keyed by (device, inode, size, mtime_ns)
+#define HASH_CACHE_DEFAULT_MAX_AGE 5
+
+struct stat;
+typedef struct HashCache HashCache;
+
+// Tool entry points
+int hash_generator_execute(int argc, char *argv[]);
+void hash_generator_help(void);
+
+// Engine functions
+bool hash_engine_init(HashEngine *engine, unsigned int types);
+bool hash_engine_reset(HashEngine *engine);
+void hash_engine_update(HashEngine *engine, const void *data, size_t length);
+void hash_engine_final(HashEngine *engine, HashResult *result);
+void hash_engine_free(HashEngine *engine);
+
+// File hashing ("-" reads stdin); buffer may be NULL to allocate one
+int hash_file(HashEngine *engine, const char *filename, void *buffer,
+              size_t buffer_size, HashResult *result);
+int calculate_hash(const char *filename, HashType type, char *output);
+
+// Cache functions (lookups and stores are safe from worker threads)
+HashCache* hash_cache_open(const char *path);
+void hash_cache_close(HashCache *cache);
+bool hash_cache_lookup(HashCache *cache, const struct stat *st, unsigned int types,
+                       HashResult *result);
+void hash_cache_store(HashCache *cache, const struct stat *st, const HashResult *result);
+int hash_cache_compact(HashCache *cache, unsigned int max_age);
+void hash_cache_stats(const HashCache *cache, size_t *hits, size_t *misses);
+
+// Tree mode: chunks hashed in parallel, folded into one root digest
+int tree_hash_files(char **files, int count, const TreeHashOptions *options);
+
+// Formatting
+const char* hash_type_name(HashType type);
+void hash_result_hex(const HashResult *result, HashType type, char *output);
+void print_manifest_line(FILE *out, const char *filename, const HashResult *result);
+
+#endif // DEVTOOLS_HASH_GENERATOR_H
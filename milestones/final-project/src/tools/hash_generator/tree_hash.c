@@ -0,0 +1,382 @@
+#include "hash_generator.h"
+#include "../../common/error.h"
+#include "../../common/logging.h"
+#include "../../common/memory.h"
+#include "../../common/ordered_pool.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Domain separation so a leaf can never be confused with an inner node
+#define TREE_LEAF_PREFIX 0x00
+#define TREE_NODE_PREFIX 0x01
+
+typedef struct {
+    unsigned char digest[HASH_MAX_RAW_LENGTH];
+} TreeDigest;
+
+// Shared state while hashing the chunks of one file
+typedef struct {
+    int fd;
+    uint64_t file_size;
+    uint64_t chunk_size;
+    HashType type;
+    HashEngine *engines;
+    void **buffers;
+    TreeDigest *leaves;
+    unsigned int digest_length;
+    int status;
+} TreeRun;
+
+static uint64_t chunk_length(const TreeRun *run, size_t index) {
+    uint64_t offset = (uint64_t)index * run->chunk_size;
+    uint64_t remaining = run->file_size - offset;
+    return remaining < run->chunk_size ? remaining : run->chunk_size;
+}
+
+// Leaf = H(0x00 || chunk). Chunks are read with pread() in buffer-sized
+// pieces so every worker shares one descriptor and a small buffer.
+static void tree_leaf_work(size_t index, int worker, void *ctx) {
+    TreeRun *run = (TreeRun*)ctx;
+    HashEngine *engine = &run->engines[worker];
+    unsigned char prefix = TREE_LEAF_PREFIX;
+
+    hash_engine_reset(engine);
+    hash_engine_update(engine, &prefix, 1);
+
+    uint64_t offset = (uint64_t)index * run->chunk_size;
+    uint64_t remaining = chunk_length(run, index);
+
+    while (remaining > 0) {
+        size_t want = remaining < HASH_READ_BUFFER_SIZE ? (size_t)remaining : HASH_READ_BUFFER_SIZE;
+        ssize_t n = pread(run->fd, run->buffers[worker], want, (off_t)offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            // Truncated underneath us or an I/O error; reported by the emitter
+            __atomic_store_n(&run->status, ERROR_UNKNOWN, __ATOMIC_RELAXED);
+            return;
+        }
+
+        hash_engine_update(engine, run->buffers[worker], (size_t)n);
+        offset += (uint64_t)n;
+        remaining -= (uint64_t)n;
+    }
+
+    HashResult result;
+    hash_engine_final(engine, &result);
+    memcpy(run->leaves[index].digest, result.digest[run->type], result.length[run->type]);
+    __atomic_store_n(&run->digest_length, result.length[run->type], __ATOMIC_RELAXED);
+}
+
+static void tree_leaf_emit(size_t index, void *ctx) {
+    (void)index;
+    (void)ctx;
+}
+
+// Fold levels in place: node = H(0x01 || left || right); an odd node at
+// the end of a level is promoted unchanged
+static void tree_combine(HashEngine *engine, HashType type, TreeDigest *nodes,
+                         size_t count, unsigned int length, unsigned char *root) {
+    unsigned char prefix = TREE_NODE_PREFIX;
+    HashResult result;
+
+    while (count > 1) {
+        size_t parents = 0;
+        for (size_t i = 0; i < count; i += 2) {
+            if (i + 1 == count) {
+                nodes[parents++] = nodes[i];
+                continue;
+            }
+
+            hash_engine_reset(engine);
+            hash_engine_update(engine, &prefix, 1);
+            hash_engine_update(engine, nodes[i].digest, length);
+            hash_engine_update(engine, nodes[i + 1].digest, length);
+            hash_engine_final(engine, &result);
+            memcpy(nodes[parents++].digest, result.digest[type], length);
+        }
+        count = parents;
+    }
+
+    memcpy(root, nodes[0].digest, length);
+}
+
+static void digest_to_hex(const unsigned char *digest, unsigned int length, char *output) {
+    static const char hex[] = "0123456789abcdef";
+
+    for (unsigned int i = 0; i < length; i++) {
+        output[i * 2] = hex[digest[i] >> 4];
+        output[i * 2 + 1] = hex[digest[i] & 0x0f];
+    }
+    output[length * 2] = '\0';
+}
+
+// Chunk digests loaded from an earlier --print-chunks manifest
+typedef struct {
+    char (*chunks)[SHA512_DIGEST_LENGTH + 1];
+    size_t count;
+    uint64_t chunk_size;
+    HashType type;
+} ChunkManifest;
+
+// Algorithm named by "tree-<alg>/" at the start of a manifest root line
+static bool parse_tree_type(const char *line, const char *slash, HashType *type) {
+    const char *name = line + 5;
+    size_t length = (size_t)(slash - name);
+
+    for (int t = 0; t < HASH_TYPE_COUNT; t++) {
+        const char *candidate = hash_type_name((HashType)t);
+        if (strlen(candidate) == length && strncmp(name, candidate, length) == 0) {
+            *type = (HashType)t;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Find "tree-<alg>/<chunk>:<root>  <file>" for this file in a manifest
+// written by --print-chunks and load the chunk digests that follow it
+static int load_chunk_manifest(const char *path, const char *filename, ChunkManifest *manifest) {
+    FILE *file = fopen(path, "r");
+    if (!file) return ERROR_FILE_NOT_FOUND;
+
+    char line[MAX_PATH_LENGTH + 256];
+    bool in_block = false;
+    size_t capacity = 0;
+    char (**chunks)[SHA512_DIGEST_LENGTH + 1] = &manifest->chunks;
+    size_t *chunk_count = &manifest->count;
+
+    *chunks = NULL;
+    *chunk_count = 0;
+
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\n")] = '\0';
+
+        if (strncmp(line, "tree-", 5) == 0) {
+            if (in_block) break;
+
+            char *sep = strstr(line, "  ");
+            char *slash = strchr(line, '/');
+            if (!sep || !slash || slash > sep || strcmp(sep + 2, filename) != 0) {
+                continue;
+            }
+            if (!parse_tree_type(line, slash, &manifest->type)) break;
+            manifest->chunk_size = strtoull(slash + 1, NULL, 10);
+            in_block = true;
+            continue;
+        }
+
+        if (!in_block) continue;
+
+        size_t index;
+        unsigned long long offset, length;
+        char hex[SHA512_DIGEST_LENGTH + 1];
+        if (sscanf(line, " chunk %zu %llu %llu %128s", &index, &offset, &length, hex) != 4 ||
+            index != *chunk_count) {
+            break;
+        }
+
+        if (*chunk_count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            void *grown = REALLOC(*chunks, capacity * sizeof(**chunks));
+            if (!grown) {
+                FREE(*chunks);
+                fclose(file);
+                return ERROR_MEMORY_ALLOCATION;
+            }
+            *chunks = grown;
+        }
+        strcpy((*chunks)[(*chunk_count)++], hex);
+    }
+
+    fclose(file);
+    return in_block ? SUCCESS : ERROR_PARSE_ERROR;
+}
+
+// Compare freshly computed leaves with a previous manifest chunk by chunk;
+// ERROR_UNKNOWN means the file was read fine but some chunks changed
+static int verify_chunks(const ChunkManifest *manifest, const char *filename,
+                         const TreeRun *run, size_t count) {
+    char (*expected)[SHA512_DIGEST_LENGTH + 1] = manifest->chunks;
+    size_t expected_count = manifest->count;
+
+    size_t mismatches = 0;
+    size_t limit = count > expected_count ? count : expected_count;
+    char hex[SHA512_DIGEST_LENGTH + 1];
+
+    for (size_t i = 0; i < limit; i++) {
+        if (i < count && i < expected_count) {
+            digest_to_hex(run->leaves[i].digest, run->digest_length, hex);
+            if (strcmp(hex, expected[i]) == 0) continue;
+        }
+
+        printf("%s: chunk %zu (offset %llu) %s\n", filename, i,
+               (unsigned long long)((uint64_t)i * run->chunk_size),
+               i >= count ? "missing" : i >= expected_count ? "added" : "differs");
+        mismatches++;
+    }
+
+    if (mismatches == 0) {
+        printf("%s: OK (%zu chunks)\n", filename, count);
+    } else {
+        printf("%s: FAILED (%zu of %zu chunks changed)\n", filename, mismatches, limit);
+    }
+
+    return mismatches == 0 ? SUCCESS : ERROR_UNKNOWN;
+}
+
+static int tree_hash_file(const char *filename, const TreeHashOptions *options,
+                          HashEngine *engines, void **buffers, bool *reported) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return errno == ENOENT ? ERROR_FILE_NOT_FOUND : ERROR_PERMISSION_DENIED;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return ERROR_INVALID_ARGUMENT;
+    }
+
+    // Verification reuses the chunk size recorded in the manifest; chunks
+    // hashed with another algorithm could never match, so that is an error
+    // rather than a report of every chunk changed
+    ChunkManifest manifest = { .chunk_size = options->chunk_size, .type = options->type };
+    if (options->verify_manifest) {
+        int status = load_chunk_manifest(options->verify_manifest, filename, &manifest);
+        if (status != SUCCESS || manifest.chunk_size == 0) {
+            fprintf(stderr, "hash-generate: %s: no chunk list in %s\n",
+                    filename, options->verify_manifest);
+            FREE(manifest.chunks);
+            close(fd);
+            *reported = true;
+            return status != SUCCESS ? status : ERROR_PARSE_ERROR;
+        }
+        if (manifest.type != options->type) {
+            fprintf(stderr, "hash-generate: %s: manifest %s uses %s, not %s (rerun with --%s)\n",
+                    filename, options->verify_manifest, hash_type_name(manifest.type),
+                    hash_type_name(options->type), hash_type_name(manifest.type));
+            FREE(manifest.chunks);
+            close(fd);
+            *reported = true;
+            return ERROR_INVALID_ARGUMENT;
+        }
+    }
+
+    TreeRun run;
+    memset(&run, 0, sizeof(run));
+    run.fd = fd;
+    run.file_size = (uint64_t)st.st_size;
+    run.chunk_size = manifest.chunk_size;
+    run.type = options->type;
+    run.engines = engines;
+    run.buffers = buffers;
+    run.status = SUCCESS;
+
+    // An empty file still has one (empty) leaf
+    size_t count = (size_t)((run.file_size + run.chunk_size - 1) / run.chunk_size);
+    if (count == 0) count = 1;
+
+    run.leaves = MALLOC(count * sizeof(TreeDigest));
+    if (!run.leaves) {
+        FREE(manifest.chunks);
+        close(fd);
+        return ERROR_MEMORY_ALLOCATION;
+    }
+
+    int status = ordered_pool_run(count, options->jobs, (size_t)options->jobs * 4,
+                                  tree_leaf_work, tree_leaf_emit, &run);
+    close(fd);
+    if (status == SUCCESS) {
+        status = run.status;
+    }
+    if (status != SUCCESS) {
+        FREE(manifest.chunks);
+        FREE(run.leaves);
+        return status;
+    }
+
+    char hex[SHA512_DIGEST_LENGTH + 1];
+
+    if (options->verify_manifest) {
+        status = verify_chunks(&manifest, filename, &run, count);
+        *reported = status != SUCCESS;
+    } else if (options->print_chunks) {
+        // Chunk lines follow the root line; print them before the leaves
+        // are folded into the tree in place
+        TreeDigest *copy = MALLOC(count * sizeof(TreeDigest));
+        if (!copy) {
+            FREE(run.leaves);
+            return ERROR_MEMORY_ALLOCATION;
+        }
+        memcpy(copy, run.leaves, count * sizeof(TreeDigest));
+
+        unsigned char root[HASH_MAX_RAW_LENGTH];
+        tree_combine(&engines[0], run.type, copy, count, run.digest_length, root);
+        digest_to_hex(root, run.digest_length, hex);
+        printf("tree-%s/%llu:%s  %s\n", hash_type_name(run.type),
+               (unsigned long long)run.chunk_size, hex, filename);
+        FREE(copy);
+
+        for (size_t i = 0; i < count; i++) {
+            digest_to_hex(run.leaves[i].digest, run.digest_length, hex);
+            printf("  chunk %zu %llu %llu %s\n", i,
+                   (unsigned long long)((uint64_t)i * run.chunk_size),
+                   (unsigned long long)chunk_length(&run, i), hex);
+        }
+    } else {
+        unsigned char root[HASH_MAX_RAW_LENGTH];
+        tree_combine(&engines[0], run.type, run.leaves, count, run.digest_length, root);
+        digest_to_hex(root, run.digest_length, hex);
+        printf("tree-%s/%llu:%s  %s\n", hash_type_name(run.type),
+               (unsigned long long)run.chunk_size, hex, filename);
+    }
+
+    FREE(manifest.chunks);
+    FREE(run.leaves);
+    return status;
+}
+
+int tree_hash_files(char **files, int count, const TreeHashOptions *options) {
+    int jobs = options->jobs;
+    HashEngine *engines = MALLOC((size_t)jobs * sizeof(HashEngine));
+    void **buffers = MALLOC((size_t)jobs * sizeof(void*));
+    if (!engines || !buffers) {
+        FREE(engines);
+        FREE(buffers);
+        return ERROR_MEMORY_ALLOCATION;
+    }
+    memset(engines, 0, (size_t)jobs * sizeof(HashEngine));
+    memset(buffers, 0, (size_t)jobs * sizeof(void*));
+
+    int result = SUCCESS;
+    for (int i = 0; i < jobs && result == SUCCESS; i++) {
+        if (!hash_engine_init(&engines[i], HASH_MASK(options->type)) ||
+            posix_memalign(&buffers[i], 4096, HASH_READ_BUFFER_SIZE) != 0) {
+            result = ERROR_MEMORY_ALLOCATION;
+        }
+    }
+
+    for (int i = 0; i < count && result != ERROR_MEMORY_ALLOCATION; i++) {
+        bool reported = false;
+        int status = tree_hash_file(files[i], options, engines, buffers, &reported);
+        if (status != SUCCESS) {
+            if (!reported) {
+                fprintf(stderr, "hash-generate: %s: %s\n", files[i], error_string(status));
+            }
+            result = status;
+        }
+    }
+
+    for (int i = 0; i < jobs; i++) {
+        hash_engine_free(&engines[i]);
+        free(buffers[i]);
+    }
+    FREE(engines);
+    FREE(buffers);
+    return result;
+}
@@ -0,0 +1,443 @@
+#include "json_validator.h"
+#include "../../common/error.h"
+#include "../../common/logging.h"
+#include "../../common/memory.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_ROUNDS 3
+
+static double elapsed_seconds(const struct timespec *start, const struct timespec *end) {
+    return (double)(end->tv_sec - start->tv_sec) +
+           (double)(end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static uint64_t bench_random(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static size_t bench_string(char *out, uint64_t *rng) {
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJ0123456789-_./";
+    size_t length = 4 + bench_random(rng) % 60;
+    size_t n = 0;
+
+    out[n++] = '"';
+    for (size_t i = 0; i < length; i++) {
+        uint64_t r = bench_random(rng);
+        if (r % 97 == 0) {
+            out[n++] = '\\';
+            out[n++] = "n\"\\t"[r % 4];
+        } else {
+            out[n++] = alphabet[r % (sizeof(alphabet) - 1)];
+        }
+    }
+    out[n++] = '"';
+    return n;
+}
+
+// Synthetic corpus: an array of records, alternately pretty-printed and
+// compact, with escaped strings, numbers, literals and nested arrays
+static char* bench_corpus(size_t target, size_t *length) {
+    char *corpus = MALLOC(target + 4096);
+    if (!corpus) return NULL;
+
+    uint64_t rng = 0x9E3779B97F4A7C15ull;
+    size_t n = 0;
+    corpus[n++] = '[';
+
+    for (size_t record = 0; n < target; record++) {
+        bool pretty = record % 2 == 0;
+        const char *indent = pretty ? "\n    " : "";
+        const char *sep = pretty ? ": " : ":";
+
+        if (record > 0) corpus[n++] = ',';
+        n += (size_t)sprintf(corpus + n, "%s{%s\"id\"%s%zu,%s\"name\"%s", pretty ? "\n  " : "",
+                             indent, sep, record, indent, sep);
+        n += bench_string(corpus + n, &rng);
+        n += (size_t)sprintf(corpus + n, ",%s\"score\"%s%.6f,%s\"active\"%s%s,%s\"parent\"%snull,"
+                             "%s\"tags\"%s[", indent, sep,
+                             (double)(bench_random(&rng) % 1000000) / 1000.0 - 500.0,
+                             indent, sep, bench_random(&rng) % 2 ? "true" : "false",
+                             indent, sep, indent, sep);
+        for (int tag = 0; tag < 3; tag++) {
+            if (tag > 0) corpus[n++] = ',';
+            n += bench_string(corpus + n, &rng);
+        }
+        n += (size_t)sprintf(corpus + n, "],%s\"matrix\"%s[[1,2,3],[4,5e10,-6.25]]%s}",
+                             indent, sep, pretty ? "\n  " : "");
+    }
+
+    corpus[n++] = ']';
+    corpus[n++] = '\n';
+    *length = n;
+    return corpus;
+}
+
+// Times the same corpus through every scan level this CPU supports:
+// stage 1 alone (classifying every block) and full validation
+int json_scan_benchmark(size_t megabytes) {
+    size_t length;
+    char *corpus = bench_corpus(megabytes << 20, &length);
+    if (!corpus) return ERROR_MEMORY_ALLOCATION;
+
+    JsonScanLevel best = json_scan_level();
+    size_t blocks = length / JSON_SCAN_BLOCK;
+    double scalar_rate = 0;
+    int status = SUCCESS;
+
+    printf("JSON scan benchmark\n");
+    printf("===================\n");
+    printf("Corpus: %.1f MB synthetic JSON, best of %d rounds\n\n",
+           (double)length / (1024.0 * 1024.0), BENCH_ROUNDS);
+    printf("  %-8s %16s %16s\n", "level", "stage 1", "validate");
+
+    for (int level = 0; level < JSON_SCAN_LEVEL_COUNT; level++) {
+        if (!json_scan_set_level((JsonScanLevel)level)) {
+            printf("  %-8s %16s\n", json_scan_level_name((JsonScanLevel)level), "not supported");
+            continue;
+        }
+
+        JsonClassifyFn classify = json_scan_kernel();
+        if (!classify) classify = json_classify_scalar;
+
+        double classify_time = 0, validate_time = 0;
+        uint64_t structural = 0;
+        bool mismatch = false;
+
+        for (int round = 0; round < BENCH_ROUNDS; round++) {
+            struct timespec start, end;
+            JsonBlockMasks masks, reference;
+
+            structural = 0;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (size_t b = 0; b < blocks; b++) {
+                classify((const unsigned char*)corpus + b * JSON_SCAN_BLOCK, &masks);
+                structural += (uint64_t)__builtin_popcountll(masks.structural);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            double t = elapsed_seconds(&start, &end);
+            if (round == 0 || t < classify_time) classify_time = t;
+
+            // Cross-check the kernel against the reference once
+            if (round == 0 && classify != json_classify_scalar) {
+                for (size_t b = 0; b < blocks && !mismatch; b++) {
+                    const unsigned char *block = (const unsigned char*)corpus + b * JSON_SCAN_BLOCK;
+                    classify(block, &masks);
+                    json_classify_scalar(block, &reference);
+                    mismatch = memcmp(&masks, &reference, sizeof(masks)) != 0;
+                }
+            }
+
+            JsonTokenizer tokenizer;
+            json_tokenizer_open_memory(&tokenizer, corpus, length);
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            JsonValidationResult result = validate_json_document(&tokenizer, NULL);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            json_tokenizer_close(&tokenizer);
+
+            if (!result.valid) {
+                LOG_ERROR("Benchmark corpus rejected at %d:%d: %s", result.line_number,
+                          result.column, result.error_message);
+                status = ERROR_PARSE_ERROR;
+            }
+
+            t = elapsed_seconds(&start, &end);
+            if (round == 0 || t < validate_time) validate_time = t;
+        }
+
+        if (classify_time <= 0) classify_time = 1e-9;
+        if (validate_time <= 0) validate_time = 1e-9;
+        double rate = (double)length / validate_time / 1e9;
+        if (level == JSON_SCAN_SCALAR) scalar_rate = rate;
+
+        printf("  %-8s %11.2f GB/s %11.2f GB/s", json_scan_level_name((JsonScanLevel)level),
+               (double)(blocks * JSON_SCAN_BLOCK) / classify_time / 1e9, rate);
+        if (level != JSON_SCAN_SCALAR && scalar_rate > 0) {
+            printf("  %.2fx", rate / scalar_rate);
+        }
+        printf("%s\n", mismatch ? "  MASK MISMATCH" : "");
+        if (mismatch) status = ERROR_UNKNOWN;
+    }
+
+    json_scan_set_level(best);
+    FREE(corpus);
+    return status;
+}
+
+// ---------------------------------------------------------------------
+// DOM memory benchmark
+// ---------------------------------------------------------------------
+
+// Baseline DOM with one heap allocation per node, its text and its child
+// array: what pretty-printing would cost without the tape
+typedef struct MallocNode {
+    JsonTokenType type;
+    char *text;
+    size_t length;
+    struct MallocNode **children;
+    size_t child_count;
+    size_t child_capacity;
+} MallocNode;
+
+typedef struct {
+    double seconds;
+    size_t allocations;
+    int status;
+} DomBenchResult;
+
+static MallocNode* malloc_node(const JsonToken *token, size_t *allocations) {
+    MallocNode *node = calloc(1, sizeof(MallocNode));
+    if (!node) return NULL;
+    (*allocations)++;
+
+    node->type = token->type;
+    if (token->type != JSON_OBJECT_START && token->type != JSON_ARRAY_START) {
+        node->text = malloc(token->length);
+        if (!node->text) return node;
+        (*allocations)++;
+        memcpy(node->text, token->start, token->length);
+        node->length = token->length;
+    }
+    return node;
+}
+
+static bool add_child(MallocNode *parent, MallocNode *child, size_t *allocations) {
+    if (parent->child_count == parent->child_capacity) {
+        size_t capacity = parent->child_capacity ? parent->child_capacity * 2 : 4;
+        MallocNode **grown = realloc(parent->children, capacity * sizeof(*grown));
+        if (!grown) return false;
+        (*allocations)++;
+        parent->children = grown;
+        parent->child_capacity = capacity;
+    }
+    parent->children[parent->child_count++] = child;
+    return true;
+}
+
+static void free_malloc_tree(MallocNode *node) {
+    for (size_t i = 0; i < node->child_count; i++) {
+        free_malloc_tree(node->children[i]);
+    }
+    free(node->children);
+    free(node->text);
+    free(node);
+}
+
+static void print_malloc_tree(FILE *out, const MallocNode *node, int depth) {
+    if (node->type != JSON_OBJECT_START && node->type != JSON_ARRAY_START) {
+        fwrite(node->text, 1, node->length, out);
+        return;
+    }
+
+    bool is_object = node->type == JSON_OBJECT_START;
+    if (node->child_count == 0) {
+        fputs(is_object ? "{}" : "[]", out);
+        return;
+    }
+
+    fputc(is_object ? '{' : '[', out);
+    for (size_t i = 0; i < node->child_count; i++) {
+        bool key = is_object && i % 2 == 0;
+        if (!is_object || key) {
+            fprintf(out, "%s\n%*s", i > 0 ? "," : "", (depth + 1) * JSON_PRETTY_INDENT, "");
+        } else {
+            fputs(": ", out);
+        }
+        print_malloc_tree(out, node->children[i], depth + 1);
+    }
+    fprintf(out, "\n%*s%c", depth * JSON_PRETTY_INDENT, "", is_object ? '}' : ']');
+}
+
+static void bench_malloc_dom(const char *corpus, size_t length, FILE *out,
+                             DomBenchResult *result) {
+    MallocNode *stack[JSON_MAX_DEPTH + 1];
+    MallocNode *root = NULL;
+    int depth = 0;
+    JsonTokenizer tokenizer;
+    JsonToken token;
+
+    json_tokenizer_open_memory(&tokenizer, corpus, length);
+    while (json_next_token(&tokenizer, &token) != JSON_EOF) {
+        if (token.type == JSON_ERROR) {
+            result->status = ERROR_PARSE_ERROR;
+            break;
+        }
+        if (token.type == JSON_COMMA || token.type == JSON_COLON) continue;
+
+        if (token.type == JSON_OBJECT_END || token.type == JSON_ARRAY_END) {
+            depth--;
+            continue;
+        }
+
+        MallocNode *node = malloc_node(&token, &result->allocations);
+        if (!node) {
+            result->status = ERROR_MEMORY_ALLOCATION;
+            break;
+        }
+
+        if (depth == 0) {
+            root = node;
+        } else if (!add_child(stack[depth - 1], node, &result->allocations)) {
+            result->status = ERROR_MEMORY_ALLOCATION;
+            break;
+        }
+
+        if (token.type == JSON_OBJECT_START || token.type == JSON_ARRAY_START) {
+            stack[depth++] = node;
+        }
+    }
+    json_tokenizer_close(&tokenizer);
+
+    if (root) {
+        if (result->status == SUCCESS) {
+            print_malloc_tree(out, root, 0);
+            fputc('\n', out);
+        }
+        free_malloc_tree(root);
+    }
+}
+
+static void bench_tape_dom(const char *corpus, size_t length, FILE *out,
+                           DomBenchResult *result) {
+    JsonTokenizer tokenizer;
+    JsonTape *tape = malloc(sizeof(JsonTape));
+    if (!tape) {
+        result->status = ERROR_MEMORY_ALLOCATION;
+        return;
+    }
+
+    json_tokenizer_open_memory(&tokenizer, corpus, length);
+    json_tape_init(tape);
+
+    JsonValidationResult validation = validate_json_document(&tokenizer, tape);
+    if (validation.valid) {
+        JsonPrinter printer;
+        json_printer_init(&printer, out);
+        json_printer_print(&printer, tape);
+        json_printer_free(&printer);
+    } else {
+        result->status = ERROR_PARSE_ERROR;
+    }
+
+    // Tape struct, arena blocks and the printer's one output buffer
+    result->allocations = 2 + tape->arena.blocks;
+    json_tape_free(tape);
+    free(tape);
+    json_tokenizer_close(&tokenizer);
+}
+
+static void bench_validate_only(const char *corpus, size_t length, FILE *out,
+                                DomBenchResult *result) {
+    (void)out;
+    JsonTokenizer tokenizer;
+    json_tokenizer_open_memory(&tokenizer, corpus, length);
+    JsonValidationResult validation = validate_json_document(&tokenizer, NULL);
+    json_tokenizer_close(&tokenizer);
+    if (!validation.valid) result->status = ERROR_PARSE_ERROR;
+}
+
+typedef void (*DomBenchFn)(const char *corpus, size_t length, FILE *out,
+                           DomBenchResult *result);
+
+// Runs one variant in a child process so its peak RSS is measured on its
+// own (ru_maxrss of the waited-for child). The corpus is inherited, so it
+// counts towards every variant alike.
+static bool run_dom_variant(DomBenchFn fn, const char *corpus, size_t length,
+                            DomBenchResult *result, long *peak_kb) {
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+
+    if (pid == 0) {
+        DomBenchResult child = { .status = SUCCESS };
+        FILE *out = fopen("/dev/null", "w");
+        struct timespec start, end;
+
+        close(fds[0]);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        fn(corpus, length, out ? out : stdout, &child);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        child.seconds = elapsed_seconds(&start, &end);
+        if (out) fclose(out);
+
+        ssize_t written = write(fds[1], &child, sizeof(child));
+        _exit(written == (ssize_t)sizeof(child) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    ssize_t n = read(fds[0], result, sizeof(*result));
+    close(fds[0]);
+
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) != pid || n != (ssize_t)sizeof(*result)) {
+        return false;
+    }
+    *peak_kb = usage.ru_maxrss;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Pretty-prints one synthetic document through a malloc-per-node tree and
+// through the arena-backed tape, reporting time, allocations and peak RSS
+int json_dom_benchmark(size_t megabytes) {
+    static const struct {
+        const char *name;
+        DomBenchFn fn;
+    } variants[] = {
+        { "validate only", bench_validate_only },
+        { "malloc tree", bench_malloc_dom },
+        { "arena tape", bench_tape_dom }
+    };
+
+    size_t length;
+    char *corpus = bench_corpus(megabytes << 20, &length);
+    if (!corpus) return ERROR_MEMORY_ALLOCATION;
+
+    printf("JSON DOM benchmark\n");
+    printf("==================\n");
+    printf("Corpus: %.1f MB synthetic JSON, pretty-printed to /dev/null\n\n",
+           (double)length / (1024.0 * 1024.0));
+    printf("  %-14s %10s %14s %14s\n", "variant", "time", "allocations", "peak RSS");
+
+    int status = SUCCESS;
+    long floor_kb = 0;
+
+    for (size_t i = 0; i < sizeof(variants) / sizeof(variants[0]); i++) {
+        DomBenchResult result = {0};
+        long peak_kb = 0;
+
+        if (!run_dom_variant(variants[i].fn, corpus, length, &result, &peak_kb) ||
+            result.status != SUCCESS) {
+            printf("  %-14s %10s\n", variants[i].name, "failed");
+            status = result.status != SUCCESS ? result.status : ERROR_UNKNOWN;
+            continue;
+        }
+
+        if (i == 0) floor_kb = peak_kb;
+        printf("  %-14s %8.3f s %14zu %11.1f MB", variants[i].name, result.seconds,
+               result.allocations, (double)peak_kb / 1024.0);
+        if (i > 0) {
+            printf("  (+%.1f MB over validation)", (double)(peak_kb - floor_kb) / 1024.0);
+        }
+        printf("\n");
+    }
+
+    FREE(corpus);
+    return status;
+}
@@ -0,0 +1,122 @@
+#include "json_printer.h"
+#include "../../common/memory.h"
+
+#include <string.h>
+
+#define PRINTER_INITIAL_CAPACITY (64 * 1024)
+
+// Per-level flags while walking the tape
+enum {
+    LEVEL_OBJECT = 1 << 0,
+    LEVEL_NONEMPTY = 1 << 1,
+    LEVEL_AFTER_KEY = 1 << 2
+};
+
+static void append(JsonPrinter *p, const char *text, size_t length) {
+    if (p->failed) return;
+
+    if (p->length + length > p->capacity) {
+        size_t capacity = p->capacity ? p->capacity : PRINTER_INITIAL_CAPACITY;
+        while (capacity < p->length + length) {
+            capacity *= 2;
+        }
+
+        char *grown = REALLOC(p->data, capacity);
+        if (!grown) {
+            p->failed = true;
+            return;
+        }
+        p->data = grown;
+        p->capacity = capacity;
+    }
+
+    memcpy(p->data + p->length, text, length);
+    p->length += length;
+}
+
+static void newline(JsonPrinter *p, int depth) {
+    static const char spaces[] = "                                ";
+    size_t width = (size_t)depth * JSON_PRETTY_INDENT;
+
+    append(p, "\n", 1);
+    while (width > 0) {
+        size_t n = width < sizeof(spaces) - 1 ? width : sizeof(spaces) - 1;
+        append(p, spaces, n);
+        width -= n;
+    }
+}
+
+void json_printer_init(JsonPrinter *p, FILE *sink) {
+    memset(p, 0, sizeof(JsonPrinter));
+    p->sink = sink;
+}
+
+void json_printer_free(JsonPrinter *p) {
+    json_printer_flush(p);
+    FREE(p->data);
+    json_printer_init(p, NULL);
+}
+
+void json_printer_reset(JsonPrinter *p) {
+    p->length = 0;
+    p->failed = false;
+}
+
+void json_printer_flush(JsonPrinter *p) {
+    if (p->sink && p->length > 0) {
+        fwrite(p->data, 1, p->length, p->sink);
+        p->length = 0;
+    }
+}
+
+void json_printer_print(JsonPrinter *p, const JsonTape *tape) {
+    unsigned char level[JSON_MAX_DEPTH + 1];
+    int depth = 0;
+
+    level[0] = 0;
+
+    for (size_t i = 0; i < tape->count; i++) {
+        uint64_t entry = json_tape_entry(tape, i);
+        JsonTokenType type = JSON_TAPE_TYPE(entry);
+
+        if (type == JSON_OBJECT_END || type == JSON_ARRAY_END) {
+            newline(p, --depth);
+            append(p, type == JSON_OBJECT_END ? "}" : "]", 1);
+        } else {
+            // Separator in front of a key, array element or object value
+            unsigned char *flags = &level[depth];
+            if (depth > 0) {
+                if (*flags & LEVEL_AFTER_KEY) {
+                    append(p, ": ", 2);
+                    *flags &= (unsigned char)~LEVEL_AFTER_KEY;
+                } else {
+                    if (*flags & LEVEL_NONEMPTY) append(p, ",", 1);
+                    newline(p, depth);
+                    *flags |= LEVEL_NONEMPTY;
+                    if (*flags & LEVEL_OBJECT) *flags |= LEVEL_AFTER_KEY;
+                }
+            }
+
+            if (type == JSON_OBJECT_START || type == JSON_ARRAY_START) {
+                bool object = type == JSON_OBJECT_START;
+                if (JSON_TAPE_PAYLOAD(entry) == i + 1) {
+                    append(p, object ? "{}" : "[]", 2);
+                    i++;
+                } else {
+                    append(p, object ? "{" : "[", 1);
+                    level[++depth] = object ? LEVEL_OBJECT : 0;
+                }
+            } else {
+                size_t length;
+                const char *text = json_tape_text(tape, entry, &length);
+                append(p, text, length);
+            }
+        }
+
+        if (p->sink && p->length >= JSON_PRINTER_FLUSH_SIZE) {
+            json_printer_flush(p);
+        }
+    }
+
+    append(p, "\n", 1);
+}
@@ -0,0 +1,31 @@
+#ifndef DEVTOOLS_JSON_PRINTER_H
+#define DEVTOOLS_JSON_PRINTER_H
+
+#include <stdio.h>
+
+#include "json_tape.h"
+
+#define JSON_PRETTY_INDENT 2
+#define JSON_PRINTER_FLUSH_SIZE (64 * 1024)
+
+// Pretty-printer over a validated tape. Output accumulates in a growable
+// buffer that is reused between calls; with a `sink` the buffer is written
+// out whenever it passes JSON_PRINTER_FLUSH_SIZE, so printing a huge
+// document needs no more than the tape itself.
+typedef struct {
+    FILE *sink;
+    char *data;
+    size_t length;
+    size_t capacity;
+    bool failed;
+} JsonPrinter;
+
+void json_printer_init(JsonPrinter *p, FILE *sink);
+void json_printer_free(JsonPrinter *p);
+void json_printer_reset(JsonPrinter *p);
+void json_printer_flush(JsonPrinter *p);
+
+// Append one document (or NDJSON record), followed by a newline
+void json_printer_print(JsonPrinter *p, const JsonTape *tape);
+
+#endif // DEVTOOLS_JSON_PRINTER_H
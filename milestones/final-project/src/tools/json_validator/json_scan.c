@@ -0,0 +1,226 @@
+#include "json_scan.h"
+
+#include <pthread.h>
+#include <stddef.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define JSON_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+// Class bits for the scalar table
+enum {
+    CLASS_QUOTE      = 1 << 0,
+    CLASS_BACKSLASH  = 1 << 1,
+    CLASS_STRUCTURAL = 1 << 2,
+    CLASS_WHITESPACE = 1 << 3,
+    CLASS_NEWLINE    = 1 << 4,
+    CLASS_CONTROL    = 1 << 5
+};
+
+static unsigned char byte_class[256];
+static pthread_once_t byte_class_once = PTHREAD_ONCE_INIT;
+static pthread_once_t level_once = PTHREAD_ONCE_INIT;
+static int active_level = JSON_SCAN_SCALAR;
+
+static void init_byte_class(void) {
+    for (int c = 0; c < 0x20; c++) {
+        byte_class[c] = CLASS_CONTROL;
+    }
+    byte_class['"'] = CLASS_QUOTE;
+    byte_class['\\'] = CLASS_BACKSLASH;
+    byte_class['{'] = byte_class['}'] = CLASS_STRUCTURAL;
+    byte_class['['] = byte_class[']'] = CLASS_STRUCTURAL;
+    byte_class[':'] = byte_class[','] = CLASS_STRUCTURAL;
+    byte_class[' '] = CLASS_WHITESPACE;
+    byte_class['\t'] |= CLASS_WHITESPACE;
+    byte_class['\r'] |= CLASS_WHITESPACE;
+    byte_class['\n'] |= CLASS_WHITESPACE | CLASS_NEWLINE;
+}
+
+void json_classify_scalar(const unsigned char *block, JsonBlockMasks *masks) {
+    uint64_t quote = 0, backslash = 0, structural = 0;
+    uint64_t whitespace = 0, newline = 0, control = 0;
+
+    pthread_once(&byte_class_once, init_byte_class);
+
+    for (int i = 0; i < JSON_SCAN_BLOCK; i++) {
+        unsigned cls = byte_class[block[i]];
+        uint64_t bit = 1ull << i;
+        if (cls & CLASS_QUOTE) quote |= bit;
+        if (cls & CLASS_BACKSLASH) backslash |= bit;
+        if (cls & CLASS_STRUCTURAL) structural |= bit;
+        if (cls & CLASS_WHITESPACE) whitespace |= bit;
+        if (cls & CLASS_NEWLINE) newline |= bit;
+        if (cls & CLASS_CONTROL) control |= bit;
+    }
+
+    masks->quote = quote;
+    masks->backslash = backslash;
+    masks->structural = structural;
+    masks->whitespace = whitespace;
+    masks->newline = newline;
+    masks->control = control;
+}
+
+#ifdef JSON_SCAN_X86
+
+// SSE2: four 16-byte lanes per block. '{'/'[' and '}'/']' differ only in
+// bit 0x20, so OR-ing it in folds four comparisons into two. Control bytes
+// are the ones left unchanged by an unsigned min with 0x1f.
+__attribute__((target("sse2")))
+static void classify_sse2(const unsigned char *block, JsonBlockMasks *masks) {
+    const __m128i quote_c = _mm_set1_epi8('"');
+    const __m128i backslash_c = _mm_set1_epi8('\\');
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    const __m128i open_c = _mm_set1_epi8('{');
+    const __m128i close_c = _mm_set1_epi8('}');
+    const __m128i colon_c = _mm_set1_epi8(':');
+    const __m128i comma_c = _mm_set1_epi8(',');
+    const __m128i space_c = _mm_set1_epi8(' ');
+    const __m128i tab_c = _mm_set1_epi8('\t');
+    const __m128i cr_c = _mm_set1_epi8('\r');
+    const __m128i newline_c = _mm_set1_epi8('\n');
+    const __m128i control_max = _mm_set1_epi8(0x1f);
+
+    uint64_t quote = 0, backslash = 0, structural = 0;
+    uint64_t whitespace = 0, newline = 0, control = 0;
+
+    for (int i = 0; i < JSON_SCAN_BLOCK; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(block + i));
+        __m128i folded = _mm_or_si128(v, case_bit);
+
+        __m128i s = _mm_or_si128(_mm_cmpeq_epi8(folded, open_c), _mm_cmpeq_epi8(folded, close_c));
+        s = _mm_or_si128(s, _mm_or_si128(_mm_cmpeq_epi8(v, colon_c), _mm_cmpeq_epi8(v, comma_c)));
+
+        __m128i nl = _mm_cmpeq_epi8(v, newline_c);
+        __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(v, space_c), _mm_cmpeq_epi8(v, tab_c));
+        ws = _mm_or_si128(ws, _mm_or_si128(_mm_cmpeq_epi8(v, cr_c), nl));
+
+        __m128i ctl = _mm_cmpeq_epi8(_mm_min_epu8(v, control_max), v);
+
+        quote |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote_c)) << i;
+        backslash |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash_c)) << i;
+        structural |= (uint64_t)(uint16_t)_mm_movemask_epi8(s) << i;
+        whitespace |= (uint64_t)(uint16_t)_mm_movemask_epi8(ws) << i;
+        newline |= (uint64_t)(uint16_t)_mm_movemask_epi8(nl) << i;
+        control |= (uint64_t)(uint16_t)_mm_movemask_epi8(ctl) << i;
+    }
+
+    masks->quote = quote;
+    masks->backslash = backslash;
+    masks->structural = structural;
+    masks->whitespace = whitespace;
+    masks->newline = newline;
+    masks->control = control;
+}
+
+// AVX2: the same classification over two 32-byte lanes
+__attribute__((target("avx2")))
+static void classify_avx2(const unsigned char *block, JsonBlockMasks *masks) {
+    const __m256i quote_c = _mm256_set1_epi8('"');
+    const __m256i backslash_c = _mm256_set1_epi8('\\');
+    const __m256i case_bit = _mm256_set1_epi8(0x20);
+    const __m256i open_c = _mm256_set1_epi8('{');
+    const __m256i close_c = _mm256_set1_epi8('}');
+    const __m256i colon_c = _mm256_set1_epi8(':');
+    const __m256i comma_c = _mm256_set1_epi8(',');
+    const __m256i space_c = _mm256_set1_epi8(' ');
+    const __m256i tab_c = _mm256_set1_epi8('\t');
+    const __m256i cr_c = _mm256_set1_epi8('\r');
+    const __m256i newline_c = _mm256_set1_epi8('\n');
+    const __m256i control_max = _mm256_set1_epi8(0x1f);
+
+    uint64_t quote = 0, backslash = 0, structural = 0;
+    uint64_t whitespace = 0, newline = 0, control = 0;
+
+    for (int i = 0; i < JSON_SCAN_BLOCK; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(block + i));
+        __m256i folded = _mm256_or_si256(v, case_bit);
+
+        __m256i s = _mm256_or_si256(_mm256_cmpeq_epi8(folded, open_c),
+                                    _mm256_cmpeq_epi8(folded, close_c));
+        s = _mm256_or_si256(s, _mm256_or_si256(_mm256_cmpeq_epi8(v, colon_c),
+                                               _mm256_cmpeq_epi8(v, comma_c)));
+
+        __m256i nl = _mm256_cmpeq_epi8(v, newline_c);
+        __m256i ws = _mm256_or_si256(_mm256_cmpeq_epi8(v, space_c), _mm256_cmpeq_epi8(v, tab_c));
+        ws = _mm256_or_si256(ws, _mm256_or_si256(_mm256_cmpeq_epi8(v, cr_c), nl));
+
+        __m256i ctl = _mm256_cmpeq_epi8(_mm256_min_epu8(v, control_max), v);
+
+        quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, quote_c)) << i;
+        backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(
+                         _mm256_cmpeq_epi8(v, backslash_c)) << i;
+        structural |= (uint64_t)(uint32_t)_mm256_movemask_epi8(s) << i;
+        whitespace |= (uint64_t)(uint32_t)_mm256_movemask_epi8(ws) << i;
+        newline |= (uint64_t)(uint32_t)_mm256_movemask_epi8(nl) << i;
+        control |= (uint64_t)(uint32_t)_mm256_movemask_epi8(ctl) << i;
+    }
+
+    masks->quote = quote;
+    masks->backslash = backslash;
+    masks->structural = structural;
+    masks->whitespace = whitespace;
+    masks->newline = newline;
+    masks->control = control;
+}
+
+#endif // JSON_SCAN_X86
+
+bool json_scan_supported(JsonScanLevel level) {
+    switch (level) {
+        case JSON_SCAN_SCALAR:
+            return true;
+#ifdef JSON_SCAN_X86
+        case JSON_SCAN_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case JSON_SCAN_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+JsonScanLevel json_scan_best_level(void) {
+    if (json_scan_supported(JSON_SCAN_AVX2)) return JSON_SCAN_AVX2;
+    if (json_scan_supported(JSON_SCAN_SSE2)) return JSON_SCAN_SSE2;
+    return JSON_SCAN_SCALAR;
+}
+
+// The best level is detected once, whichever thread asks first
+static void detect_level(void) {
+    active_level = json_scan_best_level();
+}
+
+JsonScanLevel json_scan_level(void) {
+    pthread_once(&level_once, detect_level);
+    return (JsonScanLevel)active_level;
+}
+
+bool json_scan_set_level(JsonScanLevel level) {
+    pthread_once(&level_once, detect_level);
+    if (!json_scan_supported(level)) return false;
+    active_level = level;
+    return true;
+}
+
+const char* json_scan_level_name(JsonScanLevel level) {
+    switch (level) {
+        case JSON_SCAN_SCALAR: return "scalar";
+        case JSON_SCAN_SSE2:   return "sse2";
+        case JSON_SCAN_AVX2:   return "avx2";
+        default:               return "unknown";
+    }
+}
+
+JsonClassifyFn json_scan_kernel(void) {
+    switch (json_scan_level()) {
+#ifdef JSON_SCAN_X86
+        case JSON_SCAN_SSE2: return classify_sse2;
+        case JSON_SCAN_AVX2: return classify_avx2;
+#endif
+        default:             return NULL;
+    }
+}
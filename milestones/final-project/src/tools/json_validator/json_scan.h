@@ -0,0 +1,48 @@
+#ifndef DEVTOOLS_JSON_SCAN_H
+#define DEVTOOLS_JSON_SCAN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Stage 1 of the tokenizer: classify 64 input bytes at a time into bit
+// masks (bit i describes byte i of the block). The tokenizer then jumps
+// through strings and whitespace with count-trailing-zeros instead of
+// testing every byte, takes structural characters straight from their
+// mask bit, and finds where a number or literal ends with one bit scan.
+
+#define JSON_SCAN_BLOCK 64
+
+typedef struct {
+    uint64_t quote;         // "
+    uint64_t backslash;     // '\'
+    uint64_t structural;    // { } [ ] : ,
+    uint64_t whitespace;    // space, \t, \r, \n
+    uint64_t newline;       // \n
+    uint64_t control;       // bytes below 0x20
+} JsonBlockMasks;
+
+typedef void (*JsonClassifyFn)(const unsigned char *block, JsonBlockMasks *masks);
+
+typedef enum {
+    JSON_SCAN_SCALAR,
+    JSON_SCAN_SSE2,
+    JSON_SCAN_AVX2,
+    JSON_SCAN_LEVEL_COUNT
+} JsonScanLevel;
+
+// Runtime dispatch. The best supported level is picked on first use;
+// json_scan_set_level() overrides it (returns false if the CPU lacks it).
+JsonScanLevel json_scan_best_level(void);
+JsonScanLevel json_scan_level(void);
+bool json_scan_set_level(JsonScanLevel level);
+bool json_scan_supported(JsonScanLevel level);
+const char* json_scan_level_name(JsonScanLevel level);
+
+// Classifier for the active level, or NULL at JSON_SCAN_SCALAR: the
+// tokenizer then falls back to its byte-at-a-time loops.
+JsonClassifyFn json_scan_kernel(void);
+
+// Portable reference classifier (also used to cross-check the SIMD kernels)
+void json_classify_scalar(const unsigned char *block, JsonBlockMasks *masks);
+
+#endif // DEVTOOLS_JSON_SCAN_H
@@ -0,0 +1,114 @@
+#include "json_tape.h"
+
+#include <string.h>
+
+void json_tape_init(JsonTape *tape) {
+    memset(tape, 0, offsetof(JsonTape, open));
+    arena_init(&tape->arena, ARENA_DEFAULT_BLOCK_SIZE);
+}
+
+void json_tape_free(JsonTape *tape) {
+    arena_free(&tape->arena);
+    json_tape_init(tape);
+}
+
+void json_tape_reset(JsonTape *tape, const char *input, size_t length) {
+    arena_reset(&tape->arena);
+    tape->segments = NULL;
+    tape->segment_count = 0;
+    tape->directory_capacity = 0;
+    tape->count = 0;
+    tape->input = input;
+    tape->input_length = length;
+    tape->depth = 0;
+    tape->failed = false;
+}
+
+// The segment directory doubles inside the arena too; the old copy is
+// simply abandoned, which wastes less than the final directory size
+static bool add_segment(JsonTape *tape) {
+    if (tape->segment_count == tape->directory_capacity) {
+        size_t capacity = tape->directory_capacity ? tape->directory_capacity * 2 : 64;
+        uint64_t **directory = arena_alloc(&tape->arena, capacity * sizeof(uint64_t*));
+        if (!directory) return false;
+
+        if (tape->segment_count > 0) {
+            memcpy(directory, tape->segments, tape->segment_count * sizeof(uint64_t*));
+        }
+        tape->segments = directory;
+        tape->directory_capacity = capacity;
+    }
+
+    uint64_t *segment = arena_alloc(&tape->arena, JSON_TAPE_SEGMENT_SIZE * sizeof(uint64_t));
+    if (!segment) return false;
+
+    tape->segments[tape->segment_count++] = segment;
+    return true;
+}
+
+static bool push(JsonTape *tape, JsonTokenType type, size_t payload) {
+    if (tape->count == tape->segment_count * JSON_TAPE_SEGMENT_SIZE && !add_segment(tape)) {
+        tape->failed = true;
+        return false;
+    }
+
+    tape->segments[tape->count >> JSON_TAPE_SEGMENT_SHIFT][tape->count & (JSON_TAPE_SEGMENT_SIZE - 1)] =
+        ((uint64_t)payload << 4) | (uint64_t)type;
+    tape->count++;
+    return true;
+}
+
+bool json_tape_append(JsonTape *tape, const JsonToken *token) {
+    if (tape->failed) return false;
+
+    switch (token->type) {
+        case JSON_OBJECT_START:
+        case JSON_ARRAY_START:
+            // Parser caps nesting at JSON_MAX_DEPTH, so the stack cannot overflow
+            tape->open[tape->depth++] = tape->count;
+            return push(tape, token->type, 0);
+
+        case JSON_OBJECT_END:
+        case JSON_ARRAY_END: {
+            size_t open = tape->open[--tape->depth];
+            size_t close = tape->count;
+            uint64_t *entry = &tape->segments[open >> JSON_TAPE_SEGMENT_SHIFT]
+                                             [open & (JSON_TAPE_SEGMENT_SIZE - 1)];
+            *entry = ((uint64_t)close << 4) | (*entry & 0xf);
+            return push(tape, token->type, open);
+        }
+
+        case JSON_NULL:
+        case JSON_BOOL:
+        case JSON_NUMBER:
+        case JSON_STRING:
+            return push(tape, token->type, (size_t)(token->start - tape->input));
+
+        default:
+            return true;
+    }
+}
+
+const char* json_tape_text(const JsonTape *tape, uint64_t entry, size_t *length) {
+    const char *start = tape->input + JSON_TAPE_PAYLOAD(entry);
+    const char *end = tape->input + tape->input_length;
+    const char *p = start;
+
+    if (JSON_TAPE_TYPE(entry) == JSON_STRING) {
+        // Already validated: the first unescaped quote closes the string
+        p++;
+        while (*p != '"') {
+            p += *p == '\\' ? 2 : 1;
+        }
+        p++;
+    } else {
+        // Numbers and literals end at the first byte that cannot continue them
+        while (p < end && ((*p >= '0' && *p <= '9') || (*p >= 'a' && *p <= 'z') ||
+               *p == '.' || *p == '-' || *p == '+' || *p == 'E')) {
+            p++;
+        }
+    }
+
+    *length = (size_t)(p - start);
+    return start;
+}
@@ -0,0 +1,54 @@
+#ifndef DEVTOOLS_JSON_TAPE_H
+#define DEVTOOLS_JSON_TAPE_H
+
+#include "../../common/arena.h"
+#include "json_tokenizer.h"
+
+// Compact DOM: one 64-bit word per value, in document order.
+//
+//   bits 0-3   JsonTokenType (values and container starts/ends only)
+//   bits 4-63  scalars: byte offset of the token in the input buffer
+//              '{' / '[': tape index of the matching close
+//              '}' / ']': tape index of the matching open
+//
+// Scalar text is not copied; it is re-read from the input when needed.
+// Entries live in fixed-size segments allocated from one arena, so a
+// document costs O(1) allocations and is released in one shot.
+
+#define JSON_TAPE_SEGMENT_SHIFT 13
+#define JSON_TAPE_SEGMENT_SIZE ((size_t)1 << JSON_TAPE_SEGMENT_SHIFT)
+
+#define JSON_TAPE_TYPE(entry) ((JsonTokenType)((entry) & 0xf))
+#define JSON_TAPE_PAYLOAD(entry) ((size_t)((entry) >> 4))
+
+typedef struct {
+    Arena arena;
+    uint64_t **segments;
+    size_t segment_count;
+    size_t directory_capacity;
+    size_t count;
+    const char *input;
+    size_t input_length;
+    int depth;
+    bool failed;
+    size_t open[JSON_MAX_DEPTH];
+} JsonTape;
+
+void json_tape_init(JsonTape *tape);
+void json_tape_free(JsonTape *tape);
+
+// Start a new document whose token offsets are relative to `input`.
+// Arena blocks are kept, so reusing a tape costs no allocation.
+void json_tape_reset(JsonTape *tape, const char *input, size_t length);
+
+// Record a token already accepted by the parser (',' and ':' are skipped)
+bool json_tape_append(JsonTape *tape, const JsonToken *token);
+
+static inline uint64_t json_tape_entry(const JsonTape *tape, size_t index) {
+    return tape->segments[index >> JSON_TAPE_SEGMENT_SHIFT][index & (JSON_TAPE_SEGMENT_SIZE - 1)];
+}
+
+// Text of a scalar entry, measured from the input
+const char* json_tape_text(const JsonTape *tape, uint64_t entry, size_t *length);
+
+#endif // DEVTOOLS_JSON_TAPE_H
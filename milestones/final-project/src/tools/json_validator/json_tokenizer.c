@@ -0,0 +1,625 @@
+#include "json_tokenizer.h"
+#include "../../common/memory.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+
+// Parser states
+enum {
+    EXPECT_VALUE,
+    EXPECT_VALUE_OR_CLOSE,
+    EXPECT_KEY_OR_CLOSE,
+    EXPECT_KEY,
+    EXPECT_COLON,
+    EXPECT_COMMA_OR_CLOSE,
+    EXPECT_NOTHING
+};
+
+// ---------------------------------------------------------------------
+// Input window
+// ---------------------------------------------------------------------
+
+// Everything before `pos` has been consumed, so the window is simply
+// overwritten from the start on every refill
+static bool refill(JsonTokenizer *t) {
+    if (t->eof || !t->window) {
+        t->eof = true;
+        return false;
+    }
+
+    for (;;) {
+        ssize_t n = read(t->fd, t->window, JSON_BUFFER_SIZE);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            t->eof = true;
+            return false;
+        }
+
+        t->pos = 0;
+        t->end = (size_t)n;
+        t->bytes += (uint64_t)n;
+        t->block = NULL;
+        return true;
+    }
+}
+
+static inline int peek_char(JsonTokenizer *t) {
+    if (t->pos == t->end && !refill(t)) return -1;
+    return t->data[t->pos];
+}
+
+static inline void advance(JsonTokenizer *t) {
+    t->pos++;
+    t->column++;
+}
+
+static JsonTokenType fail(JsonTokenizer *t, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    vsnprintf(t->error, sizeof(t->error), format, args);
+    va_end(args);
+
+    t->error_line = t->line;
+    t->error_column = t->column;
+    return JSON_ERROR;
+}
+
+bool json_tokenizer_open_fd(JsonTokenizer *t, int fd) {
+    memset(t, 0, sizeof(JsonTokenizer));
+
+    t->window = MALLOC(JSON_BUFFER_SIZE);
+    if (!t->window) return false;
+
+    t->fd = fd;
+    t->data = t->window;
+    t->classify = json_scan_kernel();
+    t->line = 1;
+    t->column = 1;
+    return true;
+}
+
+void json_tokenizer_open_memory(JsonTokenizer *t, const char *data, size_t length) {
+    memset(t, 0, sizeof(JsonTokenizer));
+
+    t->fd = -1;
+    t->data = (const unsigned char*)data;
+    t->end = length;
+    t->bytes = length;
+    t->classify = json_scan_kernel();
+    t->line = 1;
+    t->column = 1;
+}
+
+void json_tokenizer_close(JsonTokenizer *t) {
+    FREE(t->window);
+}
+
+// ---------------------------------------------------------------------
+// Stage 1 masks
+// ---------------------------------------------------------------------
+
+// Make sure the cached masks cover `p`. A new block is classified starting
+// at `p` itself; near the end of the buffered data (less than one block
+// left) this fails and the caller finishes byte by byte.
+static inline bool load_block(JsonTokenizer *t, const unsigned char *p) {
+    if (t->block && p >= t->block && p < t->block + JSON_SCAN_BLOCK) return true;
+    if ((size_t)(t->data + t->end - p) < JSON_SCAN_BLOCK) return false;
+
+    t->classify(p, &t->masks);
+    t->block = p;
+    return true;
+}
+
+// Advance to the next quote, backslash or control byte inside a string
+static const unsigned char* skip_plain_run(JsonTokenizer *t, const unsigned char *p,
+                                           const unsigned char *end) {
+    while (t->classify && load_block(t, p)) {
+        unsigned offset = (unsigned)(p - t->block);
+        uint64_t stop = (t->masks.quote | t->masks.backslash | t->masks.control) >> offset;
+        if (stop) {
+            return p + __builtin_ctzll(stop);
+        }
+        p = t->block + JSON_SCAN_BLOCK;
+    }
+
+    while (p < end && *p != '"' && *p != '\\' && *p >= 0x20) {
+        p++;
+    }
+    return p;
+}
+
+// Skip a whitespace run a block at a time, counting the newlines in it
+static void skip_whitespace_run(JsonTokenizer *t) {
+    const unsigned char *p = t->data + t->pos;
+
+    while (load_block(t, p)) {
+        unsigned offset = (unsigned)(p - t->block);
+        uint64_t other = ~t->masks.whitespace >> offset;
+        unsigned run = other ? (unsigned)__builtin_ctzll(other) : JSON_SCAN_BLOCK - offset;
+        uint64_t in_run = run == 64 ? ~0ull : (1ull << run) - 1;
+        uint64_t newlines = (t->masks.newline >> offset) & in_run;
+
+        if (newlines) {
+            t->line += __builtin_popcountll(newlines);
+            t->column = (int)(run - (63 - __builtin_clzll(newlines)));
+        } else {
+            t->column += (int)run;
+        }
+
+        p += run;
+        if (other) break;
+    }
+
+    t->pos = (size_t)(p - t->data);
+}
+
+// ---------------------------------------------------------------------
+// Token scanners
+// ---------------------------------------------------------------------
+
+static JsonTokenType scan_string(JsonTokenizer *t) {
+    advance(t); // opening quote
+
+    for (;;) {
+        if (t->pos == t->end && !refill(t)) {
+            return fail(t, "Unterminated string");
+        }
+
+        // Skip the plain run up to the next quote, backslash or control byte
+        const unsigned char *p = t->data + t->pos;
+        const unsigned char *end = t->data + t->end;
+        p = skip_plain_run(t, p, end);
+        t->column += (int)(p - (t->data + t->pos));
+        t->pos = (size_t)(p - t->data);
+        if (p == end) continue;
+
+        if (*p == '"') {
+            advance(t);
+            return JSON_STRING;
+        }
+
+        if (*p < 0x20) {
+            return fail(t, "Unescaped control character 0x%02x in string", *p);
+        }
+
+        // Escape sequence
+        advance(t);
+        int c = peek_char(t);
+        switch (c) {
+            case '"': case '\\': case '/': case 'b':
+            case 'f': case 'n': case 'r': case 't':
+                advance(t);
+                break;
+
+            case 'u':
+                advance(t);
+                for (int i = 0; i < 4; i++) {
+                    int h = peek_char(t);
+                    bool hex = (h >= '0' && h <= '9') || (h >= 'a' && h <= 'f') ||
+                               (h >= 'A' && h <= 'F');
+                    if (!hex) {
+                        return fail(t, "Invalid \\u escape: expected 4 hex digits");
+                    }
+                    advance(t);
+                }
+                break;
+
+            case -1:
+                return fail(t, "Unterminated string");
+
+            default:
+                return fail(t, "Invalid escape sequence '\\%c'", c);
+        }
+    }
+}
+
+static int scan_digits(JsonTokenizer *t) {
+    int count = 0;
+    int c;
+    while ((c = peek_char(t)) >= '0' && c <= '9') {
+        advance(t);
+        count++;
+    }
+    return count;
+}
+
+// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+static JsonTokenType scan_number(JsonTokenizer *t) {
+    int c = peek_char(t);
+
+    if (c == '-') {
+        advance(t);
+        c = peek_char(t);
+    }
+
+    if (c == '0') {
+        advance(t);
+        c = peek_char(t);
+        if (c >= '0' && c <= '9') {
+            return fail(t, "Leading zeros are not allowed in numbers");
+        }
+    } else if (c >= '1' && c <= '9') {
+        scan_digits(t);
+    } else {
+        return fail(t, "Invalid number");
+    }
+
+    if (peek_char(t) == '.') {
+        advance(t);
+        if (scan_digits(t) == 0) {
+            return fail(t, "Expected digits after decimal point");
+        }
+    }
+
+    c = peek_char(t);
+    if (c == 'e' || c == 'E') {
+        advance(t);
+        c = peek_char(t);
+        if (c == '+' || c == '-') {
+            advance(t);
+        }
+        if (scan_digits(t) == 0) {
+            return fail(t, "Expected digits in exponent");
+        }
+    }
+
+    return JSON_NUMBER;
+}
+
+static JsonTokenType scan_literal(JsonTokenizer *t) {
+    char word[8];
+    size_t length = 0;
+    int c;
+
+    while ((c = peek_char(t)) >= 'a' && c <= 'z') {
+        if (length == sizeof(word) - 1) {
+            return fail(t, "Invalid literal");
+        }
+        word[length++] = (char)c;
+        advance(t);
+    }
+    word[length] = '\0';
+
+    if (strcmp(word, "true") == 0 || strcmp(word, "false") == 0) return JSON_BOOL;
+    if (strcmp(word, "null") == 0) return JSON_NULL;
+
+    t->column -= (int)length;
+    return fail(t, length ? "Invalid literal '%s'" : "Unexpected character", word);
+}
+
+// ---------------------------------------------------------------------
+// Stage 2 over the masks
+// ---------------------------------------------------------------------
+
+static JsonTokenType structural_token(int c) {
+    switch (c) {
+        case '{': return JSON_OBJECT_START;
+        case '}': return JSON_OBJECT_END;
+        case '[': return JSON_ARRAY_START;
+        case ']': return JSON_ARRAY_END;
+        case ':': return JSON_COLON;
+        default:  return JSON_COMMA;
+    }
+}
+
+// Length of the number or literal starting at `p`: it runs up to the next
+// structural, whitespace or quote byte. 0 when that byte is not within
+// the classifiable part of the buffered data.
+static size_t scalar_extent(JsonTokenizer *t, const unsigned char *p) {
+    const unsigned char *start = p;
+
+    while (load_block(t, p)) {
+        unsigned offset = (unsigned)(p - t->block);
+        uint64_t stop = (t->masks.structural | t->masks.whitespace | t->masks.quote) >> offset;
+        if (stop) {
+            return (size_t)(p - start) + (size_t)__builtin_ctzll(stop);
+        }
+        p = t->block + JSON_SCAN_BLOCK;
+    }
+    return 0;
+}
+
+static size_t span_digits(const unsigned char *s, size_t i, size_t n) {
+    while (i < n && s[i] >= '0' && s[i] <= '9') i++;
+    return i;
+}
+
+// Whether s[0, n) is exactly one number, by the grammar of scan_number()
+static bool number_span(const unsigned char *s, size_t n) {
+    size_t i = 0;
+    if (s[i] == '-') i++;
+
+    if (i < n && s[i] == '0') {
+        i++;
+    } else if (i < n && s[i] >= '1' && s[i] <= '9') {
+        i = span_digits(s, i + 1, n);
+    } else {
+        return false;
+    }
+
+    if (i < n && s[i] == '.') {
+        size_t digits = i + 1;
+        i = span_digits(s, digits, n);
+        if (i == digits) return false;
+    }
+
+    if (i < n && (s[i] == 'e' || s[i] == 'E')) {
+        i++;
+        if (i < n && (s[i] == '+' || s[i] == '-')) i++;
+        size_t digits = i;
+        i = span_digits(s, digits, n);
+        if (i == digits) return false;
+    }
+
+    return i == n;
+}
+
+// Next token from the cached masks. A structural byte is a token by
+// itself; a number or literal is delimited with one bit scan and checked
+// as a span. Returns false to leave the token to the byte-at-a-time
+// scanners: strings, anything invalid (so errors are reported exactly as
+// before), and scalars whose end is not yet buffered.
+static bool scan_with_masks(JsonTokenizer *t, int c, JsonTokenType *type) {
+    const unsigned char *p = t->data + t->pos;
+    if (!load_block(t, p)) return false;
+
+    unsigned offset = (unsigned)(p - t->block);
+    if ((t->masks.structural >> offset) & 1) {
+        *type = structural_token(c);
+        advance(t);
+        return true;
+    }
+
+    bool number = c == '-' || (c >= '0' && c <= '9');
+    if (!number && !(c >= 'a' && c <= 'z')) return false;
+
+    size_t n = scalar_extent(t, p);
+    if (n == 0) return false;
+
+    if (number) {
+        if (!number_span(p, n)) return false;
+        *type = JSON_NUMBER;
+    } else if (n == 4 && memcmp(p, "true", 4) == 0) {
+        *type = JSON_BOOL;
+    } else if (n == 5 && memcmp(p, "false", 5) == 0) {
+        *type = JSON_BOOL;
+    } else if (n == 4 && memcmp(p, "null", 4) == 0) {
+        *type = JSON_NULL;
+    } else {
+        return false;
+    }
+
+    // Scalars never contain newlines
+    t->pos += n;
+    t->column += (int)n;
+    return true;
+}
+
+JsonTokenType json_next_token(JsonTokenizer *t, JsonToken *token) {
+    int c;
+
+    // Whitespace
+    for (;;) {
+        c = peek_char(t);
+        if (t->classify && (c == ' ' || c == '\n' || c == '\t' || c == '\r')) {
+            skip_whitespace_run(t);
+            c = peek_char(t);
+        }
+        if (c == ' ' || c == '\t' || c == '\r') {
+            advance(t);
+        } else if (c == '\n') {
+            t->pos++;
+            t->line++;
+            t->column = 1;
+        } else {
+            break;
+        }
+    }
+
+    token->line = t->line;
+    token->column = t->column;
+    token->start = NULL;
+    token->length = 0;
+
+    size_t start = t->pos;
+
+    // The masks settle most tokens; the byte scanners handle the rest
+    if (!t->classify || c < 0 || !scan_with_masks(t, c, &token->type)) {
+        switch (c) {
+            case -1:  token->type = JSON_EOF; return JSON_EOF;
+            case '{': advance(t); token->type = JSON_OBJECT_START; break;
+            case '}': advance(t); token->type = JSON_OBJECT_END; break;
+            case '[': advance(t); token->type = JSON_ARRAY_START; break;
+            case ']': advance(t); token->type = JSON_ARRAY_END; break;
+            case ':': advance(t); token->type = JSON_COLON; break;
+            case ',': advance(t); token->type = JSON_COMMA; break;
+            case '"': token->type = scan_string(t); break;
+
+            default:
+                if (c == '-' || (c >= '0' && c <= '9')) {
+                    token->type = scan_number(t);
+                } else if (c >= 'a' && c <= 'z') {
+                    token->type = scan_literal(t);
+                } else {
+                    token->type = fail(t, (c >= 0x20 && c < 0x7f) ? "Unexpected character '%c'"
+                                                                 : "Unexpected byte 0x%02x", c);
+                }
+                break;
+        }
+    }
+
+    // Memory input never refills, so the token text is still addressable
+    if (!t->window && token->type != JSON_ERROR) {
+        token->start = (const char*)t->data + start;
+        token->length = t->pos - start;
+    }
+
+    return token->type;
+}
+
+// Resynchronize after an error in line-oriented (NDJSON) input
+bool json_tokenizer_skip_line(JsonTokenizer *t) {
+    int start_line = t->line;
+
+    for (;;) {
+        if (t->pos == t->end && !refill(t)) return false;
+
+        const unsigned char *p = memchr(t->data + t->pos, '\n', t->end - t->pos);
+        if (p) {
+            t->pos = (size_t)(p - t->data) + 1;
+            t->line = start_line + 1;
+            t->column = 1;
+            return true;
+        }
+        t->pos = t->end;
+    }
+}
+
+// ---------------------------------------------------------------------
+// Structural validation
+// ---------------------------------------------------------------------
+
+const char* json_token_name(JsonTokenType type) {
+    switch (type) {
+        case JSON_NULL:         return "null";
+        case JSON_BOOL:         return "boolean";
+        case JSON_NUMBER:       return "number";
+        case JSON_STRING:       return "string";
+        case JSON_ARRAY_START:  return "'['";
+        case JSON_ARRAY_END:    return "']'";
+        case JSON_OBJECT_START: return "'{'";
+        case JSON_OBJECT_END:   return "'}'";
+        case JSON_COLON:        return "':'";
+        case JSON_COMMA:        return "','";
+        case JSON_EOF:          return "end of input";
+        case JSON_ERROR:        return "invalid token";
+    }
+    return "token";
+}
+
+void json_parser_init(JsonParser *p) {
+    memset(p, 0, sizeof(JsonParser));
+    p->state = EXPECT_VALUE;
+}
+
+static bool in_object(const JsonParser *p) {
+    int level = p->depth - 1;
+    return (p->stack[level / 8] >> (level % 8)) & 1;
+}
+
+static JsonParseStatus parse_error(JsonValidationResult *result, const JsonToken *token,
+                                   const char *expected) {
+    result->valid = false;
+    result->line_number = token->line;
+    result->column = token->column;
+    snprintf(result->error_message, sizeof(result->error_message),
+             "Expected %s but found %s", expected, json_token_name(token->type));
+    return JSON_PARSE_FAILED;
+}
+
+static JsonParseStatus value_complete(JsonParser *p) {
+    if (p->depth == 0) {
+        p->state = EXPECT_NOTHING;
+        return JSON_PARSE_DONE;
+    }
+    p->state = EXPECT_COMMA_OR_CLOSE;
+    return JSON_PARSE_CONTINUE;
+}
+
+static JsonParseStatus open_container(JsonParser *p, const JsonToken *token,
+                                      JsonValidationResult *result, bool object) {
+    if (p->depth == JSON_MAX_DEPTH) {
+        result->valid = false;
+        result->line_number = token->line;
+        result->column = token->column;
+        snprintf(result->error_message, sizeof(result->error_message),
+                 "Nesting deeper than %d levels", JSON_MAX_DEPTH);
+        return JSON_PARSE_FAILED;
+    }
+
+    int level = p->depth++;
+    if (object) {
+        p->stack[level / 8] |= (unsigned char)(1u << (level % 8));
+        p->state = EXPECT_KEY_OR_CLOSE;
+    } else {
+        p->stack[level / 8] &= (unsigned char)~(1u << (level % 8));
+        p->state = EXPECT_VALUE_OR_CLOSE;
+    }
+    return JSON_PARSE_CONTINUE;
+}
+
+static JsonParseStatus parse_value(JsonParser *p, const JsonToken *token,
+                                   JsonValidationResult *result) {
+    switch (token->type) {
+        case JSON_NULL:
+        case JSON_BOOL:
+        case JSON_NUMBER:
+        case JSON_STRING:
+            return value_complete(p);
+
+        case JSON_ARRAY_START:
+            return open_container(p, token, result, false);
+
+        case JSON_OBJECT_START:
+            return open_container(p, token, result, true);
+
+        default:
+            return parse_error(result, token, "a value");
+    }
+}
+
+JsonParseStatus json_parser_feed(JsonParser *p, const JsonToken *token,
+                                 JsonValidationResult *result) {
+    switch (p->state) {
+        case EXPECT_VALUE:
+            return parse_value(p, token, result);
+
+        case EXPECT_VALUE_OR_CLOSE:
+            if (token->type == JSON_ARRAY_END) {
+                p->depth--;
+                return value_complete(p);
+            }
+            return parse_value(p, token, result);
+
+        case EXPECT_KEY_OR_CLOSE:
+            if (token->type == JSON_OBJECT_END) {
+                p->depth--;
+                return value_complete(p);
+            }
+            if (token->type != JSON_STRING) {
+                return parse_error(result, token, "a string key or '}'");
+            }
+            p->state = EXPECT_COLON;
+            return JSON_PARSE_CONTINUE;
+
+        case EXPECT_KEY:
+            if (token->type != JSON_STRING) {
+                return parse_error(result, token, "a string key");
+            }
+            p->state = EXPECT_COLON;
+            return JSON_PARSE_CONTINUE;
+
+        case EXPECT_COLON:
+            if (token->type != JSON_COLON) {
+                return parse_error(result, token, "':'");
+            }
+            p->state = EXPECT_VALUE;
+            return JSON_PARSE_CONTINUE;
+
+        case EXPECT_COMMA_OR_CLOSE:
+            if (token->type == JSON_COMMA) {
+                p->state = in_object(p) ? EXPECT_KEY : EXPECT_VALUE;
+                return JSON_PARSE_CONTINUE;
+            }
+            if (token->type == (in_object(p) ? JSON_OBJECT_END : JSON_ARRAY_END)) {
+                p->depth--;
+                return value_complete(p);
+            }
+            return parse_error(result, token, in_object(p) ? "',' or '}'" : "',' or ']'");
+
+        default:
+            return parse_error(result, token, "end of input");
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef DEVTOOLS_JSON_TOKENIZER_H
+#define DEVTOOLS_JSON_TOKENIZER_H
+
+#include "../../config.h"
+#include "json_scan.h"
+
+#define JSON_BUFFER_SIZE (64 * 1024)
+#define JSON_MAX_DEPTH 1024
+
+// A token as returned by the pull tokenizer. `start`/`length` point at the
+// token text only when the input is an in-memory buffer; streamed input
+// is validated on the fly and never copied, so they are NULL/0 there.
+typedef struct {
+    JsonTokenType type;
+    int line;
+    int column;
+    const char *start;
+    size_t length;
+} JsonToken;
+
+// Pull tokenizer over either a file descriptor (read through one fixed
+// JSON_BUFFER_SIZE window that is refilled in place) or a memory buffer.
+// Memory use is constant regardless of document size. When a SIMD
+// classifier is available, `block`/`masks` cache the stage 1 masks of the
+// 64-byte block the tokenizer is currently walking through.
+typedef struct {
+    int fd;
+    unsigned char *window;
+    const unsigned char *data;
+    size_t pos;
+    size_t end;
+    bool eof;
+    uint64_t bytes;         // input consumed so far
+    JsonClassifyFn classify;
+    const unsigned char *block;
+    JsonBlockMasks masks;
+    int line;
+    int column;
+    int error_line;
+    int error_column;
+    char error[MAX_STRING_LENGTH];
+} JsonTokenizer;
+
+// Structural validator fed one token at a time. Nesting is tracked in a
+// bit stack (object or array per level), so it needs no allocation either.
+typedef enum {
+    JSON_PARSE_CONTINUE,
+    JSON_PARSE_DONE,
+    JSON_PARSE_FAILED
+} JsonParseStatus;
+
+typedef struct {
+    int state;
+    int depth;
+    unsigned char stack[JSON_MAX_DEPTH / 8];
+} JsonParser;
+
+// Tokenizer functions
+bool json_tokenizer_open_fd(JsonTokenizer *t, int fd);
+void json_tokenizer_open_memory(JsonTokenizer *t, const char *data, size_t length);
+void json_tokenizer_close(JsonTokenizer *t);
+JsonTokenType json_next_token(JsonTokenizer *t, JsonToken *token);
+bool json_tokenizer_skip_line(JsonTokenizer *t);
+
+// Parser functions
+void json_parser_init(JsonParser *p);
+JsonParseStatus json_parser_feed(JsonParser *p, const JsonToken *token,
+                                 JsonValidationResult *result);
+const char* json_token_name(JsonTokenType type);
+
+#endif // DEVTOOLS_JSON_TOKENIZER_H
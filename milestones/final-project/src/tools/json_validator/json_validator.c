@@ -0,0 +1,518 @@
+#include "json_validator.h"
+#include "../../common/error.h"
+#include "../../common/logging.h"
+#include "../../common/memory.h"
+#include "../../common/work_queue.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_MAX_ERRORS 20
+#define INCOMPLETE_RECORD "Record ends before its JSON value is complete"
+
+// Reporting context for the sequential NDJSON path
+typedef struct {
+    const char *name;
+    const JsonValidatorOptions *options;
+    JsonValidationStats *stats;
+    int cut_line;
+} ReportContext;
+
+static double elapsed_seconds(const struct timespec *start, const struct timespec *end) {
+    return (double)(end->tv_sec - start->tv_sec) +
+           (double)(end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void set_result(JsonValidationResult *result, int line, int column, const char *message) {
+    result->valid = false;
+    result->line_number = line;
+    result->column = column;
+    strncpy(result->error_message, message, sizeof(result->error_message) - 1);
+    result->error_message[sizeof(result->error_message) - 1] = '\0';
+}
+
+static void tokenizer_result(const JsonTokenizer *t, JsonValidationResult *result) {
+    set_result(result, t->error_line, t->error_column, t->error);
+}
+
+JsonValidationResult validate_json_document(JsonTokenizer *t, JsonTape *tape) {
+    JsonValidationResult result = { .valid = true };
+    JsonParser parser;
+    JsonToken token;
+    bool done = false;
+
+    json_parser_init(&parser);
+    if (tape) json_tape_reset(tape, (const char*)t->data, t->end);
+
+    for (;;) {
+        JsonTokenType type = json_next_token(t, &token);
+
+        if (type == JSON_ERROR) {
+            tokenizer_result(t, &result);
+            break;
+        }
+
+        if (done) {
+            if (type != JSON_EOF) {
+                set_result(&result, token.line, token.column, "Unexpected data after JSON value");
+            }
+            break;
+        }
+
+        if (type == JSON_EOF && parser.depth == 0) {
+            set_result(&result, token.line, token.column, "Empty document");
+            break;
+        }
+
+        JsonParseStatus status = json_parser_feed(&parser, &token, &result);
+        if (status == JSON_PARSE_FAILED) break;
+        if (tape && !json_tape_append(tape, &token)) {
+            set_result(&result, token.line, token.column, "Out of memory building the document tape");
+            break;
+        }
+        if (status == JSON_PARSE_DONE) done = true;
+    }
+
+    return result;
+}
+
+void json_report_error(const char *name, const JsonValidationResult *result,
+                       const JsonValidatorOptions *options, size_t ordinal) {
+    if (options->max_errors > 0 && ordinal > (size_t)options->max_errors) return;
+
+    // Keep stdout clean for the pretty-printed records
+    FILE *out = options->pretty ? stderr : stdout;
+    fprintf(out, "%s:%d:%d: %s\n", name, result->line_number, result->column,
+            result->error_message);
+    if (options->max_errors > 0 && ordinal == (size_t)options->max_errors) {
+        fprintf(out, "%s: too many errors, further errors are counted but not shown\n", name);
+    }
+}
+
+void ndjson_note_continuation(JsonValidationResult *result, int *cut_line) {
+    bool cut = strcmp(result->error_message, INCOMPLETE_RECORD) == 0;
+
+    if (*cut_line > 0 && result->line_number == *cut_line + 1) {
+        size_t length = strlen(result->error_message);
+        snprintf(result->error_message + length, sizeof(result->error_message) - length,
+                 " (likely the rest of the incomplete record on line %d)", *cut_line);
+    }
+    *cut_line = cut ? result->line_number : 0;
+}
+
+static void report_error(const JsonValidationResult *result, void *ctx) {
+    ReportContext *report = (ReportContext*)ctx;
+    JsonValidationResult error = *result;
+    ndjson_note_continuation(&error, &report->cut_line);
+    json_report_error(report->name, &error, report->options, report->stats->invalid);
+}
+
+// One JSON value per line. Blank lines are skipped; a record that does not
+// end on its own line, or a second value on the same line, is an error.
+// Each invalid record is counted in `stats` and passed to `on_error`; with
+// a printer, each valid record is built into `tape` and printed.
+void validate_ndjson(JsonTokenizer *t, JsonTape *tape, JsonPrinter *printer,
+                     JsonErrorFn on_error, void *ctx, JsonValidationStats *stats) {
+    JsonParser parser;
+    JsonToken token;
+    JsonValidationResult result;
+    bool in_record = false;
+    int record_line = 0;
+    int record_column = 0;
+    int finished_line = 0;
+
+    for (;;) {
+        JsonTokenType type = json_next_token(t, &token);
+
+        if (in_record && type != JSON_ERROR && (type == JSON_EOF || token.line != record_line)) {
+            set_result(&result, record_line, record_column, INCOMPLETE_RECORD);
+            stats->invalid++;
+            on_error(&result, ctx);
+            in_record = false;
+        }
+
+        if (type == JSON_EOF) break;
+
+        if (type == JSON_ERROR) {
+            if (!in_record) stats->records++;
+            tokenizer_result(t, &result);
+            stats->invalid++;
+            on_error(&result, ctx);
+            in_record = false;
+            if (!json_tokenizer_skip_line(t)) break;
+            continue;
+        }
+
+        if (!in_record) {
+            if (token.line == finished_line) {
+                set_result(&result, token.line, token.column, "More than one JSON value on a line");
+                stats->invalid++;
+                on_error(&result, ctx);
+                if (!json_tokenizer_skip_line(t)) break;
+                continue;
+            }
+
+            json_parser_init(&parser);
+            if (printer) json_tape_reset(tape, (const char*)t->data, t->end);
+            in_record = true;
+            record_line = token.line;
+            record_column = token.column;
+            stats->records++;
+        }
+
+        JsonParseStatus status = json_parser_feed(&parser, &token, &result);
+        if (status == JSON_PARSE_FAILED) {
+            stats->invalid++;
+            on_error(&result, ctx);
+            in_record = false;
+            if (!json_tokenizer_skip_line(t)) break;
+            continue;
+        }
+
+        if (printer) json_tape_append(tape, &token);
+
+        if (status == JSON_PARSE_DONE) {
+            if (printer && tape->failed) {
+                printer->failed = true;
+            } else if (printer) {
+                json_printer_print(printer, tape);
+            }
+            in_record = false;
+            finished_line = record_line;
+        }
+    }
+}
+
+// Whole-input image for the in-memory paths: mmap for regular files,
+// read() into a growing buffer for pipes
+typedef struct {
+    char *data;
+    size_t length;
+    bool mapped;
+} JsonInput;
+
+static int load_input(int fd, JsonInput *input) {
+    struct stat st;
+    memset(input, 0, sizeof(JsonInput));
+
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        input->length = (size_t)st.st_size;
+        if (input->length == 0) return SUCCESS;
+
+        void *data = mmap(NULL, input->length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            madvise(data, input->length, MADV_SEQUENTIAL);
+            input->data = data;
+            input->mapped = true;
+            return SUCCESS;
+        }
+        input->length = 0;
+    }
+
+    size_t capacity = 0;
+    for (;;) {
+        if (input->length == capacity) {
+            capacity = capacity ? capacity * 2 : JSON_BUFFER_SIZE;
+            char *grown = REALLOC(input->data, capacity);
+            if (!grown) {
+                FREE(input->data);
+                return ERROR_MEMORY_ALLOCATION;
+            }
+            input->data = grown;
+        }
+
+        ssize_t n = read(fd, input->data + input->length, capacity - input->length);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            FREE(input->data);
+            return ERROR_PERMISSION_DENIED;
+        }
+        if (n == 0) return SUCCESS;
+        input->length += (size_t)n;
+    }
+}
+
+static void free_input(JsonInput *input) {
+    if (input->mapped) {
+        munmap(input->data, input->length);
+    } else {
+        FREE(input->data);
+    }
+}
+
+static int finish_ndjson(const char *name, const JsonValidatorOptions *options,
+                         const JsonValidationStats *stats) {
+    FILE *out = options->pretty ? stderr : stdout;
+
+    if (stats->invalid > 0) {
+        fprintf(out, "%s: %zu records, %zu invalid\n", name, stats->records, stats->invalid);
+        return ERROR_PARSE_ERROR;
+    }
+    if (!g_config.quiet) {
+        fprintf(out, "%s: %zu records, all valid\n", name, stats->records);
+    }
+    return SUCCESS;
+}
+
+static int finish_document(const char *name, const JsonValidatorOptions *options,
+                           const JsonValidationResult *result) {
+    FILE *out = options->pretty ? stderr : stdout;
+
+    if (!result->valid) {
+        fprintf(out, "%s:%d:%d: %s\n", name, result->line_number, result->column,
+                result->error_message);
+        return ERROR_PARSE_ERROR;
+    }
+    if (!g_config.quiet && !options->pretty) {
+        fprintf(out, "%s: valid JSON\n", name);
+    }
+    return SUCCESS;
+}
+
+// In-memory validation: NDJSON is split across worker threads, a single
+// document is validated (and optionally pretty-printed) in place
+static int validate_loaded(const JsonInput *input, const char *name,
+                           const JsonValidatorOptions *options) {
+    if (options->ndjson) {
+        JsonValidationStats stats = {0};
+        int status = validate_ndjson_parallel(input->data, input->length, name, options, &stats);
+        if (status != SUCCESS) return status;
+        return finish_ndjson(name, options, &stats);
+    }
+
+    // The whole document is validated into the tape first, so nothing is
+    // printed for invalid input; the printer then streams to stdout
+    JsonTokenizer tokenizer;
+    JsonTape *tape = options->pretty ? MALLOC(sizeof(JsonTape)) : NULL;
+    if (options->pretty && !tape) return ERROR_MEMORY_ALLOCATION;
+
+    json_tokenizer_open_memory(&tokenizer, input->data, input->length);
+    if (tape) json_tape_init(tape);
+
+    JsonValidationResult result = validate_json_document(&tokenizer, tape);
+    int status = finish_document(name, options, &result);
+
+    if (tape) {
+        if (result.valid) {
+            JsonPrinter printer;
+            json_printer_init(&printer, stdout);
+            json_printer_print(&printer, tape);
+            if (printer.failed) status = ERROR_MEMORY_ALLOCATION;
+            json_printer_free(&printer);
+        }
+        json_tape_free(tape);
+        FREE(tape);
+    }
+
+    json_tokenizer_close(&tokenizer);
+    return status;
+}
+
+// Streaming validation through the fixed window (constant memory)
+static int validate_streamed(int fd, const char *name, const JsonValidatorOptions *options,
+                             uint64_t *bytes) {
+    JsonTokenizer tokenizer;
+    if (!json_tokenizer_open_fd(&tokenizer, fd)) {
+        return ERROR_MEMORY_ALLOCATION;
+    }
+
+    int status;
+    if (options->ndjson) {
+        JsonValidationStats stats = {0};
+        ReportContext report = { name, options, &stats, 0 };
+        validate_ndjson(&tokenizer, NULL, NULL, report_error, &report, &stats);
+        status = finish_ndjson(name, options, &stats);
+    } else {
+        JsonValidationResult result = validate_json_document(&tokenizer, NULL);
+        status = finish_document(name, options, &result);
+    }
+
+    *bytes = tokenizer.bytes;
+    json_tokenizer_close(&tokenizer);
+    return status;
+}
+
+int validate_json_file(const char *filename, const JsonValidatorOptions *options) {
+    bool from_stdin = strcmp(filename, "-") == 0;
+    int fd = from_stdin ? STDIN_FILENO : open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "json-validator: %s: %s\n", filename, strerror(errno));
+        return errno == ENOENT ? ERROR_FILE_NOT_FOUND : ERROR_PERMISSION_DENIED;
+    }
+
+    const char *name = from_stdin ? "<stdin>" : filename;
+    struct stat st;
+    bool regular = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+    uint64_t bytes = 0;
+    int status;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Pretty-printing needs token text, and NDJSON files are split across
+    // threads, so those are validated from memory. Everything else, and
+    // NDJSON arriving on a pipe, streams through the fixed window.
+    if (options->pretty || (options->ndjson && regular)) {
+        JsonInput input;
+        status = load_input(fd, &input);
+        if (status == SUCCESS) {
+            status = validate_loaded(&input, name, options);
+            bytes = input.length;
+            free_input(&input);
+        }
+    } else {
+#ifdef POSIX_FADV_SEQUENTIAL
+        if (regular) {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        }
+#endif
+        status = validate_streamed(fd, name, options, &bytes);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (g_config.verbose) {
+        double elapsed = elapsed_seconds(&start, &end);
+        if (elapsed <= 0) elapsed = 1e-9;
+        fprintf(options->pretty ? stderr : stdout,
+                "%s: %.2f MB in %.3f s, %.2f GB/s (%s scan)\n", name,
+                (double)bytes / (1024.0 * 1024.0), elapsed,
+                (double)bytes / elapsed / 1e9, json_scan_level_name(json_scan_level()));
+    }
+
+    if (!from_stdin) close(fd);
+    return status;
+}
+
+int json_validator_execute(int argc, char *argv[]) {
+    JsonValidatorOptions options = {
+        .ndjson = false,
+        .pretty = false,
+        .jobs = 0,
+        .max_errors = DEFAULT_MAX_ERRORS
+    };
+    size_t bench_megabytes = 0;
+    size_t bench_dom_megabytes = 0;
+
+    static struct option long_options[] = {
+        {"ndjson", no_argument, 0, 'l'},
+        {"pretty", no_argument, 0, 'p'},
+        {"jobs", required_argument, 0, 'j'},
+        {"max-errors", required_argument, 0, 'm'},
+        {"scan", required_argument, 0, 1000},
+        {"bench", required_argument, 0, 1001},
+        {"bench-dom", required_argument, 0, 1002},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    // Reset getopt state left over from global option parsing
+    optind = 0;
+
+    int c;
+    while ((c = getopt_long(argc, argv, "lpj:m:h", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'l':
+                options.ndjson = true;
+                break;
+
+            case 'p':
+                options.pretty = true;
+                break;
+
+            case 'j':
+                options.jobs = atoi(optarg);
+                break;
+
+            case 'm':
+                options.max_errors = atoi(optarg);
+                break;
+
+            case 1000: { // --scan
+                int level = 0;
+                while (level < JSON_SCAN_LEVEL_COUNT &&
+                       strcmp(optarg, json_scan_level_name((JsonScanLevel)level)) != 0) {
+                    level++;
+                }
+                if (level == JSON_SCAN_LEVEL_COUNT) {
+                    LOG_ERROR("Unknown scan level: %s (use scalar, sse2 or avx2)", optarg);
+                    return ERROR_INVALID_ARGUMENT;
+                }
+                if (!json_scan_set_level((JsonScanLevel)level)) {
+                    LOG_ERROR("Scan level %s is not supported by this CPU", optarg);
+                    return ERROR_INVALID_ARGUMENT;
+                }
+                break;
+            }
+
+            case 1001: // --bench
+                bench_megabytes = strtoul(optarg, NULL, 10);
+                break;
+
+            case 1002: // --bench-dom
+                bench_dom_megabytes = strtoul(optarg, NULL, 10);
+                break;
+
+            case 'h':
+                json_validator_help();
+                return SUCCESS;
+
+            default:
+                return ERROR_INVALID_ARGUMENT;
+        }
+    }
+
+    if (bench_megabytes > 0) {
+        return json_scan_benchmark(bench_megabytes);
+    }
+
+    if (bench_dom_megabytes > 0) {
+        return json_dom_benchmark(bench_dom_megabytes);
+    }
+
+    if (optind >= argc) {
+        LOG_ERROR("Usage: devtools json-validator [--ndjson] [--pretty] <files>");
+        return ERROR_INVALID_ARGUMENT;
+    }
+
+    int result = SUCCESS;
+    for (int i = optind; i < argc; i++) {
+        int status = validate_json_file(argv[i], &options);
+        if (status != SUCCESS) {
+            result = status;
+        }
+    }
+
+    return result;
+}
+
+void json_validator_help(void) {
+    printf("JSON Validator Tool\n");
+    printf("==================\n");
+    printf("Validates JSON documents and newline-delimited JSON (NDJSON).\n");
+    printf("Input is streamed through a fixed 64 KB window, so files of any\n");
+    printf("size are validated in constant memory. Errors are reported as\n");
+    printf("file:line:column: message. Strings and whitespace are skipped\n");
+    printf("64 bytes at a time using SSE2/AVX2 when the CPU supports them.\n");
+    printf("\nOptions:\n");
+    printf("  -l, --ndjson        One JSON value per line; report every bad record\n");
+    printf("  -p, --pretty        Pretty-print valid input to stdout (errors go to stderr)\n");
+    printf("  -j, --jobs N        Worker threads for NDJSON files (default: CPU count)\n");
+    printf("  -m, --max-errors N  Errors shown per file (default: %d, 0 = all)\n",
+           DEFAULT_MAX_ERRORS);
+    printf("      --scan LEVEL    Force the scan level: scalar, sse2 or avx2\n");
+    printf("      --bench MB      Compare scan levels on MB of synthetic JSON\n");
+    printf("      --bench-dom MB  Compare peak memory of pretty-printing DOMs\n");
+    printf("\nUsage:\n");
+    printf("  devtools json-validator config.json\n");
+    printf("  devtools json-validator --ndjson events.ndjson\n");
+    printf("  devtools json-validator --ndjson --pretty -j 8 events.ndjson > events.txt\n");
+    printf("  zcat export.json.gz | devtools json-validator -\n");
+}
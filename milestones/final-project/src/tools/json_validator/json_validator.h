@@ -0,0 +1,57 @@
+#ifndef DEVTOOLS_JSON_VALIDATOR_H
+#define DEVTOOLS_JSON_VALIDATOR_H
+
+#include "../../config.h"
+#include "json_printer.h"
+#include "json_tokenizer.h"
+
+#define NDJSON_CHUNK_SIZE (1024 * 1024)
+
+typedef struct {
+    bool ndjson;
+    bool pretty;
+    int jobs;           // NDJSON worker threads; 0 = one per CPU
+    int max_errors;     // reported per file; 0 = unlimited
+} JsonValidatorOptions;
+
+typedef struct {
+    size_t records;
+    size_t invalid;
+} JsonValidationStats;
+
+// Called for every invalid NDJSON record, after it has been counted
+typedef void (*JsonErrorFn)(const JsonValidationResult *result, void *ctx);
+
+// Tool entry points
+int json_validator_execute(int argc, char *argv[]);
+void json_validator_help(void);
+
+// Validation functions. `tape` and `printer` may be NULL; when set, the
+// document (or each valid record) is recorded on the tape, and NDJSON
+// records are pretty-printed as they complete. Memory tokenizer input only.
+JsonValidationResult validate_json_document(JsonTokenizer *t, JsonTape *tape);
+void validate_ndjson(JsonTokenizer *t, JsonTape *tape, JsonPrinter *printer,
+                     JsonErrorFn on_error, void *ctx, JsonValidationStats *stats);
+int validate_json_file(const char *filename, const JsonValidatorOptions *options);
+
+// Parallel NDJSON over an in-memory image: split at line boundaries into
+// NDJSON_CHUNK_SIZE chunks, validated on worker threads, reported in order
+int validate_ndjson_parallel(const char *data, size_t length, const char *name,
+                             const JsonValidatorOptions *options, JsonValidationStats *stats);
+
+// Prints one error as name:line:column, honouring max_errors. `ordinal` is
+// the 1-based count of invalid records so far in this file.
+void json_report_error(const char *name, const JsonValidationResult *result,
+                       const JsonValidatorOptions *options, size_t ordinal);
+
+// NDJSON errors arrive in line order. An error on the line after a record
+// cut off at its line end is most likely the rest of that record, and its
+// message is amended to say so. `cut_line` carries the last cut line from
+// one error to the next; start it at 0 for each file.
+void ndjson_note_continuation(JsonValidationResult *result, int *cut_line);
+
+// Benchmarks over synthetic corpora
+int json_scan_benchmark(size_t megabytes);
+int json_dom_benchmark(size_t megabytes);
+
+#endif // DEVTOOLS_JSON_VALIDATOR_H
@@ -0,0 +1,163 @@
+#include "json_validator.h"
+#include "../../common/error.h"
+#include "../../common/memory.h"
+#include "../../common/ordered_pool.h"
+#include "../../common/work_queue.h"
+
+#include <string.h>
+
+// Everything one chunk produces. Slots are reused round-robin, so the tape
+// arena, printer buffer and error array keep their capacity from chunk to
+// chunk.
+typedef struct {
+    JsonTape tape;
+    JsonPrinter printer;
+    JsonValidationResult *errors;
+    size_t error_count;
+    size_t error_capacity;
+    size_t error_limit;
+    JsonValidationStats stats;
+    size_t lines;
+    bool failed;
+} ChunkResult;
+
+typedef struct {
+    const char *data;
+    size_t length;
+    const char *name;
+    const JsonValidatorOptions *options;
+    ChunkResult *slots;
+    size_t window;
+    size_t line_base;
+    int cut_line;               // see ndjson_note_continuation()
+    JsonValidationStats *stats;
+    int result;
+} NdjsonRun;
+
+// Start of chunk k: just past the first newline at or after its nominal
+// offset. Neighbouring chunks compute the same boundary independently, so
+// workers never need to coordinate and records are never split.
+static size_t chunk_boundary(const NdjsonRun *run, size_t k) {
+    if (k == 0) return 0;
+
+    size_t offset = k * NDJSON_CHUNK_SIZE;
+    if (offset >= run->length) return run->length;
+
+    const char *newline = memchr(run->data + offset - 1, '\n', run->length - offset + 1);
+    return newline ? (size_t)(newline - run->data) + 1 : run->length;
+}
+
+// Only the first max_errors errors of a file are ever shown, so no chunk
+// needs to keep more than that; the rest are just counted
+static void collect_error(const JsonValidationResult *result, void *ctx) {
+    ChunkResult *chunk = (ChunkResult*)ctx;
+
+    if (chunk->error_limit > 0 && chunk->error_count >= chunk->error_limit) return;
+
+    if (chunk->error_count == chunk->error_capacity) {
+        size_t capacity = chunk->error_capacity ? chunk->error_capacity * 2 : 16;
+        JsonValidationResult *grown = REALLOC(chunk->errors, capacity * sizeof(*grown));
+        if (!grown) {
+            chunk->failed = true;
+            return;
+        }
+        chunk->errors = grown;
+        chunk->error_capacity = capacity;
+    }
+
+    chunk->errors[chunk->error_count++] = *result;
+}
+
+static void ndjson_work(size_t index, int worker, void *ctx) {
+    (void)worker;
+    NdjsonRun *run = (NdjsonRun*)ctx;
+    ChunkResult *chunk = &run->slots[index % run->window];
+    size_t start = chunk_boundary(run, index);
+    size_t end = chunk_boundary(run, index + 1);
+
+    json_printer_reset(&chunk->printer);
+    memset(&chunk->stats, 0, sizeof(chunk->stats));
+    chunk->error_count = 0;
+    chunk->lines = 0;
+
+    if (start == end) return;
+
+    JsonTokenizer tokenizer;
+    json_tokenizer_open_memory(&tokenizer, run->data + start, end - start);
+    validate_ndjson(&tokenizer, &chunk->tape, run->options->pretty ? &chunk->printer : NULL,
+                    collect_error, chunk, &chunk->stats);
+    json_tokenizer_close(&tokenizer);
+
+    const char *p = run->data + start;
+    const char *limit = run->data + end;
+    while ((p = memchr(p, '\n', (size_t)(limit - p))) != NULL) {
+        chunk->lines++;
+        p++;
+    }
+}
+
+// Runs on the calling thread in chunk order: rebase line numbers onto the
+// whole file, report errors, and write the pretty-printed records
+static void ndjson_emit(size_t index, void *ctx) {
+    NdjsonRun *run = (NdjsonRun*)ctx;
+    ChunkResult *chunk = &run->slots[index % run->window];
+
+    if (chunk->failed || chunk->printer.failed) {
+        run->result = ERROR_MEMORY_ALLOCATION;
+    }
+
+    for (size_t i = 0; i < chunk->error_count; i++) {
+        JsonValidationResult error = chunk->errors[i];
+        error.line_number += (int)run->line_base;
+        ndjson_note_continuation(&error, &run->cut_line);
+        run->stats->invalid++;
+        json_report_error(run->name, &error, run->options, run->stats->invalid);
+    }
+    run->stats->invalid += chunk->stats.invalid - chunk->error_count;
+    run->stats->records += chunk->stats.records;
+
+    if (chunk->printer.length > 0) {
+        fwrite(chunk->printer.data, 1, chunk->printer.length, stdout);
+    }
+
+    run->line_base += chunk->lines;
+}
+
+int validate_ndjson_parallel(const char *data, size_t length, const char *name,
+                             const JsonValidatorOptions *options, JsonValidationStats *stats) {
+    int jobs = options->jobs > 0 ? options->jobs : work_pool_default_workers();
+    size_t count = (length + NDJSON_CHUNK_SIZE - 1) / NDJSON_CHUNK_SIZE;
+
+    NdjsonRun run = {
+        .data = data,
+        .length = length,
+        .name = name,
+        .options = options,
+        .window = (size_t)jobs * 4,
+        .line_base = 0,
+        .cut_line = 0,
+        .stats = stats,
+        .result = SUCCESS
+    };
+
+    run.slots = MALLOC(run.window * sizeof(ChunkResult));
+    if (!run.slots) return ERROR_MEMORY_ALLOCATION;
+
+    memset(run.slots, 0, run.window * sizeof(ChunkResult));
+    for (size_t i = 0; i < run.window; i++) {
+        json_tape_init(&run.slots[i].tape);
+        json_printer_init(&run.slots[i].printer, NULL);
+        run.slots[i].error_limit = options->max_errors > 0 ? (size_t)options->max_errors : 0;
+    }
+
+    int status = ordered_pool_run(count, jobs, run.window, ndjson_work, ndjson_emit, &run);
+
+    for (size_t i = 0; i < run.window; i++) {
+        json_tape_free(&run.slots[i].tape);
+        json_printer_free(&run.slots[i].printer);
+        FREE(run.slots[i].errors);
+    }
+    FREE(run.slots);
+
+    return status != SUCCESS ? status : run.result;
+}
@@ -0,0 +1,352 @@
+#include "aho_corasick.h"
+#include "../../common/error.h"
+#include "../../common/memory.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PATTERN_ARENA_BLOCK (64 * 1024)
+
+// Build-time trie with sorted child lists, laid out into the double array
+// by ac_build
+typedef struct {
+    int32_t first_child;
+    int32_t next_sibling;
+    int32_t output;
+    int32_t state;          // slot in the double array once placed
+    int code;
+} TrieNode;
+
+typedef struct {
+    TrieNode *nodes;
+    size_t count;
+    size_t capacity;
+} Trie;
+
+static int32_t trie_new_node(Trie *trie, int code) {
+    if (trie->count == trie->capacity) {
+        size_t capacity = trie->capacity ? trie->capacity * 2 : 1024;
+        TrieNode *grown = REALLOC(trie->nodes, capacity * sizeof(TrieNode));
+        if (!grown) return -1;
+        trie->nodes = grown;
+        trie->capacity = capacity;
+    }
+
+    TrieNode *node = &trie->nodes[trie->count];
+    node->first_child = -1;
+    node->next_sibling = -1;
+    node->output = -1;
+    node->state = -1;
+    node->code = code;
+    return (int32_t)trie->count++;
+}
+
+// Child of `parent` on `code`, created in sorted position if missing
+static int32_t trie_child(Trie *trie, int32_t parent, int code) {
+    int32_t previous = -1;
+    int32_t child = trie->nodes[parent].first_child;
+
+    while (child >= 0 && trie->nodes[child].code < code) {
+        previous = child;
+        child = trie->nodes[child].next_sibling;
+    }
+    if (child >= 0 && trie->nodes[child].code == code) return child;
+
+    int32_t node = trie_new_node(trie, code);
+    if (node < 0) return -1;
+
+    trie->nodes[node].next_sibling = child;
+    if (previous >= 0) {
+        trie->nodes[previous].next_sibling = node;
+    } else {
+        trie->nodes[parent].first_child = node;
+    }
+    return node;
+}
+
+static int byte_code(AhoCorasick *ac, unsigned char c) {
+    if (!ac->case_sensitive) c = (unsigned char)tolower(c);
+
+    if (ac->byte_class[c] == 0) {
+        ac->byte_class[c] = (uint16_t)++ac->alphabet;
+        if (!ac->case_sensitive) {
+            ac->byte_class[toupper(c)] = ac->byte_class[c];
+        }
+    }
+    return ac->byte_class[c];
+}
+
+void ac_init(AhoCorasick *ac, bool case_sensitive) {
+    memset(ac, 0, sizeof(*ac));
+    ac->case_sensitive = case_sensitive;
+    arena_init(&ac->strings, PATTERN_ARENA_BLOCK);
+}
+
+static void free_trie(AhoCorasick *ac) {
+    Trie *trie = (Trie*)ac->trie;
+    if (!trie) return;
+
+    FREE(trie->nodes);
+    FREE(trie);
+    ac->trie = NULL;
+}
+
+void ac_free(AhoCorasick *ac) {
+    free_trie(ac);
+    FREE(ac->slots);
+    FREE(ac->fail);
+    FREE(ac->output);
+    FREE(ac->report);
+    FREE(ac->patterns);
+    FREE(ac->lengths);
+    arena_free(&ac->strings);
+    memset(ac, 0, sizeof(*ac));
+}
+
+bool ac_add_pattern(AhoCorasick *ac, const char *pattern, size_t length) {
+    if (length == 0) return true;
+
+    if (!ac->trie) {
+        Trie *trie = MALLOC(sizeof(Trie));
+        if (!trie) return false;
+        memset(trie, 0, sizeof(*trie));
+        ac->trie = trie;
+        if (trie_new_node(trie, 0) < 0) return false;
+    }
+
+    if (ac->pattern_count == ac->pattern_capacity) {
+        size_t capacity = ac->pattern_capacity ? ac->pattern_capacity * 2 : 256;
+        const char **patterns = REALLOC(ac->patterns, capacity * sizeof(*patterns));
+        if (!patterns) return false;
+        ac->patterns = patterns;
+
+        size_t *lengths = REALLOC(ac->lengths, capacity * sizeof(*lengths));
+        if (!lengths) return false;
+        ac->lengths = lengths;
+        ac->pattern_capacity = capacity;
+    }
+
+    char *copy = arena_alloc(&ac->strings, length + 1);
+    if (!copy) return false;
+    memcpy(copy, pattern, length);
+    copy[length] = '\0';
+
+    Trie *trie = (Trie*)ac->trie;
+    int32_t node = 0;
+    for (size_t i = 0; i < length; i++) {
+        node = trie_child(trie, node, byte_code(ac, (unsigned char)pattern[i]));
+        if (node < 0) return false;
+    }
+    if (trie->nodes[node].output < 0) {
+        trie->nodes[node].output = (int32_t)ac->pattern_count;
+    }
+
+    ac->patterns[ac->pattern_count] = copy;
+    ac->lengths[ac->pattern_count] = length;
+    ac->pattern_count++;
+    if (length > ac->max_length) ac->max_length = length;
+    return true;
+}
+
+int ac_load_patterns(AhoCorasick *ac, const char *filename) {
+    FILE *file = fopen(filename, "r");
+    if (!file) {
+        return errno == ENOENT ? ERROR_FILE_NOT_FOUND : ERROR_PERMISSION_DENIED;
+    }
+
+    char *line = NULL;
+    size_t capacity = 0;
+    ssize_t length;
+    int status = SUCCESS;
+
+    while ((length = getline(&line, &capacity, file)) >= 0) {
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) {
+            length--;
+        }
+        if (!ac_add_pattern(ac, line, (size_t)length)) {
+            status = ERROR_MEMORY_ALLOCATION;
+            break;
+        }
+    }
+
+    free(line);
+    fclose(file);
+    return status;
+}
+
+static bool grow_slots(AhoCorasick *ac, size_t needed) {
+    if (needed <= ac->slot_count) return true;
+
+    size_t capacity = ac->slot_count ? ac->slot_count : 1024;
+    while (capacity < needed) capacity *= 2;
+
+    AcSlot *slots = REALLOC(ac->slots, capacity * sizeof(AcSlot));
+    if (!slots) return false;
+    for (size_t i = ac->slot_count; i < capacity; i++) {
+        slots[i].base = 0;
+        slots[i].check = -1;
+    }
+
+    ac->slots = slots;
+    ac->slot_count = capacity;
+    return true;
+}
+
+static inline int32_t ac_goto(const AhoCorasick *ac, int32_t state, int code) {
+    size_t t = (size_t)(ac->slots[state].base + code);
+    return t < ac->slot_count && ac->slots[t].check == state ? (int32_t)t : -1;
+}
+
+// Places the children of every node breadth-first: each node gets the
+// lowest base at which all of its child slots are free. `first_free`
+// only moves forward, which keeps placement close to linear.
+static bool place_states(AhoCorasick *ac, Trie *trie, int32_t *queue) {
+    size_t head = 0, tail = 0;
+    size_t first_free = 1;
+
+    if (!grow_slots(ac, trie->count + (size_t)ac->alphabet + 1)) return false;
+    trie->nodes[0].state = 0;
+    ac->slots[0].check = 0;
+    queue[tail++] = 0;
+
+    while (head < tail) {
+        TrieNode *node = &trie->nodes[queue[head++]];
+        int32_t child = node->first_child;
+        if (child < 0) continue;
+
+        int lowest = trie->nodes[child].code;
+        size_t base;
+        for (size_t pos = first_free;; pos++) {
+            if (!grow_slots(ac, pos + (size_t)ac->alphabet + 1)) return false;
+            if (ac->slots[pos].check != -1 || pos < (size_t)lowest) continue;
+
+            base = pos - (size_t)lowest;
+            bool fits = true;
+            for (int32_t c = trie->nodes[child].next_sibling; c >= 0; c = trie->nodes[c].next_sibling) {
+                if (ac->slots[base + (size_t)trie->nodes[c].code].check != -1) {
+                    fits = false;
+                    break;
+                }
+            }
+            if (fits) break;
+        }
+
+        ac->slots[node->state].base = (int32_t)base;
+        for (int32_t c = child; c >= 0; c = trie->nodes[c].next_sibling) {
+            size_t slot = base + (size_t)trie->nodes[c].code;
+            ac->slots[slot].check = node->state;
+            trie->nodes[c].state = (int32_t)slot;
+            queue[tail++] = c;
+        }
+
+        while (first_free < ac->slot_count && ac->slots[first_free].check != -1) {
+            first_free++;
+        }
+    }
+
+    // Every state's base + any class must stay inside the array
+    return grow_slots(ac, first_free + (size_t)ac->alphabet + 1);
+}
+
+// Failure links in the same breadth-first order, so a state's fail target
+// (always shallower) is finished before the state itself
+static void link_states(AhoCorasick *ac, Trie *trie, const int32_t *queue) {
+    for (size_t i = 0; i < trie->count; i++) {
+        TrieNode *node = &trie->nodes[queue[i]];
+        int32_t state = node->state;
+
+        for (int32_t c = node->first_child; c >= 0; c = trie->nodes[c].next_sibling) {
+            int32_t child = trie->nodes[c].state;
+            int code = trie->nodes[c].code;
+            int32_t target = 0;
+
+            if (state != 0) {
+                for (int32_t f = ac->fail[state];; f = ac->fail[f]) {
+                    int32_t next = ac_goto(ac, f, code);
+                    if (next >= 0) {
+                        target = next;
+                        break;
+                    }
+                    if (f == 0) break;
+                }
+            }
+
+            ac->fail[child] = target;
+            ac->output[child] = trie->nodes[c].output;
+            ac->report[child] = ac->output[child] >= 0 ? child : ac->report[target];
+        }
+    }
+}
+
+static bool alloc_links(AhoCorasick *ac) {
+    ac->fail = MALLOC(ac->slot_count * sizeof(int32_t));
+    ac->output = MALLOC(ac->slot_count * sizeof(int32_t));
+    ac->report = MALLOC(ac->slot_count * sizeof(int32_t));
+    if (!ac->fail || !ac->output || !ac->report) return false;
+
+    for (size_t i = 0; i < ac->slot_count; i++) {
+        ac->fail[i] = 0;
+        ac->output[i] = -1;
+        ac->report[i] = -1;
+    }
+    return true;
+}
+
+bool ac_build(AhoCorasick *ac) {
+    Trie *trie = (Trie*)ac->trie;
+
+    if (!trie) {
+        // No patterns: a lone root that never matches
+        if (!grow_slots(ac, 1)) return false;
+        ac->slots[0].check = 0;
+        return alloc_links(ac);
+    }
+
+    int32_t *queue = MALLOC(trie->count * sizeof(int32_t));
+    bool ok = queue && place_states(ac, trie, queue) && alloc_links(ac);
+    if (ok) {
+        link_states(ac, trie, queue);
+        free_trie(ac);
+    }
+
+    FREE(queue);
+    return ok;
+}
+
+size_t ac_scan(const AhoCorasick *ac, const char *text, size_t length,
+               AcMatchFn fn, void *ctx) {
+    const AcSlot *slots = ac->slots;
+    int32_t state = 0;
+    size_t matches = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        int code = ac->byte_class[(unsigned char)text[i]];
+        if (code == 0) {
+            state = 0;
+            continue;
+        }
+
+        for (;;) {
+            int32_t next = slots[state].base + code;
+            if (slots[next].check == state) {
+                state = next;
+                break;
+            }
+            if (state == 0) break;
+            state = ac->fail[state];
+        }
+
+        for (int32_t hit = ac->report[state]; hit >= 0; hit = ac->report[ac->fail[hit]]) {
+            TextMatch match;
+            match.pattern = (size_t)ac->output[hit];
+            match.end = i + 1;
+            match.start = match.end - ac->lengths[match.pattern];
+            matches++;
+            if (!fn(&match, ctx)) return matches;
+        }
+    }
+
+    return matches;
+}
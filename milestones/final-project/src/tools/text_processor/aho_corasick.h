@@ -0,0 +1,72 @@
+#ifndef DEVTOOLS_AHO_CORASICK_H
+#define DEVTOOLS_AHO_CORASICK_H
+
+#include "../../config.h"
+#include "../../common/arena.h"
+
+// Multi-pattern matcher.
+//
+// Patterns are compiled into an Aho-Corasick automaton whose goto function
+// lives in a double array: the child of state s on byte class c is slot
+// base[s] + c, valid when check of that slot is s. Bytes are first mapped
+// to a dense alphabet of the bytes that occur in patterns (case-folded if
+// requested), so the array stays small and every other byte sends the
+// scan straight back to the root.
+
+// A match of pattern `pattern` covering text[start, end)
+typedef struct {
+    size_t pattern;
+    size_t start;
+    size_t end;
+} TextMatch;
+
+// Return false to stop the scan
+typedef bool (*AcMatchFn)(const TextMatch *match, void *ctx);
+
+typedef struct {
+    int32_t base;
+    int32_t check;      // parent state, -1 for a free slot
+} AcSlot;
+
+typedef struct {
+    // Automaton (valid after ac_build); arrays are indexed by state
+    AcSlot *slots;
+    size_t slot_count;
+    int32_t *fail;
+    int32_t *output;    // pattern ending in this state, -1 for none
+    int32_t *report;    // first state with an output on the fail chain
+    uint16_t byte_class[256];   // up to 256 classes plus 0, so wider than a byte
+    int alphabet;       // byte classes in use; class 0 is "not in any pattern"
+
+    // Patterns, interned in the arena
+    Arena strings;
+    const char **patterns;
+    size_t *lengths;
+    size_t pattern_count;
+    size_t pattern_capacity;
+    size_t max_length;
+    bool case_sensitive;
+
+    // Build-time trie, released by ac_build
+    void *trie;
+} AhoCorasick;
+
+void ac_init(AhoCorasick *ac, bool case_sensitive);
+void ac_free(AhoCorasick *ac);
+
+// Empty patterns are ignored. Duplicates are kept in the pattern list but
+// only the first one is ever reported.
+bool ac_add_pattern(AhoCorasick *ac, const char *pattern, size_t length);
+
+// One pattern per line ("\r\n" tolerated, blank lines skipped)
+int ac_load_patterns(AhoCorasick *ac, const char *filename);
+
+bool ac_build(AhoCorasick *ac);
+
+// Reports every match, overlapping ones included, in order of their end
+// position (longer before shorter at the same end). Returns the number of
+// matches reported.
+size_t ac_scan(const AhoCorasick *ac, const char *text, size_t length,
+               AcMatchFn fn, void *ctx);
+
+#endif // DEVTOOLS_AHO_CORASICK_H
@@ -0,0 +1,261 @@
+#include "literal_search.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LITERAL_X86 1
+#include <immintrin.h>
+#endif
+
+// Byte counters are folded into the total before they can wrap
+#define COUNT_BATCH 255
+
+static int active_kernel = -1;
+
+static inline unsigned char fold_byte(unsigned char c) {
+    return c >= 'A' && c <= 'Z' ? (unsigned char)(c | 0x20) : c;
+}
+
+static inline bool is_letter(unsigned char c) {
+    c = fold_byte(c);
+    return c >= 'a' && c <= 'z';
+}
+
+static inline bool literal_equal(const LiteralPattern *pattern, const char *text) {
+    if (pattern->case_sensitive) {
+        return memcmp(text, pattern->text, pattern->length) == 0;
+    }
+
+    for (size_t i = 0; i < pattern->length; i++) {
+        if (fold_byte((unsigned char)text[i]) != fold_byte((unsigned char)pattern->text[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void literal_init(LiteralPattern *pattern, const char *text, size_t length,
+                  bool case_sensitive) {
+    unsigned char first = (unsigned char)text[0];
+    unsigned char last = (unsigned char)text[length - 1];
+
+    pattern->text = text;
+    pattern->length = length;
+    pattern->case_sensitive = case_sensitive;
+    pattern->first_fold = !case_sensitive && is_letter(first) ? 0x20 : 0;
+    pattern->last_fold = !case_sensitive && is_letter(last) ? 0x20 : 0;
+    pattern->first = (unsigned char)(first | pattern->first_fold);
+    pattern->last = (unsigned char)(last | pattern->last_fold);
+}
+
+// ---------------------------------------------------------------------
+// Scalar
+// ---------------------------------------------------------------------
+
+static size_t find_scalar(const LiteralPattern *pattern, const char *text, size_t length) {
+    if (length < pattern->length) return length;
+    size_t starts = length - pattern->length + 1;
+
+    if (pattern->first_fold == 0) {
+        // An exact first byte: let memchr find the candidates
+        const char *p = text;
+        const char *end = text + starts;
+        while ((p = memchr(p, pattern->first, (size_t)(end - p))) != NULL) {
+            if (literal_equal(pattern, p)) return (size_t)(p - text);
+            p++;
+        }
+        return length;
+    }
+
+    for (size_t i = 0; i < starts; i++) {
+        if (((unsigned char)text[i] | 0x20) == pattern->first && literal_equal(pattern, text + i)) {
+            return i;
+        }
+    }
+    return length;
+}
+
+static size_t count_scalar(const char *text, size_t length) {
+    size_t count = 0;
+    for (size_t i = 0; i < length; i++) {
+        count += text[i] == '\n';
+    }
+    return count;
+}
+
+#ifdef LITERAL_X86
+
+// ---------------------------------------------------------------------
+// SSE2: 16 candidate positions per step
+// ---------------------------------------------------------------------
+
+__attribute__((target("sse2")))
+static size_t find_sse2(const LiteralPattern *pattern, const char *text, size_t length) {
+    const __m128i first = _mm_set1_epi8((char)pattern->first);
+    const __m128i last = _mm_set1_epi8((char)pattern->last);
+    const __m128i first_fold = _mm_set1_epi8((char)pattern->first_fold);
+    const __m128i last_fold = _mm_set1_epi8((char)pattern->last_fold);
+    size_t offset = pattern->length - 1;
+    size_t i = 0;
+
+    for (; i + offset + 16 <= length; i += 16) {
+        __m128i head = _mm_or_si128(_mm_loadu_si128((const __m128i*)(text + i)), first_fold);
+        __m128i tail = _mm_or_si128(_mm_loadu_si128((const __m128i*)(text + i + offset)),
+                                    last_fold);
+        unsigned mask = (unsigned)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last)));
+
+        while (mask) {
+            size_t at = i + (size_t)__builtin_ctz(mask);
+            if (literal_equal(pattern, text + at)) return at;
+            mask &= mask - 1;
+        }
+    }
+
+    return i + find_scalar(pattern, text + i, length - i);
+}
+
+__attribute__((target("sse2")))
+static size_t count_sse2(const char *text, size_t length) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i zero = _mm_setzero_si128();
+    size_t count = 0;
+    size_t i = 0;
+
+    while (i + 16 <= length) {
+        // Each matching lane subtracts -1; at most COUNT_BATCH steps per lane
+        __m128i counters = zero;
+        for (int step = 0; step < COUNT_BATCH && i + 16 <= length; step++, i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(text + i));
+            counters = _mm_sub_epi8(counters, _mm_cmpeq_epi8(v, newline));
+        }
+
+        __m128i sums = _mm_sad_epu8(counters, zero);
+        count += (size_t)_mm_extract_epi16(sums, 0) + (size_t)_mm_extract_epi16(sums, 4);
+    }
+
+    return count + count_scalar(text + i, length - i);
+}
+
+// ---------------------------------------------------------------------
+// AVX2: the same filter 32 positions at a time
+// ---------------------------------------------------------------------
+
+__attribute__((target("avx2")))
+static size_t find_avx2(const LiteralPattern *pattern, const char *text, size_t length) {
+    const __m256i first = _mm256_set1_epi8((char)pattern->first);
+    const __m256i last = _mm256_set1_epi8((char)pattern->last);
+    const __m256i first_fold = _mm256_set1_epi8((char)pattern->first_fold);
+    const __m256i last_fold = _mm256_set1_epi8((char)pattern->last_fold);
+    size_t offset = pattern->length - 1;
+    size_t i = 0;
+
+    for (; i + offset + 32 <= length; i += 32) {
+        __m256i head = _mm256_or_si256(_mm256_loadu_si256((const __m256i*)(text + i)),
+                                       first_fold);
+        __m256i tail = _mm256_or_si256(_mm256_loadu_si256((const __m256i*)(text + i + offset)),
+                                       last_fold);
+        unsigned mask = (unsigned)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(head, first), _mm256_cmpeq_epi8(tail, last)));
+
+        while (mask) {
+            size_t at = i + (size_t)__builtin_ctz(mask);
+            if (literal_equal(pattern, text + at)) return at;
+            mask &= mask - 1;
+        }
+    }
+
+    return i + find_scalar(pattern, text + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static size_t count_avx2(const char *text, size_t length) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i zero = _mm256_setzero_si256();
+    size_t count = 0;
+    size_t i = 0;
+
+    while (i + 32 <= length) {
+        __m256i counters = zero;
+        for (int step = 0; step < COUNT_BATCH && i + 32 <= length; step++, i += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(text + i));
+            counters = _mm256_sub_epi8(counters, _mm256_cmpeq_epi8(v, newline));
+        }
+
+        __m256i sums = _mm256_sad_epu8(counters, zero);
+        count += (size_t)_mm256_extract_epi16(sums, 0) + (size_t)_mm256_extract_epi16(sums, 4) +
+                 (size_t)_mm256_extract_epi16(sums, 8) + (size_t)_mm256_extract_epi16(sums, 12);
+    }
+
+    return count + count_scalar(text + i, length - i);
+}
+
+#endif // LITERAL_X86
+
+// ---------------------------------------------------------------------
+// Dispatch
+// ---------------------------------------------------------------------
+
+bool literal_kernel_supported(LiteralKernel kernel) {
+    switch (kernel) {
+        case LITERAL_KERNEL_SCALAR:
+            return true;
+#ifdef LITERAL_X86
+        case LITERAL_KERNEL_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case LITERAL_KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+LiteralKernel literal_best_kernel(void) {
+    if (literal_kernel_supported(LITERAL_KERNEL_AVX2)) return LITERAL_KERNEL_AVX2;
+    if (literal_kernel_supported(LITERAL_KERNEL_SSE2)) return LITERAL_KERNEL_SSE2;
+    return LITERAL_KERNEL_SCALAR;
+}
+
+LiteralKernel literal_kernel(void) {
+    if (active_kernel < 0) {
+        active_kernel = literal_best_kernel();
+    }
+    return (LiteralKernel)active_kernel;
+}
+
+bool literal_set_kernel(LiteralKernel kernel) {
+    if (!literal_kernel_supported(kernel)) return false;
+    active_kernel = kernel;
+    return true;
+}
+
+const char* literal_kernel_name(LiteralKernel kernel) {
+    switch (kernel) {
+        case LITERAL_KERNEL_SCALAR: return "scalar";
+        case LITERAL_KERNEL_SSE2:   return "sse2";
+        case LITERAL_KERNEL_AVX2:   return "avx2";
+        default:                    return "unknown";
+    }
+}
+
+size_t literal_find(const LiteralPattern *pattern, const char *text, size_t length) {
+    switch (literal_kernel()) {
+#ifdef LITERAL_X86
+        case LITERAL_KERNEL_SSE2: return find_sse2(pattern, text, length);
+        case LITERAL_KERNEL_AVX2: return find_avx2(pattern, text, length);
+#endif
+        default:                  return find_scalar(pattern, text, length);
+    }
+}
+
+size_t literal_count_lines(const char *text, size_t length) {
+    switch (literal_kernel()) {
+#ifdef LITERAL_X86
+        case LITERAL_KERNEL_SSE2: return count_sse2(text, length);
+        case LITERAL_KERNEL_AVX2: return count_avx2(text, length);
+#endif
+        default:                  return count_scalar(text, length);
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef DEVTOOLS_LITERAL_SEARCH_H
+#define DEVTOOLS_LITERAL_SEARCH_H
+
+#include "../../config.h"
+
+// Single-literal search over large blocks.
+//
+// Candidates are found a vector at a time by comparing every position
+// against the first byte of the pattern and the position length - 1 bytes
+// further on against the last byte; only positions where both agree are
+// compared in full. Case-insensitive patterns fold letters by setting bit
+// 5 before comparing, which can only add candidates, never lose one.
+
+typedef struct {
+    const char *text;
+    size_t length;
+    bool case_sensitive;
+    unsigned char first;        // folded if the byte is a letter
+    unsigned char last;
+    unsigned char first_fold;   // 0x20 when `first` is a case-folded letter
+    unsigned char last_fold;
+} LiteralPattern;
+
+typedef enum {
+    LITERAL_KERNEL_SCALAR,
+    LITERAL_KERNEL_SSE2,
+    LITERAL_KERNEL_AVX2,
+    LITERAL_KERNEL_COUNT
+} LiteralKernel;
+
+// Kernel selection (runtime CPU dispatch; the best one is used by default).
+// The scalar kernel is memchr on the first byte plus a full compare.
+LiteralKernel literal_best_kernel(void);
+LiteralKernel literal_kernel(void);
+bool literal_set_kernel(LiteralKernel kernel);
+bool literal_kernel_supported(LiteralKernel kernel);
+const char* literal_kernel_name(LiteralKernel kernel);
+
+// `text` must outlive the pattern and must not be empty
+void literal_init(LiteralPattern *pattern, const char *text, size_t length,
+                  bool case_sensitive);
+
+// Offset of the first match in text[0, length), or `length` if there is none
+size_t literal_find(const LiteralPattern *pattern, const char *text, size_t length);
+
+// Number of '\n' bytes in text[0, length)
+size_t literal_count_lines(const char *text, size_t length);
+
+#endif // DEVTOOLS_LITERAL_SEARCH_H
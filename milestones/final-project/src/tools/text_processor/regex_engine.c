@@ -0,0 +1,1038 @@
+#include "regex_engine.h"
+#include "../../common/error.h"
+#include "../../common/memory.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define STATE_UNKNOWN (-2)
+#define STATE_DEAD (-1)
+
+// Budget charged per DFA state besides its transition row
+#define STATE_OVERHEAD (sizeof(size_t) * 2 + 1)
+
+typedef struct {
+    uint32_t bits[8];
+} ByteSet;
+
+static inline bool set_has(const ByteSet *set, unsigned char c) {
+    return (set->bits[c >> 5] >> (c & 31)) & 1;
+}
+
+static inline void set_add(ByteSet *set, unsigned char c) {
+    set->bits[c >> 5] |= 1u << (c & 31);
+}
+
+static void set_add_range(ByteSet *set, int low, int high) {
+    for (int c = low; c <= high; c++) set_add(set, (unsigned char)c);
+}
+
+static void set_merge(ByteSet *set, const ByteSet *other) {
+    for (int i = 0; i < 8; i++) set->bits[i] |= other->bits[i];
+}
+
+static void set_invert(ByteSet *set) {
+    for (int i = 0; i < 8; i++) set->bits[i] = ~set->bits[i];
+}
+
+// ASCII letters get their other case
+static void set_fold(ByteSet *set) {
+    for (int c = 'a'; c <= 'z'; c++) {
+        if (set_has(set, (unsigned char)c) || set_has(set, (unsigned char)(c - 32))) {
+            set_add(set, (unsigned char)c);
+            set_add(set, (unsigned char)(c - 32));
+        }
+    }
+}
+
+// ---------------------------------------------------------------------
+// Parser: pattern -> syntax tree
+// ---------------------------------------------------------------------
+
+typedef enum {
+    NODE_EMPTY,
+    NODE_SET,
+    NODE_CONCAT,
+    NODE_ALTERNATE,
+    NODE_REPEAT,
+    NODE_LINE_START,
+    NODE_LINE_END
+} NodeType;
+
+typedef struct {
+    NodeType type;
+    int left;
+    int right;
+    int set;            // NODE_SET
+    int min;            // NODE_REPEAT; max is -1 when unbounded
+    int max;
+    bool greedy;
+} Node;
+
+typedef struct {
+    const char *pattern;
+    size_t length;
+    size_t position;
+    bool case_sensitive;
+    int depth;
+
+    Node *nodes;
+    size_t node_count;
+    size_t node_capacity;
+    ByteSet *sets;
+    size_t set_count;
+    size_t set_capacity;
+
+    bool failed;
+    char *error;
+    size_t error_size;
+} Parser;
+
+static int parse_alternation(Parser *p);
+
+static int parse_fail(Parser *p, const char *message) {
+    if (!p->failed) {
+        snprintf(p->error, p->error_size, "%s at offset %zu", message, p->position);
+        p->failed = true;
+    }
+    return -1;
+}
+
+static int new_node(Parser *p, NodeType type, int left, int right) {
+    if (p->node_count == p->node_capacity) {
+        size_t capacity = p->node_capacity ? p->node_capacity * 2 : 64;
+        Node *grown = REALLOC(p->nodes, capacity * sizeof(Node));
+        if (!grown) return parse_fail(p, "out of memory");
+        p->nodes = grown;
+        p->node_capacity = capacity;
+    }
+
+    Node *node = &p->nodes[p->node_count];
+    memset(node, 0, sizeof(*node));
+    node->type = type;
+    node->left = left;
+    node->right = right;
+    node->set = -1;
+    return (int)p->node_count++;
+}
+
+static int new_set_node(Parser *p, ByteSet *set) {
+    if (!p->case_sensitive) set_fold(set);
+
+    if (p->set_count == p->set_capacity) {
+        size_t capacity = p->set_capacity ? p->set_capacity * 2 : 16;
+        ByteSet *grown = REALLOC(p->sets, capacity * sizeof(ByteSet));
+        if (!grown) return parse_fail(p, "out of memory");
+        p->sets = grown;
+        p->set_capacity = capacity;
+    }
+    p->sets[p->set_count] = *set;
+
+    int node = new_node(p, NODE_SET, -1, -1);
+    if (node >= 0) p->nodes[node].set = (int)p->set_count++;
+    return node;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// The escape after a backslash. Returns the byte it stands for, or -1 with
+// `set` filled in for a class escape; -2 on error.
+static int parse_escape(Parser *p, ByteSet *set) {
+    if (p->position >= p->length) {
+        parse_fail(p, "trailing backslash");
+        return -2;
+    }
+
+    char c = p->pattern[p->position++];
+    memset(set, 0, sizeof(*set));
+
+    switch (c) {
+        case 'd': case 'D':
+            set_add_range(set, '0', '9');
+            break;
+        case 'w': case 'W':
+            set_add_range(set, 'a', 'z');
+            set_add_range(set, 'A', 'Z');
+            set_add_range(set, '0', '9');
+            set_add(set, '_');
+            break;
+        case 's': case 'S':
+            set_add(set, ' ');
+            set_add_range(set, '\t', '\r');
+            break;
+        case 't': return '\t';
+        case 'n': return '\n';
+        case 'r': return '\r';
+        case 'f': return '\f';
+        case 'v': return '\v';
+        case 'x': {
+            int high = p->position < p->length ? hex_value(p->pattern[p->position]) : -1;
+            int low = p->position + 1 < p->length ? hex_value(p->pattern[p->position + 1]) : -1;
+            if (high < 0 || low < 0) {
+                parse_fail(p, "\\x needs two hex digits");
+                return -2;
+            }
+            p->position += 2;
+            return high << 4 | low;
+        }
+        case 'b': case 'B':
+            parse_fail(p, "word boundaries are not supported");
+            return -2;
+        default:
+            if (c >= '1' && c <= '9') {
+                parse_fail(p, "backreferences are not supported");
+                return -2;
+            }
+            if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '0') {
+                parse_fail(p, "unknown escape");
+                return -2;
+            }
+            return (unsigned char)c;
+    }
+
+    // Upper-case class escapes are the complement
+    if (c == 'D' || c == 'W' || c == 'S') set_invert(set);
+    return -1;
+}
+
+// One member of a bracket expression: a byte (returned) or a class escape
+static int parse_class_atom(Parser *p, ByteSet *set) {
+    char c = p->pattern[p->position++];
+    if (c == '\\') return parse_escape(p, set);
+    return (unsigned char)c;
+}
+
+static int parse_class(Parser *p) {
+    ByteSet set;
+    memset(&set, 0, sizeof(set));
+
+    bool negate = p->position < p->length && p->pattern[p->position] == '^';
+    if (negate) p->position++;
+
+    bool first = true;
+    while (p->position < p->length && (p->pattern[p->position] != ']' || first)) {
+        first = false;
+
+        ByteSet item;
+        int low = parse_class_atom(p, &item);
+        if (low == -2) return -1;
+        if (low == -1) {
+            set_merge(&set, &item);
+            continue;
+        }
+
+        // A '-' before the closing bracket is a literal
+        if (p->position + 1 < p->length && p->pattern[p->position] == '-' &&
+            p->pattern[p->position + 1] != ']') {
+            p->position++;
+            int high = parse_class_atom(p, &item);
+            if (high == -2) return -1;
+            if (high == -1) return parse_fail(p, "class escape used as range end");
+            if (high < low) return parse_fail(p, "invalid range");
+            set_add_range(&set, low, high);
+        } else {
+            set_add(&set, (unsigned char)low);
+        }
+    }
+
+    if (p->position >= p->length) return parse_fail(p, "missing ]");
+    p->position++;
+
+    if (!p->case_sensitive) set_fold(&set);
+    if (negate) {
+        set_invert(&set);
+        set.bits['\n' >> 5] &= ~(1u << ('\n' & 31));
+    }
+    return new_set_node(p, &set);
+}
+
+static int parse_atom(Parser *p) {
+    char c = p->pattern[p->position++];
+    ByteSet set;
+    memset(&set, 0, sizeof(set));
+
+    switch (c) {
+        case '(': {
+            if (++p->depth > REGEX_MAX_DEPTH) return parse_fail(p, "groups nested too deeply");
+            if (p->position < p->length && p->pattern[p->position] == '?') {
+                if (p->position + 1 < p->length && p->pattern[p->position + 1] == ':') {
+                    p->position += 2;
+                } else {
+                    return parse_fail(p, "unsupported group syntax");
+                }
+            }
+
+            int node = parse_alternation(p);
+            if (node < 0) return -1;
+            if (p->position >= p->length || p->pattern[p->position] != ')') {
+                return parse_fail(p, "missing )");
+            }
+            p->position++;
+            p->depth--;
+            return node;
+        }
+
+        case '[':
+            return parse_class(p);
+
+        case '.':
+            set_invert(&set);
+            set.bits['\n' >> 5] &= ~(1u << ('\n' & 31));
+            return new_set_node(p, &set);
+
+        case '^':
+            return new_node(p, NODE_LINE_START, -1, -1);
+
+        case '$':
+            return new_node(p, NODE_LINE_END, -1, -1);
+
+        case '*': case '+': case '?':
+            p->position--;
+            return parse_fail(p, "nothing to repeat");
+
+        case '\\': {
+            int byte = parse_escape(p, &set);
+            if (byte == -2) return -1;
+            if (byte >= 0) set_add(&set, (unsigned char)byte);
+            return new_set_node(p, &set);
+        }
+
+        default:
+            set_add(&set, (unsigned char)c);
+            return new_set_node(p, &set);
+    }
+}
+
+static bool parse_count(Parser *p, size_t *position, int *value) {
+    size_t start = *position;
+    long n = 0;
+
+    while (*position < p->length && p->pattern[*position] >= '0' && p->pattern[*position] <= '9') {
+        if (n <= REGEX_MAX_REPEAT) n = n * 10 + (p->pattern[*position] - '0');
+        (*position)++;
+    }
+
+    *value = (int)(n > REGEX_MAX_REPEAT ? REGEX_MAX_REPEAT + 1 : n);
+    return *position > start;
+}
+
+// {n}, {n,} or {n,m}; anything else leaves '{' to be read as a literal
+static bool parse_braces(Parser *p, int *min, int *max) {
+    size_t position = p->position + 1;
+
+    if (!parse_count(p, &position, min)) return false;
+    *max = *min;
+    if (position < p->length && p->pattern[position] == ',') {
+        position++;
+        if (!parse_count(p, &position, max)) *max = -1;
+    }
+    if (position >= p->length || p->pattern[position] != '}') return false;
+
+    p->position = position + 1;
+    return true;
+}
+
+static int parse_repeat(Parser *p) {
+    int atom = parse_atom(p);
+
+    while (atom >= 0 && p->position < p->length) {
+        char c = p->pattern[p->position];
+        int min, max;
+
+        if (c == '*') {
+            min = 0, max = -1;
+            p->position++;
+        } else if (c == '+') {
+            min = 1, max = -1;
+            p->position++;
+        } else if (c == '?') {
+            min = 0, max = 1;
+            p->position++;
+        } else if (c != '{' || !parse_braces(p, &min, &max)) {
+            break;
+        }
+
+        if (min > REGEX_MAX_REPEAT || max > REGEX_MAX_REPEAT) {
+            return parse_fail(p, "repeat count too large");
+        }
+        if (max >= 0 && max < min) return parse_fail(p, "invalid repeat range");
+
+        bool greedy = true;
+        if (p->position < p->length && p->pattern[p->position] == '?') {
+            greedy = false;
+            p->position++;
+        }
+
+        int node = new_node(p, NODE_REPEAT, atom, -1);
+        if (node < 0) return -1;
+        p->nodes[node].min = min;
+        p->nodes[node].max = max;
+        p->nodes[node].greedy = greedy;
+        atom = node;
+    }
+
+    return atom;
+}
+
+static int parse_concat(Parser *p) {
+    int node = -1;
+
+    while (p->position < p->length && p->pattern[p->position] != '|' &&
+           p->pattern[p->position] != ')') {
+        int atom = parse_repeat(p);
+        if (atom < 0) return -1;
+        node = node < 0 ? atom : new_node(p, NODE_CONCAT, node, atom);
+        if (node < 0) return -1;
+    }
+
+    return node < 0 ? new_node(p, NODE_EMPTY, -1, -1) : node;
+}
+
+static int parse_alternation(Parser *p) {
+    int node = parse_concat(p);
+
+    while (node >= 0 && p->position < p->length && p->pattern[p->position] == '|') {
+        p->position++;
+        int right = parse_concat(p);
+        if (right < 0) return -1;
+        node = new_node(p, NODE_ALTERNATE, node, right);
+    }
+
+    return node;
+}
+
+// ---------------------------------------------------------------------
+// Compiler: syntax tree -> Thompson NFA
+// ---------------------------------------------------------------------
+
+typedef enum {
+    INST_SET,           // consume a byte in `set`, continue at out
+    INST_SPLIT,         // try out, then out1
+    INST_MATCH,
+    INST_ASSERT_START,  // continue at out only at the start of the scan
+    INST_ASSERT_END     // continue at out only at the end of the scan
+} InstType;
+
+typedef struct {
+    InstType type;
+    int32_t out;
+    int32_t out1;
+    int32_t set;
+} Inst;
+
+struct RegexProgram {
+    Inst *insts;
+    size_t count;
+    size_t capacity;
+    int32_t start;
+    bool overflow;
+
+    ByteSet *sets;
+    unsigned char class_byte[256];  // a member byte of every byte class
+    int class_count;
+};
+
+static int32_t emit(RegexProgram *program, InstType type, int32_t out, int32_t out1, int32_t set) {
+    if (program->overflow) return -1;
+
+    if (program->count == REGEX_MAX_PROGRAM) {
+        program->overflow = true;
+        return -1;
+    }
+
+    if (program->count == program->capacity) {
+        size_t capacity = program->capacity ? program->capacity * 2 : 64;
+        if (capacity > REGEX_MAX_PROGRAM) capacity = REGEX_MAX_PROGRAM;
+        Inst *grown = REALLOC(program->insts, capacity * sizeof(Inst));
+        if (!grown) {
+            program->overflow = true;
+            return -1;
+        }
+        program->insts = grown;
+        program->capacity = capacity;
+    }
+
+    Inst *inst = &program->insts[program->count];
+    inst->type = type;
+    inst->out = out;
+    inst->out1 = out1;
+    inst->set = set;
+    return (int32_t)program->count++;
+}
+
+// Whether the node can match without consuming a byte
+static bool node_nullable(const Node *nodes, int index) {
+    const Node *node = &nodes[index];
+
+    switch (node->type) {
+        case NODE_SET:
+            return false;
+        case NODE_CONCAT:
+            return node_nullable(nodes, node->left) && node_nullable(nodes, node->right);
+        case NODE_ALTERNATE:
+            return node_nullable(nodes, node->left) || node_nullable(nodes, node->right);
+        case NODE_REPEAT:
+            return node->min == 0 || node_nullable(nodes, node->left);
+        default:
+            return true;
+    }
+}
+
+// Compiles `index` so that it continues at `out` and returns its entry.
+// Built back to front, so every successor exists before its predecessor.
+// The reversed program matches the reversed text: concatenations are
+// compiled in the opposite order and the two anchors trade places.
+static int32_t compile_node(RegexProgram *program, const Node *nodes, int index,
+                            int32_t out, bool reverse) {
+    const Node *node = &nodes[index];
+    if (program->overflow) return -1;
+
+    switch (node->type) {
+        case NODE_EMPTY:
+            return out;
+
+        case NODE_SET:
+            return emit(program, INST_SET, out, -1, node->set);
+
+        case NODE_CONCAT:
+            if (reverse) {
+                return compile_node(program, nodes, node->right,
+                                    compile_node(program, nodes, node->left, out, reverse), reverse);
+            }
+            return compile_node(program, nodes, node->left,
+                                compile_node(program, nodes, node->right, out, reverse), reverse);
+
+        case NODE_ALTERNATE: {
+            int32_t left = compile_node(program, nodes, node->left, out, reverse);
+            int32_t right = compile_node(program, nodes, node->right, out, reverse);
+            return emit(program, INST_SPLIT, left, right, -1);
+        }
+
+        case NODE_LINE_START:
+            return emit(program, reverse ? INST_ASSERT_END : INST_ASSERT_START, out, -1, -1);
+
+        case NODE_LINE_END:
+            return emit(program, reverse ? INST_ASSERT_START : INST_ASSERT_END, out, -1, -1);
+
+        case NODE_REPEAT: {
+            int32_t next = out;
+            int copies = node->min;
+
+            if (node->max < 0 && !node_nullable(nodes, node->left)) {
+                // A loop: split in front of x, x leading back to the split
+                int32_t split = emit(program, INST_SPLIT, -1, -1, -1);
+                int32_t body = compile_node(program, nodes, node->left, split, reverse);
+                if (program->overflow) return -1;
+                program->insts[split].out = node->greedy ? body : out;
+                program->insts[split].out1 = node->greedy ? out : body;
+                next = split;
+            } else if (node->max < 0) {
+                // x can match empty: its empty path would come back to the
+                // loop split and die there, ranking x's consuming paths above
+                // the exit. As (x+)? with the split after x, the empty path
+                // reaches the exit first.
+                int32_t split = emit(program, INST_SPLIT, -1, -1, -1);
+                int32_t body = compile_node(program, nodes, node->left, split, reverse);
+                if (program->overflow) return -1;
+                program->insts[split].out = node->greedy ? body : out;
+                program->insts[split].out1 = node->greedy ? out : body;
+
+                if (copies == 0) {
+                    next = node->greedy ? emit(program, INST_SPLIT, body, out, -1)
+                                        : emit(program, INST_SPLIT, out, body, -1);
+                } else {
+                    next = body;
+                    copies--;
+                }
+            } else {
+                // Nested optional copies: (x(x)?)? for {0,2}
+                for (int i = 0; i < node->max - node->min; i++) {
+                    int32_t body = compile_node(program, nodes, node->left, next, reverse);
+                    next = node->greedy ? emit(program, INST_SPLIT, body, out, -1)
+                                        : emit(program, INST_SPLIT, out, body, -1);
+                }
+            }
+
+            for (int i = 0; i < copies; i++) {
+                next = compile_node(program, nodes, node->left, next, reverse);
+            }
+            return next;
+        }
+    }
+
+    return -1;
+}
+
+static RegexProgram* compile_program(const Parser *p, int root, const unsigned char *byte_class,
+                                     int class_count, bool reverse) {
+    RegexProgram *program = MALLOC(sizeof(RegexProgram));
+    if (!program) return NULL;
+    memset(program, 0, sizeof(*program));
+
+    program->class_count = class_count;
+    for (int c = 255; c >= 0; c--) {
+        program->class_byte[byte_class[c]] = (unsigned char)c;
+    }
+
+    // The sets of the pattern plus one matching any byte
+    program->sets = MALLOC((p->set_count + 1) * sizeof(ByteSet));
+    if (!program->sets) {
+        FREE(program);
+        return NULL;
+    }
+    if (p->set_count > 0) memcpy(program->sets, p->sets, p->set_count * sizeof(ByteSet));
+    memset(&program->sets[p->set_count], 0xFF, sizeof(ByteSet));
+
+    int32_t match = emit(program, INST_MATCH, -1, -1, -1);
+    int32_t start = compile_node(program, p->nodes, root, match, reverse);
+
+    if (!reverse) {
+        // Unanchored: a lazy loop over any byte in front of the pattern,
+        // lowest priority so earlier starts always win
+        int32_t loop = emit(program, INST_SPLIT, start, -1, -1);
+        int32_t skip = emit(program, INST_SET, loop, -1, (int32_t)p->set_count);
+        if (!program->overflow) program->insts[loop].out1 = skip;
+        start = loop;
+    }
+
+    program->start = start;
+    return program;
+}
+
+static void free_program(RegexProgram *program) {
+    if (!program) return;
+    FREE(program->insts);
+    FREE(program->sets);
+    FREE(program);
+}
+
+// Splits the bytes into classes that no set tells apart
+static int compute_byte_classes(const Parser *p, unsigned char *byte_class) {
+    int count = 1;
+    memset(byte_class, 0, 256);
+
+    for (size_t s = 0; s < p->set_count; s++) {
+        int map[512];
+        int next = 0;
+        for (int i = 0; i < 512; i++) map[i] = -1;
+
+        for (int c = 0; c < 256; c++) {
+            int key = byte_class[c] * 2 + set_has(&p->sets[s], (unsigned char)c);
+            if (map[key] < 0) map[key] = next++;
+            byte_class[c] = (unsigned char)map[key];
+        }
+        count = next;
+    }
+
+    return count;
+}
+
+// ---------------------------------------------------------------------
+// Lazy DFA
+// ---------------------------------------------------------------------
+
+static size_t dfa_stride(const RegexDfa *dfa) {
+    return (size_t)dfa->program->class_count + 1;
+}
+
+static bool dfa_init(RegexDfa *dfa, const RegexProgram *program, bool longest) {
+    memset(dfa, 0, sizeof(*dfa));
+    dfa->program = program;
+    dfa->longest = longest;
+    dfa->budget = REGEX_CACHE_BYTES;
+    for (int i = 0; i < 4; i++) dfa->starts[i] = STATE_UNKNOWN;
+
+    dfa->scratch = MALLOC(program->count * sizeof(int32_t));
+    dfa->stack = MALLOC((program->count * 2 + 1) * sizeof(int32_t));
+    dfa->marks = MALLOC(program->count * sizeof(uint32_t));
+    if (!dfa->scratch || !dfa->stack || !dfa->marks) return false;
+    memset(dfa->marks, 0, program->count * sizeof(uint32_t));
+    return true;
+}
+
+static void dfa_free(RegexDfa *dfa) {
+    FREE(dfa->table);
+    FREE(dfa->matching);
+    FREE(dfa->list_offsets);
+    FREE(dfa->list_lengths);
+    FREE(dfa->lists);
+    FREE(dfa->buckets);
+    FREE(dfa->scratch);
+    FREE(dfa->stack);
+    FREE(dfa->marks);
+    memset(dfa, 0, sizeof(*dfa));
+}
+
+static void dfa_flush(RegexDfa *dfa) {
+    dfa->state_count = 0;
+    dfa->lists_used = 0;
+    for (size_t i = 0; i < dfa->bucket_count; i++) dfa->buckets[i] = -1;
+    for (int i = 0; i < 4; i++) dfa->starts[i] = STATE_UNKNOWN;
+    dfa->flushes++;
+}
+
+static size_t dfa_bytes(const RegexDfa *dfa, size_t states, size_t list_entries) {
+    return states * (dfa_stride(dfa) * sizeof(int32_t) + STATE_OVERHEAD) +
+           list_entries * sizeof(int32_t) + dfa->bucket_count * sizeof(int32_t);
+}
+
+static uint32_t hash_list(const int32_t *list, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint32_t)list[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static void dfa_rehash(RegexDfa *dfa) {
+    for (size_t i = 0; i < dfa->bucket_count; i++) dfa->buckets[i] = -1;
+
+    for (size_t s = 0; s < dfa->state_count; s++) {
+        size_t slot = hash_list(dfa->lists + dfa->list_offsets[s], dfa->list_lengths[s]) &
+                      (dfa->bucket_count - 1);
+        while (dfa->buckets[slot] >= 0) slot = (slot + 1) & (dfa->bucket_count - 1);
+        dfa->buckets[slot] = (int32_t)s;
+    }
+}
+
+static bool dfa_reserve(RegexDfa *dfa, size_t list_length) {
+    size_t stride = dfa_stride(dfa);
+
+    if (dfa->state_count == dfa->state_capacity) {
+        size_t capacity = dfa->state_capacity ? dfa->state_capacity * 2 : 64;
+        int32_t *table = REALLOC(dfa->table, capacity * stride * sizeof(int32_t));
+        if (!table) return false;
+        dfa->table = table;
+        unsigned char *matching = REALLOC(dfa->matching, capacity);
+        if (!matching) return false;
+        dfa->matching = matching;
+        size_t *offsets = REALLOC(dfa->list_offsets, capacity * sizeof(size_t));
+        if (!offsets) return false;
+        dfa->list_offsets = offsets;
+        size_t *lengths = REALLOC(dfa->list_lengths, capacity * sizeof(size_t));
+        if (!lengths) return false;
+        dfa->list_lengths = lengths;
+        dfa->state_capacity = capacity;
+    }
+
+    if (dfa->lists_used + list_length > dfa->lists_capacity) {
+        size_t capacity = dfa->lists_capacity ? dfa->lists_capacity * 2 : 1024;
+        while (capacity < dfa->lists_used + list_length) capacity *= 2;
+        int32_t *lists = REALLOC(dfa->lists, capacity * sizeof(int32_t));
+        if (!lists) return false;
+        dfa->lists = lists;
+        dfa->lists_capacity = capacity;
+    }
+
+    // Keep the hash table at most half full
+    if ((dfa->state_count + 1) * 2 > dfa->bucket_count) {
+        size_t count = dfa->bucket_count ? dfa->bucket_count * 2 : 128;
+        int32_t *buckets = REALLOC(dfa->buckets, count * sizeof(int32_t));
+        if (!buckets) return false;
+        dfa->buckets = buckets;
+        dfa->bucket_count = count;
+        dfa_rehash(dfa);
+    }
+
+    return true;
+}
+
+// The state for an NFA state list, added if new. Flushes the cache first
+// when the new state would not fit the budget.
+static int32_t dfa_intern(RegexDfa *dfa, const int32_t *list, size_t length, bool matching) {
+    uint32_t hash = hash_list(list, length);
+
+    if (dfa->bucket_count > 0) {
+        size_t slot = hash & (dfa->bucket_count - 1);
+        for (int32_t s; (s = dfa->buckets[slot]) >= 0; slot = (slot + 1) & (dfa->bucket_count - 1)) {
+            if (dfa->list_lengths[s] == length &&
+                memcmp(dfa->lists + dfa->list_offsets[s], list, length * sizeof(int32_t)) == 0) {
+                return s;
+            }
+        }
+    }
+
+    if (dfa->state_count > 0 &&
+        dfa_bytes(dfa, dfa->state_count + 1, dfa->lists_used + length) > dfa->budget) {
+        dfa_flush(dfa);
+    }
+    if (!dfa_reserve(dfa, length)) return STATE_DEAD;
+
+    int32_t state = (int32_t)dfa->state_count++;
+    size_t stride = dfa_stride(dfa);
+    for (size_t i = 0; i < stride; i++) {
+        dfa->table[(size_t)state * stride + i] = STATE_UNKNOWN;
+    }
+    dfa->matching[state] = matching;
+    dfa->list_offsets[state] = dfa->lists_used;
+    dfa->list_lengths[state] = length;
+    memcpy(dfa->lists + dfa->lists_used, list, length * sizeof(int32_t));
+    dfa->lists_used += length;
+
+    size_t slot = hash & (dfa->bucket_count - 1);
+    while (dfa->buckets[slot] >= 0) slot = (slot + 1) & (dfa->bucket_count - 1);
+    dfa->buckets[slot] = state;
+    return state;
+}
+
+static void dfa_next_generation(RegexDfa *dfa) {
+    if (++dfa->generation == 0) {
+        memset(dfa->marks, 0, dfa->program->count * sizeof(uint32_t));
+        dfa->generation = 1;
+    }
+}
+
+// Appends the states reachable from `pc` without consuming a byte, in
+// priority order. Assertions that cannot hold yet are kept in the list
+// (end of scan) or dropped for good (start of scan).
+static void dfa_closure(RegexDfa *dfa, int32_t pc, bool at_start, bool at_end,
+                        size_t *length, bool *matching) {
+    const Inst *insts = dfa->program->insts;
+    size_t top = 0;
+
+    dfa->stack[top++] = pc;
+    while (top > 0) {
+        pc = dfa->stack[--top];
+        if (dfa->marks[pc] == dfa->generation) continue;
+        dfa->marks[pc] = dfa->generation;
+
+        const Inst *inst = &insts[pc];
+        switch (inst->type) {
+            case INST_SPLIT:
+                dfa->stack[top++] = inst->out1;
+                dfa->stack[top++] = inst->out;
+                break;
+
+            case INST_ASSERT_START:
+                if (at_start) dfa->stack[top++] = inst->out;
+                break;
+
+            case INST_ASSERT_END:
+                if (at_end) {
+                    dfa->stack[top++] = inst->out;
+                } else {
+                    dfa->scratch[(*length)++] = pc;
+                }
+                break;
+
+            case INST_MATCH:
+                *matching = true;
+                dfa->scratch[(*length)++] = pc;
+                break;
+
+            case INST_SET:
+                dfa->scratch[(*length)++] = pc;
+                break;
+        }
+    }
+}
+
+// Leftmost-first: threads after a match have lower priority than it and
+// can never be reported, so the list ends there
+static size_t dfa_truncate(const RegexDfa *dfa, size_t length) {
+    if (dfa->longest) return length;
+
+    for (size_t i = 0; i < length; i++) {
+        if (dfa->program->insts[dfa->scratch[i]].type == INST_MATCH) return i + 1;
+    }
+    return length;
+}
+
+// The state before the first byte. A scan over nothing is at its start
+// and its end at once, which is the only way $ can be followed by ^.
+static int32_t dfa_start(RegexDfa *dfa, bool at_start, bool at_end) {
+    int index = (at_start ? 1 : 0) | (at_end ? 2 : 0);
+    int32_t state = dfa->starts[index];
+    if (state != STATE_UNKNOWN) return state;
+
+    size_t length = 0;
+    bool matching = false;
+    dfa_next_generation(dfa);
+    dfa_closure(dfa, dfa->program->start, at_start, at_end, &length, &matching);
+    length = dfa_truncate(dfa, length);
+
+    state = length > 0 ? dfa_intern(dfa, dfa->scratch, length, matching) : STATE_DEAD;
+    dfa->starts[index] = state;
+    return state;
+}
+
+// Subset construction for one transition; class `class_count` is the end
+// of the scan. The transition is cached unless building it flushed the
+// cache, which invalidates `state`.
+static int32_t dfa_compute(RegexDfa *dfa, int32_t state, int byte_class) {
+    const RegexProgram *program = dfa->program;
+    const int32_t *list = dfa->lists + dfa->list_offsets[state];
+    size_t count = dfa->list_lengths[state];
+    bool at_end = byte_class == program->class_count;
+    unsigned char byte = program->class_byte[at_end ? 0 : byte_class];
+    size_t length = 0;
+    bool matching = false;
+
+    dfa_next_generation(dfa);
+    for (size_t i = 0; i < count; i++) {
+        const Inst *inst = &program->insts[list[i]];
+
+        if (inst->type == INST_MATCH) {
+            if (at_end) dfa_closure(dfa, list[i], false, true, &length, &matching);
+            if (!dfa->longest) break;
+        } else if (at_end) {
+            if (inst->type == INST_ASSERT_END) {
+                dfa_closure(dfa, inst->out, false, true, &length, &matching);
+            }
+        } else if (inst->type == INST_SET && set_has(&program->sets[inst->set], byte)) {
+            dfa_closure(dfa, inst->out, false, false, &length, &matching);
+        }
+    }
+    length = dfa_truncate(dfa, length);
+
+    size_t flushes = dfa->flushes;
+    int32_t next = length > 0 ? dfa_intern(dfa, dfa->scratch, length, matching) : STATE_DEAD;
+    if (dfa->flushes == flushes) {
+        dfa->table[(size_t)state * dfa_stride(dfa) + (size_t)byte_class] = next;
+    }
+    return next;
+}
+
+static inline int32_t dfa_step(RegexDfa *dfa, int32_t state, int byte_class) {
+    int32_t next = dfa->table[(size_t)state * dfa_stride(dfa) + (size_t)byte_class];
+    return next != STATE_UNKNOWN ? next : dfa_compute(dfa, state, byte_class);
+}
+
+// ---------------------------------------------------------------------
+// Matching
+// ---------------------------------------------------------------------
+
+int regex_compile(Regex *re, const char *pattern, bool case_sensitive,
+                  char *error, size_t error_size) {
+    memset(re, 0, sizeof(*re));
+
+    Parser p;
+    memset(&p, 0, sizeof(p));
+    p.pattern = pattern;
+    p.length = strlen(pattern);
+    p.case_sensitive = case_sensitive;
+    p.error = error;
+    p.error_size = error_size;
+
+    int root = parse_alternation(&p);
+    if (root >= 0 && p.position < p.length) parse_fail(&p, "unmatched )");
+
+    int status = SUCCESS;
+    if (p.failed) {
+        status = ERROR_PARSE_ERROR;
+    } else {
+        re->class_count = compute_byte_classes(&p, re->byte_class);
+        re->forward = compile_program(&p, root, re->byte_class, re->class_count, false);
+        re->reverse = compile_program(&p, root, re->byte_class, re->class_count, true);
+
+        if (!re->forward || !re->reverse) {
+            snprintf(error, error_size, "out of memory");
+            status = ERROR_MEMORY_ALLOCATION;
+        } else if (re->forward->overflow || re->reverse->overflow) {
+            snprintf(error, error_size, "pattern compiles to more than %d states",
+                     REGEX_MAX_PROGRAM);
+            status = ERROR_PARSE_ERROR;
+        } else if (!dfa_init(&re->forward_dfa, re->forward, false) ||
+                   !dfa_init(&re->reverse_dfa, re->reverse, true)) {
+            snprintf(error, error_size, "out of memory");
+            status = ERROR_MEMORY_ALLOCATION;
+        }
+    }
+
+    FREE(p.nodes);
+    FREE(p.sets);
+    if (status != SUCCESS) regex_free(re);
+    return status;
+}
+
+void regex_free(Regex *re) {
+    dfa_free(&re->forward_dfa);
+    dfa_free(&re->reverse_dfa);
+    free_program(re->forward);
+    free_program(re->reverse);
+    memset(re, 0, sizeof(*re));
+}
+
+// Runs the forward DFA from `from`. With `earliest` it stops at the first
+// match end; otherwise it runs until the leftmost-first match can no
+// longer grow and reports where it ends.
+static bool forward_scan(Regex *re, const char *text, size_t length, size_t from,
+                         bool earliest, size_t *end) {
+    RegexDfa *dfa = &re->forward_dfa;
+    size_t stride = (size_t)re->class_count + 1;
+    bool found = false;
+
+    int32_t state = dfa_start(dfa, from == 0, from == length);
+    if (state < 0) return false;
+    if (dfa->matching[state]) {
+        found = true;
+        *end = from;
+        if (earliest) return true;
+    }
+
+    if (from == length) return found;
+
+    for (size_t i = from; i < length; i++) {
+        int byte_class = re->byte_class[(unsigned char)text[i]];
+        int32_t next = dfa->table[(size_t)state * stride + (size_t)byte_class];
+        if (next == STATE_UNKNOWN) next = dfa_compute(dfa, state, byte_class);
+        if (next == STATE_DEAD) return found;
+
+        state = next;
+        if (dfa->matching[state]) {
+            found = true;
+            *end = i + 1;
+            if (earliest) return true;
+        }
+    }
+
+    int32_t next = dfa_step(dfa, state, re->class_count);
+    if (next >= 0 && dfa->matching[next]) {
+        found = true;
+        *end = length;
+    }
+    return found;
+}
+
+// Runs the reversed pattern backwards from a match end down to `from` and
+// returns the smallest offset where a match ending at `end` can start
+static size_t reverse_scan(Regex *re, const char *text, size_t length, size_t from, size_t end) {
+    RegexDfa *dfa = &re->reverse_dfa;
+    size_t start = end;
+
+    int32_t state = dfa_start(dfa, end == length, end == from && from == 0);
+    if (state < 0) return start;
+
+    size_t i = end;
+    for (; i > from; i--) {
+        int32_t next = dfa_step(dfa, state, re->byte_class[(unsigned char)text[i - 1]]);
+        if (next == STATE_DEAD) return start;
+        state = next;
+        if (dfa->matching[state]) start = i - 1;
+    }
+
+    // ^ holds only at the real start of the subject
+    if (from == 0 && end > 0) {
+        int32_t next = dfa_step(dfa, state, re->class_count);
+        if (next >= 0 && dfa->matching[next]) start = 0;
+    }
+    return start;
+}
+
+bool regex_is_match(Regex *re, const char *text, size_t length) {
+    size_t end;
+    return forward_scan(re, text, length, 0, true, &end);
+}
+
+bool regex_find(Regex *re, const char *text, size_t length, size_t from,
+                size_t *start, size_t *end) {
+    if (from > length || !forward_scan(re, text, length, from, false, end)) return false;
+
+    *start = reverse_scan(re, text, length, from, *end);
+    return true;
+}
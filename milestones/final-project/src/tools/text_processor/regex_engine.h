@@ -0,0 +1,83 @@
+#ifndef DEVTOOLS_REGEX_ENGINE_H
+#define DEVTOOLS_REGEX_ENGINE_H
+
+#include "../../config.h"
+
+// Linear-time regular expressions.
+//
+// A pattern is parsed into a syntax tree and compiled twice into Thompson
+// NFAs: a forward program with an unanchored prefix, and the reversed
+// pattern for finding where a match starts. Both run as lazy DFAs whose
+// states are the ordered sets of NFA states reachable after each byte.
+// States are built on first use and cached; when a cache outgrows its
+// budget it is flushed and rebuilt from the current position. Every byte
+// costs at most one DFA step, or one subset construction over the NFA
+// when the state is new, so no pattern can backtrack.
+//
+// Matching is leftmost-first (Perl order: earlier alternatives and greedy
+// quantifiers win) within a single line. Supported syntax:
+//   literals, .  [...] [^...]  \d \D \w \W \s \S \t \n \r \f \v \xHH
+//   escaped punctuation, * + ? {n} {n,} {n,m} (and lazy *? +? ?? {..}?)
+//   | ( ) (?: )  ^ $
+// Backreferences and look-around cannot run in a DFA and are rejected.
+
+#define REGEX_MAX_REPEAT 1000
+#define REGEX_MAX_PROGRAM 100000
+#define REGEX_MAX_DEPTH 256
+#define REGEX_CACHE_BYTES (2 * 1024 * 1024)
+
+typedef struct RegexProgram RegexProgram;
+
+// Lazily built DFA over one program
+typedef struct {
+    const RegexProgram *program;
+    bool longest;               // keep matching after the first match ends
+
+    int32_t *table;             // state * stride + byte class; -2 not built, -1 dead
+    unsigned char *matching;    // per state: a match ends here
+    size_t *list_offsets;       // per state: its NFA states in `lists`
+    size_t *list_lengths;
+    size_t state_count;
+    size_t state_capacity;
+
+    int32_t *lists;
+    size_t lists_used;
+    size_t lists_capacity;
+
+    int32_t *buckets;           // hash of NFA state list -> DFA state
+    size_t bucket_count;
+
+    int32_t starts[4];          // by at start (bit 0) / at end (bit 1) of the scan
+    size_t budget;
+    size_t flushes;
+
+    // Subset construction scratch space
+    int32_t *scratch;
+    int32_t *stack;
+    uint32_t *marks;
+    uint32_t generation;
+} RegexDfa;
+
+typedef struct {
+    RegexProgram *forward;
+    RegexProgram *reverse;
+    RegexDfa forward_dfa;
+    RegexDfa reverse_dfa;
+    unsigned char byte_class[256];
+    int class_count;
+} Regex;
+
+// Returns ERROR_PARSE_ERROR with a message in `error` for invalid patterns
+int regex_compile(Regex *re, const char *pattern, bool case_sensitive,
+                  char *error, size_t error_size);
+void regex_free(Regex *re);
+
+// Whether text[0, length) contains a match; stops at the first match end
+bool regex_is_match(Regex *re, const char *text, size_t length);
+
+// Leftmost-first match starting at or after `from`. Anchors see the whole
+// subject, so ^ only matches at offset 0.
+bool regex_find(Regex *re, const char *text, size_t length, size_t from,
+                size_t *start, size_t *end);
+
+#endif // DEVTOOLS_REGEX_ENGINE_H
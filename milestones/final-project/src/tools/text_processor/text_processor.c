@@ -0,0 +1,1236 @@
+#include "text_processor.h"
+#include "../../common/error.h"
+#include "../../common/file_map.h"
+#include "../../common/logging.h"
+#include "../../common/memory.h"
+#include "../../common/stream.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SEARCH_BLOCK_SIZE (4 * 1024 * 1024)
+#define BENCH_ROUNDS 3
+#define BINARY_PROBE 8192
+
+static double elapsed_seconds(const struct timespec *start, const struct timespec *end) {
+    return (double)(end->tv_sec - start->tv_sec) +
+           (double)(end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static bool is_word_byte(unsigned char c) {
+    return isalnum(c) || c == '_';
+}
+
+// Whole-word mode: the match must not continue a word on either side
+static bool match_allowed(const TextProcessorConfig *config, const char *text, size_t length,
+                          const TextMatch *match) {
+    if (!config->whole_words) return true;
+    if (match->start > 0 && is_word_byte((unsigned char)text[match->start - 1])) return false;
+    if (match->end < length && is_word_byte((unsigned char)text[match->end])) return false;
+    return true;
+}
+
+int text_search_init(TextSearch *search, const TextProcessorConfig *config,
+                     const char *pattern_file) {
+    memset(search, 0, sizeof(*search));
+    search->config = config;
+    search->pattern_file = pattern_file;
+    search->out = stdout;
+    ac_init(&search->matcher, config->case_sensitive);
+
+    if (config->regex_mode && pattern_file) {
+        LOG_ERROR("Regex mode takes a single pattern, not a pattern file");
+        return ERROR_INVALID_ARGUMENT;
+    }
+
+    if (pattern_file) {
+        int status = ac_load_patterns(&search->matcher, pattern_file);
+        if (status != SUCCESS) {
+            LOG_ERROR("Cannot read patterns from %s", pattern_file);
+            return status;
+        }
+    } else if (!ac_add_pattern(&search->matcher, config->search_term, strlen(config->search_term))) {
+        return ERROR_MEMORY_ALLOCATION;
+    }
+
+    if (search->matcher.pattern_count == 0) {
+        LOG_ERROR("No search pattern given");
+        return ERROR_INVALID_ARGUMENT;
+    }
+
+    if (!ac_build(&search->matcher)) return ERROR_MEMORY_ALLOCATION;
+
+    if (config->regex_mode) {
+        char error[MAX_STRING_LENGTH];
+        int status = regex_compile(&search->regex, config->search_term, config->case_sensitive,
+                                   error, sizeof(error));
+        if (status != SUCCESS) {
+            LOG_ERROR("Invalid regex: %s", error);
+            return status;
+        }
+        search->use_regex = true;
+    }
+
+    const AhoCorasick *ac = &search->matcher;
+    if (ac->pattern_count == 1 && !config->whole_words && !config->regex_mode &&
+        !memchr(ac->patterns[0], '\n', ac->lengths[0])) {
+        literal_init(&search->literal, ac->patterns[0], ac->lengths[0], config->case_sensitive);
+        search->use_literal = true;
+    }
+
+    search->pattern_hits = MALLOC(search->matcher.pattern_count * sizeof(size_t));
+    if (!search->pattern_hits) return ERROR_MEMORY_ALLOCATION;
+    memset(search->pattern_hits, 0, search->matcher.pattern_count * sizeof(size_t));
+
+    return SUCCESS;
+}
+
+void text_search_free(TextSearch *search) {
+    ac_free(&search->matcher);
+    if (search->use_regex) regex_free(&search->regex);
+    FREE(search->pattern_hits);
+}
+
+// ---------------------------------------------------------------------
+// Search
+// ---------------------------------------------------------------------
+
+typedef struct {
+    TextSearch *search;
+    const char *line;
+    size_t length;
+    size_t hits;
+} LineScan;
+
+static bool on_line_match(const TextMatch *match, void *ctx) {
+    LineScan *scan = (LineScan*)ctx;
+    TextSearch *search = scan->search;
+
+    if (!match_allowed(search->config, scan->line, scan->length, match)) return true;
+
+    scan->hits++;
+    search->pattern_hits[match->pattern]++;
+
+    // Printing lines only needs to know that there is a match
+    return search->count_only;
+}
+
+// Matches of the regex in one line that pass the whole-word filter. Line
+// output only needs the first; without -w that is a single forward scan
+// that stops at the first match end.
+static size_t regex_line_hits(TextSearch *search, const char *line, size_t length) {
+    if (!search->count_only && !search->config->whole_words) {
+        return regex_is_match(&search->regex, line, length) ? 1 : 0;
+    }
+
+    size_t hits = 0;
+    size_t from = 0;
+    TextMatch match = { .pattern = 0 };
+
+    while (regex_find(&search->regex, line, length, from, &match.start, &match.end)) {
+        if (match_allowed(search->config, line, length, &match)) {
+            hits++;
+            if (!search->count_only) break;
+            from = match.end > match.start ? match.end : match.end + 1;
+        } else {
+            from = match.start + 1;
+        }
+    }
+
+    search->pattern_hits[0] += hits;
+    return hits;
+}
+
+// One line of context kept for printing later. `text` points into the
+// input until the region it lies in goes away; then it is copied to `copy`.
+typedef struct {
+    const char *text;
+    size_t length;
+    size_t line_number;
+    char *copy;
+    size_t capacity;
+} ContextLine;
+
+// Context output (-C): a fixed ring of the last lines passed over without
+// being printed, so the lines before a match can be printed when it turns
+// up without seeking back or reading the input again
+typedef struct {
+    ContextLine *lines;         // `size` slots, oldest at `head`
+    size_t size;
+    size_t head;
+    size_t count;
+    size_t last_printed;        // 0 before the first line is printed
+    size_t after;               // lines after the last match still to print
+} ContextRing;
+
+// Block search state for one file. Regions handed to scan_region are whole
+// lines, so line numbers only need the newlines between matches counted.
+typedef struct {
+    TextSearch *search;
+    const char *name;           // output prefix, NULL for none
+    size_t line_number;         // number of the line the next region starts with
+    size_t last_matched;        // last line counted in matched_lines
+    ContextRing *context;       // NULL without context lines
+} BlockScan;
+
+// Matched lines are "N:line", context lines "N-line" (grep's format).
+// Context multiplies the lines printed, so no format string is parsed
+// per line.
+static void print_line(FILE *out, const char *name, size_t line_number, char separator,
+                       const char *line, size_t length) {
+    char number[24];
+    size_t at = sizeof(number);
+
+    number[--at] = separator;
+    do {
+        number[--at] = (char)('0' + line_number % 10);
+        line_number /= 10;
+    } while (line_number > 0);
+
+    if (name) {
+        fputs(name, out);
+        putc(separator, out);
+    }
+    fwrite(number + at, 1, sizeof(number) - at, out);
+    fwrite(line, 1, length, out);
+    putc('\n', out);
+}
+
+// Literal search: the filter runs over the whole region and only matches
+// are taken apart into lines
+static void scan_literal(BlockScan *scan, const char *text, size_t length) {
+    TextSearch *search = scan->search;
+    size_t line_number = scan->line_number;
+    size_t counted = 0;
+    size_t position = 0;
+
+    while (position < length) {
+        size_t at = position + literal_find(&search->literal, text + position, length - position);
+        if (at >= length) break;
+
+        line_number += literal_count_lines(text + counted, at - counted);
+        counted = at;
+        search->matches++;
+        search->pattern_hits[0]++;
+        if (line_number != scan->last_matched) {
+            search->matched_lines++;
+            scan->last_matched = line_number;
+        }
+
+        if (search->count_only) {
+            position = at + 1;
+            continue;
+        }
+
+        // Only now look for the line around the match
+        size_t start = at;
+        while (start > 0 && text[start - 1] != '\n') start--;
+        const char *newline = memchr(text + at, '\n', length - at);
+        size_t end = newline ? (size_t)(newline - text) : length;
+
+        print_line(search->out, scan->name, line_number, ':', text + start, end - start);
+        position = end + 1;
+    }
+
+    if (counted < length) {
+        line_number += literal_count_lines(text + counted, length - counted);
+    }
+    scan->line_number = line_number;
+}
+
+// Line by line through the automaton or the regex
+static void scan_lines(BlockScan *scan, const char *text, size_t length) {
+    TextSearch *search = scan->search;
+    const char *line = text;
+    const char *end = text + length;
+
+    while (line < end) {
+        const char *newline = memchr(line, '\n', (size_t)(end - line));
+        LineScan line_scan = {
+            .search = search,
+            .line = line,
+            .length = newline ? (size_t)(newline - line) : (size_t)(end - line),
+            .hits = 0
+        };
+
+        if (search->use_regex) {
+            line_scan.hits = regex_line_hits(search, line, line_scan.length);
+        } else {
+            ac_scan(&search->matcher, line, line_scan.length, on_line_match, &line_scan);
+        }
+
+        if (line_scan.hits > 0) {
+            search->matched_lines++;
+            search->matches += line_scan.hits;
+            if (!search->count_only) {
+                print_line(search->out, scan->name, scan->line_number, ':',
+                           line, line_scan.length);
+            }
+        }
+
+        scan->line_number++;
+        if (!newline) break;
+        line = newline + 1;
+    }
+}
+
+// ---------------------------------------------------------------------
+// Context lines
+// ---------------------------------------------------------------------
+
+static ContextRing* context_create(size_t size) {
+    ContextRing *ring = MALLOC(sizeof(ContextRing));
+    if (!ring) return NULL;
+    memset(ring, 0, sizeof(*ring));
+
+    ring->lines = MALLOC(size * sizeof(ContextLine));
+    if (!ring->lines) {
+        FREE(ring);
+        return NULL;
+    }
+    memset(ring->lines, 0, size * sizeof(ContextLine));
+    ring->size = size;
+    return ring;
+}
+
+static void context_free(ContextRing *ring) {
+    if (!ring) return;
+
+    for (size_t i = 0; i < ring->size; i++) {
+        FREE(ring->lines[i].copy);
+    }
+    FREE(ring->lines);
+    FREE(ring);
+}
+
+static void context_push(ContextRing *ring, const char *text, size_t length, size_t line_number) {
+    size_t slot = (ring->head + ring->count) % ring->size;
+    if (ring->count == ring->size) {
+        ring->head = (ring->head + 1) % ring->size;
+    } else {
+        ring->count++;
+    }
+
+    ring->lines[slot].text = text;
+    ring->lines[slot].length = length;
+    ring->lines[slot].line_number = line_number;
+}
+
+// Copy the kept lines out of a region that is about to be released. Only
+// block input needs this, and only for the few lines in the ring; a
+// mapped file is one region that outlives the scan.
+static bool context_pin(ContextRing *ring) {
+    for (size_t i = 0; i < ring->count; i++) {
+        ContextLine *line = &ring->lines[(ring->head + i) % ring->size];
+        if (line->text == line->copy) continue;
+
+        if (line->length > line->capacity || !line->copy) {
+            char *grown = REALLOC(line->copy, line->length + 1);
+            if (!grown) return false;
+            line->copy = grown;
+            line->capacity = line->length + 1;
+        }
+        memcpy(line->copy, line->text, line->length);
+        line->text = line->copy;
+    }
+    return true;
+}
+
+static void print_context_line(BlockScan *scan, size_t line_number, char separator,
+                               const char *text, size_t length) {
+    ContextRing *ring = scan->context;
+
+    // Groups that do not touch are separated like grep does it, also
+    // between files
+    if (ring->last_printed > 0 ? line_number > ring->last_printed + 1
+                               : scan->search->context_printed) {
+        fputs("--\n", scan->search->out);
+    }
+    scan->search->context_printed = true;
+    print_line(scan->search->out, scan->name, line_number, separator, text, length);
+    ring->last_printed = line_number;
+}
+
+// Lines text[from, to) hold no match. The first ones may still be owed as
+// context after the last match; of the rest only the last ring-size lines
+// can be printed before the next match, so only those are walked back to
+// and kept, however long the gap is.
+static void context_gap(BlockScan *scan, const char *text, size_t from, size_t to) {
+    ContextRing *ring = scan->context;
+    const char *p = text + from;
+    const char *end = text + to;
+
+    while (ring->after > 0 && p < end) {
+        const char *newline = memchr(p, '\n', (size_t)(end - p));
+        size_t length = newline ? (size_t)(newline - p) : (size_t)(end - p);
+
+        print_context_line(scan, scan->line_number, '-', p, length);
+        scan->line_number++;
+        ring->after--;
+        p = newline ? newline + 1 : end;
+    }
+    if (p >= end) return;
+
+    size_t skipped = literal_count_lines(p, (size_t)(end - p)) + (end[-1] != '\n');
+    size_t keep = skipped < ring->size ? skipped : ring->size;
+
+    // Back to the start of the first line kept
+    const char *line = end[-1] == '\n' ? end - 1 : end;
+    for (size_t k = 0; k < keep; k++) {
+        while (line > p && line[-1] != '\n') line--;
+        if (k + 1 < keep) line--;
+    }
+
+    size_t line_number = scan->line_number + skipped - keep;
+    for (size_t k = 0; k < keep; k++) {
+        const char *newline = memchr(line, '\n', (size_t)(end - line));
+        size_t length = newline ? (size_t)(newline - line) : (size_t)(end - line);
+        context_push(ring, line, length, line_number++);
+        line = newline ? newline + 1 : end;
+    }
+
+    scan->line_number += skipped;
+}
+
+static void context_match(BlockScan *scan, const char *line, size_t length) {
+    ContextRing *ring = scan->context;
+
+    for (size_t i = 0; i < ring->count; i++) {
+        const ContextLine *before = &ring->lines[(ring->head + i) % ring->size];
+        if (before->line_number > ring->last_printed &&
+            before->line_number + ring->size >= scan->line_number) {
+            print_context_line(scan, before->line_number, '-', before->text, before->length);
+        }
+    }
+
+    print_context_line(scan, scan->line_number, ':', line, length);
+    ring->count = 0;
+    ring->after = ring->size;
+}
+
+// The next matching line at or after `from` (a line start): its bounds and
+// its number of matches, 0 if there is none
+static size_t next_matching_line(BlockScan *scan, const char *text, size_t length, size_t from,
+                                 size_t *start, size_t *end) {
+    TextSearch *search = scan->search;
+
+    if (search->use_literal) {
+        size_t at = from + literal_find(&search->literal, text + from, length - from);
+        if (at >= length) return 0;
+
+        *start = at;
+        while (*start > from && text[*start - 1] != '\n') (*start)--;
+        const char *newline = memchr(text + at, '\n', length - at);
+        *end = newline ? (size_t)(newline - text) : length;
+        search->pattern_hits[0]++;
+        return 1;
+    }
+
+    while (from < length) {
+        const char *line = text + from;
+        const char *newline = memchr(line, '\n', length - from);
+        LineScan line_scan = {
+            .search = search,
+            .line = line,
+            .length = newline ? (size_t)(newline - line) : length - from,
+            .hits = 0
+        };
+
+        if (search->use_regex) {
+            line_scan.hits = regex_line_hits(search, line, line_scan.length);
+        } else {
+            ac_scan(&search->matcher, line, line_scan.length, on_line_match, &line_scan);
+        }
+        if (line_scan.hits > 0) {
+            *start = from;
+            *end = from + line_scan.length;
+            return line_scan.hits;
+        }
+
+        from += line_scan.length + 1;
+    }
+    return 0;
+}
+
+// Matching lines with the lines around them
+static void scan_context(BlockScan *scan, const char *text, size_t length) {
+    TextSearch *search = scan->search;
+    size_t position = 0;
+
+    while (position < length) {
+        size_t start = 0, end = 0;
+        size_t hits = next_matching_line(scan, text, length, position, &start, &end);
+
+        context_gap(scan, text, position, hits > 0 ? start : length);
+        if (hits == 0) break;
+
+        search->matched_lines++;
+        search->matches += hits;
+        context_match(scan, text + start, end - start);
+        scan->line_number++;
+        position = end + 1;
+    }
+}
+
+static void scan_region(BlockScan *scan, const char *text, size_t length) {
+    if (scan->context) {
+        scan_context(scan, text, length);
+    } else if (scan->search->use_literal) {
+        scan_literal(scan, text, length);
+    } else {
+        scan_lines(scan, text, length);
+    }
+}
+
+static bool append_carry(char **carry, size_t *length, size_t *capacity,
+                         const char *data, size_t size) {
+    if (*length + size > *capacity) {
+        size_t grown_capacity = *capacity ? *capacity * 2 : 4096;
+        while (grown_capacity < *length + size) grown_capacity *= 2;
+
+        char *grown = REALLOC(*carry, grown_capacity);
+        if (!grown) return false;
+        *carry = grown;
+        *capacity = grown_capacity;
+    }
+
+    memcpy(*carry + *length, data, size);
+    *length += size;
+    return true;
+}
+
+// Input that cannot be mapped (pipes, terminals) is read in blocks. The
+// lines complete in a block are searched where they lie; a line cut by the
+// block boundary is joined in `carry` and searched once its newline
+// arrives.
+static int search_blocks(BlockScan *scan, int fd) {
+    StreamReader reader;
+    int status = stream_reader_open(&reader, fd, SEARCH_BLOCK_SIZE, 0);
+    if (status != SUCCESS) return status;
+
+    char *carry = NULL;
+    size_t carry_length = 0, carry_capacity = 0;
+
+    for (;;) {
+        char *data;
+        ssize_t n = stream_reader_next(&reader, &data);
+        if (n < 0) {
+            LOG_ERROR("Read failed: %s", strerror(errno));
+            status = ERROR_PERMISSION_DENIED;
+            break;
+        }
+        if (n == 0) {
+            if (carry_length > 0) scan_region(scan, carry, carry_length);
+            break;
+        }
+
+        const char *p = data;
+        const char *end = data + n;
+
+        if (carry_length > 0) {
+            const char *newline = memchr(p, '\n', (size_t)n);
+            size_t head = newline ? (size_t)(newline + 1 - p) : (size_t)n;
+            if (!append_carry(&carry, &carry_length, &carry_capacity, p, head)) {
+                status = ERROR_MEMORY_ALLOCATION;
+                break;
+            }
+            p += head;
+            if (!newline) continue;
+
+            scan_region(scan, carry, carry_length);
+            carry_length = 0;
+            if (scan->context && !context_pin(scan->context)) {
+                status = ERROR_MEMORY_ALLOCATION;
+                break;
+            }
+        }
+
+        const char *tail = end;
+        while (tail > p && tail[-1] != '\n') tail--;
+
+        scan_region(scan, p, (size_t)(tail - p));
+        if (scan->context && !context_pin(scan->context)) {
+            status = ERROR_MEMORY_ALLOCATION;
+            break;
+        }
+        if (!append_carry(&carry, &carry_length, &carry_capacity, tail, (size_t)(end - tail))) {
+            status = ERROR_MEMORY_ALLOCATION;
+            break;
+        }
+    }
+
+    FREE(carry);
+    stream_reader_close(&reader);
+    return status;
+}
+
+// Regular files are scanned in place through a mapping; anything else is
+// read in blocks
+int text_search_file(TextSearch *search, const char *filename) {
+    bool from_stdin = strcmp(filename, "-") == 0;
+    int fd = from_stdin ? STDIN_FILENO : open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "text-processor: %s: %s\n", filename, strerror(errno));
+        return errno == ENOENT ? ERROR_FILE_NOT_FOUND : ERROR_PERMISSION_DENIED;
+    }
+
+    search->files++;
+    BlockScan scan = {
+        .search = search,
+        .name = search->show_names ? (from_stdin ? "(stdin)" : filename) : NULL,
+        .line_number = 1,
+        .last_matched = 0,
+        .context = NULL
+    };
+
+    // Context only makes sense when lines are printed
+    if (search->config->context_lines > 0 && !search->count_only) {
+        scan.context = context_create((size_t)search->config->context_lines);
+        if (!scan.context) {
+            if (!from_stdin) close(fd);
+            return ERROR_MEMORY_ALLOCATION;
+        }
+    }
+
+    int status;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        FileMap map;
+        status = file_map_fd(&map, fd);
+        if (status == SUCCESS) {
+            scan_region(&scan, map.data, map.length);
+            file_map_close(&map);
+        } else {
+            fprintf(stderr, "text-processor: %s: %s\n", filename, strerror(errno));
+        }
+    } else {
+        status = search_blocks(&scan, fd);
+    }
+
+    context_free(scan.context);
+    if (!from_stdin) close(fd);
+    return status;
+}
+
+// ---------------------------------------------------------------------
+// Replace
+// ---------------------------------------------------------------------
+
+typedef struct {
+    TextSearch *search;
+    const char *text;
+    size_t length;
+    TextMatch *matches;
+    size_t count;
+    size_t capacity;
+    bool failed;
+} MatchList;
+
+static bool collect_match(const TextMatch *match, void *ctx) {
+    MatchList *list = (MatchList*)ctx;
+
+    if (!match_allowed(list->search->config, list->text, list->length, match)) return true;
+
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 256;
+        TextMatch *grown = REALLOC(list->matches, capacity * sizeof(TextMatch));
+        if (!grown) {
+            list->failed = true;
+            return false;
+        }
+        list->matches = grown;
+        list->capacity = capacity;
+    }
+
+    list->matches[list->count++] = *match;
+    return true;
+}
+
+// Regex matches never span lines: every line is a subject of its own, so
+// ^ and $ anchor at line boundaries. After an empty match the search
+// moves on by one byte.
+static void collect_regex_matches(Regex *re, MatchList *list) {
+    size_t line_start = 0;
+
+    while (line_start < list->length && !list->failed) {
+        const char *newline = memchr(list->text + line_start, '\n', list->length - line_start);
+        size_t line_end = newline ? (size_t)(newline - list->text) : list->length;
+        const char *line = list->text + line_start;
+        size_t line_length = line_end - line_start;
+        size_t from = 0;
+        TextMatch match = { .pattern = 0 };
+
+        while (regex_find(re, line, line_length, from, &match.start, &match.end)) {
+            size_t start = match.start, end = match.end;
+            match.start += line_start;
+            match.end += line_start;
+
+            if (!match_allowed(list->search->config, list->text, list->length, &match)) {
+                from = start + 1;
+                continue;
+            }
+            if (!collect_match(&match, list)) break;
+            from = end > start ? end : end + 1;
+        }
+
+        if (!newline) break;
+        line_start = line_end + 1;
+    }
+}
+
+// Leftmost first, longest first among matches starting at the same byte
+static int compare_matches(const void *a, const void *b) {
+    const TextMatch *x = (const TextMatch*)a;
+    const TextMatch *y = (const TextMatch*)b;
+
+    if (x->start != y->start) return x->start < y->start ? -1 : 1;
+    if (x->end != y->end) return x->end > y->end ? -1 : 1;
+    return 0;
+}
+
+static bool write_file(const char *filename, const char *data, size_t length) {
+    FILE *file = fopen(filename, "wb");
+    if (!file) return false;
+
+    bool ok = fwrite(data, 1, length, file) == length;
+    ok = fclose(file) == 0 && ok;
+    return ok;
+}
+
+static bool write_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t n = write(fd, data, length);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return false;
+        data += n;
+        length -= (size_t)n;
+    }
+
+    return true;
+}
+
+// Swap new contents into `filename` in one step: they are written to a
+// hidden temporary file in the same directory (so the rename cannot cross
+// file systems) with the original's permissions, then renamed over it.
+// Readers see either the old file or the new one, never a partial write.
+// The backup is a hard link to the original inode made before the rename,
+// falling back to a copy where links are not supported.
+static int rewrite_file(const TextSearch *search, const char *filename,
+                        const char *original, size_t original_length,
+                        const char *data, size_t length) {
+    struct stat st;
+    if (stat(filename, &st) != 0) {
+        LOG_ERROR("Cannot stat %s: %s", filename, strerror(errno));
+        return ERROR_FILE_NOT_FOUND;
+    }
+
+    const char *slash = strrchr(filename, '/');
+    int directory_length = slash ? (int)(slash + 1 - filename) : 0;
+    char temp[MAX_PATH_LENGTH];
+    if (snprintf(temp, sizeof(temp), "%.*s.%s.XXXXXX", directory_length, filename,
+                 filename + directory_length) >= (int)sizeof(temp)) {
+        LOG_ERROR("Path too long: %s", filename);
+        return ERROR_INVALID_ARGUMENT;
+    }
+
+    int fd = mkstemp(temp);
+    if (fd < 0) {
+        LOG_ERROR("Cannot rewrite %s: %s", filename, strerror(errno));
+        return ERROR_PERMISSION_DENIED;
+    }
+
+    bool ok = fchmod(fd, st.st_mode & 07777) == 0 && write_all(fd, data, length);
+    ok = close(fd) == 0 && ok;
+    if (!ok) {
+        LOG_ERROR("Cannot rewrite %s: %s", filename, strerror(errno));
+        unlink(temp);
+        return ERROR_PERMISSION_DENIED;
+    }
+
+    if (search->config->backup_files) {
+        char backup[MAX_PATH_LENGTH];
+        bool backed_up = snprintf(backup, sizeof(backup), "%s.bak", filename) < (int)sizeof(backup);
+        if (backed_up) {
+            unlink(backup);
+            backed_up = link(filename, backup) == 0 ||
+                        write_file(backup, original, original_length);
+        }
+        if (!backed_up) {
+            LOG_ERROR("Cannot write backup of %s", filename);
+            unlink(temp);
+            return ERROR_PERMISSION_DENIED;
+        }
+    }
+
+    if (rename(temp, filename) != 0) {
+        LOG_ERROR("Cannot rewrite %s: %s", filename, strerror(errno));
+        unlink(temp);
+        return ERROR_PERMISSION_DENIED;
+    }
+
+    return SUCCESS;
+}
+
+int text_replace_file(TextSearch *search, const char *filename) {
+    bool from_stdin = strcmp(filename, "-") == 0;
+    FileMap map;
+    int status = file_map_open(&map, filename);
+    if (status != SUCCESS) {
+        fprintf(stderr, "text-processor: %s: %s\n", filename, strerror(errno));
+        return status;
+    }
+
+    const char *text = map.data;
+    size_t length = map.length;
+
+    // A tree walk meets object files and images too; a NUL byte near the
+    // start is the usual sign of one, and rewriting it would corrupt it
+    size_t probe = length < BINARY_PROBE ? length : BINARY_PROBE;
+    if (search->config->recursive && memchr(text, '\0', probe)) {
+        file_map_close(&map);
+        return SUCCESS;
+    }
+
+    search->files++;
+
+    MatchList list = { .search = search, .text = text, .length = length };
+    if (search->use_regex) {
+        collect_regex_matches(&search->regex, &list);
+    } else {
+        ac_scan(&search->matcher, text, length, collect_match, &list);
+    }
+    if (list.failed) {
+        file_map_close(&map);
+        FREE(list.matches);
+        return ERROR_MEMORY_ALLOCATION;
+    }
+
+    if (list.count == 0) {
+        if (from_stdin) fwrite(text, 1, length, search->out);
+        file_map_close(&map);
+        FREE(list.matches);
+        return SUCCESS;
+    }
+
+    // Keep non-overlapping matches, leftmost-longest first
+    qsort(list.matches, list.count, sizeof(TextMatch), compare_matches);
+
+    const char *replacement = search->config->replace_term;
+    size_t replacement_length = strlen(replacement);
+    size_t kept = 0, end = 0;
+    for (size_t i = 0; i < list.count; i++) {
+        if (list.matches[i].start < end) continue;
+        list.matches[kept++] = list.matches[i];
+        end = list.matches[i].end;
+    }
+
+    size_t capacity = length + kept * replacement_length;
+    char *output = MALLOC(capacity + 1);
+    if (!output) {
+        file_map_close(&map);
+        FREE(list.matches);
+        return ERROR_MEMORY_ALLOCATION;
+    }
+
+    size_t out = 0, position = 0;
+    for (size_t i = 0; i < kept; i++) {
+        memcpy(output + out, text + position, list.matches[i].start - position);
+        out += list.matches[i].start - position;
+        memcpy(output + out, replacement, replacement_length);
+        out += replacement_length;
+        position = list.matches[i].end;
+    }
+    memcpy(output + out, text + position, length - position);
+    out += length - position;
+
+    search->matches += kept;
+
+    if (from_stdin) {
+        fwrite(output, 1, out, search->out);
+    } else {
+        status = rewrite_file(search, filename, text, length, output, out);
+        if (status == SUCCESS && !g_config.quiet) {
+            fprintf(search->out, "%s: %zu replacement%s\n", filename, kept, kept == 1 ? "" : "s");
+        }
+    }
+
+    file_map_close(&map);
+    FREE(output);
+    FREE(list.matches);
+    return status;
+}
+
+// ---------------------------------------------------------------------
+// Tool
+// ---------------------------------------------------------------------
+
+// Source-like lines; the rare term shows up in about one line in 4096
+static bool write_bench_corpus(int fd, size_t length, uint64_t *rng) {
+    static const char *lines[] = {
+        "#include <stdio.h>\n",
+        "static int parse_header(const char *data, size_t length) {\n",
+        "    if (length == 0) return -1;\n",
+        "    for (size_t i = 0; i < count; i++) {\n",
+        "        total += values[i] * scale;\n",
+        "    }\n",
+        "    // Skip the separator before the next field\n",
+        "    return (int)(end - start);\n",
+        "}\n",
+        "\n",
+        "        LOG_DEBUG(\"Processing %s\", entry->name);\n",
+        "    char buffer[MAX_LINE_LENGTH];\n",
+        "        status = read_block(file, buffer, sizeof(buffer));\n",
+        "typedef struct { int width; int height; } Size;\n",
+        "    memcpy(out + used, text, length);\n",
+        "            continue;\n"
+    };
+    static const char *rare = "    pthread_mutex_lock(&queue->lock);\n";
+    char *buffer = MALLOC(SEARCH_BLOCK_SIZE + 256);
+    if (!buffer) return false;
+
+    bool ok = true;
+    size_t written = 0;
+    while (ok && written < length) {
+        size_t used = 0;
+        while (used < SEARCH_BLOCK_SIZE) {
+            *rng ^= *rng << 13;
+            *rng ^= *rng >> 7;
+            *rng ^= *rng << 17;
+            const char *line = (*rng & 4095) == 0 ? rare :
+                               lines[(*rng >> 32) % (sizeof(lines) / sizeof(lines[0]))];
+            size_t line_length = strlen(line);
+            memcpy(buffer + used, line, line_length);
+            used += line_length;
+        }
+
+        ok = (size_t)write(fd, buffer, used) == used;
+        written += used;
+    }
+
+    FREE(buffer);
+    return ok;
+}
+
+// One timed search of `path`: best of BENCH_ROUNDS, counts only
+static double bench_search(TextSearch *search, const char *path) {
+    double best = 0;
+
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        search->files = search->matched_lines = search->matches = 0;
+        search->pattern_hits[0] = 0;
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        text_search_file(search, path);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        double t = elapsed_seconds(&start, &end);
+        if (round == 0 || t < best) best = t;
+    }
+
+    return best > 0 ? best : 1e-9;
+}
+
+// Compares the line-by-line automaton path with the block path under every
+// kernel the CPU supports, on a temporary file of generated source code.
+// Every block run must report the same line and match counts.
+static int run_benchmark(size_t megabytes) {
+    static const char *terms[] = { "pthread_mutex_lock", "return" };
+    char path[] = "/tmp/devtools-text-bench-XXXXXX";
+    uint64_t rng = 0x9E3779B97F4A7C15ull;
+
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        LOG_ERROR("Cannot create benchmark file: %s", strerror(errno));
+        return ERROR_PERMISSION_DENIED;
+    }
+    bool written = write_bench_corpus(fd, megabytes << 20, &rng);
+    off_t size = lseek(fd, 0, SEEK_END);
+    close(fd);
+    if (!written) {
+        LOG_ERROR("Cannot write benchmark file %s", path);
+        unlink(path);
+        return ERROR_PERMISSION_DENIED;
+    }
+
+    LiteralKernel best = literal_kernel();
+    int status = SUCCESS;
+
+    printf("Text search benchmark\n");
+    printf("=====================\n");
+    printf("Data: %.0f MB of generated source, best of %d rounds\n",
+           (double)size / (1 << 20), BENCH_ROUNDS);
+
+    for (size_t t = 0; t < sizeof(terms) / sizeof(terms[0]) && status == SUCCESS; t++) {
+        TextProcessorConfig config;
+        memset(&config, 0, sizeof(config));
+        config.case_sensitive = true;
+        strncpy(config.search_term, terms[t], sizeof(config.search_term) - 1);
+
+        TextSearch search;
+        status = text_search_init(&search, &config, NULL);
+        if (status != SUCCESS) {
+            text_search_free(&search);
+            break;
+        }
+        search.count_only = true;
+
+        printf("\n\"%s\"\n", terms[t]);
+        printf("  %-14s %10s %12s %12s\n", "path", "GB/s", "lines", "matches");
+
+        search.use_literal = false;
+        double elapsed = bench_search(&search, path);
+        size_t reference_lines = search.matched_lines;
+        size_t reference_matches = search.matches;
+        printf("  %-14s %10.2f %12zu %12zu\n", "line", (double)size / elapsed / 1e9,
+               search.matched_lines, search.matches);
+
+        search.use_literal = true;
+        for (int k = 0; k < LITERAL_KERNEL_COUNT; k++) {
+            char label[32];
+            snprintf(label, sizeof(label), "block/%s", literal_kernel_name((LiteralKernel)k));
+            if (!literal_set_kernel((LiteralKernel)k)) {
+                printf("  %-14s %10s\n", label, "not supported");
+                continue;
+            }
+
+            elapsed = bench_search(&search, path);
+            bool ok = search.matched_lines == reference_lines && search.matches == reference_matches;
+            printf("  %-14s %10.2f %12zu %12zu%s\n", label, (double)size / elapsed / 1e9,
+                   search.matched_lines, search.matches, ok ? "" : "  MISMATCH");
+            if (!ok) status = ERROR_UNKNOWN;
+        }
+
+        text_search_free(&search);
+    }
+
+    literal_set_kernel(best);
+    unlink(path);
+    return status;
+}
+
+static void print_pattern_counts(const TextSearch *search) {
+    const AhoCorasick *ac = &search->matcher;
+
+    for (size_t i = 0; i < ac->pattern_count; i++) {
+        if (search->pattern_hits[i] > 0) {
+            printf("%10zu  %s\n", search->pattern_hits[i], ac->patterns[i]);
+        }
+    }
+}
+
+int text_processor_execute(int argc, char *argv[]) {
+    TextProcessorConfig config;
+    memset(&config, 0, sizeof(config));
+    config.case_sensitive = true;
+
+    const char *pattern_file = NULL;
+    bool replace = false;
+    bool count_only = false;
+    int jobs = 0;
+    size_t bench_megabytes = 0;
+
+    static struct option long_options[] = {
+        {"search", required_argument, 0, 's'},
+        {"replace", required_argument, 0, 'r'},
+        {"new", required_argument, 0, 'n'},
+        {"patterns", required_argument, 0, 'f'},
+        {"ignore-case", no_argument, 0, 'i'},
+        {"whole-words", no_argument, 0, 'w'},
+        {"regex", no_argument, 0, 'E'},
+        {"count", no_argument, 0, 'c'},
+        {"backup", no_argument, 0, 'b'},
+        {"recursive", no_argument, 0, 'R'},
+        {"jobs", required_argument, 0, 'j'},
+        {"include", required_argument, 0, 1002},
+        {"context", required_argument, 0, 'C'},
+        {"kernel", required_argument, 0, 1000},
+        {"bench", required_argument, 0, 1001},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    // Reset getopt state left over from global option parsing
+    optind = 0;
+
+    int c;
+    while ((c = getopt_long(argc, argv, "s:r:n:f:iwEcbRj:C:h", long_options, NULL)) != -1) {
+        switch (c) {
+            case 's':
+            case 'r':
+                strncpy(config.search_term, optarg, sizeof(config.search_term) - 1);
+                break;
+
+            case 'n':
+                strncpy(config.replace_term, optarg, sizeof(config.replace_term) - 1);
+                replace = true;
+                break;
+
+            case 'f':
+                pattern_file = optarg;
+                break;
+
+            case 'i':
+                config.case_sensitive = false;
+                break;
+
+            case 'w':
+                config.whole_words = true;
+                break;
+
+            case 'E':
+                config.regex_mode = true;
+                break;
+
+            case 'c':
+                count_only = true;
+                break;
+
+            case 'b':
+                config.backup_files = true;
+                break;
+
+            case 'R':
+                config.recursive = true;
+                break;
+
+            case 'j':
+                jobs = atoi(optarg);
+                if (jobs < 1) {
+                    LOG_ERROR("Invalid job count: %s", optarg);
+                    return ERROR_INVALID_ARGUMENT;
+                }
+                break;
+
+            case 'C':
+                config.context_lines = atoi(optarg);
+                if (config.context_lines < 0) {
+                    LOG_ERROR("Invalid context line count: %s", optarg);
+                    return ERROR_INVALID_ARGUMENT;
+                }
+                break;
+
+            case 1002: // --include
+                strncpy(config.file_pattern, optarg, sizeof(config.file_pattern) - 1);
+                break;
+
+            case 1000: { // --kernel
+                int kernel = 0;
+                while (kernel < LITERAL_KERNEL_COUNT &&
+                       strcmp(optarg, literal_kernel_name((LiteralKernel)kernel)) != 0) {
+                    kernel++;
+                }
+                if (kernel == LITERAL_KERNEL_COUNT) {
+                    LOG_ERROR("Unknown kernel: %s (use scalar, sse2 or avx2)", optarg);
+                    return ERROR_INVALID_ARGUMENT;
+                }
+                if (!literal_set_kernel((LiteralKernel)kernel)) {
+                    LOG_ERROR("Kernel %s is not supported by this CPU", optarg);
+                    return ERROR_INVALID_ARGUMENT;
+                }
+                break;
+            }
+
+            case 1001: // --bench
+                bench_megabytes = strtoul(optarg, NULL, 10);
+                break;
+
+            case 'h':
+                text_processor_help();
+                return SUCCESS;
+
+            default:
+                return ERROR_INVALID_ARGUMENT;
+        }
+    }
+
+    if (bench_megabytes > 0) {
+        return run_benchmark(bench_megabytes);
+    }
+
+    TextSearch search;
+    int status = text_search_init(&search, &config, pattern_file);
+    if (status != SUCCESS) {
+        text_search_free(&search);
+        return status;
+    }
+    search.replace = replace;
+    search.count_only = count_only;
+    search.show_names = argc - optind > 1 || config.recursive;
+
+    int result = SUCCESS;
+    if (config.recursive) {
+        // With no paths, walk the current directory
+        static char *here[] = { "." };
+        result = optind < argc ? text_search_tree(&search, argv + optind, argc - optind, jobs)
+                               : text_search_tree(&search, here, 1, jobs);
+    } else if (optind >= argc) {
+        result = replace ? text_replace_file(&search, "-") : text_search_file(&search, "-");
+    }
+    for (int i = config.recursive ? argc : optind; i < argc; i++) {
+        status = replace ? text_replace_file(&search, argv[i]) : text_search_file(&search, argv[i]);
+        if (status != SUCCESS) {
+            result = status;
+        }
+    }
+
+    if (count_only) {
+        print_pattern_counts(&search);
+    }
+    if (!g_config.quiet) {
+        if (replace) {
+            fprintf(stderr, "%zu replacements in %zu files\n", search.matches, search.files);
+        } else if (count_only) {
+            fprintf(stderr, "%zu matches in %zu lines (%zu files, %zu patterns)\n",
+                    search.matches, search.matched_lines, search.files,
+                    search.matcher.pattern_count);
+        } else {
+            // Line output stops scanning a line at its first match
+            fprintf(stderr, "%zu matching lines (%zu files, %zu patterns)\n",
+                    search.matched_lines, search.files, search.matcher.pattern_count);
+        }
+    }
+
+    text_search_free(&search);
+    return result;
+}
+
+void text_processor_help(void) {
+    printf("Text Processor Tool\n");
+    printf("===================\n");
+    printf("Searches files for one or many literal patterns in a single pass\n");
+    printf("(Aho-Corasick), or replaces every match in place. A single pattern\n");
+    printf("without -w is searched for with a vectorized filter over whole blocks.\n");
+    printf("\nOptions:\n");
+    printf("  -s, --search TERM     Print lines containing TERM\n");
+    printf("  -f, --patterns FILE   Search for every pattern in FILE (one per line)\n");
+    printf("  -r, --replace TERM    Term to replace (same as -s)\n");
+    printf("  -n, --new TEXT        Replace matches with TEXT, rewriting the files\n");
+    printf("  -i, --ignore-case     Case-insensitive matching (ASCII)\n");
+    printf("  -w, --whole-words     Only match whole words\n");
+    printf("  -E, --regex           TERM is a regular expression, matched within lines\n");
+    printf("                        in linear time (no backreferences or look-around;\n");
+    printf("                        the replacement text is literal)\n");
+    printf("  -c, --count           Print the number of matches per pattern\n");
+    printf("  -C, --context N       Print N lines before and after each matching line\n");
+    printf("  -b, --backup          Keep FILE.bak when replacing\n");
+    printf("  -R, --recursive       Walk directories on a thread pool (hidden entries\n");
+    printf("                        are skipped, binary files are never rewritten)\n");
+    printf("  -j, --jobs N          Worker threads for -R (default: one per CPU)\n");
+    printf("      --include GLOB    With -R, only process files whose name matches GLOB\n");
+    printf("      --kernel NAME     Force a literal search kernel: scalar, sse2 or avx2\n");
+    printf("      --bench MB        Compare line and block search on MB of generated source\n");
+    printf("\nUsage:\n");
+    printf("  devtools text-processor -s TODO src/*.c\n");
+    printf("  devtools text-processor -f deprecated_apis.txt -w -c src/*.c\n");
+    printf("  devtools text-processor -r \"old\" -n \"new\" *.c\n");
+    printf("  devtools text-processor -R --include \"*.[ch]\" -r old_name -n new_name src\n");
+    printf("  devtools text-processor -E -s \"^\\s*(TODO|FIXME)\" -c src/*.c\n");
+}
@@ -0,0 +1,50 @@
+#ifndef DEVTOOLS_TEXT_PROCESSOR_H
+#define DEVTOOLS_TEXT_PROCESSOR_H
+
+#include "../../config.h"
+#include "aho_corasick.h"
+#include "literal_search.h"
+#include "regex_engine.h"
+
+// Everything a run needs besides TextProcessorConfig: the compiled
+// patterns (the single search term or a pattern file) and run totals.
+// A lone literal pattern without whole-word or regex matching is searched
+// for in large blocks by `literal`; everything else goes line by line
+// through the automaton, or through the lazy DFA of `regex` in regex mode.
+typedef struct {
+    const TextProcessorConfig *config;
+    AhoCorasick matcher;
+    const char *pattern_file;
+    bool replace;               // rewrite files, replacing matches with replace_term
+    bool count_only;            // print per-pattern hit counts instead of lines
+    bool show_names;            // prefix output lines with the file name
+    bool use_literal;           // search with `literal` instead of `matcher`
+    LiteralPattern literal;
+    bool use_regex;             // regex_mode: search with `regex`
+    Regex regex;
+    FILE *out;                  // matched lines and replacement reports
+    bool context_printed;       // a context group has been printed
+
+    size_t *pattern_hits;       // per pattern, for count_only
+    size_t files;
+    size_t matched_lines;
+    size_t matches;
+} TextSearch;
+
+// Tool entry points
+int text_processor_execute(int argc, char *argv[]);
+void text_processor_help(void);
+
+// Search functions
+int text_search_init(TextSearch *search, const TextProcessorConfig *config,
+                     const char *pattern_file);
+void text_search_free(TextSearch *search);
+int text_search_file(TextSearch *search, const char *filename);
+int text_replace_file(TextSearch *search, const char *filename);
+
+// Searches or rewrites every file under `paths` (directories are walked
+// recursively) on `jobs` worker threads, 0 for one per CPU. Totals are
+// added to `search`.
+int text_search_tree(TextSearch *search, char **paths, int count, int jobs);
+
+#endif // DEVTOOLS_TEXT_PROCESSOR_H
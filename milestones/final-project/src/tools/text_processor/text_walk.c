@@ -0,0 +1,254 @@
+#include "text_processor.h"
+#include "../../common/error.h"
+#include "../../common/logging.h"
+#include "../../common/memory.h"
+#include "../../common/work_queue.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fnmatch.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// A queued directory to list or file to process; the path follows
+typedef struct {
+    bool directory;
+    char path[];
+} TreeItem;
+
+// Shared state for one tree walk. Every worker searches with its own copy
+// of the search (the regex DFA caches are filled as they run, and the
+// counters are written per match), so no locks or atomics are needed
+// while they run; the copies are summed once the pool is done.
+typedef struct {
+    const TextSearch *search;
+    TextSearch *shards;
+    int *results;               // per worker, the last failure
+} TreeWalk;
+
+static TreeItem* tree_item(const char *path, size_t length, bool directory) {
+    TreeItem *item = MALLOC(sizeof(TreeItem) + length + 1);
+    if (!item) return NULL;
+
+    item->directory = directory;
+    memcpy(item->path, path, length);
+    item->path[length] = '\0';
+    return item;
+}
+
+// A worker copy shares the compiled automaton and literal, which are only
+// read, but needs its own counters and its own regex
+static int shard_init(TextSearch *shard, const TextSearch *search) {
+    *shard = *search;
+    shard->use_regex = false;
+    shard->pattern_hits = NULL;
+    shard->files = shard->matched_lines = shard->matches = 0;
+
+    size_t count = search->matcher.pattern_count;
+    shard->pattern_hits = MALLOC(count * sizeof(size_t));
+    if (!shard->pattern_hits) return ERROR_MEMORY_ALLOCATION;
+    memset(shard->pattern_hits, 0, count * sizeof(size_t));
+
+    if (search->use_regex) {
+        char error[MAX_STRING_LENGTH];
+        int status = regex_compile(&shard->regex, search->config->search_term,
+                                   search->config->case_sensitive, error, sizeof(error));
+        if (status != SUCCESS) return status;
+        shard->use_regex = true;
+    }
+
+    return SUCCESS;
+}
+
+static void shard_free(TextSearch *shard) {
+    if (shard->use_regex) regex_free(&shard->regex);
+    FREE(shard->pattern_hits);
+}
+
+static void shard_merge(TextSearch *search, const TextSearch *shard) {
+    search->files += shard->files;
+    search->matched_lines += shard->matched_lines;
+    search->matches += shard->matches;
+    for (size_t i = 0; i < search->matcher.pattern_count; i++) {
+        search->pattern_hits[i] += shard->pattern_hits[i];
+    }
+}
+
+// Which directory entries a walk takes: hidden ones (.git and friends, and
+// the temporary files of replacements in flight) never; files only if
+// they match --include; and no backups left by earlier replace runs
+static bool wanted(const TextSearch *search, const char *name, bool directory) {
+    if (name[0] == '.') return false;
+    if (directory) return true;
+
+    const TextProcessorConfig *config = search->config;
+    if (config->file_pattern[0] && fnmatch(config->file_pattern, name, 0) != 0) return false;
+
+    size_t length = strlen(name);
+    return !(search->replace && config->backup_files &&
+             length > 4 && strcmp(name + length - 4, ".bak") == 0);
+}
+
+// Search or rewrite one file into this worker's shard. Its output is
+// collected in memory and written with a single call, so the lines of
+// files processed at the same time never interleave.
+static void process_file(TreeWalk *walk, int worker, const char *path) {
+    TextSearch *shard = &walk->shards[worker];
+    char *buffer = NULL;
+    size_t size = 0;
+
+    FILE *out = open_memstream(&buffer, &size);
+    if (!out) {
+        walk->results[worker] = ERROR_MEMORY_ALLOCATION;
+        return;
+    }
+
+    shard->out = out;
+    int status = shard->replace ? text_replace_file(shard, path) : text_search_file(shard, path);
+    fclose(out);
+
+    if (size > 0) fwrite(buffer, 1, size, stdout);
+    free(buffer);
+
+    if (status != SUCCESS) walk->results[worker] = status;
+}
+
+// List one directory completely before queueing anything from it: files
+// that workers rewrite (and the backups they add) must not show up in a
+// listing that is still being read
+static void list_directory(WorkPool *pool, TreeWalk *walk, int worker, const char *dirname) {
+    DIR *dir = opendir(dirname);
+    if (!dir) {
+        fprintf(stderr, "text-processor: %s: %s\n", dirname, strerror(errno));
+        return;
+    }
+
+    TreeItem **items = NULL;
+    size_t count = 0, capacity = 0;
+    char path[MAX_PATH_LENGTH];
+    struct dirent *entry;
+
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+
+        int len = snprintf(path, sizeof(path), "%s/%s", dirname, entry->d_name);
+        if (len < 0 || (size_t)len >= sizeof(path)) {
+            continue;
+        }
+
+        // d_type saves a stat() per entry on most file systems; symlinks
+        // are not followed, so cycles cannot occur
+        bool directory = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN) {
+            struct stat st;
+            if (lstat(path, &st) != 0) continue;
+            if (!S_ISDIR(st.st_mode) && !S_ISREG(st.st_mode)) continue;
+            directory = S_ISDIR(st.st_mode);
+        } else if (!directory && entry->d_type != DT_REG) {
+            continue;
+        }
+
+        if (!wanted(walk->search, entry->d_name, directory)) continue;
+
+        if (count == capacity) {
+            size_t grown_capacity = capacity ? capacity * 2 : 64;
+            TreeItem **grown = REALLOC(items, grown_capacity * sizeof(TreeItem*));
+            if (!grown) break;
+            items = grown;
+            capacity = grown_capacity;
+        }
+
+        items[count] = tree_item(path, (size_t)len, directory);
+        if (items[count]) count++;
+    }
+
+    closedir(dir);
+
+    for (size_t i = 0; i < count; i++) {
+        if (!work_pool_push(pool, worker, items[i])) {
+            walk->results[worker] = ERROR_MEMORY_ALLOCATION;
+            FREE(items[i]);
+        }
+    }
+    FREE(items);
+}
+
+// Work item handler
+static void process_item(WorkPool *pool, int worker, void *item, void *ctx) {
+    TreeWalk *walk = (TreeWalk*)ctx;
+    TreeItem *entry = (TreeItem*)item;
+
+    if (entry->directory) {
+        list_directory(pool, walk, worker, entry->path);
+    } else {
+        process_file(walk, worker, entry->path);
+    }
+
+    FREE(entry);
+}
+
+int text_search_tree(TextSearch *search, char **paths, int count, int jobs) {
+    if (jobs <= 0) {
+        jobs = work_pool_default_workers();
+    }
+
+    TextSearch *shards = MALLOC((size_t)jobs * sizeof(TextSearch));
+    int *results = MALLOC((size_t)jobs * sizeof(int));
+    if (!shards || !results) {
+        FREE(shards);
+        FREE(results);
+        return ERROR_MEMORY_ALLOCATION;
+    }
+
+    int status = SUCCESS;
+    int ready = 0;
+    while (ready < jobs && status == SUCCESS) {
+        results[ready] = SUCCESS;
+        status = shard_init(&shards[ready], search);
+        ready++;
+    }
+
+    // Settle the lazily chosen search kernel before workers race to pick it
+    literal_kernel();
+
+    TreeWalk walk = { .search = search, .shards = shards, .results = results };
+    WorkPool *pool = status == SUCCESS ? work_pool_create(jobs, process_item, &walk) : NULL;
+    if (status == SUCCESS && !pool) status = ERROR_MEMORY_ALLOCATION;
+
+    // Named files are searched whatever their name; directories are walked
+    for (int i = 0; pool && i < count; i++) {
+        struct stat st;
+        if (stat(paths[i], &st) != 0) {
+            fprintf(stderr, "text-processor: %s: %s\n", paths[i], strerror(errno));
+            status = ERROR_FILE_NOT_FOUND;
+            continue;
+        }
+
+        size_t length = strlen(paths[i]);
+        while (length > 1 && paths[i][length - 1] == '/') length--;
+
+        TreeItem *item = tree_item(paths[i], length, S_ISDIR(st.st_mode));
+        if (!item || !work_pool_submit(pool, item)) {
+            FREE(item);
+            status = ERROR_MEMORY_ALLOCATION;
+        }
+    }
+
+    if (pool) {
+        work_pool_run(pool);
+        work_pool_destroy(pool);
+    }
+
+    for (int i = 0; i < ready; i++) {
+        if (pool) {
+            shard_merge(search, &shards[i]);
+            if (results[i] != SUCCESS) status = results[i];
+        }
+        shard_free(&shards[i]);
+    }
+
+    FREE(shards);
+    FREE(results);
+    return status;
+}
@@ -0,0 +1,408 @@
+#include "url_encoder.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define URL_X86 1
+#include <immintrin.h>
+#endif
+
+// Escape table entry: the encoded text of one byte and its length
+typedef struct {
+    char text[3];
+    unsigned char length;
+} UrlEscape;
+
+// Bulk kernels process whole vectors and leave the last few bytes to the
+// scalar loop. Vectors of plain bytes are stored as they are and only the
+// bytes that need converting go through the tables. Stores may run up to
+// one vector past the output they produce.
+typedef char* (*EncodeBulkFn)(const unsigned char *in, size_t length, char *out,
+                              const UrlEscape *table, size_t *consumed);
+typedef unsigned char* (*DecodeBulkFn)(const char *in, size_t length, unsigned char *out,
+                                       bool plus, size_t *consumed);
+
+// ---------------------------------------------------------------------
+// Tables, generated at compile time
+// ---------------------------------------------------------------------
+
+enum {
+    URL_UNRESERVED = 1 << 0,    // copied as is when encoding
+    URL_HEX        = 1 << 1     // valid in a %XX escape
+};
+
+#define URL_IS_UNRESERVED(c) \
+    (((c) >= 'A' && (c) <= 'Z') || ((c) >= 'a' && (c) <= 'z') || \
+     ((c) >= '0' && (c) <= '9') || (c) == '-' || (c) == '.' || (c) == '_' || (c) == '~')
+
+#define URL_IS_HEX(c) \
+    (((c) >= '0' && (c) <= '9') || ((c) >= 'A' && (c) <= 'F') || ((c) >= 'a' && (c) <= 'f'))
+
+#define URL_CLASS(c) \
+    ((URL_IS_UNRESERVED(c) ? URL_UNRESERVED : 0) | (URL_IS_HEX(c) ? URL_HEX : 0))
+
+#define URL_HEX_VALUE(c) \
+    ((c) <= '9' ? (c) - '0' : ((c) | 0x20) - 'a' + 10)
+
+#define URL_HEX_ENTRY(c) (URL_IS_HEX(c) ? URL_HEX_VALUE(c) : 0)
+
+#define URL_ROW4(F, c)   F(c), F((c) + 1), F((c) + 2), F((c) + 3)
+#define URL_ROW16(F, c)  URL_ROW4(F, c), URL_ROW4(F, (c) + 4), \
+                         URL_ROW4(F, (c) + 8), URL_ROW4(F, (c) + 12)
+#define URL_ROW64(F, c)  URL_ROW16(F, c), URL_ROW16(F, (c) + 16), \
+                         URL_ROW16(F, (c) + 32), URL_ROW16(F, (c) + 48)
+#define URL_ROW256(F)    URL_ROW64(F, 0), URL_ROW64(F, 64), \
+                         URL_ROW64(F, 128), URL_ROW64(F, 192)
+
+#define URL_HEX_DIGIT(v) ((v) < 10 ? '0' + (v) : 'A' + (v) - 10)
+
+#define URL_ESCAPE(c) \
+    { { (char)(URL_IS_UNRESERVED(c) ? (c) : '%'), \
+        (char)URL_HEX_DIGIT((c) >> 4), (char)URL_HEX_DIGIT((c) & 15) }, \
+      URL_IS_UNRESERVED(c) ? 1 : 3 }
+
+#define URL_FORM_ESCAPE(c) \
+    { { (char)((c) == ' ' ? '+' : URL_IS_UNRESERVED(c) ? (c) : '%'), \
+        (char)URL_HEX_DIGIT((c) >> 4), (char)URL_HEX_DIGIT((c) & 15) }, \
+      URL_IS_UNRESERVED(c) || (c) == ' ' ? 1 : 3 }
+
+static const unsigned char url_class[256] = { URL_ROW256(URL_CLASS) };
+static const unsigned char url_hex[256] = { URL_ROW256(URL_HEX_ENTRY) };
+static const UrlEscape url_escape[256] = { URL_ROW256(URL_ESCAPE) };
+static const UrlEscape url_form_escape[256] = { URL_ROW256(URL_FORM_ESCAPE) };
+
+static int active_kernel = -1;
+
+// Branch-free: every byte writes three characters and keeps 1 or 3
+static inline char* encode_byte(const UrlEscape *table, unsigned char c, char *out) {
+    memcpy(out, table[c].text, 3);
+    return out + table[c].length;
+}
+
+// One byte that may start a conversion. The caller guarantees at least
+// three bytes of input when in[i] is '%'.
+static inline size_t decode_special(const char *in, size_t i, unsigned char **out, bool plus) {
+    unsigned char c = (unsigned char)in[i];
+
+    if (c == '%' && (url_class[(unsigned char)in[i + 1]] & URL_HEX) &&
+        (url_class[(unsigned char)in[i + 2]] & URL_HEX)) {
+        *(*out)++ = (unsigned char)(url_hex[(unsigned char)in[i + 1]] << 4 |
+                                    url_hex[(unsigned char)in[i + 2]]);
+        return i + 3;
+    }
+
+    *(*out)++ = c == '+' && plus ? ' ' : c;
+    return i + 1;
+}
+
+#ifdef URL_X86
+
+// ---------------------------------------------------------------------
+// SSE2: 16 bytes per step
+// ---------------------------------------------------------------------
+
+// Unreserved bytes as a 0xFF lane mask. Each range test shifts the range
+// to the bottom of the signed byte range so one signed compare checks
+// both ends; setting bit 5 folds upper case onto lower case.
+__attribute__((target("sse2")))
+static inline __m128i unreserved_sse2(__m128i v) {
+    __m128i letter = _mm_add_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)),
+                                  _mm_set1_epi8((char)(0x80 - 'a')));
+    letter = _mm_cmplt_epi8(letter, _mm_set1_epi8((char)(0x80 + 26)));
+
+    // '-' '.' '/' and the digits are contiguous; '/' is taken out again
+    __m128i digit = _mm_add_epi8(v, _mm_set1_epi8((char)(0x80 - '-')));
+    digit = _mm_cmplt_epi8(digit, _mm_set1_epi8((char)(0x80 + ('9' - '-' + 1))));
+    digit = _mm_andnot_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('/')), digit);
+
+    __m128i other = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('_')),
+                                 _mm_cmpeq_epi8(v, _mm_set1_epi8('~')));
+
+    return _mm_or_si128(_mm_or_si128(letter, digit), other);
+}
+
+// A mixed vector: its plain prefix is already stored. With few escapes,
+// each one is written from the table and the plain bytes after it are
+// stored again straight from the input (up to 31 bytes past `in` are
+// read); with many, every byte goes through the table.
+__attribute__((target("sse2")))
+static inline char* encode_mixed_sse2(const unsigned char *in, unsigned escaped, char *out,
+                                      const UrlEscape *table) {
+    if (__builtin_popcount(escaped) > 4) {
+        out += __builtin_ctz(escaped);
+        for (int j = __builtin_ctz(escaped); j < 16; j++) {
+            out = encode_byte(table, in[j], out);
+        }
+        return out;
+    }
+
+    int j = 0;
+    while (escaped) {
+        int p = __builtin_ctz(escaped);
+        out = encode_byte(table, in[p], out + (p - j));
+        j = p + 1;
+        _mm_storeu_si128((__m128i*)out, _mm_loadu_si128((const __m128i*)(in + j)));
+        escaped &= escaped - 1;
+    }
+
+    return out + (16 - j);
+}
+
+__attribute__((target("sse2")))
+static char* encode_sse2(const unsigned char *in, size_t length, char *out,
+                         const UrlEscape *table, size_t *consumed) {
+    size_t i = 0;
+
+    for (; i + 32 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+        _mm_storeu_si128((__m128i*)out, v);
+
+        unsigned escaped = ~(unsigned)_mm_movemask_epi8(unreserved_sse2(v)) & 0xFFFF;
+        out = escaped ? encode_mixed_sse2(in + i, escaped, out, table) : out + 16;
+    }
+
+    *consumed = i;
+    return out;
+}
+
+// Vectors are only taken while two more bytes follow them, so an escape
+// found in one always has its digits in the input
+__attribute__((target("sse2")))
+static unsigned char* decode_sse2(const char *in, size_t length, unsigned char *out,
+                                  bool plus, size_t *consumed) {
+    const __m128i percent = _mm_set1_epi8('%');
+    const __m128i space = _mm_set1_epi8(plus ? '+' : '%');
+    size_t i = 0;
+
+    while (i + 16 + 2 <= length) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+        _mm_storeu_si128((__m128i*)out, v);
+
+        __m128i special = _mm_or_si128(_mm_cmpeq_epi8(v, percent), _mm_cmpeq_epi8(v, space));
+        unsigned mask = (unsigned)_mm_movemask_epi8(special);
+        if (mask == 0) {
+            i += 16;
+            out += 16;
+            continue;
+        }
+
+        size_t run = (size_t)__builtin_ctz(mask);
+        out += run;
+        i = decode_special(in, i + run, &out, plus);
+
+        // Escaped binary is mostly back-to-back escapes: stay scalar
+        while (i + 16 + 2 <= length && in[i] == '%') {
+            i = decode_special(in, i, &out, plus);
+        }
+    }
+
+    *consumed = i;
+    return out;
+}
+
+// ---------------------------------------------------------------------
+// AVX2: the same tests 32 bytes at a time
+// ---------------------------------------------------------------------
+
+__attribute__((target("avx2")))
+static inline __m256i unreserved_avx2(__m256i v) {
+    __m256i letter = _mm256_add_epi8(_mm256_or_si256(v, _mm256_set1_epi8(0x20)),
+                                     _mm256_set1_epi8((char)(0x80 - 'a')));
+    letter = _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(0x80 + 26)), letter);
+
+    __m256i digit = _mm256_add_epi8(v, _mm256_set1_epi8((char)(0x80 - '-')));
+    digit = _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(0x80 + ('9' - '-' + 1))), digit);
+    digit = _mm256_andnot_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('/')), digit);
+
+    __m256i other = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')),
+                                    _mm256_cmpeq_epi8(v, _mm256_set1_epi8('~')));
+
+    return _mm256_or_si256(_mm256_or_si256(letter, digit), other);
+}
+
+__attribute__((target("avx2")))
+static char* encode_avx2(const unsigned char *in, size_t length, char *out,
+                         const UrlEscape *table, size_t *consumed) {
+    size_t i = 0;
+
+    for (; i + 48 <= length; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(in + i));
+        _mm256_storeu_si256((__m256i*)out, v);
+
+        uint32_t escaped = ~(uint32_t)_mm256_movemask_epi8(unreserved_avx2(v));
+        if (escaped == 0) {
+            out += 32;
+            continue;
+        }
+
+        // Finish in two halves; the high half is re-stored after the low
+        // one has moved the output
+        out = (escaped & 0xFFFF) ? encode_mixed_sse2(in + i, escaped & 0xFFFF, out, table)
+                                 : out + 16;
+        _mm_storeu_si128((__m128i*)out, _mm_loadu_si128((const __m128i*)(in + i + 16)));
+        out = (escaped >> 16) ? encode_mixed_sse2(in + i + 16, escaped >> 16, out, table)
+                              : out + 16;
+    }
+
+    size_t rest;
+    out = encode_sse2(in + i, length - i, out, table, &rest);
+    *consumed = i + rest;
+    return out;
+}
+
+__attribute__((target("avx2")))
+static unsigned char* decode_avx2(const char *in, size_t length, unsigned char *out,
+                                  bool plus, size_t *consumed) {
+    const __m256i percent = _mm256_set1_epi8('%');
+    const __m256i space = _mm256_set1_epi8(plus ? '+' : '%');
+    size_t i = 0;
+
+    while (i + 32 + 2 <= length) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(in + i));
+        _mm256_storeu_si256((__m256i*)out, v);
+
+        __m256i special = _mm256_or_si256(_mm256_cmpeq_epi8(v, percent),
+                                          _mm256_cmpeq_epi8(v, space));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(special);
+        if (mask == 0) {
+            i += 32;
+            out += 32;
+            continue;
+        }
+
+        size_t run = (size_t)__builtin_ctz(mask);
+        out += run;
+        i = decode_special(in, i + run, &out, plus);
+
+        while (i + 32 + 2 <= length && in[i] == '%') {
+            i = decode_special(in, i, &out, plus);
+        }
+    }
+
+    size_t rest;
+    out = decode_sse2(in + i, length - i, out, plus, &rest);
+    *consumed = i + rest;
+    return out;
+}
+
+#endif // URL_X86
+
+// ---------------------------------------------------------------------
+// Dispatch
+// ---------------------------------------------------------------------
+
+bool url_kernel_supported(UrlKernel kernel) {
+    switch (kernel) {
+        case URL_KERNEL_SCALAR:
+            return true;
+#ifdef URL_X86
+        case URL_KERNEL_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case URL_KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+UrlKernel url_best_kernel(void) {
+    if (url_kernel_supported(URL_KERNEL_AVX2)) return URL_KERNEL_AVX2;
+    if (url_kernel_supported(URL_KERNEL_SSE2)) return URL_KERNEL_SSE2;
+    return URL_KERNEL_SCALAR;
+}
+
+UrlKernel url_kernel(void) {
+    if (active_kernel < 0) {
+        active_kernel = url_best_kernel();
+    }
+    return (UrlKernel)active_kernel;
+}
+
+bool url_set_kernel(UrlKernel kernel) {
+    if (!url_kernel_supported(kernel)) return false;
+    active_kernel = kernel;
+    return true;
+}
+
+const char* url_kernel_name(UrlKernel kernel) {
+    switch (kernel) {
+        case URL_KERNEL_SCALAR: return "scalar";
+        case URL_KERNEL_SSE2:   return "sse2";
+        case URL_KERNEL_AVX2:   return "avx2";
+        default:                return "unknown";
+    }
+}
+
+static EncodeBulkFn encode_bulk(void) {
+    switch (url_kernel()) {
+#ifdef URL_X86
+        case URL_KERNEL_SSE2: return encode_sse2;
+        case URL_KERNEL_AVX2: return encode_avx2;
+#endif
+        default:              return NULL;
+    }
+}
+
+static DecodeBulkFn decode_bulk(void) {
+    switch (url_kernel()) {
+#ifdef URL_X86
+        case URL_KERNEL_SSE2: return decode_sse2;
+        case URL_KERNEL_AVX2: return decode_avx2;
+#endif
+        default:              return NULL;
+    }
+}
+
+// ---------------------------------------------------------------------
+// Codec
+// ---------------------------------------------------------------------
+
+size_t url_encode(const unsigned char *in, size_t length, char *out, UrlMode mode) {
+    const UrlEscape *table = mode == URL_MODE_FORM ? url_form_escape : url_escape;
+    EncodeBulkFn bulk = encode_bulk();
+    char *start = out;
+    size_t i = 0;
+
+    if (bulk) {
+        out = bulk(in, length, out, table, &i);
+    }
+
+    for (; i < length; i++) {
+        out = encode_byte(table, in[i], out);
+    }
+
+    return (size_t)(out - start);
+}
+
+size_t url_decode(const char *in, size_t length, unsigned char *out, UrlMode mode,
+                  bool final, size_t *consumed) {
+    DecodeBulkFn bulk = decode_bulk();
+    bool plus = mode == URL_MODE_FORM;
+    unsigned char *start = out;
+    size_t i = 0;
+
+    if (bulk) {
+        out = bulk(in, length, out, plus, &i);
+    }
+
+    while (i < length) {
+        unsigned char c = (unsigned char)in[i];
+
+        if (c == '%' && length - i <= 2) {
+            // Not enough input left to tell: wait for the next block
+            if (!final) break;
+            *out++ = c;
+            i++;
+        } else if (c == '%' || c == '+') {
+            i = decode_special(in, i, &out, plus);
+        } else {
+            *out++ = c;
+            i++;
+        }
+    }
+
+    *consumed = i;
+    return (size_t)(out - start);
+}
@@ -0,0 +1,447 @@
+#include "url_encoder.h"
+#include "../../common/error.h"
+#include "../../common/logging.h"
+#include "../../common/memory.h"
+#include "../../common/stream.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_ROUNDS 3
+
+static double elapsed_seconds(const struct timespec *start, const struct timespec *end) {
+    return (double)(end->tv_sec - start->tv_sec) +
+           (double)(end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int stream_error(const char *what, int error) {
+    LOG_ERROR("%s failed: %s", what, strerror(error));
+    return ERROR_PERMISSION_DENIED;
+}
+
+// Reads blocks on one thread, converts them on this one and writes them on
+// a third. Only decoding carries state between blocks: an escape cut off
+// by the block boundary is moved into the headroom of the next block.
+static int transform_stream(int in_fd, int out_fd, bool decode, UrlMode mode) {
+    size_t out_block = decode ? URL_DECODED_MAX(URL_STREAM_BLOCK + URL_ESCAPE_CARRY)
+                              : URL_ENCODED_MAX(URL_STREAM_BLOCK);
+    StreamReader reader;
+    StreamWriter writer;
+
+    int status = stream_reader_open(&reader, in_fd, URL_STREAM_BLOCK, URL_ESCAPE_CARRY);
+    if (status != SUCCESS) return status;
+
+    status = stream_writer_open(&writer, out_fd, out_block);
+    if (status != SUCCESS) {
+        stream_reader_close(&reader);
+        return status;
+    }
+
+    char carry[URL_ESCAPE_CARRY];
+    size_t carried = 0;
+
+    for (;;) {
+        char *data;
+        ssize_t n = stream_reader_next(&reader, &data);
+        if (n < 0) {
+            status = stream_error("Read", errno);
+            break;
+        }
+
+        char *out = stream_writer_buffer(&writer);
+        size_t length;
+
+        if (decode) {
+            char *block = data - carried;
+            memcpy(block, carry, carried);
+
+            size_t total = carried + (size_t)n;
+            size_t consumed;
+            length = url_decode(block, total, (unsigned char*)out, mode, n == 0, &consumed);
+
+            carried = total - consumed;
+            memcpy(carry, block + consumed, carried);
+        } else {
+            length = url_encode((const unsigned char*)data, (size_t)n, out, mode);
+        }
+
+        if (!stream_writer_commit(&writer, length) || n == 0) break;
+    }
+
+    stream_reader_close(&reader);
+    if (!stream_writer_close(&writer) && status == SUCCESS) {
+        status = stream_error("Write", writer.error);
+    }
+
+    return status;
+}
+
+// Batch mode: every input line is one record and produces one output line,
+// written straight into the writer's blocks with no allocation per record.
+// A record that decodes to data containing a newline (a%0Ab) is reported
+// and left empty, since writing it would split its line.
+typedef struct {
+    StreamWriter *writer;
+    bool decode;
+    UrlMode mode;
+    size_t records;
+    size_t invalid;
+} UrlBatch;
+
+static int batch_record(const char *record, size_t length, void *ctx) {
+    UrlBatch *batch = (UrlBatch*)ctx;
+    size_t capacity = batch->decode ? URL_DECODED_MAX(length) : URL_ENCODED_MAX(length);
+    char *out = stream_writer_reserve(batch->writer, capacity + 1);
+    if (!out) return ERROR_MEMORY_ALLOCATION;
+
+    size_t n;
+    batch->records++;
+
+    if (batch->decode) {
+        size_t consumed;
+        n = url_decode(record, length, (unsigned char*)out, batch->mode, true, &consumed);
+        if (memchr(out, '\n', n)) {
+            batch->invalid++;
+            n = 0;
+            if (!g_config.quiet) {
+                fprintf(stderr, "url-encoder: record %zu: decoded data contains a newline\n",
+                        batch->records);
+            }
+        }
+    } else {
+        n = url_encode((const unsigned char*)record, length, out, batch->mode);
+    }
+
+    out[n++] = '\n';
+    stream_writer_advance(batch->writer, n);
+    return SUCCESS;
+}
+
+static int batch_stream(int in_fd, int out_fd, UrlBatch *batch) {
+    StreamReader reader;
+    StreamWriter writer;
+
+    int status = stream_reader_open(&reader, in_fd, URL_STREAM_BLOCK, 0);
+    if (status != SUCCESS) return status;
+
+    status = stream_writer_open(&writer, out_fd, URL_ENCODED_MAX(URL_STREAM_BLOCK));
+    if (status != SUCCESS) {
+        stream_reader_close(&reader);
+        return status;
+    }
+
+    batch->writer = &writer;
+    status = stream_read_records(&reader, batch_record, batch);
+    batch->writer = NULL;
+
+    stream_reader_close(&reader);
+    if (!stream_writer_close(&writer) && status == SUCCESS) {
+        status = stream_error("Write", writer.error);
+    }
+
+    return status;
+}
+
+static int convert_stream(int fd, bool decode, UrlMode mode, UrlBatch *batch) {
+    if (batch) return batch_stream(fd, STDOUT_FILENO, batch);
+    return transform_stream(fd, STDOUT_FILENO, decode, mode);
+}
+
+static int transform_string(const char *text, bool decode, UrlMode mode) {
+    size_t length = strlen(text);
+    char *out = MALLOC(decode ? URL_DECODED_MAX(length) + 1 : URL_ENCODED_MAX(length) + 1);
+    if (!out) return ERROR_MEMORY_ALLOCATION;
+
+    size_t n;
+    if (decode) {
+        size_t consumed;
+        n = url_decode(text, length, (unsigned char*)out, mode, true, &consumed);
+    } else {
+        n = url_encode((const unsigned char*)text, length, out, mode);
+    }
+
+    fwrite(out, 1, n, stdout);
+    fputc('\n', stdout);
+
+    FREE(out);
+    return SUCCESS;
+}
+
+// Query-string-like text: words, digits and separators with the odd
+// space and UTF-8 sequence, so most bytes pass through unchanged
+static void bench_text(unsigned char *data, size_t length, uint64_t *rng) {
+    static const char *words[] = {
+        "search", "id", "page", "session", "token", "filter", "sort", "lang",
+        "category", "price", "user_name", "redirect", "v2.1", "item-42", "ok~"
+    };
+    static const char *separators[] = { "=", "&", " ", "/", "?", "\xC3\xA9", ":" };
+    size_t i = 0;
+
+    while (i < length) {
+        *rng ^= *rng << 13;
+        *rng ^= *rng >> 7;
+        *rng ^= *rng << 17;
+        const char *word = words[*rng % (sizeof(words) / sizeof(words[0]))];
+        const char *separator = separators[(*rng >> 32) % (sizeof(separators) / sizeof(separators[0]))];
+
+        for (const char *p = word; *p && i < length; p++) data[i++] = (unsigned char)*p;
+        for (const char *p = separator; *p && i < length; p++) data[i++] = (unsigned char)*p;
+    }
+}
+
+static void bench_binary(unsigned char *data, size_t length, uint64_t *rng) {
+    for (size_t i = 0; i < length; i++) {
+        *rng ^= *rng << 13;
+        *rng ^= *rng >> 7;
+        *rng ^= *rng << 17;
+        data[i] = (unsigned char)*rng;
+    }
+}
+
+// Times encode and decode with every kernel the CPU supports, on text that
+// is mostly unreserved and on random bytes that are mostly escaped. Every
+// kernel's output is checked against the scalar one.
+static int run_benchmark(size_t megabytes) {
+    size_t length = megabytes << 20;
+    unsigned char *data = MALLOC(length);
+    char *encoded = MALLOC(URL_ENCODED_MAX(length));
+    char *reference = MALLOC(URL_ENCODED_MAX(length));
+    unsigned char *decoded = MALLOC(length);
+    uint64_t rng = 0x9E3779B97F4A7C15ull;
+    int status = SUCCESS;
+
+    if (!data || !encoded || !reference || !decoded) {
+        FREE(data);
+        FREE(encoded);
+        FREE(reference);
+        FREE(decoded);
+        return ERROR_MEMORY_ALLOCATION;
+    }
+
+    UrlKernel best = url_kernel();
+    struct timespec start, end;
+
+    printf("URL encoding kernel benchmark\n");
+    printf("=============================\n");
+    printf("Data: %zu MB per corpus, best of %d rounds (GB/s of unencoded data)\n",
+           megabytes, BENCH_ROUNDS);
+
+    for (int corpus = 0; corpus < 2; corpus++) {
+        if (corpus == 0) {
+            bench_text(data, length, &rng);
+        } else {
+            bench_binary(data, length, &rng);
+        }
+
+        printf("\n%s\n", corpus == 0 ? "Query text" : "Random bytes");
+        printf("  %-8s %12s %12s\n", "kernel", "encode", "decode");
+
+        size_t reference_length = 0;
+        for (int k = 0; k < URL_KERNEL_COUNT; k++) {
+            if (!url_set_kernel((UrlKernel)k)) {
+                printf("  %-8s %12s\n", url_kernel_name((UrlKernel)k), "not supported");
+                continue;
+            }
+
+            double encode_time = 0, decode_time = 0;
+            size_t encoded_length = 0, decoded_length = 0, consumed;
+
+            for (int round = 0; round < BENCH_ROUNDS; round++) {
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                encoded_length = url_encode(data, length, encoded, URL_MODE_FORM);
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                double t = elapsed_seconds(&start, &end);
+                if (round == 0 || t < encode_time) encode_time = t;
+
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                decoded_length = url_decode(encoded, encoded_length, decoded, URL_MODE_FORM,
+                                            true, &consumed);
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                t = elapsed_seconds(&start, &end);
+                if (round == 0 || t < decode_time) decode_time = t;
+            }
+
+            bool ok = decoded_length == length && memcmp(decoded, data, length) == 0;
+            if (k == URL_KERNEL_SCALAR) {
+                memcpy(reference, encoded, encoded_length);
+                reference_length = encoded_length;
+            } else if (encoded_length != reference_length ||
+                       memcmp(reference, encoded, encoded_length) != 0) {
+                ok = false;
+            }
+
+            printf("  %-8s %7.2f GB/s %7.2f GB/s%s\n", url_kernel_name((UrlKernel)k),
+                   (double)length / encode_time / 1e9, (double)length / decode_time / 1e9,
+                   ok ? "" : "  MISMATCH");
+            if (!ok) status = ERROR_UNKNOWN;
+        }
+    }
+
+    url_set_kernel(best);
+    FREE(data);
+    FREE(encoded);
+    FREE(reference);
+    FREE(decoded);
+    return status;
+}
+
+int url_encoder_execute(int argc, char *argv[]) {
+    bool decode = false;
+    UrlMode mode = URL_MODE_COMPONENT;
+    const char *text = NULL;
+    bool batch_mode = false;
+    size_t bench_megabytes = 0;
+
+    static struct option long_options[] = {
+        {"encode", no_argument, 0, 'e'},
+        {"decode", no_argument, 0, 'd'},
+        {"form", no_argument, 0, 'f'},
+        {"string", required_argument, 0, 's'},
+        {"batch", no_argument, 0, 'b'},
+        {"kernel", required_argument, 0, 1000},
+        {"bench", required_argument, 0, 1001},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    // Reset getopt state left over from global option parsing
+    optind = 0;
+
+    int c;
+    while ((c = getopt_long(argc, argv, "edfs:bh", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'e':
+                decode = false;
+                break;
+
+            case 'd':
+                decode = true;
+                break;
+
+            case 'f':
+                mode = URL_MODE_FORM;
+                break;
+
+            case 's':
+                text = optarg;
+                break;
+
+            case 'b':
+                batch_mode = true;
+                break;
+
+            case 1000: { // --kernel
+                int kernel = 0;
+                while (kernel < URL_KERNEL_COUNT &&
+                       strcmp(optarg, url_kernel_name((UrlKernel)kernel)) != 0) {
+                    kernel++;
+                }
+                if (kernel == URL_KERNEL_COUNT) {
+                    LOG_ERROR("Unknown kernel: %s (use scalar, sse2 or avx2)", optarg);
+                    return ERROR_INVALID_ARGUMENT;
+                }
+                if (!url_set_kernel((UrlKernel)kernel)) {
+                    LOG_ERROR("Kernel %s is not supported by this CPU", optarg);
+                    return ERROR_INVALID_ARGUMENT;
+                }
+                break;
+            }
+
+            case 1001: // --bench
+                bench_megabytes = strtoul(optarg, NULL, 10);
+                break;
+
+            case 'h':
+                url_encoder_help();
+                return SUCCESS;
+
+            default:
+                return ERROR_INVALID_ARGUMENT;
+        }
+    }
+
+    if (bench_megabytes > 0) {
+        return run_benchmark(bench_megabytes);
+    }
+
+    if (text) {
+        return transform_string(text, decode, mode);
+    }
+
+    // Stream each file (or stdin) to stdout, bypassing stdio
+    fflush(stdout);
+
+    UrlBatch batch = {
+        .writer = NULL, .decode = decode, .mode = mode, .records = 0, .invalid = 0
+    };
+    UrlBatch *records = batch_mode ? &batch : NULL;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int result = SUCCESS;
+    if (optind >= argc) {
+        result = convert_stream(STDIN_FILENO, decode, mode, records);
+    }
+
+    for (int i = optind; i < argc; i++) {
+        bool from_stdin = strcmp(argv[i], "-") == 0;
+        int fd = from_stdin ? STDIN_FILENO : open(argv[i], O_RDONLY);
+        if (fd < 0) {
+            fprintf(stderr, "url-encoder: %s: %s\n", argv[i], strerror(errno));
+            result = errno == ENOENT ? ERROR_FILE_NOT_FOUND : ERROR_PERMISSION_DENIED;
+            continue;
+        }
+
+        int status = convert_stream(fd, decode, mode, records);
+        if (status != SUCCESS) {
+            result = status;
+        }
+
+        if (!from_stdin) close(fd);
+    }
+
+    if (batch_mode) {
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double elapsed = elapsed_seconds(&start, &end);
+        if (elapsed <= 0) elapsed = 1e-9;
+
+        if (!g_config.quiet) {
+            fprintf(stderr, "url-encoder: %zu records (%zu invalid) in %.3f s, %.0f records/s\n",
+                    batch.records, batch.invalid, elapsed, (double)batch.records / elapsed);
+        }
+        if (result == SUCCESS && batch.invalid > 0) {
+            result = ERROR_PARSE_ERROR;
+        }
+    }
+
+    return result;
+}
+
+void url_encoder_help(void) {
+    printf("URL Encoder/Decoder Tool\n");
+    printf("========================\n");
+    printf("Percent-encodes or decodes text (RFC 3986). Files and stdin are streamed\n");
+    printf("to stdout through a fixed double buffer, so input of any size runs in\n");
+    printf("constant memory. Runs of plain bytes are copied with SSE2/AVX2 when\n");
+    printf("available. Malformed escapes are passed through unchanged.\n");
+    printf("\nOptions:\n");
+    printf("  -e, --encode        Encode (default)\n");
+    printf("  -d, --decode        Decode\n");
+    printf("  -f, --form          Form encoding: space is written and read as '+'\n");
+    printf("  -s, --string TEXT   Convert TEXT instead of reading input\n");
+    printf("  -b, --batch         Convert each input line as a separate record and\n");
+    printf("                      report records/s on stderr; decoded records must\n");
+    printf("                      not contain newlines\n");
+    printf("      --kernel NAME   Force a kernel: scalar, sse2 or avx2\n");
+    printf("      --bench MB      Compare kernel throughput on MB of text and binary data\n");
+    printf("\nUsage:\n");
+    printf("  devtools url-encoder -s 'a b&c=d'\n");
+    printf("  devtools url-encoder -d -f < query.txt\n");
+    printf("  devtools url-encoder payload.bin > payload.url\n");
+    printf("  devtools url-encoder -b -f < queries.txt > encoded.txt\n");
+}
@@ -0,0 +1,55 @@
+#ifndef DEVTOOLS_URL_ENCODER_H
+#define DEVTOOLS_URL_ENCODER_H
+
+#include "../../config.h"
+
+// Streaming block size. Input is double-buffered in blocks of this size and
+// an escape split across two blocks is carried over, so memory use does not
+// depend on the input length.
+#define URL_STREAM_BLOCK (1024 * 1024)
+
+// Longest incomplete escape ("%" or "%X") that can end a block
+#define URL_ESCAPE_CARRY 2
+
+// Worst-case output sizes: every byte becomes "%XX" when encoding, and
+// decoding never grows its input
+#define URL_ENCODED_MAX(length) ((length) * 3)
+#define URL_DECODED_MAX(length) (length)
+
+typedef enum {
+    URL_MODE_COMPONENT,     // RFC 3986: everything but unreserved is escaped
+    URL_MODE_FORM           // application/x-www-form-urlencoded: space is '+'
+} UrlMode;
+
+typedef enum {
+    URL_KERNEL_SCALAR,
+    URL_KERNEL_SSE2,
+    URL_KERNEL_AVX2,
+    URL_KERNEL_COUNT
+} UrlKernel;
+
+// Kernel selection (runtime CPU dispatch; the best one is used by default).
+// Every kernel shares the table-driven scalar path for bytes that need
+// converting; the vector kernels copy the runs in between.
+UrlKernel url_best_kernel(void);
+UrlKernel url_kernel(void);
+bool url_set_kernel(UrlKernel kernel);
+bool url_kernel_supported(UrlKernel kernel);
+const char* url_kernel_name(UrlKernel kernel);
+
+// Codec. Encoding escapes every byte outside ALPHA / DIGIT / "-._~" (and
+// writes space as '+' in form mode). Decoding turns "%XX" into a byte and,
+// in form mode, '+' into a space; malformed escapes are copied unchanged.
+size_t url_encode(const unsigned char *in, size_t length, char *out, UrlMode mode);
+
+// When `final` is false, an incomplete escape at the very end of the input
+// is left undecoded and *consumed stops in front of it, so the caller can
+// carry it into the next block.
+size_t url_decode(const char *in, size_t length, unsigned char *out, UrlMode mode,
+                  bool final, size_t *consumed);
+
+// Tool entry points
+int url_encoder_execute(int argc, char *argv[]);
+void url_encoder_help(void);
+
+#endif // DEVTOOLS_URL_ENCODER_H